@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""Heap stress harness for an HSC_Base board.
+
+Loads the web server with concurrent requests, the traffic that fragments
+the heap through AsyncWebServer, ArduinoJson and String allocations, and
+follows the heap guard in /api/metrics while it runs.
+
+Usage:
+    heapstress.py 192.168.1.50 --clients 8 --duration 120
+    heapstress.py 192.168.1.50 --fragment 4096
+
+--fragment needs firmware built with HSC_FAULT_INJECTION (config.h): the
+board fills its heap with blocks of that many bytes separated by pinned
+ones and frees the blocks, so the free heap stays high but no allocation
+larger than the block fits. 4096 should reach "critical", 12288 "low".
+The fragmentation is undone when the run ends.
+
+Every second it prints the heap level, free heap, largest free block and
+the requests answered, shed (503), rate limited (429) and failed since the
+last line. Shed and limited requests are expected under load; failed ones
+(timeouts, resets) or a reboot are what the guards should prevent.
+
+--rate paces each client to that many requests per second, e.g. to check
+that clients under the board's per-client limit are never refused.
+"""
+
+import argparse
+import collections
+import json
+import sys
+import threading
+import time
+import urllib.error
+import urllib.request
+
+PATHS = ["/", "/api/status", "/api/settings", "/api/metrics", "/api/events",
+         "/api/tracks", "/api/tracks/stats"]
+TIMEOUT_S = 10
+
+
+def request(base, path, method="GET"):
+    req = urllib.request.Request(base + path, method=method)
+    with urllib.request.urlopen(req, timeout=TIMEOUT_S) as resp:
+        return resp.status, resp.read()
+
+
+def worker(base, paths, index, counts, lock, stop, rate):
+    i = index
+    while not stop.is_set():
+        if rate:
+            stop.wait(1 / rate)
+        path = paths[i % len(paths)]
+        i += 1
+        try:
+            status, _ = request(base, path)
+            key = "ok" if status == 200 else str(status)
+        except urllib.error.HTTPError as e:
+            key = {503: "shed", 429: "limited"}.get(e.code, str(e.code))
+        except OSError:
+            key = "failed"
+        with lock:
+            counts[key] += 1
+
+
+def metrics(base):
+    try:
+        _, body = request(base, "/api/metrics")
+        return json.loads(body)
+    except (OSError, ValueError):
+        return None
+
+
+def fragment(base, size):
+    try:
+        request(base, f"/api/fault?section=heap&bytes={size}", "POST")
+        return True
+    except urllib.error.HTTPError as e:
+        if e.code == 404:
+            sys.exit("/api/fault not found: build with HSC_FAULT_INJECTION")
+        raise
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("host")
+    parser.add_argument("--clients", type=int, default=6)
+    parser.add_argument("--duration", type=float, default=60)
+    parser.add_argument("--fragment", type=int, metavar="BYTES",
+                        help="fragment the heap into holes of BYTES first")
+    parser.add_argument("--rate", type=float,
+                        help="requests per second per client")
+    parser.add_argument("--path", action="append",
+                        help="request only these paths (repeatable)")
+    args = parser.parse_args()
+    base = "http://" + args.host
+
+    start = metrics(base)
+    if not start or "heap" not in start:
+        sys.exit(f"{base}/api/metrics has no heap report")
+    if args.fragment:
+        fragment(base, args.fragment)
+
+    counts = collections.Counter()
+    lock = threading.Lock()
+    stop = threading.Event()
+    threads = [threading.Thread(target=worker,
+                                args=(base, args.path or PATHS, n, counts,
+                                      lock, stop, args.rate), daemon=True)
+               for n in range(args.clients)]
+    for t in threads:
+        t.start()
+
+    levels = collections.Counter()
+    worst = None
+    end = time.monotonic() + args.duration
+    try:
+        while time.monotonic() < end:
+            time.sleep(1)
+            with lock:
+                window = dict(counts)
+                counts.clear()
+            m = metrics(base)
+            if not m:
+                print("metrics unavailable")
+                continue
+            h = m["heap"]
+            levels[h["level"]] += 1
+            if worst is None or h["largest_block"] < worst["largest_block"]:
+                worst = h
+            print(f"{h['level']:8} free {h['free']:6} largest "
+                  f"{h['largest_block']:6} frag {h['fragmentation']:3}% | "
+                  f"ok {window.get('ok', 0):4} shed "
+                  f"{window.get('shed', 0):4} limited "
+                  f"{window.get('limited', 0):4} failed "
+                  f"{window.get('failed', 0):3}")
+    except KeyboardInterrupt:
+        pass
+    stop.set()
+    for t in threads:
+        t.join(TIMEOUT_S)
+    if args.fragment:
+        fragment(base, 0)
+
+    m = metrics(base) or {}
+    h = m.get("heap", {})
+    print(f"seconds per level: {dict(levels)}")
+    if worst:
+        print(f"lowest largest block {worst['largest_block']} "
+              f"(free {worst['free']}), min free since boot "
+              f"{h.get('min_free')}")
+    print(f"web rejected {h.get('web_rejected')}, history refused "
+          f"{h.get('history_refused')}, level changes {h.get('transitions')}")
+    w = m.get("web", {})
+    print(f"web admitted {w.get('admitted')}, client limited "
+          f"{w.get('client_limited')}, global limited "
+          f"{w.get('global_limited')}, busy {w.get('busy')}, deferred "
+          f"{w.get('deferred')}, peak open {w.get('peak_open')}")
+    if not h:
+        print("board did not answer at the end: check for a reboot")
+
+
+if __name__ == "__main__":
+    main()
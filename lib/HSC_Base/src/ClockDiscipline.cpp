@@ -0,0 +1,94 @@
+#include "ClockDiscipline.h"
+
+ClockDiscipline::ClockDiscipline()
+    : _synced(false), _anchorMono(0), _anchorUtc(0), _freqPpb(0),
+      _slewUs(0), _offsetUs(0), _spike(false), _spikeOffsetUs(0), _syncs(0),
+      _steps(0), _rejected(0) {}
+
+// Part of slewUs taken up after elapsed µs at CLOCK_SLEW_PPM
+static int64_t slewed(int64_t slewUs, int64_t elapsed) {
+  if (elapsed <= 0)
+    return 0;
+  int64_t limit = elapsed * CLOCK_SLEW_PPM / 1000000;
+  if (slewUs > limit)
+    return limit;
+  if (slewUs < -limit)
+    return -limit;
+  return slewUs;
+}
+
+void ClockDiscipline::sample(int64_t monoUs, int64_t ntpUs) {
+  _syncs++;
+  if (!_synced) {
+    _synced = true;
+    _anchorMono = monoUs;
+    _anchorUtc = ntpUs;
+    _steps++;
+    return;
+  }
+
+  int64_t local = utcAt(monoUs);
+  int64_t offset = ntpUs - local;
+  _offsetUs = offset;
+
+  if (offset > CLOCK_STEP_US || offset < -CLOCK_STEP_US) {
+    // One reply this far off is more likely bad (delayed, or from a server
+    // that is wrong for a moment) than the clock: wait for the next
+    int64_t change = offset - _spikeOffsetUs;
+    if (!_spike || change > CLOCK_STEP_US || change < -CLOCK_STEP_US) {
+      _spike = true;
+      _spikeOffsetUs = offset;
+      _rejected++;
+      return;
+    }
+    // Confirmed and too far off to slew in reasonable time (a bad first
+    // sample, or the server itself was stepped)
+    _spike = false;
+    _anchorMono = monoUs;
+    _anchorUtc = ntpUs;
+    _slewUs = 0;
+    _steps++;
+    return;
+  }
+
+  _spike = false;
+
+  // Whatever the last slew did not take up yet is not drift
+  int64_t elapsed = monoUs - _anchorMono;
+  if (elapsed >= CLOCK_MIN_DRIFT_INTERVAL_US) {
+    int64_t drift = offset - (_slewUs - slewed(_slewUs, elapsed));
+    _freqPpb += drift * 1000000000 / elapsed / CLOCK_FREQ_GAIN;
+    int64_t maxPpb = (int64_t)CLOCK_MAX_FREQ_PPM * 1000;
+    if (_freqPpb > maxPpb)
+      _freqPpb = maxPpb;
+    if (_freqPpb < -maxPpb)
+      _freqPpb = -maxPpb;
+  }
+
+  // Continue from where the old mapping is, and slew the rest in
+  _anchorMono = monoUs;
+  _anchorUtc = local;
+  _slewUs = offset;
+}
+
+int64_t ClockDiscipline::utcAt(int64_t monoUs) const {
+  if (!_synced)
+    return 0;
+  int64_t elapsed = monoUs - _anchorMono;
+  return _anchorUtc + elapsed + elapsed * _freqPpb / 1000000000 +
+         slewed(_slewUs, elapsed);
+}
+
+ClockStats ClockDiscipline::stats(int64_t monoUs) const {
+  ClockStats st;
+  int64_t elapsed = monoUs - _anchorMono;
+  st.synced = _synced;
+  st.offsetUs = _offsetUs;
+  st.driftPpm = _freqPpb / 1000.0f;
+  st.slewUs = _synced ? _slewUs - slewed(_slewUs, elapsed) : 0;
+  st.syncs = _syncs;
+  st.steps = _steps;
+  st.rejected = _rejected;
+  st.lastSyncAgeS = _synced ? elapsed / 1000000 : 0;
+  return st;
+}
@@ -0,0 +1,64 @@
+#ifndef CLOCK_DISCIPLINE_H
+#define CLOCK_DISCIPLINE_H
+
+#include <stdint.h>
+
+// --- Clock Tuning ---
+// Offsets beyond this are stepped, smaller ones slewed (as ntpd does). A
+// single sample this far off is dropped as a spike; the clock is stepped
+// once the next one agrees with it to within the same margin.
+static const int64_t CLOCK_STEP_US = 128000;
+// Fastest slew and largest frequency correction, in parts per million
+static const int32_t CLOCK_SLEW_PPM = 500;
+static const int32_t CLOCK_MAX_FREQ_PPM = 500;
+// Syncs closer together than this are too short to estimate drift from
+static const int64_t CLOCK_MIN_DRIFT_INTERVAL_US = 60000000;
+// Only 1/CLOCK_FREQ_GAIN of the drift seen in one interval is taken up,
+// so a noisy sample cannot swing the frequency
+static const int32_t CLOCK_FREQ_GAIN = 4;
+
+struct ClockStats {
+  bool synced;
+  int64_t offsetUs; // Last measured NTP - local
+  float driftPpm;   // Frequency correction applied to the local clock
+  int64_t slewUs;   // Correction still being slewed in
+  uint32_t syncs;
+  uint32_t steps;
+  uint32_t rejected;     // Spikes dropped
+  uint32_t lastSyncAgeS; // Seconds since the last NTP sample
+};
+
+// Maps the monotonic esp_timer clock to UTC. Each NTP sample re-anchors
+// the mapping where the old one leaves off and slews the measured offset in
+// at up to CLOCK_SLEW_PPM, so UTC from utcAt() never jumps or runs
+// backwards unless the offset is beyond CLOCK_STEP_US twice in a row. The
+// part of the offset that is drift also corrects the frequency, so the
+// clock stays close between samples. Pure logic, so it can be run against
+// recorded or simulated samples on the host.
+class ClockDiscipline {
+public:
+  ClockDiscipline();
+
+  // Feed an NTP sample: the UTC time ntpUs read at monotonic time monoUs
+  void sample(int64_t monoUs, int64_t ntpUs);
+
+  bool synced() const { return _synced; }
+  // UTC in µs at monotonic time monoUs, 0 before the first sample
+  int64_t utcAt(int64_t monoUs) const;
+  ClockStats stats(int64_t monoUs) const;
+
+private:
+  bool _synced;
+  int64_t _anchorMono;
+  int64_t _anchorUtc;
+  int64_t _freqPpb;
+  int64_t _slewUs;
+  int64_t _offsetUs;
+  bool _spike; // The last sample was beyond CLOCK_STEP_US
+  int64_t _spikeOffsetUs;
+  uint32_t _syncs;
+  uint32_t _steps;
+  uint32_t _rejected;
+};
+
+#endif
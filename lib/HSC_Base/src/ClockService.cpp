@@ -0,0 +1,58 @@
+#include "ClockService.h"
+#include <esp_sntp.h>
+#include <esp_timer.h>
+
+ClockService *ClockService::_instance = nullptr;
+
+ClockService::ClockService() : _mux(portMUX_INITIALIZER_UNLOCKED) {}
+
+void ClockService::begin(const char *server, const char *tz) {
+  _instance = this;
+  sntp_set_time_sync_notification_cb(onSync);
+  sntp_set_sync_interval(CLOCK_SYNC_INTERVAL_MS);
+  // The public pool stays as a fallback for a local server that is down
+  const char *fallback = "pool.ntp.org";
+  if (!server || !*server)
+    server = fallback;
+  configTzTime(tz, server, strcmp(server, fallback) ? fallback : nullptr);
+}
+
+// Runs on the SNTP task right after it has set the system time to tv
+void ClockService::onSync(struct timeval *tv) {
+  int64_t mono = esp_timer_get_time();
+  int64_t ntp = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+  ClockService *self = _instance;
+  if (!self)
+    return;
+  portENTER_CRITICAL(&self->_mux);
+  self->_discipline.sample(mono, ntp);
+  portEXIT_CRITICAL(&self->_mux);
+}
+
+bool ClockService::synced() const {
+  portENTER_CRITICAL(&_mux);
+  bool synced = _discipline.synced();
+  portEXIT_CRITICAL(&_mux);
+  return synced;
+}
+
+int64_t ClockService::monoMicros() const { return esp_timer_get_time(); }
+
+int64_t ClockService::utcAt(int64_t monoUs) const {
+  portENTER_CRITICAL(&_mux);
+  int64_t utc = _discipline.utcAt(monoUs);
+  portEXIT_CRITICAL(&_mux);
+  return utc;
+}
+
+time_t ClockService::bootTime() const {
+  return utcAt(0) / 1000000;
+}
+
+ClockStats ClockService::stats() const {
+  int64_t mono = monoMicros();
+  portENTER_CRITICAL(&_mux);
+  ClockStats st = _discipline.stats(mono);
+  portEXIT_CRITICAL(&_mux);
+  return st;
+}
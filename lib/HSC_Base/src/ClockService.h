@@ -0,0 +1,44 @@
+#ifndef CLOCK_SERVICE_H
+#define CLOCK_SERVICE_H
+
+#include "ClockDiscipline.h"
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <stdint.h>
+#include <time.h>
+
+// --- Clock Service Tuning ---
+// SNTP poll interval
+static const uint32_t CLOCK_SYNC_INTERVAL_MS = 600000;
+
+// System clock service: SNTP from the configured server (a local one keeps
+// a layout's boards within a few ms of each other) and the TZ for local
+// time, disciplining a ClockDiscipline that event stamps come from.
+// Samples arrive on the SNTP task; the readers are safe from any task.
+class ClockService {
+public:
+  ClockService();
+
+  // Start SNTP; call once WiFi is up. tz is a POSIX TZ string.
+  void begin(const char *server, const char *tz);
+
+  bool synced() const;
+  // Monotonic µs since boot, the base for all captured timestamps
+  int64_t monoMicros() const;
+  // UTC µs now or at a monotonic time; 0 until the first sync
+  int64_t nowUtcMicros() const { return utcAt(monoMicros()); }
+  int64_t utcAt(int64_t monoUs) const;
+  // UTC time of boot in seconds, 0 until the first sync
+  time_t bootTime() const;
+
+  ClockStats stats() const;
+
+private:
+  ClockDiscipline _discipline;
+  mutable portMUX_TYPE _mux;
+
+  static ClockService *_instance;
+  static void onSync(struct timeval *tv);
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "ConfigManager.h"
+#include "DeviceProfile.h"
 #include "config.h"
 
 ConfigManager::ConfigManager() { loadDefaults(); }
@@ -15,10 +16,25 @@ void ConfigManager::loadDefaults() {
   _config.mqtt_port = MQTT_PORT;
   _config.mqtt_user = MQTT_USER;
   _config.mqtt_password = MQTT_PASSWORD;
+  _config.mqtt_fallback = MQTT_FALLBACK;
+  _config.mqtt_dual = false;
   _config.board_id = BOARD_ID;
   _config.location = "";
+  _config.low_power = false;
+  _config.peer_link = false;
+  _config.ntp_server = NTP_SERVER;
+  _config.tz = NTP_TZ;
   _config.location = "";
   _config.update_url = "";
+  for (int i = 0; i < MAX_TRACK_INPUTS; i++) {
+    _config.debounce_ms[i] = 0;
+    _config.debounce_adaptive[i] = false;
+    _config.track_pins[i] = 0;
+  }
+  _config.num_tracks = 0;
+  _config.rules = "";
+  _config.provision_key = PROVISION_KEY;
+  _config.provision_seq = 0;
 }
 
 Config ConfigManager::load() {
@@ -39,18 +55,46 @@ Config ConfigManager::load() {
   _config.mqtt_port = _prefs.getInt("mqtt_port", MQTT_PORT);
   _config.mqtt_user = _prefs.getString("mqtt_user", MQTT_USER);
   _config.mqtt_password = _prefs.getString("mqtt_pass", MQTT_PASSWORD);
+  _config.mqtt_fallback = _prefs.getString("mqtt_fb", MQTT_FALLBACK);
+  _config.mqtt_dual = _prefs.getBool("mqtt_dual", false);
   _config.board_id = _prefs.getInt("board_id", BOARD_ID);
   _config.location = _prefs.getString("location", "");
+  _config.low_power = _prefs.getBool("low_power", false);
+  _config.peer_link = _prefs.getBool("peer_link", false);
+  _config.ntp_server = _prefs.getString("ntp_server", NTP_SERVER);
+  _config.tz = _prefs.getString("tz", NTP_TZ);
+  _config.rules = _prefs.getString("rules", "");
+  _config.provision_key = _prefs.getString("prov_key", PROVISION_KEY);
+  _config.provision_seq = _prefs.getUInt("prov_seq", 0);
   // _config.update_url is set by loadDefaults() and not stored in NVS to allow
   // config.h changes
   _config.update_url = "";
 
+  // Per-track arrays are optional blobs. A blob saved by a build with fewer
+  // track slots fills the leading entries, the rest keep their defaults.
+  loadBlob("debounce", _config.debounce_ms, sizeof(_config.debounce_ms));
+  loadBlob("db_adapt", _config.debounce_adaptive,
+           sizeof(_config.debounce_adaptive));
+  _config.num_tracks = _prefs.getUChar("num_tracks", 0);
+  size_t pinBytes =
+      loadBlob("track_pins", _config.track_pins, sizeof(_config.track_pins));
+  if (_config.num_tracks > (int)pinBytes) {
+    _config.num_tracks = 0;
+  }
+
   _prefs.end();
 
   Serial.println("Config loaded from NVS");
   return _config;
 }
 
+size_t ConfigManager::loadBlob(const char *key, void *dest, size_t size) {
+  size_t len = _prefs.getBytesLength(key);
+  if (len == 0 || len > size)
+    return 0;
+  return _prefs.getBytes(key, dest, len);
+}
+
 bool ConfigManager::save(const Config &config) {
   _prefs.begin("yarddetector", false); // Read-write mode
 
@@ -61,10 +105,24 @@ bool ConfigManager::save(const Config &config) {
   _prefs.putInt("mqtt_port", config.mqtt_port);
   _prefs.putString("mqtt_user", config.mqtt_user);
   _prefs.putString("mqtt_pass", config.mqtt_password);
+  _prefs.putString("mqtt_fb", config.mqtt_fallback);
+  _prefs.putBool("mqtt_dual", config.mqtt_dual);
   _prefs.putInt("board_id", config.board_id);
   _prefs.putString("location", config.location);
+  _prefs.putBool("low_power", config.low_power);
+  _prefs.putBool("peer_link", config.peer_link);
+  _prefs.putString("ntp_server", config.ntp_server);
+  _prefs.putString("tz", config.tz);
+  _prefs.putString("rules", config.rules);
+  _prefs.putString("prov_key", config.provision_key);
+  _prefs.putUInt("prov_seq", config.provision_seq);
   _prefs.putString("location", config.location);
   // _prefs.putString("update_url", config.update_url); // Moved to config.h
+  _prefs.putBytes("debounce", config.debounce_ms, sizeof(config.debounce_ms));
+  _prefs.putBytes("db_adapt", config.debounce_adaptive,
+                  sizeof(config.debounce_adaptive));
+  _prefs.putUChar("num_tracks", config.num_tracks);
+  _prefs.putBytes("track_pins", config.track_pins, sizeof(config.track_pins));
 
   _prefs.end();
 
@@ -81,3 +139,25 @@ void ConfigManager::reset() {
   loadDefaults();
   Serial.println("Config reset to defaults");
 }
+
+bool ConfigManager::validateTrackPins(const uint8_t *pins, int count,
+                                      String &error) {
+  if (count < 1 || count > MAX_TRACK_INPUTS) {
+    error = "Track count must be 1-" + String(MAX_TRACK_INPUTS);
+    return false;
+  }
+
+  uint64_t seen = 0;
+  for (int i = 0; i < count; i++) {
+    if (!isTrackInputGpio(pins[i])) {
+      error = "GPIO " + String(pins[i]) + " cannot be used as a track input";
+      return false;
+    }
+    if (seen & (1ULL << pins[i])) {
+      error = "GPIO " + String(pins[i]) + " is used more than once";
+      return false;
+    }
+    seen |= 1ULL << pins[i];
+  }
+  return true;
+}
@@ -5,6 +5,9 @@
 #include <Arduino.h>
 #include <Preferences.h>
 
+// Upper bound on track inputs stored in Config
+static const int MAX_TRACK_INPUTS = 64;
+
 struct Config {
   String wifi_ssid;
   String wifi_password;
@@ -12,9 +15,33 @@ struct Config {
   int mqtt_port;
   String mqtt_user;
   String mqtt_password;
+  // Fallback brokers, "host[:port],..." in order of preference
+  String mqtt_fallback;
+  // Also publish everything to the best available fallback
+  bool mqtt_dual;
   int board_id;
   String location;
+  // Modem sleep and light sleep between track events
+  bool low_power;
+  // Share occupancy with neighbouring boards over UDP multicast
+  bool peer_link;
+  // SNTP server and POSIX TZ string
+  String ntp_server;
+  String tz;
   String update_url;
+  // Per-track debounce window in ms (0 = application default)
+  uint16_t debounce_ms[MAX_TRACK_INPUTS];
+  // Per-track adaptive debounce enable
+  bool debounce_adaptive[MAX_TRACK_INPUTS];
+  // Application rule source (derived states), empty for none
+  String rules;
+  // Key for signed provisioning bundles, empty to refuse them
+  String provision_key;
+  // Sequence number of the last bundle applied; older ones are refused
+  uint32_t provision_seq;
+  // Runtime track pin map (num_tracks = 0 uses the compiled-in pins)
+  int num_tracks;
+  uint8_t track_pins[MAX_TRACK_INPUTS];
 };
 
 class ConfigManager {
@@ -26,10 +53,15 @@ public:
   void reset();
   Config get() const { return _config; }
 
+  // Check a track pin map; on failure error describes the first problem
+  static bool validateTrackPins(const uint8_t *pins, int count,
+                                String &error);
+
 private:
   Config _config;
   Preferences _prefs;
   void loadDefaults();
+  size_t loadBlob(const char *key, void *dest, size_t size);
 };
 
 #endif
@@ -0,0 +1,166 @@
+#include "DeltaPatch.h"
+#include <string.h>
+
+static uint32_t readLe32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+DeltaPatch::DeltaPatch(SourceReader reader, OutputWriter writer)
+    : _read(reader), _write(writer) {
+  reset();
+}
+
+void DeltaPatch::reset() {
+  _state = STATE_HEADER;
+  _error = DELTA_OK;
+  _headerLen = 0;
+  _op = DELTA_OP_END;
+  _arg = 0;
+  _argShift = 0;
+  _remaining = 0;
+  _sourceSize = 0;
+  _targetSize = 0;
+  _srcPos = 0;
+  _produced = 0;
+}
+
+bool DeltaPatch::parseHeader(const uint8_t *data, size_t len,
+                             uint32_t &sourceSize, uint32_t &targetSize) {
+  if (len < DELTA_HEADER_SIZE || memcmp(data, "HSCD", 4) != 0 ||
+      data[4] != DELTA_FORMAT_VERSION)
+    return false;
+  sourceSize = readLe32(data + 8);
+  targetSize = readLe32(data + 12);
+  return true;
+}
+
+DeltaResult DeltaPatch::feed(const uint8_t *data, size_t len) {
+  size_t i = 0;
+  while (i < len) {
+    switch (_state) {
+    case STATE_HEADER:
+      _header[_headerLen++] = data[i++];
+      if (_headerLen == DELTA_HEADER_SIZE) {
+        if (!parseHeader(_header, _headerLen, _sourceSize, _targetSize))
+          return fail(DELTA_ERR_FORMAT);
+        _state = STATE_OP;
+      }
+      break;
+
+    case STATE_OP:
+      _op = data[i++];
+      if (_op == DELTA_OP_END) {
+        if (_produced != _targetSize)
+          return fail(DELTA_ERR_RANGE);
+        _state = STATE_DONE;
+      } else if (_op > DELTA_OP_SEEK) {
+        return fail(DELTA_ERR_FORMAT);
+      } else {
+        _arg = 0;
+        _argShift = 0;
+        _state = STATE_ARG;
+      }
+      break;
+
+    case STATE_ARG: {
+      uint8_t b = data[i++];
+      if (_argShift > 28)
+        return fail(DELTA_ERR_FORMAT);
+      _arg |= (uint32_t)(b & 0x7F) << _argShift;
+      _argShift += 7;
+      if (b & 0x80)
+        break;
+      DeltaResult result = startOp();
+      if (result != DELTA_OK)
+        return result;
+      break;
+    }
+
+    case STATE_DATA: {
+      size_t n = len - i;
+      if (n > _remaining)
+        n = _remaining;
+      if (n > DELTA_BUFFER_SIZE)
+        n = DELTA_BUFFER_SIZE;
+
+      if (_op == DELTA_OP_ADD) {
+        if (!_read(_srcPos, _buf, n))
+          return fail(DELTA_ERR_SOURCE);
+        for (size_t k = 0; k < n; k++) {
+          _buf[k] += data[i + k];
+        }
+        _srcPos += n;
+        if (!_write(_buf, n))
+          return fail(DELTA_ERR_WRITE);
+      } else if (!_write(data + i, n)) {
+        return fail(DELTA_ERR_WRITE);
+      }
+
+      i += n;
+      _produced += n;
+      _remaining -= n;
+      if (_remaining == 0)
+        _state = STATE_OP;
+      break;
+    }
+
+    case STATE_DONE:
+      return fail(DELTA_ERR_FORMAT); // Data after END
+
+    case STATE_ERROR:
+      return _error;
+    }
+  }
+  return (_state == STATE_DONE) ? DELTA_DONE : DELTA_OK;
+}
+
+DeltaResult DeltaPatch::startOp() {
+  uint32_t n = _arg;
+  _state = STATE_OP;
+
+  switch (_op) {
+  case DELTA_OP_SEEK: {
+    int32_t delta = (int32_t)(n >> 1) ^ -(int32_t)(n & 1);
+    int64_t pos = (int64_t)_srcPos + delta;
+    if (pos < 0 || pos > _sourceSize)
+      return fail(DELTA_ERR_RANGE);
+    _srcPos = (uint32_t)pos;
+    return DELTA_OK;
+  }
+
+  case DELTA_OP_COPY:
+    if (n > _sourceSize - _srcPos || n > _targetSize - _produced)
+      return fail(DELTA_ERR_RANGE);
+    while (n > 0) {
+      size_t chunk = (n < DELTA_BUFFER_SIZE) ? n : DELTA_BUFFER_SIZE;
+      if (!_read(_srcPos, _buf, chunk))
+        return fail(DELTA_ERR_SOURCE);
+      if (!_write(_buf, chunk))
+        return fail(DELTA_ERR_WRITE);
+      _srcPos += chunk;
+      _produced += chunk;
+      n -= chunk;
+    }
+    return DELTA_OK;
+
+  case DELTA_OP_ADD:
+  case DELTA_OP_INSERT:
+    if ((_op == DELTA_OP_ADD && n > _sourceSize - _srcPos) ||
+        n > _targetSize - _produced)
+      return fail(DELTA_ERR_RANGE);
+    _remaining = n;
+    if (n > 0)
+      _state = STATE_DATA;
+    return DELTA_OK;
+
+  default:
+    return fail(DELTA_ERR_FORMAT);
+  }
+}
+
+DeltaResult DeltaPatch::fail(DeltaResult error) {
+  _state = STATE_ERROR;
+  _error = error;
+  return error;
+}
@@ -0,0 +1,100 @@
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary delta format produced by mkdelta.py (all values little-endian):
+//
+//   header  "HSCD", format version (1), 3 reserved bytes,
+//           uint32 source size, uint32 target size
+//   ops     one opcode byte followed by a LEB128 varint argument
+//     COPY   n          copy n bytes from the source
+//     ADD    n, bytes   copy n source bytes, adding each patch byte (mod 256)
+//     INSERT n, bytes   emit n literal bytes
+//     SEEK   d          move the source position by d (zigzag encoded)
+//     END               target complete
+//
+// Like bsdiff, a region of code that only moved is an ADD of mostly zero
+// bytes; those zero runs are stored as COPY so no compressor is needed.
+static const uint8_t DELTA_FORMAT_VERSION = 1;
+static const size_t DELTA_HEADER_SIZE = 16;
+// Source/output scratch buffer; the only RAM the applier needs
+static const size_t DELTA_BUFFER_SIZE = 512;
+
+enum DeltaOp : uint8_t {
+  DELTA_OP_END = 0,
+  DELTA_OP_COPY = 1,
+  DELTA_OP_ADD = 2,
+  DELTA_OP_INSERT = 3,
+  DELTA_OP_SEEK = 4,
+};
+
+enum DeltaResult : uint8_t {
+  DELTA_OK,         // More patch data expected
+  DELTA_DONE,       // END reached and the target is complete
+  DELTA_ERR_FORMAT, // Bad header, opcode or trailing data
+  DELTA_ERR_RANGE,  // Op reaches outside the source or target
+  DELTA_ERR_SOURCE, // Source read failed
+  DELTA_ERR_WRITE,  // Output write failed
+};
+
+// Streaming patch applier. The patch can be fed in pieces split at any
+// byte, so it can be applied straight from a network stream (and resumed
+// after a dropped connection by continuing to feed from the same offset).
+// No Arduino dependencies, so patches can be checked on the host.
+class DeltaPatch {
+public:
+  // Read len source bytes at offset into buf
+  typedef std::function<bool(uint32_t offset, uint8_t *buf, size_t len)>
+      SourceReader;
+  // Consume the next len bytes of the target
+  typedef std::function<bool(const uint8_t *data, size_t len)> OutputWriter;
+
+  DeltaPatch(SourceReader reader, OutputWriter writer);
+
+  void reset();
+
+  // Apply the next piece of the patch
+  DeltaResult feed(const uint8_t *data, size_t len);
+
+  bool isDone() const { return _state == STATE_DONE; }
+  uint32_t sourceSize() const { return _sourceSize; }
+  uint32_t targetSize() const { return _targetSize; }
+  uint32_t produced() const { return _produced; }
+
+  static bool parseHeader(const uint8_t *data, size_t len,
+                          uint32_t &sourceSize, uint32_t &targetSize);
+
+private:
+  enum State : uint8_t {
+    STATE_HEADER,
+    STATE_OP,
+    STATE_ARG,
+    STATE_DATA,
+    STATE_DONE,
+    STATE_ERROR,
+  };
+
+  SourceReader _read;
+  OutputWriter _write;
+  State _state;
+  DeltaResult _error;
+  uint8_t _header[DELTA_HEADER_SIZE];
+  size_t _headerLen;
+  uint8_t _op;
+  uint32_t _arg;
+  uint8_t _argShift;
+  uint32_t _remaining;
+  uint32_t _sourceSize;
+  uint32_t _targetSize;
+  uint32_t _srcPos;
+  uint32_t _produced;
+  uint8_t _buf[DELTA_BUFFER_SIZE];
+
+  DeltaResult startOp();
+  DeltaResult fail(DeltaResult error);
+};
+
+#endif
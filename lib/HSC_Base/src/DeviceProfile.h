@@ -0,0 +1,77 @@
+#ifndef DEVICE_PROFILE_H
+#define DEVICE_PROFILE_H
+
+#include "config.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Optional parts of a device; a profile without them compiles them out
+enum DeviceFeature : uint8_t {
+  DEVICE_FEATURE_EXPANDERS = 1 << 0,   // MCP23017 inputs on the I2C bus
+  DEVICE_FEATURE_TRACK_STATS = 1 << 1, // Occupancy statistics and API
+};
+
+// True if the GPIO can be used as a track input on the ESP32
+constexpr bool isTrackInputGpio(int pin) {
+  return pin >= 0 && pin <= 39 &&
+         // 20, 24 and 28-31 are not bonded out on the ESP32
+         pin != 20 && pin != 24 && !(pin >= 28 && pin <= 31) &&
+         // 6-11 are wired to the SPI flash
+         !(pin >= 6 && pin <= 11) &&
+         // 1 and 3 are the UART0 console
+         pin != 1 && pin != 3 &&
+         // 34-39 are input-only and have no internal pull-ups, so they need
+         // an external pull-up resistor but are otherwise valid
+         // Reserved by HSC_Base for the status LED and AP button
+         pin != 2 && pin != PIN_AP_BUTTON;
+}
+
+// Everything that sets one kind of board apart, fixed at compile time. The
+// application defines one constexpr profile in its config.h and hands it to
+// HSC_Base; identity strings stay in flash and sizes, masks and feature
+// checks fold into constants.
+struct DeviceProfile {
+  const char *desc;         // Full description for the web UI
+  const char *shortName;    // Board type for hostnames, MQTT and OTA URLs
+  const char *firmware;     // Firmware version
+  const char *topicPrefix;  // Application MQTT topics, e.g. "HSC/yard"
+  const uint8_t *trackPins; // Default native track pins
+  uint8_t trackCount;
+  uint8_t maxTracks;   // Native pins plus expanders (sizes the state arrays)
+  uint16_t debounceMs; // Default debounce window
+  uint8_t features;    // DeviceFeature bits
+
+  template <size_t N>
+  constexpr DeviceProfile(const char *desc, const char *shortName,
+                          const char *firmware, const char *topicPrefix,
+                          const uint8_t (&trackPins)[N], uint8_t maxTracks,
+                          uint16_t debounceMs, uint8_t features)
+      : desc(desc), shortName(shortName), firmware(firmware),
+        topicPrefix(topicPrefix), trackPins(trackPins), trackCount(N),
+        maxTracks(maxTracks), debounceMs(debounceMs), features(features) {}
+
+  constexpr bool has(DeviceFeature feature) const {
+    return (features & feature) != 0;
+  }
+
+  // Bit mask of the default track pins from index i on
+  constexpr uint64_t pinMask(size_t i = 0) const {
+    return i == trackCount ? 0 : (1ULL << trackPins[i]) | pinMask(i + 1);
+  }
+
+  // Every default pin is usable and none is listed twice
+  constexpr bool pinsValid(size_t i = 0) const {
+    return i == trackCount ||
+           (isTrackInputGpio(trackPins[i]) && pinsValid(i + 1));
+  }
+  constexpr bool pinsUnique() const {
+    return bitCount(pinMask()) == trackCount;
+  }
+
+private:
+  static constexpr int bitCount(uint64_t mask) {
+    return mask ? (int)(mask & 1) + bitCount(mask >> 1) : 0;
+  }
+};
+
+#endif
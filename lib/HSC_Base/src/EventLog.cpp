@@ -0,0 +1,266 @@
+#include "EventLog.h"
+#include <time.h>
+
+static const char *EVENT_LOG_PATH = "/events.log";
+static const char *EVENT_LOG_OLD_PATH = "/events.old";
+
+static portMUX_TYPE eventLogMux = portMUX_INITIALIZER_UNLOCKED;
+
+EventLog::EventLog() { _mutex = xSemaphoreCreateMutex(); }
+
+bool EventLog::begin() {
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  _mounted = true;
+
+  // A torn append leaves a partial record at the end of the segment. Start a
+  // new segment so later appends stay record-aligned; the reader resyncs past
+  // the damaged bytes using the per-record CRC.
+  if (SPIFFS.exists(EVENT_LOG_PATH)) {
+    File f = SPIFFS.open(EVENT_LOG_PATH, FILE_READ);
+    size_t size = f.size();
+    f.close();
+    if (size % EVENT_RECORD_SIZE != 0) {
+      Serial.println("Event log: partial record found, rotating segment");
+      rotateLocked();
+    }
+  }
+
+  recoverSeqLocked();
+  xSemaphoreGive(_mutex);
+
+  Serial.printf("Event log ready (next seq %u)\n", (unsigned)_nextSeq);
+  return true;
+}
+
+void EventLog::end() {
+  flush();
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  _mounted = false;
+  xSemaphoreGive(_mutex);
+}
+
+void EventLog::loop() {
+  int count;
+  unsigned long oldest;
+  portENTER_CRITICAL(&eventLogMux);
+  count = _pendingCount;
+  oldest = _oldestPendingMs;
+  portEXIT_CRITICAL(&eventLogMux);
+
+  if (count == 0)
+    return;
+  if (count >= EVENT_LOG_FLUSH_RECORDS ||
+      millis() - oldest >= EVENT_LOG_FLUSH_INTERVAL_MS) {
+    flush();
+  }
+}
+
+void EventLog::append(uint8_t type, uint16_t code, int32_t value) {
+  appendAt(millis(), type, code, value);
+}
+
+void EventLog::appendAt(uint32_t uptimeMs, uint8_t type, uint16_t code,
+                        int32_t value) {
+  // Wall time goes back by as much as the event is older than now
+  uint32_t ageMs = millis() - uptimeMs;
+  time_t now =
+      _clock ? _clock->utcAt(_clock->monoMicros() - (int64_t)ageMs * 1000) /
+                   1000000
+             : time(nullptr) - ageMs / 1000;
+
+  portENTER_CRITICAL(&eventLogMux);
+  if (_pendingCount < EVENT_LOG_BUFFER_RECORDS) {
+    EventRecord &rec = _pending[_pendingCount];
+    rec.type = type;
+    rec.code = code;
+    rec.seq = _nextSeq++;
+    rec.time = (now > 1600000000) ? (uint32_t)now : 0; // 0 until NTP syncs
+    rec.uptimeMs = uptimeMs;
+    rec.value = value;
+    if (_pendingCount == 0)
+      _oldestPendingMs = uptimeMs;
+    _pendingCount++;
+  } else {
+    _dropped++;
+  }
+  portEXIT_CRITICAL(&eventLogMux);
+}
+
+void EventLog::flush() {
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  flushLocked();
+  xSemaphoreGive(_mutex);
+}
+
+void EventLog::flushLocked() {
+  if (!_mounted)
+    return;
+
+  // Take the pending batch out of the RAM buffer, then encode and write it
+  // outside the critical section
+  EventRecord batch[EVENT_LOG_BUFFER_RECORDS];
+  int count;
+  portENTER_CRITICAL(&eventLogMux);
+  count = _pendingCount;
+  memcpy(batch, _pending, count * sizeof(EventRecord));
+  _pendingCount = 0;
+  portEXIT_CRITICAL(&eventLogMux);
+
+  if (count == 0)
+    return;
+
+  for (int i = 0; i < count; i++) {
+    encodeEventRecord(batch[i], _io + i * EVENT_RECORD_SIZE);
+  }
+  size_t bytes = count * EVENT_RECORD_SIZE;
+
+  if (SPIFFS.exists(EVENT_LOG_PATH)) {
+    File f = SPIFFS.open(EVENT_LOG_PATH, FILE_READ);
+    size_t size = f.size();
+    f.close();
+    if (size + bytes > EVENT_LOG_SEGMENT_BYTES) {
+      rotateLocked();
+    }
+  }
+
+  File f = SPIFFS.open(EVENT_LOG_PATH, FILE_APPEND);
+  if (!f) {
+    Serial.println("Event log: failed to open segment for append");
+    _dropped += count;
+    return;
+  }
+  size_t written = f.write(_io, bytes);
+  f.close();
+
+  if (written != bytes) {
+    Serial.println("Event log: short write");
+    _dropped += (bytes - written) / EVENT_RECORD_SIZE;
+  }
+}
+
+void EventLog::rotateLocked() {
+  if (SPIFFS.exists(EVENT_LOG_OLD_PATH)) {
+    SPIFFS.remove(EVENT_LOG_OLD_PATH);
+  }
+  SPIFFS.rename(EVENT_LOG_PATH, EVENT_LOG_OLD_PATH);
+}
+
+void EventLog::recoverSeqLocked() {
+  // Continue numbering from the newest intact record
+  if (!recoverSeqFrom(EVENT_LOG_PATH)) {
+    recoverSeqFrom(EVENT_LOG_OLD_PATH);
+  }
+}
+
+bool EventLog::recoverSeqFrom(const char *path) {
+  if (!SPIFFS.exists(path))
+    return false;
+
+  File f = SPIFFS.open(path, FILE_READ);
+  size_t size = f.size();
+  size_t pos = size - (size % EVENT_RECORD_SIZE);
+  uint8_t buf[EVENT_RECORD_SIZE];
+  EventRecord rec;
+
+  // Walk backwards over any damaged tail records
+  while (pos >= EVENT_RECORD_SIZE) {
+    pos -= EVENT_RECORD_SIZE;
+    f.seek(pos);
+    if (f.read(buf, EVENT_RECORD_SIZE) == EVENT_RECORD_SIZE &&
+        decodeEventRecord(buf, rec)) {
+      _nextSeq = rec.seq + 1;
+      f.close();
+      return true;
+    }
+  }
+  f.close();
+  return false;
+}
+
+void EventLog::openCursor(Cursor &cur, bool raw) {
+  cur.segment = 0;
+  cur.offset = 0;
+  cur.raw = raw;
+  cur.linePos = 0;
+  cur.lineLen = 0;
+  if (!raw) {
+    cur.lineLen = snprintf(cur.line, sizeof(cur.line),
+                           "seq,time,uptime_ms,type,code,value\n");
+  }
+}
+
+size_t EventLog::formatLine(const EventRecord &rec, char *out, size_t len) {
+  int n = snprintf(out, len, "%u,%u,%u,%s,%u,%d\n", (unsigned)rec.seq,
+                   (unsigned)rec.time, (unsigned)rec.uptimeMs,
+                   eventTypeName(rec.type), (unsigned)rec.code,
+                   (int)rec.value);
+  return (n > 0 && (size_t)n < len) ? n : 0;
+}
+
+size_t EventLog::read(Cursor &cur, uint8_t *buf, size_t maxLen) {
+  size_t written = 0;
+  File f;
+  int openSegment = -1;
+
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  while (written < maxLen) {
+    // Drain a line left over from the previous call first
+    if (cur.linePos < cur.lineLen) {
+      size_t n = cur.lineLen - cur.linePos;
+      if (n > maxLen - written)
+        n = maxLen - written;
+      memcpy(buf + written, cur.line + cur.linePos, n);
+      cur.linePos += n;
+      written += n;
+      continue;
+    }
+
+    if (cur.segment >= 2 || !_mounted)
+      break;
+
+    if (openSegment != cur.segment) {
+      const char *path = (cur.segment == 0) ? EVENT_LOG_OLD_PATH
+                                            : EVENT_LOG_PATH;
+      if (!SPIFFS.exists(path)) {
+        cur.segment++;
+        cur.offset = 0;
+        continue;
+      }
+      f = SPIFFS.open(path, FILE_READ);
+      f.seek(cur.offset);
+      openSegment = cur.segment;
+    }
+
+    if (cur.raw) {
+      size_t n = f.read(buf + written, maxLen - written);
+      if (n == 0) {
+        cur.segment++;
+        cur.offset = 0;
+      } else {
+        cur.offset += n;
+        written += n;
+      }
+      continue;
+    }
+
+    uint8_t raw[EVENT_RECORD_SIZE];
+    EventRecord rec;
+    if (f.read(raw, EVENT_RECORD_SIZE) < EVENT_RECORD_SIZE) {
+      cur.segment++;
+      cur.offset = 0;
+      continue;
+    }
+    if (decodeEventRecord(raw, rec)) {
+      cur.offset += EVENT_RECORD_SIZE;
+      cur.lineLen = formatLine(rec, cur.line, sizeof(cur.line));
+      cur.linePos = 0;
+    } else {
+      // Skip torn or corrupt data one byte at a time until a record decodes
+      cur.offset++;
+      f.seek(cur.offset);
+    }
+  }
+  xSemaphoreGive(_mutex);
+
+  return written;
+}
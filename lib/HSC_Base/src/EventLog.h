@@ -0,0 +1,81 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include "ClockService.h"
+#include "EventRecord.h"
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// --- Event Log Tuning ---
+// Records held in RAM before they are written to SPIFFS
+static const int EVENT_LOG_BUFFER_RECORDS = 32;
+// Flush once this many records are pending...
+static const int EVENT_LOG_FLUSH_RECORDS = 16;
+// ...or when the oldest pending record is this old
+static const unsigned long EVENT_LOG_FLUSH_INTERVAL_MS = 60000;
+// Segment size before the log rotates (two segments are kept)
+static const size_t EVENT_LOG_SEGMENT_BYTES = 16 * 1024;
+
+// Append-only event log stored in two rotating SPIFFS segments.
+// Records are batched in RAM to limit flash writes and carry a CRC so a
+// torn write (power loss mid-append) is skipped when the log is read back.
+class EventLog {
+public:
+  // Read position for streaming the log out in chunks
+  struct Cursor {
+    uint8_t segment = 0; // 0 = old segment, 1 = current segment, 2 = done
+    uint32_t offset = 0;
+    bool raw = false;
+    char line[96];
+    size_t lineLen = 0;
+    size_t linePos = 0;
+  };
+
+  EventLog();
+  bool begin();
+  void end();
+  void loop();
+
+  // Date records from this clock instead of the system time
+  void setClock(const ClockService *clock) { _clock = clock; }
+
+  // Queue a record; safe to call from any task
+  void append(uint8_t type, uint16_t code = 0, int32_t value = 0);
+  // Queue a record for an event that happened at uptimeMs (millis() base),
+  // e.g. a captured input edge confirmed later
+  void appendAt(uint32_t uptimeMs, uint8_t type, uint16_t code = 0,
+                int32_t value = 0);
+
+  // Write all pending records to flash
+  void flush();
+
+  // Prepare a cursor for reading (CSV text unless raw is true)
+  void openCursor(Cursor &cur, bool raw);
+
+  // Fill buf with the next part of the log; returns 0 at the end
+  size_t read(Cursor &cur, uint8_t *buf, size_t maxLen);
+
+  uint32_t lastSeq() const { return _nextSeq - 1; }
+  uint32_t droppedCount() const { return _dropped; }
+
+private:
+  SemaphoreHandle_t _mutex;
+  const ClockService *_clock = nullptr;
+  bool _mounted = false;
+  EventRecord _pending[EVENT_LOG_BUFFER_RECORDS];
+  int _pendingCount = 0;
+  unsigned long _oldestPendingMs = 0;
+  uint32_t _nextSeq = 1;
+  uint32_t _dropped = 0;
+  uint8_t _io[EVENT_LOG_BUFFER_RECORDS * EVENT_RECORD_SIZE];
+
+  void flushLocked();
+  void rotateLocked();
+  void recoverSeqLocked();
+  bool recoverSeqFrom(const char *path);
+  size_t formatLine(const EventRecord &rec, char *out, size_t len);
+};
+
+#endif
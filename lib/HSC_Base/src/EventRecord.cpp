@@ -0,0 +1,109 @@
+#include "EventRecord.h"
+
+static void putU16(uint8_t *p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+}
+
+static void putU32(uint8_t *p, uint32_t v) {
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+  p[2] = (v >> 16) & 0xFF;
+  p[3] = (v >> 24) & 0xFF;
+}
+
+static uint16_t getU16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t getU32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+uint32_t eventCrc32(const uint8_t *data, size_t len) {
+  // CRC-32 (IEEE 802.3), bitwise to avoid a 1 KB table in RAM
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+void encodeEventRecord(const EventRecord &rec, uint8_t *out) {
+  out[0] = EVENT_RECORD_MAGIC;
+  out[1] = rec.type;
+  putU16(out + 2, rec.code);
+  putU32(out + 4, rec.seq);
+  putU32(out + 8, rec.time);
+  putU32(out + 12, rec.uptimeMs);
+  putU32(out + 16, (uint32_t)rec.value);
+  putU32(out + 20, eventCrc32(out, EVENT_RECORD_SIZE - 4));
+}
+
+bool decodeEventRecord(const uint8_t *in, EventRecord &rec) {
+  if (in[0] != EVENT_RECORD_MAGIC)
+    return false;
+  if (getU32(in + 20) != eventCrc32(in, EVENT_RECORD_SIZE - 4))
+    return false;
+
+  rec.type = in[1];
+  rec.code = getU16(in + 2);
+  rec.seq = getU32(in + 4);
+  rec.time = getU32(in + 8);
+  rec.uptimeMs = getU32(in + 12);
+  rec.value = (int32_t)getU32(in + 16);
+  return true;
+}
+
+size_t scanEventRecords(const uint8_t *buf, size_t len,
+                        void (*cb)(const EventRecord &rec, void *ctx),
+                        void *ctx) {
+  size_t pos = 0;
+  EventRecord rec;
+  while (pos + EVENT_RECORD_SIZE <= len) {
+    if (decodeEventRecord(buf + pos, rec)) {
+      cb(rec, ctx);
+      pos += EVENT_RECORD_SIZE;
+    } else {
+      pos++; // Torn write or corruption, resync on the next byte
+    }
+  }
+  return pos;
+}
+
+const char *eventTypeName(uint8_t type) {
+  switch (type) {
+  case EVENT_BOOT:
+    return "boot";
+  case EVENT_REBOOT:
+    return "reboot";
+  case EVENT_WIFI_CONNECTED:
+    return "wifi_connected";
+  case EVENT_WIFI_FAILED:
+    return "wifi_failed";
+  case EVENT_MQTT_CONNECTED:
+    return "mqtt_connected";
+  case EVENT_MQTT_FAILED:
+    return "mqtt_failed";
+  case EVENT_OTA_START:
+    return "ota_start";
+  case EVENT_OTA_RESULT:
+    return "ota_result";
+  case EVENT_CONFIG_SAVED:
+    return "config_saved";
+  case EVENT_TRACK:
+    return "track";
+  case EVENT_ERROR:
+    return "error";
+  case EVENT_STALL:
+    return "stall";
+  case EVENT_HEAP:
+    return "heap";
+  default:
+    return "unknown";
+  }
+}
@@ -0,0 +1,68 @@
+#ifndef EVENT_RECORD_H
+#define EVENT_RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-size binary record used by the persistent event log.
+// This file has no Arduino dependencies so it can be compiled on the host.
+
+enum EventType : uint8_t {
+  EVENT_NONE = 0,
+  EVENT_BOOT = 1,           // code = esp_reset_reason()
+  EVENT_REBOOT = 2,         // code = RebootReason
+  EVENT_WIFI_CONNECTED = 3, // value = RSSI
+  EVENT_WIFI_FAILED = 4,
+  EVENT_MQTT_CONNECTED = 5,
+  EVENT_MQTT_FAILED = 6, // value = MqttClient state
+  EVENT_OTA_START = 7,
+  EVENT_OTA_RESULT = 8, // code = 1 on success, value = error code
+  EVENT_CONFIG_SAVED = 9, // code = 1, value = seq from a bundle
+  EVENT_TRACK = 10, // code = track index, value = 1 occupied / 0 free
+  EVENT_ERROR = 11,
+  EVENT_STALL = 12, // code = supervisor section, value = ms stalled
+  EVENT_HEAP = 13,  // code = HeapLevel, value = largest free block
+};
+
+enum RebootReason : uint16_t {
+  REBOOT_UNKNOWN = 0,
+  REBOOT_API_RESTART = 1,
+  REBOOT_SETTINGS_SAVED = 2,
+  REBOOT_SETTINGS_RESET = 3,
+  REBOOT_AP_BUTTON = 4,
+  REBOOT_OTA = 5,
+  REBOOT_PROVISIONED = 6,
+};
+
+struct EventRecord {
+  uint8_t type;
+  uint16_t code;
+  uint32_t seq;
+  uint32_t time;     // Unix time in seconds, 0 if NTP not synced
+  uint32_t uptimeMs; // millis() when the event was recorded
+  int32_t value;
+};
+
+// magic(1) type(1) code(2) seq(4) time(4) uptime(4) value(4) crc32(4)
+static const size_t EVENT_RECORD_SIZE = 24;
+static const uint8_t EVENT_RECORD_MAGIC = 0xA5;
+
+// Encode a record into exactly EVENT_RECORD_SIZE bytes (little-endian)
+void encodeEventRecord(const EventRecord &rec, uint8_t *out);
+
+// Decode a record; returns false if the magic or CRC does not match
+bool decodeEventRecord(const uint8_t *in, EventRecord &rec);
+
+// Scan a buffer for valid records, resynchronising byte by byte past torn or
+// corrupt data. Calls cb for every valid record and returns the number of
+// bytes consumed (a trailing partial record is left for the next call).
+size_t scanEventRecords(const uint8_t *buf, size_t len,
+                        void (*cb)(const EventRecord &rec, void *ctx),
+                        void *ctx);
+
+// Short lower-case name for a record type (e.g. "track")
+const char *eventTypeName(uint8_t type);
+
+uint32_t eventCrc32(const uint8_t *data, size_t len);
+
+#endif
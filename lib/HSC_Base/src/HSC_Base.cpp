@@ -1,7 +1,20 @@
 #include "HSC_Base.h"
+#include "ProvisionBundle.h"
 #include "config.h"
+#include <ESPmDNS.h>
+#include <esp_system.h>
 #include <time.h>
 
+// Members of a settings object, with room to spare
+static const size_t SETTINGS_MAX_KEYS = 32;
+
+// Entries in the per-track settings arrays: the most tracks this board
+// can have
+static int settingsTracks(const DeviceProfile &profile) {
+  return profile.maxTracks < MAX_TRACK_INPUTS ? profile.maxTracks
+                                              : MAX_TRACK_INPUTS;
+}
+
 // Embedded HTML and CSS
 static const char index_html[] PROGMEM = R"rawliteral(
 <!DOCTYPE html>
@@ -47,6 +60,14 @@ static const char index_html[] PROGMEM = R"rawliteral(
                     <label for="mqtt_password">Password:</label>
                     <input type="password" id="mqtt_password" name="mqtt_password">
                 </div>
+                <div class="form-group">
+                    <label for="mqtt_fallback">Fallbacks:</label>
+                    <input type="text" id="mqtt_fallback" name="mqtt_fallback" placeholder="host:port, host:port">
+                </div>
+                <div class="form-group">
+                    <label for="mqtt_dual">Dual Publish:</label>
+                    <input type="checkbox" id="mqtt_dual" name="mqtt_dual">
+                </div>
                 <h3>Device Settings</h3>
                 <div class="form-group">
                     <label>Board Type:</label>
@@ -56,6 +77,23 @@ static const char index_html[] PROGMEM = R"rawliteral(
                     <label for="board_id">Board ID:</label>
                     <input type="number" id="board_id" name="board_id" required>
                 </div>
+                <div class="form-group">
+                    <label for="low_power">Low Power:</label>
+                    <input type="checkbox" id="low_power" name="low_power">
+                </div>
+                <div class="form-group">
+                    <label for="peer_link">Peer Link:</label>
+                    <input type="checkbox" id="peer_link" name="peer_link">
+                </div>
+                <h3>Time Settings</h3>
+                <div class="form-group">
+                    <label for="ntp_server">NTP Server:</label>
+                    <input type="text" id="ntp_server" name="ntp_server" placeholder="pool.ntp.org">
+                </div>
+                <div class="form-group">
+                    <label for="tz">Time Zone:</label>
+                    <input type="text" id="tz" name="tz" placeholder="EST5EDT,M3.2.0,M11.1.0">
+                </div>
                 <h3>Location Settings</h3>
                 <div class="form-group">
                     <label for="location">Location:</label>
@@ -74,6 +112,16 @@ static const char index_html[] PROGMEM = R"rawliteral(
         </div>
         <script>
             let locateState = false;
+            // Busy or over the rate limit: come back when the board says
+            function fetchRetry(url, options, tries = 5) {
+                return fetch(url, options).then(r => {
+                    const wait = r.headers.get('Retry-After');
+                    if ((r.status === 429 || r.status === 503) && wait && tries > 1)
+                        return new Promise(res => setTimeout(res, wait * 1000))
+                            .then(() => fetchRetry(url, options, tries - 1));
+                    return r;
+                });
+            }
             fetch('/api/settings')
                 .then(response => response.json())
                 .then(data => {
@@ -83,7 +131,13 @@ static const char index_html[] PROGMEM = R"rawliteral(
                     document.getElementById('mqtt_port').value = data.mqtt_port || 1883;
                     document.getElementById('mqtt_user').value = data.mqtt_user || '';
                     document.getElementById('mqtt_password').value = data.mqtt_password || '';
+                    document.getElementById('mqtt_fallback').value = data.mqtt_fallback || '';
+                    document.getElementById('mqtt_dual').checked = !!data.mqtt_dual;
                     document.getElementById('board_id').value = (data.board_id !== undefined) ? data.board_id : 1;
+                    document.getElementById('low_power').checked = !!data.low_power;
+                    document.getElementById('peer_link').checked = !!data.peer_link;
+                    document.getElementById('ntp_server').value = data.ntp_server || '';
+                    document.getElementById('tz').value = data.tz || '';
                     document.getElementById('location').value = data.location || '';
                     document.getElementById('headerLocation').textContent = data.location || '';
                     locateState = false;
@@ -93,15 +147,17 @@ static const char index_html[] PROGMEM = R"rawliteral(
             document.getElementById('configForm').addEventListener('submit', function (e) {
                 e.preventDefault();
                 const formData = new FormData(this);
-                const data = {};
+                const data = { mqtt_dual: false, low_power: false, peer_link: false };
                 formData.forEach((value, key) => {
-                    if (key === 'mqtt_port' || key === 'board_id') {
+                    if (key === 'mqtt_dual' || key === 'low_power' || key === 'peer_link') {
+                        data[key] = true;
+                    } else if (key === 'mqtt_port' || key === 'board_id') {
                         data[key] = parseInt(value);
                     } else {
                         data[key] = value;
                     }
                 });
-                fetch('/api/settings', {
+                fetchRetry('/api/settings', {
                     method: 'POST',
                     headers: { 'Content-Type': 'application/json' },
                     body: JSON.stringify(data),
@@ -403,22 +459,98 @@ footer .value {
 }
 )rawliteral";
 
-HSC_Base::HSC_Base() : server(80), mqttClient(espClient) {
-  boardTypeDesc = BOARD_TYPE_DESC;
-  boardTypeShort = BOARD_TYPE_SHORT;
+// Answers requests with 503 while the heap is critical, except the ones
+// needed to see why. Added before every other handler, so it is asked
+// first; declining costs a string compare.
+class HeapShedHandler : public AsyncWebHandler {
+public:
+  HeapShedHandler(const HeapGuard &heap, volatile uint32_t &rejected)
+      : _heap(heap), _rejected(rejected) {}
+
+  bool canHandle(AsyncWebServerRequest *request) override {
+    if (_heap.level() != HEAP_CRITICAL)
+      return false;
+    const String &url = request->url();
+    return url != "/api/status" && url != "/api/metrics" &&
+           url != "/api/fault";
+  }
+
+  void handleRequest(AsyncWebServerRequest *request) override {
+    _rejected = _rejected + 1;
+    AsyncWebServerResponse *response =
+        request->beginResponse(503, "application/json",
+                               "{\"status\":\"error\",\"message\":\"Low "
+                               "memory, try again later\"}");
+    response->addHeader("Retry-After", "10");
+    request->send(response);
+  }
+
+private:
+  const HeapGuard &_heap;
+  volatile uint32_t &_rejected;
+};
+
+// Cheap requests are answered from memory, heavy ones write flash, stream
+// for a long time or wait on the update server
+static RequestClass requestClass(AsyncWebServerRequest *request) {
+  const String &url = request->url();
+  if (url == "/api/status" || url == "/api/metrics" ||
+      url == "/api/update/status")
+    return REQUEST_CHEAP;
+  if (url == "/api/firmware/check" || url == "/api/events" ||
+      (request->method() == HTTP_POST &&
+       (url == "/api/settings" || url == "/api/provision")))
+    return REQUEST_HEAVY;
+  return REQUEST_NORMAL;
 }
 
-#include <HTTPClient.h>
+// Admission control, asked right after the heap check: answers 429 for a
+// client or the whole server over its rate and 503 when no connection slot
+// is left for the request's class. An admitted request is declined here and
+// handled as usual; its slot is freed when the connection closes.
+class RequestGateHandler : public AsyncWebHandler {
+public:
+  explicit RequestGateHandler(RequestLimiter &limiter)
+      : _limiter(limiter), _verdict(REQUEST_ADMITTED) {}
+
+  bool canHandle(AsyncWebServerRequest *request) override {
+    RequestClass cls = requestClass(request);
+    _verdict =
+        _limiter.admit(request->client()->remoteIP(), cls, millis());
+    if (_verdict != REQUEST_ADMITTED)
+      return true;
+    RequestLimiter &limiter = _limiter;
+    request->onDisconnect([&limiter, cls]() { limiter.release(cls); });
+    return false;
+  }
 
-void HSC_Base::setUpdateUrl(const char *url) { _preConfigUpdateUrl = url; }
+  // Runs straight after canHandle() on the same task, so _verdict is the
+  // one for this request
+  void handleRequest(AsyncWebServerRequest *request) override {
+    bool rate = _verdict == REQUEST_CLIENT_LIMITED ||
+                _verdict == REQUEST_GLOBAL_LIMITED;
+    AsyncWebServerResponse *response = request->beginResponse(
+        rate ? 429 : 503, "application/json",
+        rate ? "{\"status\":\"error\",\"message\":\"Too many requests\"}"
+             : "{\"status\":\"error\",\"message\":\"Busy, try again\"}");
+    response->addHeader("Retry-After", String(WEB_RETRY_AFTER_S));
+    request->send(response);
+  }
 
-void HSC_Base::setBoardInfo(const char *desc, const char *shortName,
-                            const char *fwVersion) {
-  boardTypeDesc = desc;
-  boardTypeShort = shortName;
-  firmwareVersion = fwVersion;
+private:
+  RequestLimiter &_limiter;
+  RequestVerdict _verdict;
+};
+
+HSC_Base::HSC_Base(const DeviceProfile &profile)
+    : server(80), profile(profile) {
+  eventLog.setClock(&clockService);
 }
 
+#include <HTTPClient.h>
+
+void HSC_Base::setUpdateUrl(const char *url) { _preConfigUpdateUrl = url; }
+
 void HSC_Base::begin() {
   Serial.begin(115200);
 
@@ -429,7 +561,31 @@ void HSC_Base::begin() {
   // Initialize SPIFFS
   if (!SPIFFS.begin(true)) {
     Serial.println("An Error has occurred while mounting SPIFFS");
+  } else {
+    eventLog.begin();
   }
+  eventLog.append(EVENT_BOOT, esp_reset_reason());
+
+  // Before anything that could hang. A stall recorded before the reset is
+  // logged and published from the loop.
+  supervisor.begin();
+  networkSection =
+      supervisor.addSection("network", SUPERVISOR_NETWORK_TIMEOUT_MS);
+  webSection = supervisor.addSection("web", SUPERVISOR_WEB_TIMEOUT_MS);
+
+  ota.setCurrentVersion(profile.firmware);
+
+  // Close the event log while OTA rewrites the filesystem image
+  ota.onFilesystemUpdate(
+      [this]() {
+        eventLog.end();
+        SPIFFS.end();
+      },
+      [this]() {
+        if (SPIFFS.begin(true)) {
+          eventLog.begin();
+        }
+      });
 
   // Initialize AP Mode Button
   pinMode(PIN_AP_BUTTON, INPUT_PULLUP);
@@ -446,38 +602,49 @@ void HSC_Base::begin() {
   }
 
   setupWifi();
-  mqttClient.setServer(currentConfig.mqtt_server.c_str(),
-                       currentConfig.mqtt_port);
+  setupMdns();
 
   setupWebServer();
   server.begin();
 
-  // Initialize Identity
-  uint8_t mac[6];
-  WiFi.macAddress(mac);
-  char macBuf[20];
-  sprintf(macBuf, "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2],
-          mac[3], mac[4], mac[5]);
-  macStr = String(macBuf);
-
-  char devIdBuf[32];
-  String shortName = String(boardTypeShort);
-  shortName.toLowerCase();
-  sprintf(devIdBuf, "%s-%02x%02x%02x", shortName.c_str(), mac[3], mac[4],
-          mac[5]);
-  deviceId = String(devIdBuf);
-
-  // Approximate boot time (will be refined when NTP syncs)
-  bootTime = time(nullptr);
+  setupMqtt();
 }
 
 void HSC_Base::loop() {
+  if (configPending) {
+    currentConfig = pendingConfig;
+    if (pendingReboot)
+      shouldReboot = true;
+    else
+      applyLiveConfig();
+    configPending = false;
+  }
+
   // Handle Reboot
   if (shouldReboot) {
+    prepareReboot(rebootReason);
     delay(1000);
     ESP.restart();
   }
 
+  eventLog.loop();
+
+  // Stalls are reported by the supervisor task, logged here
+  if (supervisor.takeNewStall()) {
+    StallReport st = supervisor.lastStall();
+    eventLog.append(EVENT_STALL, st.sectionId, st.stalledMs);
+    stallPending = true;
+  }
+  if (stallPending && mqttClient.connected())
+    publishStall();
+
+#ifdef HSC_FAULT_INJECTION
+  if (faultLoopMs) {
+    delay(faultLoopMs);
+    faultLoopMs = 0;
+  }
+#endif
+
   // Handle AP Mode Button
   static unsigned long apButtonPressStart = 0;
   static bool apButtonActive = false;
@@ -491,6 +658,7 @@ void HSC_Base::loop() {
         Serial.println("AP Mode Button Held - Resetting WiFi Password");
         currentConfig.wifi_password = "password";
         configManager.save(currentConfig);
+        rebootReason = REBOOT_AP_BUTTON;
         shouldReboot = true;
         apButtonActive = false;
         for (int k = 0; k < 10; k++) {
@@ -519,17 +687,40 @@ void HSC_Base::loop() {
     shouldUpdate = false;
     performOTA(currentConfig.update_url);
   }
+  handleRollout();
+  handleOtaProgress();
+  ota.closeIdleConnection();
+
+  if (millis() - lastHeapSample >= HEAP_SAMPLE_MS) {
+    lastHeapSample = millis();
+    sampleHeap();
+  }
+  if (heapPending && mqttClient.connected())
+    publishHeap();
 
   // Handle MQTT
   if (currentConfig.board_id != 0) {
-    if (!mqttClient.connected()) {
-      unsigned long now = millis();
-      if (now - lastMqttReconnectAttempt > 5000) {
-        lastMqttReconnectAttempt = now;
-        reconnectMqtt();
+    {
+      Supervisor::Scope scope(supervisor, networkSection);
+#ifdef HSC_FAULT_INJECTION
+      if (faultNetworkMs) {
+        delay(faultNetworkMs);
+        faultNetworkMs = 0;
       }
+#endif
+      mqttClient.loop(WiFi.status() == WL_CONNECTED);
     }
-    mqttClient.loop();
+    supervisor.progress(networkSection);
+
+    // Info went out without a boot time if NTP had not synced yet
+    if (bootTime == 0 && clockService.synced() && mqttClient.connected())
+      publishDeviceInfo();
+
+    // Board ids double as peer ids, so unconfigured boards stay out
+    if (currentConfig.peer_link && !peers.started() &&
+        WiFi.status() == WL_CONNECTED)
+      peers.begin(currentConfig.board_id, clockService);
+    peers.loop();
   }
 }
 
@@ -538,7 +729,7 @@ void HSC_Base::setupWifi() {
   Serial.println();
   Serial.println("--------------------------------");
   Serial.println("Starting HSC-ESP32-Base");
-  Serial.println("FW Rev: " + String(FW_VERSION));
+  Serial.println("FW Rev: " + String(profile.firmware));
   Serial.println("Board ID: " + String(currentConfig.board_id));
   Serial.println("--------------------------------");
   Serial.println();
@@ -547,18 +738,29 @@ void HSC_Base::setupWifi() {
 
   WiFi.mode(WIFI_STA);
 
-  // Set Hostname
+  // Initialize Identity; the device ID doubles as the hostname
   uint8_t mac[6];
   WiFi.macAddress(mac);
+  char macBuf[20];
+  sprintf(macBuf, "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2],
+          mac[3], mac[4], mac[5]);
+  macStr = String(macBuf);
+
   char hostname[32];
-  String shortName = String(boardTypeShort);
-  shortName.toLowerCase();
-  sprintf(hostname, "%s-%02x%02x%02x", shortName.c_str(), mac[3], mac[4],
-          mac[5]);
+  size_t n = 0;
+  for (const char *p = profile.shortName; *p && n < 24; p++)
+    hostname[n++] = tolower(*p);
+  sprintf(hostname + n, "-%02x%02x%02x", mac[3], mac[4], mac[5]);
+  deviceId = String(hostname);
   WiFi.setHostname(hostname);
   Serial.print("Hostname: ");
   Serial.println(hostname);
 
+  // Max modem sleep only wakes the radio every few beacons: incoming
+  // traffic waits up to a few hundred ms, outgoing is sent at once
+  WiFi.setSleep(currentConfig.low_power ? WIFI_PS_MAX_MODEM
+                                        : WIFI_PS_MIN_MODEM);
+
   WiFi.begin(currentConfig.wifi_ssid.c_str(),
              currentConfig.wifi_password.c_str());
 
@@ -575,80 +777,253 @@ void HSC_Base::setupWifi() {
     WiFi.softAP("HSC-Setup", "password");
     Serial.println("AP IP address: ");
     Serial.println(WiFi.softAPIP());
+    eventLog.append(EVENT_WIFI_FAILED);
   } else {
     Serial.println("");
     Serial.println("WiFi connected");
     Serial.println("IP address: ");
     Serial.println(WiFi.localIP());
+    eventLog.append(EVENT_WIFI_CONNECTED, 0, WiFi.RSSI());
 
-    Serial.println("Configuring NTP...");
-    configTime(-5 * 3600, 0, "pool.ntp.org", "time.nist.gov");
+    Serial.println("Configuring NTP (" + currentConfig.ntp_server + ")...");
+    clockService.begin(currentConfig.ntp_server.c_str(),
+                       currentConfig.tz.c_str());
     Serial.println("NTP configured (will sync in background)");
   }
 }
 
-void HSC_Base::reconnectMqtt() {
-  if (WiFi.status() != WL_CONNECTED)
-    return;
-  if (currentConfig.board_id == 0)
+// Advertised as _hsc._tcp so a provisioning tool can find every board of a
+// layout without knowing the addresses; _http._tcp for browsers
+void HSC_Base::setupMdns() {
+  if (!MDNS.begin(deviceId.c_str())) {
+    Serial.println("Failed to start mDNS");
     return;
+  }
+  MDNS.addService("http", "tcp", 80);
+  MDNS.addService("hsc", "tcp", 80);
+  MDNS.addServiceTxt("hsc", "tcp", "board", profile.shortName);
+  MDNS.addServiceTxt("hsc", "tcp", "board_id",
+                     String(currentConfig.board_id));
+  MDNS.addServiceTxt("hsc", "tcp", "fw", profile.firmware);
+  MDNS.addServiceTxt("hsc", "tcp", "mac", macStr);
+  MDNS.addServiceTxt("hsc", "tcp", "model", profile.desc);
+  MDNS.addServiceTxt("hsc", "tcp", "location", currentConfig.location);
+}
 
-  Serial.print("Attempting MQTT connection...");
-  String clientId = "HSC-Device-";
-  clientId += String(currentConfig.board_id);
-
-  if (mqttClient.connect(deviceId.c_str(), currentConfig.mqtt_user.c_str(),
-                         currentConfig.mqtt_password.c_str(),
-                         ("HSC/devices/" + deviceId + "/status").c_str(), 0,
-                         true, "offline")) {
-    Serial.println("connected");
-
-    // 1. Publish Online Status (Retained)
-    String statusTopic = "HSC/devices/" + deviceId + "/status";
-    mqttClient.publish(statusTopic.c_str(), "online", true);
-
-    // 2. Publish Device Information (Retained)
-    // Calculate boot time based on current time - uptime
-    time_t now;
-    time(&now);
-    time_t actualBootTime = now - (millis() / 1000);
-
-    StaticJsonDocument<512> doc;
-    doc["hostname"] = deviceId;
-    doc["model"] = boardTypeDesc;
-    doc["board_code"] = boardTypeShort;
-    doc["firmware"] = firmwareVersion;
-    doc["mac"] = macStr;
-    doc["ip"] = WiFi.localIP().toString();
-    doc["boot_time"] = actualBootTime;
-
-    String infoTopic = "HSC/devices/" + deviceId + "/info";
-    char buffer[512];
-    serializeJson(doc, buffer);
-    mqttClient.publish(infoTopic.c_str(), buffer, true);
-
-    // 3. Optional Boot Announcement (Non-retained)
-    // We send this every time we reconnect, which acts as a "device allows" or
-    // "hello" message
-    StaticJsonDocument<128> bootDoc;
-    bootDoc["hostname"] = deviceId;
-    bootDoc["event"] = "boot"; // or 'reconnect' if we wanted to be specific
-    char bootBuf[128];
-    serializeJson(bootDoc, bootBuf);
+void HSC_Base::setupMqtt() {
+  // Primary broker first, then the fallbacks in the order given
+  mqttClient.addBroker(currentConfig.mqtt_server, currentConfig.mqtt_port);
+  String list = currentConfig.mqtt_fallback;
+  while (list.length() > 0) {
+    int comma = list.indexOf(',');
+    String entry = comma < 0 ? list : list.substring(0, comma);
+    list = comma < 0 ? "" : list.substring(comma + 1);
+    entry.trim();
+    int colon = entry.indexOf(':');
+    uint16_t port = colon < 0 ? MQTT_PORT : entry.substring(colon + 1).toInt();
+    String host = colon < 0 ? entry : entry.substring(0, colon);
+    if (!mqttClient.addBroker(host, port) && host.length() > 0)
+      Serial.println("Ignoring MQTT fallback " + entry);
+  }
+  mqttClient.setDualPublish(currentConfig.mqtt_dual);
+  mqttClient.setPersistentSession(MQTT_PERSISTENT_SESSION);
+
+  mqttClient.setSession(deviceId, currentConfig.mqtt_user,
+                        currentConfig.mqtt_password,
+                        "HSC/devices/" + deviceId + "/status", "offline");
+  mqttClient.setCallback(
+      [this](char *topic, uint8_t *payload, unsigned int length) {
+        handleMqttMessage(topic, payload, length);
+      });
+  mqttClient.onConnect([this]() { onMqttConnected(); });
+  mqttClient.onFailure([this](int broker, int state) {
+    Serial.print("MQTT connection to " + mqttClient.brokerHost(broker) +
+                 " failed, rc=");
+    Serial.println(state);
+    // Only log the first failure of an outage to avoid flooding the log
+    if (!mqttFailureLogged) {
+      eventLog.append(EVENT_MQTT_FAILED, broker, state);
+      mqttFailureLogged = true;
+    }
+  });
+}
+
+// Runs whenever a broker becomes the active one, including a failover
+void HSC_Base::onMqttConnected() {
+  int broker = mqttClient.activeBroker();
+  Serial.println("MQTT connected to " + mqttClient.brokerHost(broker));
+  eventLog.append(EVENT_MQTT_CONNECTED, broker);
+  mqttFailureLogged = false;
+
+  // 1. Publish Online Status (Retained). Always sent: the broker may have
+  // published the will in the meantime.
+  String statusTopic = "HSC/devices/" + deviceId + "/status";
+  mqttClient.publish(statusTopic.c_str(), "online", true, 1);
+
+  // 2. Publish Device Information (Retained)
+  publishDeviceInfo();
+
+  // 3. Boot Announcement (Non-retained)
+  // Only for a new session: a resumed one means the broker, and whoever
+  // listens to it, already knows the device
+  if (!mqttClient.sessionPresent()) {
+    char bootBuf[96];
+    JsonWriter boot(bootBuf, sizeof(bootBuf));
+    boot.beginObject();
+    boot.add("hostname", deviceId.c_str());
+    boot.add("event", "boot");
+    boot.endObject();
     mqttClient.publish("HSC/devices/announce", bootBuf, false);
+  }
+
+  // Current memory state (Retained)
+  heapPending = true;
+
+  // 4. Subscribe to Configuration
+  String configTopic = "HSC/devices/" + deviceId + "/config";
+  mqttClient.subscribe(configTopic.c_str());
+
+  // 5. Subscribe to fleet rollout broadcasts
+  mqttClient.subscribe("HSC/devices/rollout");
+
+  if (mqttConnectHandler)
+    mqttConnectHandler();
+}
+
+// Retained, so the same message is skipped on a reconnect. Boot time is
+// fixed at the first NTP sync and the info republished then.
+void HSC_Base::publishDeviceInfo() {
+  if (bootTime == 0 && clockService.synced())
+    bootTime = clockService.bootTime();
+
+  char buffer[320];
+  JsonWriter json(buffer, sizeof(buffer));
+  json.beginObject();
+  json.add("hostname", deviceId.c_str());
+  json.add("model", profile.desc);
+  json.add("board_code", profile.shortName);
+  json.add("firmware", profile.firmware);
+  json.add("mac", macStr.c_str());
+  json.add("ip", WiFi.localIP().toString().c_str());
+  json.add("boot_time", bootTime);
+  json.endObject();
+  if (json.overflowed()) {
+    Serial.println("Device info too long, not published");
+    return;
+  }
+
+  String infoTopic = "HSC/devices/" + deviceId + "/info";
+  mqttClient.publish(infoTopic.c_str(), buffer, true, 1);
+}
+
+// Shedding follows the level: on a drop the idle update server connection
+// is closed at once and the MQTT window shrunk; the web and history checks
+// read the level directly.
+void HSC_Base::sampleHeap() {
+  HeapSample sample;
+  sample.freeBytes = ESP.getFreeHeap();
+  sample.minFreeBytes = ESP.getMinFreeHeap();
+  sample.largestBlock = ESP.getMaxAllocHeap();
+  if (!heap.update(sample))
+    return;
+
+  HeapLevel level = heap.level();
+  Serial.printf("Heap %s: %u free, largest block %u\n",
+                HeapGuard::levelName(level), sample.freeBytes,
+                sample.largestBlock);
+  eventLog.append(EVENT_HEAP, level, sample.largestBlock);
+  if (level != HEAP_OK)
+    ota.closeIdleConnection(0);
+  mqttClient.setInflightWindow(level == HEAP_OK
+                                   ? MQTT_INFLIGHT_WINDOW
+                                   : MQTT_INFLIGHT_WINDOW_LOW_HEAP);
+  heapPending = true;
+}
+
+// Retained QoS 1 on every level change, from a stack buffer so it goes out
+// even when the heap is critical
+void HSC_Base::publishHeap() {
+  const HeapSample &hs = heap.sample();
+  StaticJsonDocument<192> doc;
+  doc["level"] = HeapGuard::levelName(heap.level());
+  doc["free"] = hs.freeBytes;
+  doc["min_free"] = hs.minFreeBytes;
+  doc["largest_block"] = hs.largestBlock;
+  doc["fragmentation"] = heap.fragmentation();
+  doc["uptime_ms"] = millis();
+
+  char topic[64];
+  snprintf(topic, sizeof(topic), "HSC/devices/%s/heap", deviceId.c_str());
+  char buffer[192];
+  serializeJson(doc, buffer);
+  if (mqttClient.publish(topic, buffer, true, 1))
+    heapPending = false;
+}
+
+// Retained, so the last stall stays visible after a clean reboot. Sent on
+// the first connect after the stall, even when it recovered.
+void HSC_Base::publishStall() {
+  StallReport st = supervisor.lastStall();
+  StaticJsonDocument<256> doc;
+  doc["section"] = st.section;
+  if (st.inside[0])
+    doc["inside"] = st.inside;
+  doc["stalled_ms"] = st.stalledMs;
+  doc["busy"] = st.busy;
+  doc["uptime_ms"] = st.uptimeMs;
+  doc["caused_reset"] = st.beforeReset;
+  if (st.beforeReset)
+    doc["reset_reason"] = st.resetReason;
+  doc["boot_time"] = bootTime;
+
+  String stallTopic = "HSC/devices/" + deviceId + "/stall";
+  char buffer[256];
+  serializeJson(doc, buffer);
+  if (mqttClient.publish(stallTopic.c_str(), buffer, true, 1))
+    stallPending = false;
+}
 
-    // 4. Subscribe to Configuration
-    String configTopic = "HSC/devices/" + deviceId + "/config";
-    mqttClient.subscribe(configTopic.c_str());
+// Never waits for the clock: getLocalTime() would block up to 5 s before
+// the first NTP sync
+void HSC_Base::readStatus(DeviceStatus &status) {
+  unsigned long seconds = millis() / 1000;
+  unsigned long days = seconds / 86400;
+  seconds %= 86400;
+  unsigned long hours = seconds / 3600;
+  seconds %= 3600;
+  unsigned long minutes = seconds / 60;
+  seconds %= 60;
+  if (days > 0) {
+    snprintf(status.uptime, sizeof(status.uptime), "%lud %02luh %02lum", days,
+             hours, minutes);
+  } else if (hours > 0) {
+    snprintf(status.uptime, sizeof(status.uptime), "%luh %02lum %02lus",
+             hours, minutes, seconds);
   } else {
-    Serial.print("failed, rc=");
-    Serial.println(mqttClient.state());
+    snprintf(status.uptime, sizeof(status.uptime), "%lum %02lus", minutes,
+             seconds);
   }
+
+  if (WiFi.status() == WL_CONNECTED)
+    snprintf(status.rssi, sizeof(status.rssi), "%d dBm", WiFi.RSSI());
+  else
+    strcpy(status.rssi, "N/A");
+
+  snprintf(status.freeMemory, sizeof(status.freeMemory), "%.1f KB",
+           ESP.getFreeHeap() / 1024.0);
+  status.memoryState = heap.level();
+
+  struct tm timeinfo;
+  if (getLocalTime(&timeinfo, 0))
+    strftime(status.runtime, sizeof(status.runtime), "%m-%d-%y %H:%M:%S",
+             &timeinfo);
+  else
+    strcpy(status.runtime, "Not synced");
 }
 
 String HSC_Base::processor(const String &var) {
   if (var == "FW_REV") {
-    return firmwareVersion;
+    return profile.firmware;
   }
   if (var == "IP") {
     if (WiFi.status() == WL_CONNECTED) {
@@ -658,14 +1033,7 @@ String HSC_Base::processor(const String &var) {
     }
   }
   if (var == "HOSTNAME") {
-    uint8_t mac[6];
-    WiFi.macAddress(mac);
-    char hostname[32];
-    String shortName = String(boardTypeShort);
-    shortName.toLowerCase();
-    sprintf(hostname, "%s-%02x%02x%02x", shortName.c_str(), mac[3], mac[4],
-            mac[5]);
-    return String(hostname);
+    return deviceId;
   }
   if (var == "SSID") {
     return currentConfig.wifi_ssid;
@@ -676,45 +1044,17 @@ String HSC_Base::processor(const String &var) {
     }
     return mqttClient.connected() ? "Connected" : "Disconnected";
   }
-  if (var == "UPTIME") {
-    unsigned long seconds = millis() / 1000;
-    unsigned long days = seconds / 86400;
-    seconds %= 86400;
-    unsigned long hours = seconds / 3600;
-    seconds %= 3600;
-    unsigned long minutes = seconds / 60;
-    seconds %= 60;
-
-    char uptime[32];
-    if (days > 0) {
-      sprintf(uptime, "%lud %02luh %02lum", days, hours, minutes);
-    } else if (hours > 0) {
-      sprintf(uptime, "%luh %02lum %02lus", hours, minutes, seconds);
-    } else {
-      sprintf(uptime, "%lum %02lus", minutes, seconds);
-    }
-    return String(uptime);
-  }
-  if (var == "RSSI") {
-    if (WiFi.status() == WL_CONNECTED) {
-      return String(WiFi.RSSI()) + " dBm";
-    }
-    return "N/A";
-  }
-  if (var == "FREE_MEMORY") {
-    float freeKB = ESP.getFreeHeap() / 1024.0;
-    char mem[16];
-    sprintf(mem, "%.1f KB", freeKB);
-    return String(mem);
-  }
-  if (var == "DATETIME") {
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo)) {
-      return "Not synced";
-    }
-    char dateTimeStr[32];
-    strftime(dateTimeStr, sizeof(dateTimeStr), "%m-%d-%y %H:%M:%S", &timeinfo);
-    return String(dateTimeStr);
+  if (var == "UPTIME" || var == "RSSI" || var == "FREE_MEMORY" ||
+      var == "DATETIME") {
+    DeviceStatus status;
+    readStatus(status);
+    if (var == "UPTIME")
+      return status.uptime;
+    if (var == "RSSI")
+      return status.rssi;
+    if (var == "FREE_MEMORY")
+      return status.freeMemory;
+    return status.runtime;
   }
   if (var == "CAN_STATUS") {
     return "N/A";
@@ -723,15 +1063,18 @@ String HSC_Base::processor(const String &var) {
     return String(currentConfig.board_id);
   }
   if (var == "BOARD_TYPE") {
-    return boardTypeDesc;
+    return profile.desc;
   }
   if (var == "BOARD_TYPE_SHORT") {
-    return boardTypeShort;
+    return profile.shortName;
   }
   return String();
 }
 
 void HSC_Base::setupWebServer() {
+  server.addHandler(new HeapShedHandler(heap, webRejected));
+  server.addHandler(new RequestGateHandler(webLimiter));
+
   // Serve embedded index.html
   server.on("/", HTTP_GET, [this](AsyncWebServerRequest *request) {
     request->send_P(200, "text/html", index_html,
@@ -776,16 +1119,41 @@ void HSC_Base::setupWebServer() {
   server.on("/api/settings", HTTP_GET, [this](AsyncWebServerRequest *request) {
     AsyncResponseStream *response =
         request->beginResponseStream("application/json");
-    StaticJsonDocument<512> doc;
-    doc["wifi_ssid"] = currentConfig.wifi_ssid;
-    doc["wifi_password"] = currentConfig.wifi_password;
-    doc["mqtt_server"] = currentConfig.mqtt_server;
-    doc["mqtt_port"] = currentConfig.mqtt_port;
-    doc["mqtt_user"] = currentConfig.mqtt_user;
-    doc["mqtt_password"] = currentConfig.mqtt_password;
-    doc["board_id"] = currentConfig.board_id;
-    doc["location"] = currentConfig.location;
-    serializeJson(doc, *response);
+    const Config &c = currentConfig;
+    JsonWriter json(*response);
+    json.beginObject();
+    json.add("wifi_ssid", c.wifi_ssid.c_str());
+    json.add("wifi_password", c.wifi_password.c_str());
+    json.add("mqtt_server", c.mqtt_server.c_str());
+    json.add("mqtt_port", c.mqtt_port);
+    json.add("mqtt_user", c.mqtt_user.c_str());
+    json.add("mqtt_password", c.mqtt_password.c_str());
+    json.add("mqtt_fallback", c.mqtt_fallback.c_str());
+    json.add("mqtt_dual", c.mqtt_dual);
+    json.add("board_id", c.board_id);
+    json.add("location", c.location.c_str());
+    json.add("low_power", c.low_power);
+    json.add("peer_link", c.peer_link);
+    json.add("ntp_server", c.ntp_server.c_str());
+    json.add("tz", c.tz.c_str());
+    json.add("rules", c.rules.c_str());
+    // The key itself is never sent back
+    json.add("provision_key_set", c.provision_key.length() > 0);
+    json.add("provision_seq", c.provision_seq);
+    int tracks = settingsTracks(profile);
+    json.beginArray("debounce_ms");
+    for (int i = 0; i < tracks; i++)
+      json.value(c.debounce_ms[i]);
+    json.endArray();
+    json.beginArray("debounce_adaptive");
+    for (int i = 0; i < tracks; i++)
+      json.value(c.debounce_adaptive[i]);
+    json.endArray();
+    json.beginArray("track_pins");
+    for (int i = 0; i < c.num_tracks; i++)
+      json.value(c.track_pins[i]);
+    json.endArray();
+    json.endObject();
     request->send(response);
   });
 
@@ -801,8 +1169,25 @@ void HSC_Base::setupWebServer() {
           body += (char)data[i];
 
         if (index + len == total) {
-          StaticJsonDocument<512> doc;
+          if (configPending) {
+            request->send(503, "application/json",
+                          "{\"status\":\"error\",\"message\":\"Settings "
+                          "change in progress\"}");
+            return;
+          }
+          // Sized for this board: the scalar settings, the per-track arrays
+          // and a copy of every string, which the body bounds
+          size_t docSize = JSON_OBJECT_SIZE(SETTINGS_MAX_KEYS) +
+                           3 * JSON_ARRAY_SIZE(settingsTracks(profile)) +
+                           body.length();
+          DynamicJsonDocument doc(docSize);
           DeserializationError error = deserializeJson(doc, body);
+          if (error == DeserializationError::NoMemory) {
+            request->send(413, "application/json",
+                          "{\"status\":\"error\",\"message\":\"More "
+                          "settings than this board has tracks for\"}");
+            return;
+          }
           if (error) {
             request->send(400, "application/json",
                           "{\"status\":\"error\",\"message\":\"Invalid "
@@ -810,26 +1195,31 @@ void HSC_Base::setupWebServer() {
             return;
           }
 
-          Config newConfig;
-          newConfig.wifi_ssid = doc["wifi_ssid"] | currentConfig.wifi_ssid;
-          newConfig.wifi_password =
-              doc["wifi_password"] | currentConfig.wifi_password;
-          newConfig.mqtt_server =
-              doc["mqtt_server"] | currentConfig.mqtt_server;
-          newConfig.mqtt_port = doc["mqtt_port"] | currentConfig.mqtt_port;
-          newConfig.mqtt_user = doc["mqtt_user"] | currentConfig.mqtt_user;
-          newConfig.mqtt_password =
-              doc["mqtt_password"] | currentConfig.mqtt_password;
-          newConfig.board_id = doc["board_id"] | currentConfig.board_id;
-          newConfig.location = doc["location"] | currentConfig.location;
+          Config newConfig = currentConfig;
+          String configError;
+          if (!parseConfig(doc.as<JsonVariantConst>(), newConfig,
+                           configError)) {
+            StaticJsonDocument<192> err;
+            err["status"] = "error";
+            err["message"] = configError;
+            String errStr;
+            serializeJson(err, errStr);
+            request->send(400, "application/json", errStr);
+            return;
+          }
+          // Once set, the key can only be changed by a bundle signed with it
+          if (currentConfig.provision_key.length() > 0)
+            newConfig.provision_key = currentConfig.provision_key;
 
           if (configManager.save(newConfig)) {
-            currentConfig = newConfig;
+            eventLog.append(EVENT_CONFIG_SAVED);
             request->send(200, "application/json",
                           "{\"status\":\"success\",\"message\":\"Settings "
                           "saved. Rebooting...\"}");
-            delay(1000);
-            ESP.restart();
+            pendingConfig = newConfig;
+            pendingReboot = true;
+            rebootReason = REBOOT_SETTINGS_SAVED;
+            configPending = true;
           } else {
             request->send(500, "application/json",
                           "{\"status\":\"error\",\"message\":\"Failed to save "
@@ -838,14 +1228,42 @@ void HSC_Base::setupWebServer() {
         }
       });
 
+  // API: Apply a signed provisioning bundle (see ProvisionBundle.h)
+  server.on(
+      "/api/provision", HTTP_POST, [](AsyncWebServerRequest *request) {},
+      NULL,
+      [this](AsyncWebServerRequest *request, uint8_t *data, size_t len,
+             size_t index, size_t total) {
+        static String body;
+        if (total > PROVISION_MAX_BYTES) {
+          if (index == 0)
+            request->send(413, "application/json",
+                          "{\"status\":\"error\",\"message\":\"Bundle too "
+                          "large\"}");
+          return;
+        }
+        if (index == 0) {
+          body = "";
+          body.reserve(total);
+        }
+        for (size_t i = 0; i < len; i++)
+          body += (char)data[i];
+
+        if (index + len == total) {
+          Supervisor::Scope scope(supervisor, webSection);
+          handleProvision(request, body);
+          body = "";
+        }
+      });
+
   // API: Reset Settings
   server.on("/api/reset", HTTP_POST, [this](AsyncWebServerRequest *request) {
     configManager.reset();
     request->send(200, "application/json",
                   "{\"status\":\"success\",\"message\":\"Settings reset. "
                   "Rebooting...\"}");
-    delay(1000);
-    ESP.restart();
+    rebootReason = REBOOT_SETTINGS_RESET;
+    shouldReboot = true;
   });
 
   // API: Toggle Locate
@@ -870,258 +1288,711 @@ void HSC_Base::setupWebServer() {
   server.on("/api/restart", HTTP_POST, [this](AsyncWebServerRequest *request) {
     request->send(200, "application/json",
                   "{\"status\":\"success\",\"message\":\"Rebooting...\"}");
+    rebootReason = REBOOT_API_RESTART;
     shouldReboot = true;
   });
 
   // API: OTA Update
   server.on("/api/update", HTTP_POST, [this](AsyncWebServerRequest *request) {
+    if (ota.isRunning()) {
+      request->send(409, "application/json",
+                    "{\"status\":\"error\",\"message\":\"Update already in "
+                    "progress\"}");
+      return;
+    }
     request->send(200, "application/json",
-                  "{\"status\":\"success\",\"message\":\"Update started. Check "
-                  "Serial Monitor. Device will reboot...\"}");
+                  "{\"status\":\"success\",\"message\":\"Update started. "
+                  "Device will reboot when it completes...\"}");
     shouldUpdate = true;
   });
 
+  // API: OTA Progress
+  server.on("/api/update/status", HTTP_GET,
+            [this](AsyncWebServerRequest *request) {
+              StaticJsonDocument<384> doc;
+              fillOtaStatus(doc.to<JsonObject>(), ota.status());
+              String response;
+              serializeJson(doc, response);
+              request->send(200, "application/json", response);
+            });
+
   // API: Check Firmware
   server.on(
       "/api/firmware/check", HTTP_GET, [this](AsyncWebServerRequest *request) {
-        const char *currentVersion = firmwareVersion.c_str();
-        String updateUrl = currentConfig.update_url;
-        if (updateUrl.length() == 0) {
+        // Blocks on the update server
+        Supervisor::Scope scope(supervisor, webSection);
+        if (currentConfig.update_url.length() == 0) {
           request->send(400, "application/json",
                         "{\"status\":\"error\",\"message\":\"No update URL "
                         "configured\"}");
           return;
         }
 
-        // Resolve URL
-        updateUrl.replace("%BOARD_TYPE%", boardTypeShort);
-
-        // Derive Metadata URL (replace extension .bin with .json)
-        String checkUrl = updateUrl;
-        int dotIndex = checkUrl.lastIndexOf('.');
-        if (dotIndex != -1) {
-          checkUrl = checkUrl.substring(0, dotIndex) + ".json";
-        } else {
-          checkUrl += ".json";
-        }
-
-        WiFiClient client;
-        HTTPClient http;
-        http.begin(client, checkUrl);
-        int httpCode = http.GET();
-
-        if (httpCode == HTTP_CODE_OK) {
-          String payload = http.getString();
-          StaticJsonDocument<1024> remoteDoc;
-          DeserializationError error = deserializeJson(remoteDoc, payload);
-
-          if (!error) {
-            String remoteVersion = remoteDoc["version"] | "unknown";
-            String notes = remoteDoc["notes"] | "";
-
-            bool updateAvailable = remoteVersion != String(currentVersion);
-
-            // Construct response
-            StaticJsonDocument<1024> resDoc;
-            resDoc["current_version"] = currentVersion;
-            resDoc["remote_version"] = remoteVersion;
-            resDoc["update_available"] = updateAvailable;
-            resDoc["notes"] = notes;
-
-            String resStr;
-            serializeJson(resDoc, resStr);
-            request->send(200, "application/json", resStr);
-          } else {
-            request->send(
-                502, "application/json",
-                "{\"status\":\"error\",\"message\":\"Invalid JSON from "
-                "server\"}");
-          }
-        } else {
+        FirmwareMetadata meta;
+        MetadataResult result =
+            ota.checkMetadata(resolveUpdateUrl(currentConfig.update_url), meta);
+        if (result == METADATA_ERR_HTTP) {
           request->send(
               502, "application/json",
               "{\"status\":\"error\",\"message\":\"Failed to fetch update "
               "metadata\"}");
+          return;
+        } else if (result == METADATA_ERR_JSON) {
+          request->send(
+              502, "application/json",
+              "{\"status\":\"error\",\"message\":\"Invalid JSON from "
+              "server\"}");
+          return;
+        }
+
+        String remoteVersion =
+            meta.version.length() > 0 ? meta.version : "unknown";
+
+        // Construct response
+        StaticJsonDocument<1024> resDoc;
+        resDoc["current_version"] = profile.firmware;
+        resDoc["remote_version"] = remoteVersion;
+        resDoc["update_available"] = remoteVersion != profile.firmware;
+        resDoc["notes"] = meta.notes;
+        resDoc["size"] = meta.size;
+        // Delta available from the running version (if the image matches)
+        const DeltaInfo *delta = meta.deltaFrom(profile.firmware);
+        if (delta) {
+          resDoc["delta_size"] = delta->size;
         }
-        http.end();
+        resDoc["cached"] = result != METADATA_FETCHED;
+
+        String resStr;
+        serializeJson(resDoc, resStr);
+        request->send(200, "application/json", resStr);
       });
 
+  // API: Download Event Log (CSV, or raw records with ?format=bin)
+  server.on("/api/events", HTTP_GET, [this](AsyncWebServerRequest *request) {
+    // The stream holds a chunk buffer and a SPIFFS file for its whole run
+    if (heap.shedding()) {
+      historyRefused++;
+      request->send(503, "application/json",
+                    "{\"status\":\"error\",\"message\":\"Event history "
+                    "unavailable while memory is low\"}");
+      return;
+    }
+    bool raw = request->hasParam("format") &&
+               request->getParam("format")->value() == "bin";
+
+    // Include records still waiting in the RAM buffer
+    {
+      Supervisor::Scope scope(supervisor, webSection);
+      eventLog.flush();
+    }
+
+    std::shared_ptr<EventLog::Cursor> cursor =
+        std::make_shared<EventLog::Cursor>();
+    eventLog.openCursor(*cursor, raw);
+
+    AsyncWebServerResponse *response = request->beginChunkedResponse(
+        raw ? "application/octet-stream" : "text/csv",
+        [this, cursor](uint8_t *buffer, size_t maxLen, size_t index) {
+          return eventLog.read(*cursor, buffer, maxLen);
+        });
+    response->addHeader("Content-Disposition",
+                        raw ? "attachment; filename=events.bin"
+                            : "attachment; filename=events.csv");
+    request->send(response);
+  });
+
   // API: Get Status
   server.on("/api/status", HTTP_GET, [this](AsyncWebServerRequest *request) {
     AsyncResponseStream *response =
         request->beginResponseStream("application/json");
-    StaticJsonDocument<256> doc;
-
-    unsigned long seconds = millis() / 1000;
-    unsigned long days = seconds / 86400;
-    seconds %= 86400;
-    unsigned long hours = seconds / 3600;
-    seconds %= 3600;
-    unsigned long minutes = seconds / 60;
-    seconds %= 60;
-
-    char uptime[32];
-    if (days > 0) {
-      sprintf(uptime, "%lud %02luh %02lum", days, hours, minutes);
-    } else if (hours > 0) {
-      sprintf(uptime, "%luh %02lum %02lus", hours, minutes, seconds);
-    } else {
-      sprintf(uptime, "%lum %02lus", minutes, seconds);
-    }
-    doc["uptime"] = uptime;
+    DeviceStatus status;
+    readStatus(status);
+    JsonWriter json(*response);
+    json.beginObject();
+    json.add("uptime", status.uptime);
+    json.add("rssi", status.rssi);
+    json.add("free_memory", status.freeMemory);
+    json.add("memory_state", HeapGuard::levelName(status.memoryState));
+    json.add("runtime", status.runtime);
+    json.endObject();
+    request->send(response);
+  });
 
-    if (WiFi.status() == WL_CONNECTED) {
-      char rssi[16];
-      sprintf(rssi, "%d dBm", WiFi.RSSI());
-      doc["rssi"] = rssi;
+#ifdef HSC_FAULT_INJECTION
+  // API: Block a supervised path once, to test stall detection, or
+  // fragment the heap
+  server.on("/api/fault", HTTP_POST, [this](AsyncWebServerRequest *request) {
+    String section =
+        request->hasParam("section") ? request->getParam("section")->value()
+                                     : "";
+    uint32_t ms = request->hasParam("ms")
+                      ? request->getParam("ms")->value().toInt()
+                      : 0;
+    if (section == "loop") {
+      faultLoopMs = ms;
+    } else if (section == "network") {
+      faultNetworkMs = ms;
+    } else if (section == "web") {
+      Supervisor::Scope scope(supervisor, webSection);
+      delay(ms);
+    } else if (section == "heap") {
+      // Fill the heap with blocks of N bytes, each followed by a small
+      // pinned one, then free the blocks: the free heap comes back, but
+      // in holes of N bytes. bytes=0 frees the pins.
+      uint32_t bytes = request->hasParam("bytes")
+                           ? request->getParam("bytes")->value().toInt()
+                           : 0;
+      for (int i = 0; i < 128; i++) {
+        free(faultPins[i]);
+        faultPins[i] = nullptr;
+      }
+      void *blocks[128] = {};
+      for (int i = 0; bytes > 0 && i < 128; i++) {
+        blocks[i] = malloc(bytes);
+        faultPins[i] = malloc(32);
+        if (!blocks[i] || !faultPins[i])
+          break;
+      }
+      for (int i = 0; i < 128; i++)
+        free(blocks[i]);
+      Serial.printf("Fault injection: heap in %u byte holes, largest %u\n",
+                    bytes, ESP.getMaxAllocHeap());
+      request->send(200, "application/json", "{\"status\":\"success\"}");
+      return;
     } else {
-      doc["rssi"] = "N/A";
+      request->send(400, "application/json",
+                    "{\"status\":\"error\",\"message\":\"section must be "
+                    "loop, network, web or heap\"}");
+      return;
     }
+    Serial.printf("Fault injection: blocking %s for %u ms\n", section.c_str(),
+                  ms);
+    request->send(200, "application/json", "{\"status\":\"success\"}");
+  });
+#endif
 
-    float freeKB = ESP.getFreeHeap() / 1024.0;
-    char mem[16];
-    sprintf(mem, "%.1f KB", freeKB);
-    doc["free_memory"] = mem;
-
-    struct tm timeinfo;
-    if (getLocalTime(&timeinfo)) {
-      char dateTimeStr[32];
-      strftime(dateTimeStr, sizeof(dateTimeStr), "%m-%d-%y %H:%M:%S",
-               &timeinfo);
-      doc["runtime"] = dateTimeStr;
-    } else {
-      doc["runtime"] = "Not synced";
+  // API: Delivery metrics
+  server.on("/api/metrics", HTTP_GET, [this](AsyncWebServerRequest *request) {
+    AsyncResponseStream *response =
+        request->beginResponseStream("application/json");
+    // Streamed: this is answered even while the heap guard sheds load
+    JsonWriter json(*response);
+
+    const MqttOutboxStats &st = mqttClient.outboxStats();
+    json.beginObject();
+    json.beginObject("mqtt");
+    json.add("connected", mqttClient.state() == MQTT_STATE_CONNECTED);
+    json.add("state", mqttClient.state());
+    json.add("queued", st.queued);
+    json.add("acked", st.acked);
+    json.add("in_flight", st.inFlight);
+    json.add("in_flight_max", st.maxInFlight);
+    json.add("pending", st.pending);
+    json.add("retransmits", st.retransmits);
+    json.add("dropped", st.dropped);
+    json.add("dual_publish", mqttClient.dualPublish());
+    json.add("session_present", mqttClient.sessionPresent());
+    json.add("skipped", mqttClient.skippedCount());
+
+    json.beginArray("brokers");
+    int active = mqttClient.activeBroker();
+    int secondary = mqttClient.secondaryBroker();
+    for (size_t i = 0; i < mqttClient.brokerCount(); i++) {
+      const MqttBrokerStats &bs = mqttClient.brokerStats(i);
+      json.beginObject();
+      json.add("host", mqttClient.brokerHost(i).c_str());
+      json.add("port", mqttClient.brokerPort(i));
+      json.add("role", (int)i == active      ? "active"
+                       : (int)i == secondary ? "secondary"
+                                             : "standby");
+      json.add("connects", bs.connects);
+      json.add("failures", bs.failures);
+      json.add("lost", bs.lost);
+      json.add("connect_ms", bs.connectMs);
+      json.add("rtt_ms", bs.rttMs);
+      json.add("state", bs.lastState);
+      json.endObject();
+    }
+    json.endArray();
+    json.endObject();
+
+    ClockStats cs = clockService.stats();
+    json.beginObject("clock");
+    json.add("synced", cs.synced);
+    json.add("server", currentConfig.ntp_server.c_str());
+    json.add("offset_us", cs.offsetUs);
+    json.add("drift_ppm", cs.driftPpm, 3);
+    json.add("slew_us", cs.slewUs);
+    json.add("syncs", cs.syncs);
+    json.add("steps", cs.steps);
+    json.add("rejected", cs.rejected);
+    json.add("last_sync_s", cs.lastSyncAgeS);
+    json.add("utc_us", clockService.nowUtcMicros());
+    json.endObject();
+
+    const HeapSample &hs = heap.sample();
+    json.beginObject("heap");
+    json.add("level", HeapGuard::levelName(heap.level()));
+    json.add("free", hs.freeBytes);
+    json.add("min_free", hs.minFreeBytes);
+    json.add("largest_block", hs.largestBlock);
+    json.add("min_largest_block", heap.minLargestBlock());
+    json.add("fragmentation", heap.fragmentation());
+    json.add("transitions", heap.transitions());
+    json.add("web_rejected", webRejected);
+    json.add("history_refused", historyRefused);
+    json.add("mqtt_window", heap.shedding() ? MQTT_INFLIGHT_WINDOW_LOW_HEAP
+                                            : MQTT_INFLIGHT_WINDOW);
+    json.endObject();
+
+    const RequestLimiterStats &ws = webLimiter.stats();
+    json.beginObject("web");
+    json.add("open", webLimiter.open());
+    json.add("peak_open", ws.peakOpen);
+    json.add("heavy", webLimiter.heavy());
+    json.add("clients", webLimiter.clients());
+    json.add("admitted", ws.admitted);
+    json.add("client_limited", ws.clientLimited);
+    json.add("global_limited", ws.globalLimited);
+    json.add("busy", ws.busy);
+    json.add("deferred", ws.deferred);
+    json.endObject();
+
+    const StallDetector &sd = supervisor.detector();
+    json.beginObject("supervisor");
+    json.add("stalls", supervisor.stallCount());
+    json.beginArray("sections");
+    uint32_t nowMs = millis();
+    for (int i = 0; i < sd.count(); i++) {
+      json.beginObject();
+      json.add("name", sd.name(i));
+      json.add("timeout_ms", sd.timeoutMs(i));
+      json.add("age_ms", sd.ageMs(i, nowMs));
+      json.add("busy_ms", sd.busyMs(i, nowMs));
+      json.endObject();
     }
+    json.endArray();
+    StallReport stall = supervisor.lastStall();
+    if (stall.valid) {
+      json.beginObject("last_stall");
+      json.add("section", stall.section);
+      json.add("inside", stall.inside);
+      json.add("stalled_ms", stall.stalledMs);
+      json.add("caused_reset", stall.beforeReset);
+      json.endObject();
+    }
+    json.endObject();
+
+    json.beginObject("peers");
+    json.add("enabled", peers.started());
+    if (peers.started()) {
+      PeerLinkStats ps = peers.stats();
+      json.add("sent", ps.sent);
+      json.add("received", ps.received);
+      json.add("invalid", ps.invalid);
+      json.add("overflow", ps.overflow);
+      json.add("rejected", peers.table().rejected());
+      json.add("latency_us_last", ps.lastLatencyUs);
+      json.add("latency_us_max", ps.maxLatencyUs);
+      json.add("latency_us_avg", ps.avgLatencyUs);
+      json.beginArray("boards");
+      uint32_t now = millis();
+      for (int i = 0; i < peers.table().count(); i++) {
+        const PeerState &p = peers.table().at(i);
+        char mask[17];
+        snprintf(mask, sizeof(mask), "%llx", (unsigned long long)p.mask);
+        json.beginObject();
+        json.add("board_id", p.boardId);
+        json.add("online", p.online);
+        json.add("tracks", p.count);
+        json.add("mask", mask);
+        json.add("seq", p.seq);
+        json.add("age_ms", now - p.lastSeenMs);
+        json.add("frames", p.frames);
+        json.add("lost", p.lost);
+        json.add("duplicates", p.duplicates);
+        json.endObject();
+      }
+      json.endArray();
+    }
+    json.endObject();
+    json.endObject();
 
-    serializeJson(doc, *response);
     request->send(response);
   });
 }
 
-void HSC_Base::registerPage(const char *uri, ArRequestHandlerFunction handler) {
-  server.on(uri, HTTP_GET, handler);
+// Reads the settings present in src over config, as sent to /api/settings
+// or in a provisioning bundle. False, with error set, if a value is invalid.
+bool HSC_Base::parseConfig(JsonVariantConst src, Config &config,
+                           String &error) {
+  config.wifi_ssid = src["wifi_ssid"] | config.wifi_ssid;
+  config.wifi_password = src["wifi_password"] | config.wifi_password;
+  config.mqtt_server = src["mqtt_server"] | config.mqtt_server;
+  config.mqtt_port = src["mqtt_port"] | config.mqtt_port;
+  config.mqtt_user = src["mqtt_user"] | config.mqtt_user;
+  config.mqtt_password = src["mqtt_password"] | config.mqtt_password;
+  config.mqtt_fallback = src["mqtt_fallback"] | config.mqtt_fallback;
+  config.mqtt_dual = src["mqtt_dual"] | config.mqtt_dual;
+  config.board_id = src["board_id"] | config.board_id;
+  config.location = src["location"] | config.location;
+  config.low_power = src["low_power"] | config.low_power;
+  config.peer_link = src["peer_link"] | config.peer_link;
+  config.ntp_server = src["ntp_server"] | config.ntp_server;
+  config.tz = src["tz"] | config.tz;
+  config.rules = src["rules"] | config.rules;
+  config.provision_key = src["provision_key"] | config.provision_key;
+
+  // Optional per-track debounce arrays, indexed by track
+  int i = 0;
+  for (JsonVariantConst v : src["debounce_ms"].as<JsonArrayConst>()) {
+    if (i >= MAX_TRACK_INPUTS)
+      break;
+    long ms = v.as<long>();
+    if (ms != 0 && (ms < (long)DEBOUNCE_MIN_MS || ms > (long)DEBOUNCE_MAX_MS)) {
+      error = "Debounce for track " + String(i + 1) + " must be 0 or " +
+              String(DEBOUNCE_MIN_MS) + "-" + String(DEBOUNCE_MAX_MS) + " ms";
+      return false;
+    }
+    config.debounce_ms[i++] = ms;
+  }
+  i = 0;
+  for (JsonVariantConst v : src["debounce_adaptive"].as<JsonArrayConst>()) {
+    if (i >= MAX_TRACK_INPUTS)
+      break;
+    config.debounce_adaptive[i++] = v.as<bool>();
+  }
+
+  // Optional track pin map, an empty array restores the defaults
+  if (src.containsKey("track_pins")) {
+    uint8_t pinMap[MAX_TRACK_INPUTS];
+    int count = 0;
+    for (JsonVariantConst v : src["track_pins"].as<JsonArrayConst>()) {
+      if (count >= MAX_TRACK_INPUTS) {
+        count++;
+        break;
+      }
+      int pin = v.as<int>();
+      pinMap[count++] = (pin >= 0 && pin <= 39) ? pin : 0xFF;
+    }
+    if (count > 0 &&
+        !ConfigManager::validateTrackPins(pinMap, count, error))
+      return false;
+    config.num_tracks = count;
+    memcpy(config.track_pins, pinMap, count);
+  }
+  return true;
 }
 
-void HSC_Base::registerApi(const char *uri, WebRequestMethodComposite method,
-                           ArRequestHandlerFunction handler) {
-  server.on(uri, method, handler);
+// Settings read only at boot: network identity and hardware setup. The
+// rest is applied by applyLiveConfig().
+bool HSC_Base::needsReboot(const Config &from, const Config &to) {
+  return from.wifi_ssid != to.wifi_ssid ||
+         from.wifi_password != to.wifi_password ||
+         from.mqtt_server != to.mqtt_server ||
+         from.mqtt_port != to.mqtt_port || from.mqtt_user != to.mqtt_user ||
+         from.mqtt_password != to.mqtt_password ||
+         from.mqtt_fallback != to.mqtt_fallback ||
+         from.board_id != to.board_id || from.low_power != to.low_power ||
+         (from.peer_link && !to.peer_link) ||
+         from.num_tracks != to.num_tracks ||
+         memcmp(from.track_pins, to.track_pins, to.num_tracks) != 0;
 }
 
-void HSC_Base::performOTA(const String &url) {
-  if (url.length() == 0) {
-    Serial.println("OTA Error: No URL configured");
-    return;
+void HSC_Base::handleProvision(AsyncWebServerRequest *request,
+                               const String &body) {
+  // Answers {"status":"error","message":message} with code
+  auto fail = [request](int code, const char *message) {
+    StaticJsonDocument<160> err;
+    err["status"] = "error";
+    err["message"] = message;
+    String errStr;
+    serializeJson(err, errStr);
+    request->send(code, "application/json", errStr);
+  };
+
+  // Another change is waiting for the loop to take it over
+  if (configPending)
+    return fail(503, "Settings change in progress");
+  if (currentConfig.provision_key.length() == 0)
+    return fail(403, "Provisioning key not set");
+  if (heap.shedding())
+    return fail(503, "Low memory, try again later");
+
+  DynamicJsonDocument outer(body.length() + 256);
+  if (deserializeJson(outer, body))
+    return fail(400, "Invalid JSON");
+  const char *bundle = outer["bundle"] | "";
+  const char *hmac = outer["hmac"] | "";
+  size_t bundleLen = strlen(bundle);
+  if (!provisionSignatureValid(bundle, bundleLen,
+                               currentConfig.provision_key.c_str(),
+                               currentConfig.provision_key.length(), hmac)) {
+    Serial.println("Provisioning: bad signature");
+    return fail(401, "Bad signature");
   }
 
-  String finalUrl = url;
-  finalUrl.replace("%BOARD_TYPE%", boardTypeShort);
+  DynamicJsonDocument doc(2 * bundleLen + 1024);
+  if (deserializeJson(doc, bundle, bundleLen))
+    return fail(400, "Invalid bundle");
+  JsonVariantConst root = doc.as<JsonVariantConst>();
+  uint32_t seq = root["seq"] | 0;
+  if (seq <= currentConfig.provision_seq)
+    return fail(409, "Bundle already applied or older");
+
+  // Common settings, then this board's own
+  Config newConfig = currentConfig;
+  String configError;
+  JsonVariantConst boards = root["boards"];
+  JsonVariantConst own = boards[macStr];
+  if (own.isNull())
+    own = boards[deviceId];
+  if (!boards.isNull() && own.isNull())
+    return fail(404, "Board not in bundle");
+  if (!parseConfig(root["config"], newConfig, configError) ||
+      (!own.isNull() && !parseConfig(own, newConfig, configError)))
+    return fail(400, configError.c_str());
+
+  newConfig.provision_seq = seq;
+  bool reboot = needsReboot(currentConfig, newConfig);
+  if (!configManager.save(newConfig))
+    return fail(500, "Failed to save settings");
+  eventLog.append(EVENT_CONFIG_SAVED, 1, seq);
+  Serial.printf("Provisioning: bundle %u applied%s\n", (unsigned)seq,
+                reboot ? ", rebooting" : "");
+
+  StaticJsonDocument<128> res;
+  res["status"] = "success";
+  res["seq"] = seq;
+  res["reboot"] = reboot;
+  String resStr;
+  serializeJson(res, resStr);
+  request->send(200, "application/json", resStr);
+
+  // Taken over by the loop, which also reboots or applies it
+  pendingConfig = newConfig;
+  pendingReboot = reboot;
+  if (reboot)
+    rebootReason = REBOOT_PROVISIONED;
+  configPending = true;
+}
 
-  // Check metadata for SPIFFS update
-  String checkUrl = finalUrl;
-  int dotIndex = checkUrl.lastIndexOf('.');
-  if (dotIndex != -1) {
-    checkUrl = checkUrl.substring(0, dotIndex) + ".json";
-  } else {
-    checkUrl += ".json";
-  }
+// Applies the settings that do not need a reboot, from the loop
+void HSC_Base::applyLiveConfig() {
+  MDNS.addServiceTxt("hsc", "tcp", "location", currentConfig.location);
+  mqttClient.setDualPublish(currentConfig.mqtt_dual);
+  if (WiFi.status() == WL_CONNECTED)
+    clockService.begin(currentConfig.ntp_server.c_str(),
+                       currentConfig.tz.c_str());
+  if (configHandler)
+    configHandler();
+}
 
-  bool updateSpiffs = false;
-  WiFiClient client;
-  HTTPClient http;
+void HSC_Base::prepareReboot(uint16_t reason) {
+  eventLog.append(EVENT_REBOOT, reason);
+  eventLog.flush();
+}
 
-  // Reuse client logic for http/https in check
-  if (checkUrl.startsWith("https")) {
-    WiFiClientSecure secureClient;
-    secureClient.setInsecure();
-    http.begin(secureClient, checkUrl);
-  } else {
-    http.begin(client, checkUrl);
+void HSC_Base::setIdleCallback(std::function<bool()> callback) {
+  idleCallback = callback;
+}
+
+void HSC_Base::setMqttConnectHandler(std::function<void()> handler) {
+  mqttConnectHandler = handler;
+}
+
+void HSC_Base::setConfigHandler(std::function<void()> handler) {
+  configHandler = handler;
+}
+
+void HSC_Base::setMqttMessageHandler(
+    std::function<void(const char *, const uint8_t *, unsigned int)>
+        handler) {
+  mqttMessageHandler = handler;
+}
+
+void HSC_Base::handleMqttMessage(char *topic, uint8_t *payload,
+                                 unsigned int length) {
+  if (strcmp(topic, "HSC/devices/rollout") == 0) {
+    handleRolloutCommand(payload, length);
+    return;
+  }
+  if (mqttMessageHandler) {
+    mqttMessageHandler(topic, payload, length);
   }
+}
 
-  int httpCode = http.GET();
-  if (httpCode == HTTP_CODE_OK) {
-    String payload = http.getString();
-    StaticJsonDocument<1024> doc;
-    DeserializationError error = deserializeJson(doc, payload);
-    if (!error) {
-      updateSpiffs = doc["update_spiffs"] | false;
-    }
+// Broadcast on HSC/devices/rollout, e.g.
+// {"version":"0.3.0","board_type":"YARD","window_s":1800,"slot_s":60}
+// Optional: "start" (Unix time the window opens), "force" (skip the idle
+// check), "cancel" (drop a pending rollout).
+void HSC_Base::handleRolloutCommand(const uint8_t *payload,
+                                    unsigned int length) {
+  StaticJsonDocument<512> doc;
+  if (deserializeJson(doc, payload, length)) {
+    Serial.println("Rollout: invalid command");
+    return;
   }
-  http.end();
 
-  if (updateSpiffs) {
-    Serial.println("Filesystem update requested...");
-    String spiffsUrl = finalUrl;
-    if (dotIndex != -1) {
-      spiffsUrl = spiffsUrl.substring(0, dotIndex) + ".spiffs.bin";
-    } else {
-      spiffsUrl += ".spiffs.bin";
+  const char *boardType = doc["board_type"] | "";
+  if (strlen(boardType) > 0 && strcmp(boardType, profile.shortName) != 0)
+    return;
+
+  if (doc["cancel"] | false) {
+    if (rollout.state() != ROLLOUT_NONE) {
+      Serial.println("Rollout: cancelled");
+      rollout.cancel();
     }
-    Serial.println("SPIFFS URL: " + spiffsUrl);
+    return;
+  }
 
-    // Unmount SPIFFS to ensure safe update
-    SPIFFS.end();
+  const char *version = doc["version"] | "";
+  if (strlen(version) == 0 || strcmp(profile.firmware, version) == 0) {
+    return; // Nothing to do, or already running this version
+  }
+  if (ota.isRunning() || (rollout.state() != ROLLOUT_NONE &&
+                          strcmp(rollout.version(), version) == 0)) {
+    return; // Repeated (e.g. retained) command
+  }
 
-    httpUpdate.rebootOnUpdate(false); // Don't reboot after SPIFFS
+  uint32_t windowS = doc["window_s"] | ROLLOUT_DEFAULT_WINDOW_S;
+  uint32_t slotS = doc["slot_s"] | ROLLOUT_DEFAULT_SLOT_S;
+  uint32_t start = doc["start"] | 0;
+  bool force = doc["force"] | false;
 
-    t_httpUpdate_return ret;
-    if (spiffsUrl.startsWith("https")) {
-      WiFiClientSecure secureClient;
-      secureClient.setInsecure();
-      ret = httpUpdate.updateSpiffs(secureClient, spiffsUrl);
-    } else {
-      ret = httpUpdate.updateSpiffs(client, spiffsUrl);
-    }
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  uint32_t offset = rolloutOffset(mac, currentConfig.board_id, windowS, slotS);
 
-    if (ret == HTTP_UPDATE_OK) {
-      Serial.println("SPIFFS Update OK");
-    } else {
-      Serial.printf("SPIFFS Update Failed (%d): %s\n",
-                    httpUpdate.getLastError(),
-                    httpUpdate.getLastErrorString().c_str());
-      // Try to recover SPIFFS mount if update failed
-      SPIFFS.begin(true);
+  // Only trust the wall clock once NTP has synced
+  time_t now = time(nullptr);
+  uint32_t nowEpoch = (now > 1600000000) ? (uint32_t)now : 0;
+
+  rollout.schedule(version, offset, start, nowEpoch, millis(), force);
+  Serial.printf("Rollout: %s scheduled in %u s\n", version,
+                (unsigned)rollout.secondsUntilDue(millis()));
+}
+
+void HSC_Base::handleRollout() {
+  // An update needs tens of KB for TLS; wait for the heap to recover
+  bool idle = (!idleCallback || idleCallback()) && !heap.shedding();
+  if (rollout.poll(millis(), idle)) {
+    Serial.printf("Rollout: starting update to %s\n", rollout.version());
+    if (!performOTA(currentConfig.update_url, rollout.version())) {
+      rollout.cancel();
     }
   }
 
-  Serial.println("Starting Firmware Update...");
-  Serial.println("URL: " + finalUrl);
+  if (rollout.state() != lastRolloutState) {
+    lastRolloutState = rollout.state();
+    publishRolloutState();
+  }
+}
 
-  httpUpdate.rebootOnUpdate(true); // Reboot after firmware
+void HSC_Base::publishRolloutState() {
+  if (!mqttClient.connected())
+    return;
 
-  if (finalUrl.startsWith("https")) {
-    WiFiClientSecure secureClient;
-    secureClient.setInsecure(); // Skip cert validation
-    t_httpUpdate_return ret = httpUpdate.update(secureClient, finalUrl);
+  StaticJsonDocument<192> doc;
+  doc["state"] = RolloutScheduler::stateName(rollout.state());
+  doc["version"] = rollout.version();
+  doc["start_in"] = rollout.secondsUntilDue(millis());
 
-    switch (ret) {
-    case HTTP_UPDATE_FAILED:
-      Serial.printf("HTTP_UPDATE_FAILED Error (%d): %s\n",
-                    httpUpdate.getLastError(),
-                    httpUpdate.getLastErrorString().c_str());
-      break;
-    case HTTP_UPDATE_NO_UPDATES:
-      Serial.println("HTTP_UPDATE_NO_UPDATES");
-      break;
-    case HTTP_UPDATE_OK:
-      Serial.println("HTTP_UPDATE_OK");
-      break;
-    }
-  } else {
-    t_httpUpdate_return ret = httpUpdate.update(client, finalUrl);
+  char buffer[192];
+  serializeJson(doc, buffer);
+  String rolloutTopic = "HSC/devices/" + deviceId + "/rollout";
+  mqttClient.publish(rolloutTopic.c_str(), buffer, false);
+}
 
-    switch (ret) {
-    case HTTP_UPDATE_FAILED:
-      Serial.printf("HTTP_UPDATE_FAILED Error (%d): %s\n",
-                    httpUpdate.getLastError(),
-                    httpUpdate.getLastErrorString().c_str());
-      break;
-    case HTTP_UPDATE_NO_UPDATES:
-      Serial.println("HTTP_UPDATE_NO_UPDATES");
-      break;
-    case HTTP_UPDATE_OK:
-      Serial.println("HTTP_UPDATE_OK");
-      break;
-    }
+void HSC_Base::registerPage(const char *uri, ArRequestHandlerFunction handler) {
+  server.on(uri, HTTP_GET, handler);
+}
+
+// Application handlers run under the web section like the built-in ones
+void HSC_Base::registerApi(const char *uri, WebRequestMethodComposite method,
+                           ArRequestHandlerFunction handler) {
+  server.on(uri, method, [this, handler](AsyncWebServerRequest *request) {
+    Supervisor::Scope scope(supervisor, webSection);
+    handler(request);
+  });
+}
+
+bool HSC_Base::performOTA(const String &url, const String &expectVersion) {
+  if (url.length() == 0) {
+    Serial.println("OTA Error: No URL configured");
+    return false;
+  }
+
+  if (heap.shedding()) {
+    Serial.println("OTA Error: Not enough free memory");
+    return false;
+  }
+
+  if (!ota.start(resolveUpdateUrl(url), expectVersion)) {
+    Serial.println("OTA Error: Update already in progress");
+    return false;
+  }
+  eventLog.append(EVENT_OTA_START);
+  return true;
+}
+
+String HSC_Base::resolveUpdateUrl(const String &url) {
+  String finalUrl = url;
+  finalUrl.replace("%BOARD_TYPE%", profile.shortName);
+  return finalUrl;
+}
+
+void HSC_Base::fillOtaStatus(JsonObject obj, const OtaStatus &st) {
+  obj["state"] = OtaUpdater::stateName(st.state);
+  obj["stage"] = OtaUpdater::stageName(st.stage);
+  obj["version"] = st.version;
+  obj["written"] = st.written;
+  obj["total"] = st.total;
+  obj["percent"] = st.total ? (int)((uint64_t)st.written * 100 / st.total) : 0;
+  obj["resumes"] = st.resumes;
+  obj["delta"] = st.delta;
+  if (st.state == OTA_FAILED) {
+    obj["error"] = st.error;
+    obj["message"] = st.message;
+  }
+}
+
+// Runs on the main loop: the OTA task only records its progress, MQTT
+// publishing and the reboot happen here
+void HSC_Base::handleOtaProgress() {
+  OtaStatus st = ota.status();
+  if (st.state == OTA_IDLE)
+    return;
+
+  int percent = st.total ? (int)((uint64_t)st.written * 100 / st.total) : 0;
+  bool changed = st.state != lastOtaState || st.stage != lastOtaStage;
+  if (!changed && (percent == lastOtaPercent ||
+                   millis() - lastOtaPublish < OTA_PROGRESS_INTERVAL_MS))
+    return;
+
+  lastOtaState = st.state;
+  lastOtaStage = st.stage;
+  lastOtaPercent = percent;
+  lastOtaPublish = millis();
+
+  if (mqttClient.connected()) {
+    StaticJsonDocument<384> doc;
+    fillOtaStatus(doc.to<JsonObject>(), st);
+    char buffer[384];
+    serializeJson(doc, buffer);
+    String otaTopic = "HSC/devices/" + deviceId + "/ota";
+    mqttClient.publish(otaTopic.c_str(), buffer, false);
+  }
+
+  if (!changed)
+    return;
+  if (st.state == OTA_FAILED) {
+    eventLog.append(EVENT_OTA_RESULT, 0, st.error);
+    // Let a repeated rollout command try again
+    rollout.cancel();
+  } else if (st.state == OTA_SUCCESS) {
+    eventLog.append(EVENT_OTA_RESULT, 1);
+    rebootReason = REBOOT_OTA;
+    shouldReboot = true;
   }
 }
@@ -1,34 +1,72 @@
 #ifndef HSC_BASE_H
 #define HSC_BASE_H
 
+#include "ClockService.h"
 #include "ConfigManager.h"
+#include "DeviceProfile.h"
+#include "EventLog.h"
+#include "HeapGuard.h"
+#include "JsonWriter.h"
+#include "MqttBrokerPool.h"
+#include "OtaUpdater.h"
+#include "PeerLink.h"
+#include "RequestLimiter.h"
+#include "RolloutScheduler.h"
+#include "Supervisor.h"
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
-#include <HTTPUpdate.h>
-#include <PubSubClient.h>
 #include <SPIFFS.h>
 #include <WiFi.h>
+#include <functional>
 
 // Forward declaration
 class HSC_Base;
 
+// Status for the web page and /api/status, formatted in one place
+struct DeviceStatus {
+  char uptime[24];     // "3d 04h 12m", "4h 12m 09s" or "12m 09s"
+  char rssi[12];       // "-61 dBm", "N/A" without WiFi
+  char freeMemory[16]; // "123.4 KB"
+  char runtime[24];    // Local time, "Not synced" before NTP
+  HeapLevel memoryState;
+};
+
 class HSC_Base {
 public:
-  HSC_Base();
+  // Board type and firmware version come from the profile, which must
+  // outlive the instance (normally the application's constexpr profile)
+  explicit HSC_Base(const DeviceProfile &profile);
   void begin();
   void loop();
 
-  // Set Board Info
-  void setBoardInfo(const char *desc, const char *shortName,
-                    const char *fwVersion);
-
   // Set Update URL
   void setUpdateUrl(const char *url);
 
-  // Perform OTA Update
-  void performOTA(const String &url);
+  // Start an OTA update on a background task; false if it could not start.
+  // A non-empty expectVersion must match the version in the metadata.
+  bool performOTA(const String &url, const String &expectVersion = "");
+
+  // Report whether the device can be interrupted for a rollout update
+  // (e.g. no occupied tracks). Without a callback the device is always idle.
+  void setIdleCallback(std::function<bool()> callback);
+
+  // Receive MQTT messages on topics the application subscribed to
+  void setMqttMessageHandler(
+      std::function<void(const char *topic, const uint8_t *payload,
+                         unsigned int length)>
+          handler);
+
+  // Called whenever a broker becomes the active one, after the device
+  // state: republish application state here. Retained QoS 1 values the
+  // broker already holds are skipped.
+  void setMqttConnectHandler(std::function<void()> handler);
+
+  // Called on the loop after settings were changed without a reboot (by a
+  // provisioning bundle): re-read getConfig() here, e.g. debounce windows
+  // and rules
+  void setConfigHandler(std::function<void()> handler);
 
   // Register a custom page handler
   void registerPage(const char *uri, ArRequestHandlerFunction handler);
@@ -39,38 +77,104 @@ public:
 
   // Getters
   AsyncWebServer &getServer() { return server; }
-  PubSubClient &getMqttClient() { return mqttClient; }
+  MqttBrokerPool &getMqttClient() { return mqttClient; }
   Config &getConfig() { return currentConfig; }
+  EventLog &getEventLog() { return eventLog; }
+  OtaUpdater &getOtaUpdater() { return ota; }
+  ClockService &getClock() { return clockService; }
+  // Occupancy of neighbouring boards; only started with Config peer_link
+  PeerLink &getPeers() { return peers; }
+  // Watchdog supervision; the application adds its own sections (e.g. the
+  // sensing loop) and reports their progress
+  Supervisor &getSupervisor() { return supervisor; }
+  // Memory pressure; applications shed their own optional work (e.g.
+  // statistics) while shedding() is true
+  const HeapGuard &getHeap() const { return heap; }
 
   // Get the template processor function
   String processTemplate(const String &var) { return processor(var); }
 
 private:
   AsyncWebServer server;
-  WiFiClient espClient;
-  PubSubClient mqttClient;
+  MqttBrokerPool mqttClient;
   ConfigManager configManager;
   Config currentConfig;
+  // Saved by a web handler; the loop takes it over, so Config Strings are
+  // never replaced under a reader on the loop task
+  Config pendingConfig;
+  volatile bool configPending = false;
+  bool pendingReboot = false; // Reboot once taken over, else apply live
+  EventLog eventLog;
+  OtaUpdater ota;
+  ClockService clockService;
+  PeerLink peers;
+  Supervisor supervisor;
+  int networkSection = -1;
+  int webSection = -1;
+  bool stallPending = false; // Stall report not yet published
+  HeapGuard heap;
+  unsigned long lastHeapSample = 0;
+  bool heapPending = false; // Level change not yet published
+  volatile uint32_t webRejected = 0;
+  RequestLimiter webLimiter;
+  uint32_t historyRefused = 0;
+#ifdef HSC_FAULT_INJECTION
+  // Set by the /api/fault endpoint
+  uint32_t faultLoopMs = 0;
+  uint32_t faultNetworkMs = 0;
+  void *faultPins[128] = {};
+#endif
 
   bool shouldReboot = false;
+  uint16_t rebootReason = REBOOT_UNKNOWN;
+  bool mqttFailureLogged = false;
   bool locateActive = false;
-  unsigned long lastMqttReconnectAttempt = 0;
-  String boardTypeDesc;
-  String boardTypeShort;
+  const DeviceProfile &profile;
 
   void setupWifi();
-  void reconnectMqtt();
+  void setupMdns();
+  void setupMqtt();
+  void onMqttConnected();
+  void publishDeviceInfo();
+  void publishStall();
+  void sampleHeap();
+  void publishHeap();
   void setupWebServer();
+  bool parseConfig(JsonVariantConst src, Config &config, String &error);
+  static bool needsReboot(const Config &from, const Config &to);
+  void handleProvision(AsyncWebServerRequest *request, const String &body);
+  void applyLiveConfig();
+  void prepareReboot(uint16_t reason);
+  void handleOtaProgress();
+  void handleMqttMessage(char *topic, uint8_t *payload, unsigned int length);
+  void handleRolloutCommand(const uint8_t *payload, unsigned int length);
+  void handleRollout();
+  void publishRolloutState();
+  void fillOtaStatus(JsonObject obj, const OtaStatus &st);
+  String resolveUpdateUrl(const String &url);
+  void readStatus(DeviceStatus &status);
   String processor(const String &var);
 
   String _preConfigUpdateUrl;
   bool shouldUpdate = false;
-  String firmwareVersion = FW_VERSION;
+  OtaState lastOtaState = OTA_IDLE;
+  OtaStage lastOtaStage = OTA_STAGE_NONE;
+  int lastOtaPercent = -1;
+  unsigned long lastOtaPublish = 0;
+
+  // Fleet rollout
+  RolloutScheduler rollout;
+  RolloutState lastRolloutState = ROLLOUT_NONE;
+  std::function<bool()> idleCallback;
+  std::function<void(const char *, const uint8_t *, unsigned int)>
+      mqttMessageHandler;
+  std::function<void()> mqttConnectHandler;
+  std::function<void()> configHandler;
 
   // Device Identity
   String deviceId;
   String macStr;
-  time_t bootTime = 0;
+  time_t bootTime = 0; // 0 until NTP has synced
 };
 
 #endif
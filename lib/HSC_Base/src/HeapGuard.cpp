@@ -0,0 +1,53 @@
+#include "HeapGuard.h"
+
+HeapGuard::HeapGuard()
+    : _level(HEAP_OK), _sample(), _minLargestBlock(UINT32_MAX),
+      _transitions(0) {}
+
+HeapLevel HeapGuard::levelFor(const HeapSample &sample, uint32_t margin) {
+  if (sample.freeBytes < HEAP_CRITICAL_FREE + margin ||
+      sample.largestBlock < HEAP_CRITICAL_BLOCK + margin)
+    return HEAP_CRITICAL;
+  if (sample.freeBytes < HEAP_LOW_FREE + margin ||
+      sample.largestBlock < HEAP_LOW_BLOCK + margin)
+    return HEAP_LOW;
+  return HEAP_OK;
+}
+
+bool HeapGuard::update(const HeapSample &sample) {
+  _sample = sample;
+  if (sample.largestBlock < _minLargestBlock)
+    _minLargestBlock = sample.largestBlock;
+
+  HeapLevel next = levelFor(sample, 0);
+  if (next < _level) {
+    // Only step down as far as the margin allows
+    next = levelFor(sample, HEAP_HYSTERESIS);
+    if (next > _level)
+      next = _level;
+  }
+  if (next == _level)
+    return false;
+  _level = next;
+  _transitions++;
+  return true;
+}
+
+uint8_t HeapGuard::fragmentation() const {
+  if (_sample.freeBytes == 0 || _sample.largestBlock >= _sample.freeBytes)
+    return 0;
+  return 100 - (uint64_t)_sample.largestBlock * 100 / _sample.freeBytes;
+}
+
+const char *HeapGuard::levelName(HeapLevel level) {
+  switch (level) {
+  case HEAP_OK:
+    return "ok";
+  case HEAP_LOW:
+    return "low";
+  case HEAP_CRITICAL:
+    return "critical";
+  default:
+    return "unknown";
+  }
+}
@@ -0,0 +1,65 @@
+#ifndef HEAP_GUARD_H
+#define HEAP_GUARD_H
+
+#include <stdint.h>
+
+// --- Heap Guard Tuning ---
+// Below either limit the device sheds load. Free heap alone is not enough:
+// once fragmented, a 4 KB allocation can fail with 40 KB free, so the
+// largest free block is watched as well.
+static const uint32_t HEAP_LOW_FREE = 40 * 1024;
+static const uint32_t HEAP_LOW_BLOCK = 16 * 1024;
+static const uint32_t HEAP_CRITICAL_FREE = 24 * 1024;
+static const uint32_t HEAP_CRITICAL_BLOCK = 8 * 1024;
+// A level is only left once both values are this far above its limits
+static const uint32_t HEAP_HYSTERESIS = 8 * 1024;
+// The largest block is found by walking the heap, so not every loop
+static const uint32_t HEAP_SAMPLE_MS = 500;
+
+enum HeapLevel : uint8_t {
+  HEAP_OK = 0,
+  // Drop what can be rebuilt later: idle HTTP session, MQTT window,
+  // history downloads
+  HEAP_LOW = 1,
+  // Refuse new web requests and updates
+  HEAP_CRITICAL = 2,
+};
+
+struct HeapSample {
+  uint32_t freeBytes;
+  uint32_t minFreeBytes; // Lowest since boot
+  uint32_t largestBlock;
+};
+
+// Turns heap samples into a load-shedding level, with hysteresis so the
+// level does not flap around a limit. Getting worse takes effect at once,
+// recovering needs a sample clear of the limits. No Arduino dependencies,
+// so it can be driven by a simulated heap on the host.
+class HeapGuard {
+public:
+  HeapGuard();
+
+  // Returns true if the level changed
+  bool update(const HeapSample &sample);
+
+  HeapLevel level() const { return _level; }
+  bool shedding() const { return _level != HEAP_OK; }
+  const HeapSample &sample() const { return _sample; }
+  // Share of the free heap not in the largest block, in percent
+  uint8_t fragmentation() const;
+  // Lowest largest block seen, the closest an allocation came to failing
+  uint32_t minLargestBlock() const { return _minLargestBlock; }
+  uint32_t transitions() const { return _transitions; }
+
+  static const char *levelName(HeapLevel level);
+
+private:
+  volatile HeapLevel _level;
+  HeapSample _sample;
+  uint32_t _minLargestBlock;
+  uint32_t _transitions;
+
+  static HeapLevel levelFor(const HeapSample &sample, uint32_t margin);
+};
+
+#endif
@@ -0,0 +1,84 @@
+#include "HttpSession.h"
+#include <WiFiClientSecure.h>
+
+HttpSession::HttpSession() { _mutex = xSemaphoreCreateMutex(); }
+
+HTTPClient *HttpSession::begin(const String &url, TickType_t wait) {
+  if (xSemaphoreTake(_mutex, wait) != pdTRUE)
+    return nullptr;
+
+  String origin = originOf(url);
+  if (!_client || origin != _origin) {
+    // Replaced before _http.begin() below, which takes the new reference
+    if (_client)
+      _client->stop();
+    _secure = url.startsWith("https");
+    if (_secure) {
+      _client.reset(new WiFiClientSecure());
+    } else {
+      _client.reset(new WiFiClient());
+    }
+    _origin = origin;
+  }
+
+  _reused = _client->connected();
+  if (!_reused) {
+    _connects++;
+    // The CA string may have been reloaded since the last handshake
+    WiFiClientSecure *secureClient =
+        _secure ? static_cast<WiFiClientSecure *>(_client.get()) : nullptr;
+    if (secureClient && _caCert && _caCert->length() > 0) {
+      secureClient->setCACert(_caCert->c_str());
+    } else if (secureClient) {
+      secureClient->setInsecure();
+    }
+  }
+
+  if (!_http.begin(*_client, url)) {
+    xSemaphoreGive(_mutex);
+    return nullptr;
+  }
+  // HTTP/1.1 so the connection survives the response
+  _http.useHTTP10(false);
+  _http.setReuse(true);
+  _http.setTimeout(HTTP_SESSION_TIMEOUT_MS);
+  return &_http;
+}
+
+int HttpSession::GET() {
+  int httpCode = _http.GET();
+  if (httpCode < 0 && _reused) {
+    // The server closed the idle connection; HTTPClient has stopped the
+    // client, so this attempt opens a new one
+    _reused = false;
+    _connects++;
+    httpCode = _http.GET();
+  }
+  return httpCode;
+}
+
+void HttpSession::end(bool reusable) {
+  if (!reusable && _client)
+    _client->stop();
+  _http.end();
+  _lastUsed = millis();
+  xSemaphoreGive(_mutex);
+}
+
+void HttpSession::closeIfIdle(uint32_t idleMs) {
+  if (xSemaphoreTake(_mutex, 0) != pdTRUE)
+    return;
+  // The stopped client stays in place for the next begin(); TLS buffers
+  // are released by stop()
+  if (_client && _client->connected() && millis() - _lastUsed > idleMs)
+    _client->stop();
+  xSemaphoreGive(_mutex);
+}
+
+String HttpSession::originOf(const String &url) {
+  int scheme = url.indexOf("://");
+  if (scheme == -1)
+    return url;
+  int path = url.indexOf('/', scheme + 3);
+  return (path == -1) ? url : url.substring(0, path);
+}
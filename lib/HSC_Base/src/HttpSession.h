@@ -0,0 +1,65 @@
+#ifndef HTTP_SESSION_H
+#define HTTP_SESSION_H
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <WiFiClient.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <memory>
+
+// --- HTTP Session Tuning ---
+// Timeout for connecting and reading response headers
+static const uint16_t HTTP_SESSION_TIMEOUT_MS = 10000;
+// Idle connections are closed after this long; a TLS connection holds
+// tens of KB of heap and servers drop idle keep-alives anyway
+static const uint32_t HTTP_SESSION_IDLE_MS = 15000;
+
+// One keep-alive HTTP(S) connection to the update server, shared by the
+// metadata check and the image downloads so they pay TCP and TLS setup once
+// instead of once per request. Only one request can use the session at a
+// time; begin() locks it until end().
+class HttpSession {
+public:
+  HttpSession();
+
+  // PEM CA used for https; empty means the server is not verified. The
+  // string must stay valid while the session is in use.
+  void setCACert(const String *caCert) { _caCert = caCert; }
+
+  // Lock the session and prepare a request for url, reconnecting when the
+  // scheme, host or port differ from the open connection. Returns nullptr
+  // if the session stays busy for wait ticks or the URL is invalid.
+  HTTPClient *begin(const String &url, TickType_t wait = portMAX_DELAY);
+
+  // Send the request. A reused connection the server has meanwhile closed
+  // is reopened once before giving up.
+  int GET();
+
+  // Finish the request and unlock the session. Pass reusable = false when
+  // the body was not read to the end, so the connection is dropped.
+  void end(bool reusable = true);
+
+  // Close the connection if it has not been used for idleMs; skipped while
+  // a request is in progress. Call periodically from the main loop.
+  void closeIfIdle(uint32_t idleMs = HTTP_SESSION_IDLE_MS);
+
+  // TCP connections opened so far, to see how well reuse works
+  uint32_t connectCount() const { return _connects; }
+
+private:
+  SemaphoreHandle_t _mutex;
+  const String *_caCert = nullptr;
+  String _origin; // scheme://host:port of the open connection
+  bool _secure = false;
+  bool _reused = false;
+  unsigned long _lastUsed = 0;
+  uint32_t _connects = 0;
+  // Destroy the HTTPClient before the client it holds a reference to
+  std::unique_ptr<WiFiClient> _client;
+  HTTPClient _http;
+
+  static String originOf(const String &url);
+};
+
+#endif
@@ -0,0 +1,169 @@
+#include "JsonWriter.h"
+#include <math.h>
+#include <string.h>
+
+JsonWriter::JsonWriter(Print &out)
+    : _out(&out), _buffer(nullptr), _size(0), _length(0), _depth(0),
+      _hasItems(0) {}
+
+JsonWriter::JsonWriter(char *buffer, size_t size)
+    : _out(nullptr), _buffer(buffer), _size(size), _length(0), _depth(0),
+      _hasItems(0) {
+  if (size > 0)
+    buffer[0] = '\0';
+}
+
+void JsonWriter::put(const char *data, size_t len) {
+  if (_out) {
+    _out->write((const uint8_t *)data, len);
+  } else if (_length + 1 < _size) {
+    size_t room = _size - 1 - _length;
+    size_t n = len < room ? len : room;
+    memcpy(_buffer + _length, data, n);
+    _buffer[_length + n] = '\0';
+  }
+  _length += len;
+}
+
+// Comma before every element of a level but the first
+void JsonWriter::separator() {
+  uint8_t bit = 1 << _depth;
+  if (_hasItems & bit)
+    put(',');
+  _hasItems |= bit;
+}
+
+void JsonWriter::key(const char *key) {
+  separator();
+  if (key) {
+    string(key);
+    put(':');
+  }
+}
+
+void JsonWriter::string(const char *value) {
+  put('"');
+  const char *run = value;
+  for (const char *p = value; *p; p++) {
+    unsigned char c = *p;
+    if (c >= 0x20 && c != '"' && c != '\\')
+      continue;
+    put(run, p - run);
+    run = p + 1;
+    char esc[6] = {'\\', 'u', '0', '0', 0, 0};
+    switch (c) {
+    case '"':
+    case '\\':
+      esc[1] = c;
+      put(esc, 2);
+      break;
+    case '\n':
+      put("\\n", 2);
+      break;
+    case '\r':
+      put("\\r", 2);
+      break;
+    case '\t':
+      put("\\t", 2);
+      break;
+    default:
+      esc[4] = "0123456789abcdef"[c >> 4];
+      esc[5] = "0123456789abcdef"[c & 0xF];
+      put(esc, 6);
+    }
+  }
+  put(run, strlen(run));
+  put('"');
+}
+
+void JsonWriter::number(unsigned long long value, bool negative) {
+  char digits[21];
+  char *p = digits + sizeof(digits);
+  do {
+    *--p = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  if (negative)
+    *--p = '-';
+  put(p, digits + sizeof(digits) - p);
+}
+
+void JsonWriter::beginObject(const char *key) {
+  this->key(key);
+  put('{');
+  if (_depth < JSON_WRITER_MAX_DEPTH - 1)
+    _depth++;
+  _hasItems &= ~(1 << _depth);
+}
+
+void JsonWriter::close(char c) {
+  if (_depth > 0)
+    _depth--;
+  put(c);
+}
+
+void JsonWriter::beginArray(const char *key) {
+  this->key(key);
+  put('[');
+  if (_depth < JSON_WRITER_MAX_DEPTH - 1)
+    _depth++;
+  _hasItems &= ~(1 << _depth);
+}
+
+void JsonWriter::add(const char *key, const char *value) {
+  this->key(key);
+  if (value)
+    string(value);
+  else
+    put("null", 4);
+}
+
+void JsonWriter::add(const char *key, bool value) {
+  this->key(key);
+  if (value)
+    put("true", 4);
+  else
+    put("false", 5);
+}
+
+void JsonWriter::addSigned(const char *key, long long value) {
+  this->key(key);
+  number(value < 0 ? 0 - (unsigned long long)value : value, value < 0);
+}
+
+void JsonWriter::addUnsigned(const char *key, unsigned long long value) {
+  this->key(key);
+  number(value, false);
+}
+
+// Fixed point, so no printf; NaN and infinity are not JSON and become null
+void JsonWriter::add(const char *key, float value, uint8_t decimals) {
+  this->key(key);
+  if (isnan(value) || isinf(value)) {
+    put("null", 4);
+    return;
+  }
+  if (decimals > 6)
+    decimals = 6;
+  uint32_t scale = 1;
+  for (uint8_t i = 0; i < decimals; i++)
+    scale *= 10;
+  bool negative = value < 0;
+  unsigned long long scaled = fabsf(value) * scale + 0.5f;
+  number(scaled / scale, negative && scaled > 0);
+  if (decimals == 0)
+    return;
+  char frac[7];
+  uint32_t rest = scaled % scale;
+  for (int i = decimals - 1; i >= 0; i--) {
+    frac[i] = '0' + rest % 10;
+    rest /= 10;
+  }
+  put('.');
+  put(frac, decimals);
+}
+
+void JsonWriter::addNull(const char *key) {
+  this->key(key);
+  put("null", 4);
+}
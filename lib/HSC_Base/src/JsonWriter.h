@@ -0,0 +1,84 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <Print.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Deepest nesting of objects and arrays
+static const int JSON_WRITER_MAX_DEPTH = 8;
+
+// Writes JSON as it goes, straight into a Print (e.g. AsyncResponseStream)
+// or a fixed buffer, without building a document first. Keys and string
+// values are escaped; nothing is allocated, so a reply costs the same heap
+// however many fields it has.
+//
+//   JsonWriter json(*response);
+//   json.beginObject();
+//   json.add("uptime", uptime);
+//   json.beginArray("pins");
+//   json.value(4);
+//   json.endArray();
+//   json.endObject();
+//
+// Nesting is not checked beyond the depth limit: callers close what they
+// open.
+class JsonWriter {
+public:
+  explicit JsonWriter(Print &out);
+  // Always NUL-terminated; see overflowed()
+  JsonWriter(char *buffer, size_t size);
+
+  void beginObject(const char *key = nullptr);
+  void endObject() { close('}'); }
+  void beginArray(const char *key = nullptr);
+  void endArray() { close(']'); }
+
+  // Object members. Integers of every width go through the overloads for
+  // the built-in types, which int32_t and friends map to on each platform.
+  void add(const char *key, const char *value);
+  void add(const char *key, bool value);
+  void add(const char *key, int value) { addSigned(key, value); }
+  void add(const char *key, long value) { addSigned(key, value); }
+  void add(const char *key, long long value) { addSigned(key, value); }
+  void add(const char *key, unsigned value) { addUnsigned(key, value); }
+  void add(const char *key, unsigned long value) { addUnsigned(key, value); }
+  void add(const char *key, unsigned long long value) {
+    addUnsigned(key, value);
+  }
+  void add(const char *key, float value, uint8_t decimals);
+  void addNull(const char *key);
+
+  // Array elements
+  void value(const char *value) { add(nullptr, value); }
+  void value(bool value) { add(nullptr, value); }
+  void value(int value) { addSigned(nullptr, value); }
+  void value(long value) { addSigned(nullptr, value); }
+  void value(unsigned value) { addUnsigned(nullptr, value); }
+  void value(unsigned long value) { addUnsigned(nullptr, value); }
+
+  // Bytes written, or that would have been for a buffer that overflowed
+  size_t length() const { return _length; }
+  // True if the buffer was too small; its content is then cut short
+  bool overflowed() const { return _buffer && _length >= _size; }
+
+private:
+  Print *_out;
+  char *_buffer;
+  size_t _size;
+  size_t _length;
+  int _depth;
+  uint8_t _hasItems; // Bit d set once level d has an element
+
+  void put(const char *data, size_t len);
+  void put(char c) { put(&c, 1); }
+  void separator();
+  void key(const char *key);
+  void close(char c);
+  void string(const char *value);
+  void number(unsigned long long value, bool negative);
+  void addSigned(const char *key, long long value);
+  void addUnsigned(const char *key, unsigned long long value);
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "MetadataCache.h"
+#include <ArduinoJson.h>
+
+bool FirmwareMetadata::parse(const String &json) {
+  DynamicJsonDocument doc(OTA_METADATA_JSON_SIZE);
+  if (deserializeJson(doc, json))
+    return false;
+
+  version = doc["version"] | "";
+  notes = doc["notes"] | "";
+  sha256 = doc["sha256"] | "";
+  size = doc["size"] | 0;
+  updateSpiffs = doc["update_spiffs"] | false;
+  spiffsSha256 = doc["spiffs_sha256"] | "";
+  spiffsSize = doc["spiffs_size"] | 0;
+
+  deltaCount = 0;
+  for (JsonObject entry : doc["deltas"].as<JsonArray>()) {
+    if (deltaCount == OTA_MAX_DELTAS)
+      break;
+    DeltaInfo &delta = deltas[deltaCount++];
+    delta.from = entry["from"] | "";
+    delta.sourceSize = entry["source_size"] | 0;
+    delta.sourceSha256 = entry["source_sha256"] | "";
+    delta.url = entry["url"] | "";
+    delta.size = entry["size"] | 0;
+  }
+  return true;
+}
+
+const DeltaInfo *FirmwareMetadata::deltaFrom(const String &version) const {
+  for (size_t i = 0; i < deltaCount; i++) {
+    if (deltas[i].from == version)
+      return &deltas[i];
+  }
+  return nullptr;
+}
+
+MetadataCache::MetadataCache() { _mutex = xSemaphoreCreateMutex(); }
+
+MetadataResult MetadataCache::fetch(const String &url, HttpSession &session,
+                                    FirmwareMetadata &out, TickType_t wait) {
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+
+  bool cached = _valid && _url == url;
+  MetadataResult result = METADATA_ERR_HTTP;
+  HTTPClient *http = session.begin(url, wait);
+  if (!http) {
+    if (cached)
+      result = METADATA_CACHED;
+  } else {
+    const char *headerKeys[] = {"ETag", "Last-Modified"};
+    http->collectHeaders(headerKeys, 2);
+    if (cached && _etag.length() > 0)
+      http->addHeader("If-None-Match", _etag);
+    if (cached && _lastModified.length() > 0)
+      http->addHeader("If-Modified-Since", _lastModified);
+
+    int httpCode = session.GET();
+    if (httpCode == HTTP_CODE_NOT_MODIFIED && cached) {
+      result = METADATA_NOT_MODIFIED;
+    } else if (httpCode == HTTP_CODE_OK) {
+      FirmwareMetadata parsed;
+      if (parsed.parse(http->getString())) {
+        _metadata = parsed;
+        _url = url;
+        _etag = http->header("ETag");
+        _lastModified = http->header("Last-Modified");
+        _valid = true;
+        result = METADATA_FETCHED;
+      } else {
+        _valid = false;
+        result = METADATA_ERR_JSON;
+      }
+    }
+    // Other responses may leave an unread body on the connection
+    session.end(httpCode == HTTP_CODE_OK ||
+                httpCode == HTTP_CODE_NOT_MODIFIED);
+  }
+
+  if (result != METADATA_ERR_HTTP && result != METADATA_ERR_JSON)
+    out = _metadata;
+
+  xSemaphoreGive(_mutex);
+  return result;
+}
@@ -0,0 +1,69 @@
+#ifndef METADATA_CACHE_H
+#define METADATA_CACHE_H
+
+#include "HttpSession.h"
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// Room for the .json metadata including a few delta entries
+static const size_t OTA_METADATA_JSON_SIZE = 3072;
+// Delta entries kept from the metadata (mkdelta.py writes at most this many)
+static const size_t OTA_MAX_DELTAS = 3;
+
+struct DeltaInfo {
+  String from;
+  uint32_t sourceSize = 0;
+  String sourceSha256;
+  String url; // As listed, possibly relative to the firmware image
+  uint32_t size = 0;
+};
+
+// Parsed firmware .json metadata
+struct FirmwareMetadata {
+  String version;
+  String notes;
+  String sha256;
+  uint32_t size = 0;
+  bool updateSpiffs = false;
+  String spiffsSha256;
+  uint32_t spiffsSize = 0;
+  DeltaInfo deltas[OTA_MAX_DELTAS];
+  size_t deltaCount = 0;
+
+  bool parse(const String &json);
+
+  // Delta made from the given version, or nullptr
+  const DeltaInfo *deltaFrom(const String &version) const;
+};
+
+enum MetadataResult : uint8_t {
+  METADATA_FETCHED,      // Downloaded and parsed
+  METADATA_NOT_MODIFIED, // Server answered 304, cached copy returned
+  METADATA_CACHED,       // Connection busy with a download, cached copy returned
+  METADATA_ERR_HTTP,
+  METADATA_ERR_JSON,
+};
+
+// Keeps the last metadata fetched and revalidates it with If-None-Match /
+// If-Modified-Since, so checking an unchanged file costs one 304 round trip
+// and no JSON parsing. Shared by the firmware check endpoint and the OTA
+// task; requests are serialised.
+class MetadataCache {
+public:
+  MetadataCache();
+
+  // Fetch url over session, waiting up to wait ticks for the connection
+  MetadataResult fetch(const String &url, HttpSession &session,
+                       FirmwareMetadata &out, TickType_t wait = portMAX_DELAY);
+
+private:
+  SemaphoreHandle_t _mutex;
+  bool _valid = false;
+  String _url;
+  String _etag;
+  String _lastModified;
+  FirmwareMetadata _metadata;
+};
+
+#endif
@@ -0,0 +1,278 @@
+#include "MqttBrokerPool.h"
+
+MqttBrokerPool::MqttBrokerPool() {
+  for (int i = 0; i < 2; i++) {
+    MqttClient *client = &_clients[i];
+    client->setCallback(
+        [this, client](char *topic, uint8_t *payload, unsigned int length) {
+          // The secondary keeps the subscriptions it had while active
+          if (client == _active && _callback)
+            _callback(topic, payload, length);
+        });
+  }
+}
+
+void MqttBrokerPool::clearBrokers() { _count = 0; }
+
+bool MqttBrokerPool::addBroker(const String &host, uint16_t port) {
+  if (_count == MQTT_MAX_BROKERS || host.length() == 0)
+    return false;
+  Broker &broker = _brokers[_count++];
+  broker.host = host;
+  broker.port = port;
+  broker.consecutiveFailures = 0;
+  broker.stats = MqttBrokerStats();
+  return true;
+}
+
+void MqttBrokerPool::setSession(const String &clientId, const String &user,
+                                const String &password,
+                                const String &willTopic,
+                                const String &willMessage) {
+  _clientId = clientId;
+  _user = user;
+  _password = password;
+  _willTopic = willTopic;
+  _willMessage = willMessage;
+}
+
+void MqttBrokerPool::loop(bool canConnect) {
+  _clients[0].loop();
+  _clients[1].loop();
+
+  unsigned long now = millis();
+  loopActive(canConnect, now);
+  loopStandby(canConnect, now);
+}
+
+void MqttBrokerPool::loopActive(bool canConnect, unsigned long now) {
+  LinkEvent event = track(_active, now);
+  if (event == LINK_CONNECTED) {
+    if (_onConnect)
+      _onConnect();
+    return;
+  }
+
+  if (event == LINK_FAILED || event == LINK_LOST) {
+    int broker = linkOf(_active).broker;
+    if (event == LINK_FAILED && _onFailure)
+      _onFailure(broker, _active->state());
+
+    // A second connection that is already up takes over at once
+    if (_standby->connected()) {
+      swap(now);
+      return;
+    }
+    // A dropped connection is retried at once, failed attempts are paced
+    if (event == LINK_LOST)
+      _retryNow = true;
+    if (_brokers[broker].consecutiveFailures >= MQTT_FAILOVER_ATTEMPTS &&
+        _count > 1) {
+      _brokers[broker].consecutiveFailures = 0;
+      _activeTarget = (broker + 1) % _count;
+      _retryNow = true;
+      Serial.println("MQTT: failing over to " +
+                     _brokers[_activeTarget].host);
+    }
+  }
+
+  if (_active->connected() || _active->connecting() || !canConnect ||
+      _count == 0)
+    return;
+  if (!_retryNow && now - _lastAttempt < MQTT_RECONNECT_MS)
+    return;
+
+  int target = _activeTarget % _count;
+  // Both clients never hold the same broker
+  if (linkOf(_standby).broker == target && _standby->connecting()) {
+    if (_count < 2)
+      return;
+    target = (target + 1) % _count;
+  }
+  _retryNow = false;
+  _lastAttempt = now;
+  start(_active, target, now);
+}
+
+void MqttBrokerPool::loopStandby(bool canConnect, unsigned long now) {
+  LinkEvent event = track(_standby, now);
+  Link &link = linkOf(_standby);
+
+  if (_draining) {
+    const MqttOutboxStats &st = _standby->outboxStats();
+    bool drained = st.inFlight == 0 && st.pending == 0;
+    if (drained || !_standby->connected() ||
+        now - _drainStart >= MQTT_DRAIN_MS) {
+      // Leave the old broker showing the device offline, as the will would
+      if (_standby->connected() && _willTopic.length() > 0)
+        _standby->publish(_willTopic.c_str(), _willMessage.c_str(), true);
+      _standby->disconnect();
+      _brokers[link.broker].stats.lastState = _standby->state();
+      link.up = false;
+      link.broker = -1;
+      _draining = false;
+    }
+    return;
+  }
+
+  if (_count < 2)
+    return;
+  int activeBroker = linkOf(_active).broker;
+
+  if (_dual) {
+    if ((event == LINK_FAILED || event == LINK_LOST) &&
+        _brokers[link.broker].consecutiveFailures >= MQTT_FAILOVER_ATTEMPTS) {
+      _brokers[link.broker].consecutiveFailures = 0;
+      _standbyTarget = nextOther(link.broker);
+    }
+    if (_standby->connected()) {
+      // Fast switch-back: the secondary holds a better broker
+      if (link.broker < activeBroker)
+        swap(now);
+      return;
+    }
+    if (_standby->connecting() || !canConnect ||
+        now - _lastStandbyAttempt < MQTT_RECONNECT_MS)
+      return;
+    int target = _standbyTarget % _count;
+    if (target == activeBroker)
+      target = nextOther(target);
+    if (target < 0)
+      return;
+    _lastStandbyAttempt = now;
+    start(_standby, target, now);
+    return;
+  }
+
+  // Without dual publish the second client only probes brokers preferred
+  // over the one in use, and takes over when one accepts
+  if (_standby->connected()) {
+    if (!_active->connected() || link.broker < activeBroker)
+      swap(now);
+    else
+      _standby->disconnect();
+    return;
+  }
+  if (_standby->connecting() || !canConnect || !_active->connected() ||
+      activeBroker <= 0 ||
+      now - _lastStandbyAttempt < MQTT_SWITCHBACK_PROBE_MS)
+    return;
+  if (_probeTarget >= activeBroker)
+    _probeTarget = 0;
+  _lastStandbyAttempt = now;
+  start(_standby, _probeTarget++, now);
+}
+
+// Make the standby the active connection. The old active one stays up as
+// the secondary with dual publish, or drains and disconnects otherwise.
+void MqttBrokerPool::swap(unsigned long now) {
+  MqttClient *old = _active;
+  _active = _standby;
+  _standby = old;
+
+  int broker = linkOf(_active).broker;
+  _activeTarget = broker;
+  _brokers[broker].consecutiveFailures = 0;
+  // With dual publish the old broker is the secondary, and the one to
+  // return to once it is healthy again
+  if (linkOf(_standby).broker >= 0)
+    _standbyTarget = linkOf(_standby).broker;
+  _draining = !_dual && _standby->connected();
+  _drainStart = now;
+  _lastStandbyAttempt = now;
+  Serial.println("MQTT: switched to " + _brokers[broker].host);
+  if (_onConnect)
+    _onConnect();
+}
+
+void MqttBrokerPool::start(MqttClient *client, int broker,
+                           unsigned long now) {
+  Link &link = linkOf(client);
+  link.broker = broker;
+  link.attempting = true;
+  link.up = false;
+  link.attemptStart = now;
+
+  Broker &b = _brokers[broker];
+  Serial.println("MQTT: connecting to " + b.host + ":" + String(b.port));
+  client->setServer(b.host.c_str(), b.port);
+  bool will = _willTopic.length() > 0;
+  client->connect(_clientId.c_str(), _user.c_str(), _password.c_str(),
+                  will ? _willTopic.c_str() : nullptr, 0, true,
+                  will ? _willMessage.c_str() : nullptr);
+}
+
+// Update the broker's stats from its client and report what changed
+MqttBrokerPool::LinkEvent MqttBrokerPool::track(MqttClient *client,
+                                                unsigned long now) {
+  Link &link = linkOf(client);
+  if (link.broker < 0)
+    return LINK_NONE;
+  MqttBrokerStats &stats = _brokers[link.broker].stats;
+  bool up = client->connected();
+  LinkEvent event = LINK_NONE;
+
+  if (link.attempting) {
+    if (client->connecting())
+      return LINK_NONE;
+    link.attempting = false;
+    if (up) {
+      stats.connects++;
+      stats.connectMs = now - link.attemptStart;
+      _brokers[link.broker].consecutiveFailures = 0;
+      link.ackedSeen = client->outboxStats().acked;
+      event = LINK_CONNECTED;
+    } else {
+      stats.failures++;
+      _brokers[link.broker].consecutiveFailures++;
+      event = LINK_FAILED;
+    }
+  } else if (link.up && !up) {
+    stats.lost++;
+    _brokers[link.broker].consecutiveFailures++;
+    event = LINK_LOST;
+  }
+  link.up = up;
+  stats.lastState = client->state();
+
+  const MqttOutboxStats &st = client->outboxStats();
+  if (up && st.acked != link.ackedSeen) {
+    link.ackedSeen = st.acked;
+    if (stats.rttMs == 0)
+      stats.rttMs = st.lastRttMs;
+    else
+      stats.rttMs += ((int32_t)st.lastRttMs - (int32_t)stats.rttMs) /
+                     MQTT_RTT_SMOOTHING;
+  }
+  return event;
+}
+
+// Next broker after from, in preference order, other than the active one
+int MqttBrokerPool::nextOther(int from) const {
+  int activeBroker = linkOf(_active).broker;
+  for (size_t i = 1; i <= _count; i++) {
+    int candidate = (from + i) % _count;
+    if (candidate != activeBroker)
+      return candidate;
+  }
+  return -1;
+}
+
+bool MqttBrokerPool::publish(const char *topic, const char *payload,
+                             bool retained, uint8_t qos) {
+  return publish(topic, (const uint8_t *)payload, strlen(payload), retained,
+                 qos);
+}
+
+bool MqttBrokerPool::publish(const char *topic, const uint8_t *payload,
+                             size_t length, bool retained, uint8_t qos) {
+  bool ok = _active->publish(topic, payload, length, retained, qos);
+  // The copy is best effort: a full secondary never fails the publish
+  if (_dual && _standby->connected())
+    _standby->publish(topic, payload, length, retained, qos);
+  return ok;
+}
+
+bool MqttBrokerPool::subscribe(const char *topic, uint8_t qos) {
+  return _active->subscribe(topic, qos);
+}
@@ -0,0 +1,173 @@
+#ifndef MQTT_BROKER_POOL_H
+#define MQTT_BROKER_POOL_H
+
+#include "MqttClient.h"
+#include <Arduino.h>
+#include <functional>
+
+// --- MQTT Failover Tuning ---
+// Primary broker plus fallbacks
+static const size_t MQTT_MAX_BROKERS = 4;
+// Failed attempts on one broker before moving on to the next
+static const uint8_t MQTT_FAILOVER_ATTEMPTS = 2;
+// Wait between attempts on the same broker
+static const unsigned long MQTT_RECONNECT_MS = 5000;
+// While on a fallback, how often a more preferred broker is tried
+static const unsigned long MQTT_SWITCHBACK_PROBE_MS = 30000;
+// Unacknowledged messages on the broker being left get this long to drain
+static const unsigned long MQTT_DRAIN_MS = 5000;
+// Weight of a new sample in the smoothed PUBACK round trip (1/n)
+static const uint8_t MQTT_RTT_SMOOTHING = 8;
+
+struct MqttBrokerStats {
+  uint32_t connects = 0;
+  uint32_t failures = 0;  // Attempts that did not get a CONNACK
+  uint32_t lost = 0;      // Established connections that dropped
+  uint32_t connectMs = 0; // Time to CONNACK of the last connect
+  uint32_t rttMs = 0;     // Smoothed QoS 1 PUBACK round trip
+  int8_t lastState = MQTT_STATE_DISCONNECTED;
+};
+
+// An ordered list of brokers behind the MqttClient calls HSC_Base and the
+// application use. The first broker is preferred: after
+// MQTT_FAILOVER_ATTEMPTS failed attempts the next one is tried, and while
+// on a fallback a second connection probes the more preferred brokers and
+// takes over as soon as one accepts. With dual publish on, that second
+// connection instead stays up to the best other broker and gets a copy of
+// every publish.
+//
+// Two MqttClients are used, so nothing blocks: attempts, probes and the
+// switch-over all happen in loop().
+class MqttBrokerPool {
+public:
+  typedef std::function<void()> ConnectHandler;
+  typedef std::function<void(int broker, int state)> FailureHandler;
+
+  MqttBrokerPool();
+
+  void clearBrokers();
+  bool addBroker(const String &host, uint16_t port);
+  size_t brokerCount() const { return _count; }
+  const String &brokerHost(size_t i) const { return _brokers[i].host; }
+  uint16_t brokerPort(size_t i) const { return _brokers[i].port; }
+  const MqttBrokerStats &brokerStats(size_t i) const {
+    return _brokers[i].stats;
+  }
+
+  // Session details used by every connection
+  void setSession(const String &clientId, const String &user,
+                  const String &password, const String &willTopic,
+                  const String &willMessage);
+  void setDualPublish(bool enabled) { _dual = enabled; }
+  // Ask every broker to keep the session across reconnects
+  void setPersistentSession(bool persistent) {
+    _clients[0].setPersistentSession(persistent);
+    _clients[1].setPersistentSession(persistent);
+  }
+  void setInflightWindow(size_t window) {
+    _clients[0].setInflightWindow(window);
+    _clients[1].setInflightWindow(window);
+  }
+  bool dualPublish() const { return _dual; }
+
+  // Messages from the active broker only
+  void setCallback(MqttClient::Callback callback) { _callback = callback; }
+  // A connection became the active one (initial connect, reconnect or
+  // switch-over): publish state and subscribe again
+  void onConnect(ConnectHandler handler) { _onConnect = handler; }
+  void onFailure(FailureHandler handler) { _onFailure = handler; }
+
+  // Drive both connections; new attempts only start while canConnect
+  void loop(bool canConnect = true);
+
+  bool connected() const { return _active->connected(); }
+  int state() const { return _active->state(); }
+  // Index of the broker in use, -1 if none
+  int activeBroker() const {
+    return connected() ? linkOf(_active).broker : -1;
+  }
+  // Index of the broker getting dual publishes, -1 if none
+  int secondaryBroker() const {
+    return _dual && _standby->connected() ? linkOf(_standby).broker : -1;
+  }
+  const MqttOutboxStats &outboxStats() const {
+    return _active->outboxStats();
+  }
+  // The active broker resumed the previous session
+  bool sessionPresent() const { return _active->sessionPresent(); }
+  // Publishes and subscriptions skipped across both connections
+  uint32_t skippedCount() const {
+    return _clients[0].skippedCount() + _clients[1].skippedCount();
+  }
+
+  // Publish to the active broker, and to the secondary with dual publish
+  bool publish(const char *topic, const char *payload, bool retained = false,
+               uint8_t qos = 0);
+  bool publish(const char *topic, const uint8_t *payload, size_t length,
+               bool retained = false, uint8_t qos = 0);
+  bool subscribe(const char *topic, uint8_t qos = 0);
+
+private:
+  struct Broker {
+    String host;
+    uint16_t port;
+    uint8_t consecutiveFailures;
+    MqttBrokerStats stats;
+  };
+
+  // Where one of the two clients is, or is trying to get to
+  struct Link {
+    int broker = -1;
+    bool attempting = false;
+    bool up = false;
+    unsigned long attemptStart = 0;
+    uint32_t ackedSeen = 0;
+  };
+
+  enum LinkEvent : uint8_t {
+    LINK_NONE,
+    LINK_CONNECTED,
+    LINK_FAILED,
+    LINK_LOST,
+  };
+
+  Broker _brokers[MQTT_MAX_BROKERS];
+  size_t _count = 0;
+
+  MqttClient _clients[2];
+  MqttClient *_active = &_clients[0];
+  MqttClient *_standby = &_clients[1];
+  Link _links[2];
+  int _activeTarget = 0;  // Broker the active client tries next
+  int _standbyTarget = 1; // Broker for the secondary with dual publish
+  int _probeTarget = 0;
+  bool _retryNow = true;
+  bool _draining = false;
+  unsigned long _drainStart = 0;
+  unsigned long _lastAttempt = 0;
+  unsigned long _lastStandbyAttempt = 0;
+  bool _dual = false;
+
+  String _clientId;
+  String _user;
+  String _password;
+  String _willTopic;
+  String _willMessage;
+
+  MqttClient::Callback _callback;
+  ConnectHandler _onConnect;
+  FailureHandler _onFailure;
+
+  Link &linkOf(const MqttClient *client) { return _links[client - _clients]; }
+  const Link &linkOf(const MqttClient *client) const {
+    return _links[client - _clients];
+  }
+  void start(MqttClient *client, int broker, unsigned long now);
+  LinkEvent track(MqttClient *client, unsigned long now);
+  void loopActive(bool canConnect, unsigned long now);
+  void loopStandby(bool canConnect, unsigned long now);
+  void swap(unsigned long now);
+  int nextOther(int from) const;
+};
+
+#endif
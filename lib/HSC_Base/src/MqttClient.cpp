@@ -0,0 +1,456 @@
+#include "MqttClient.h"
+
+MqttClient::MqttClient() {
+  // These run on the AsyncTCP task: record what happened and let loop()
+  // act on it
+  _tcp.onConnect([this](void *, AsyncClient *client) {
+    client->setNoDelay(true);
+    _eventConnected = true;
+  });
+  _tcp.onDisconnect(
+      [this](void *, AsyncClient *) { _eventDisconnected = true; });
+  _tcp.onError(
+      [this](void *, AsyncClient *, int8_t) { _eventDisconnected = true; });
+  _tcp.onAck([this](void *, AsyncClient *, size_t len, uint32_t) {
+    portENTER_CRITICAL(&_mux);
+    _ackedBytes += len;
+    portEXIT_CRITICAL(&_mux);
+  });
+  _tcp.onData([this](void *, AsyncClient *, void *data, size_t len) {
+    const uint8_t *in = (const uint8_t *)data;
+    portENTER_CRITICAL(&_mux);
+    if (_rxCount + len > MQTT_RX_BUFFER_SIZE) {
+      _rxOverflow = true;
+    } else {
+      size_t tail = (_rxHead + _rxCount) % MQTT_RX_BUFFER_SIZE;
+      size_t first = MQTT_RX_BUFFER_SIZE - tail;
+      if (first > len)
+        first = len;
+      memcpy(_rxBuf + tail, in, first);
+      memcpy(_rxBuf, in + first, len - first);
+      _rxCount += len;
+    }
+    portEXIT_CRITICAL(&_mux);
+  });
+}
+
+void MqttClient::setServer(const char *host, uint16_t port) {
+  // What one broker holds says nothing about another
+  if (_host != host || _port != port)
+    _session.clear();
+  _host = host;
+  _port = port;
+}
+
+bool MqttClient::connect(const char *clientId, const char *user,
+                         const char *password, const char *willTopic,
+                         uint8_t willQos, bool willRetain,
+                         const char *willMessage) {
+  if (connected())
+    return true;
+  if (_connecting)
+    return false;
+
+  resetTx();
+  _reader.reset();
+  portENTER_CRITICAL(&_mux);
+  _rxHead = 0;
+  _rxCount = 0;
+  _rxOverflow = false;
+  _eventConnected = false;
+  _eventDisconnected = false;
+  portEXIT_CRITICAL(&_mux);
+
+  // CONNECT is encoded now, so none of the strings need to outlive this
+  // call, and goes out as soon as TCP is up
+  MqttConnectOptions opt;
+  opt.clientId = clientId;
+  opt.user = user;
+  opt.password = password;
+  opt.willTopic = willTopic;
+  opt.willMessage = willMessage;
+  opt.willQos = willQos;
+  opt.willRetain = willRetain;
+  opt.cleanSession = !_persistent;
+  opt.keepAliveS = MQTT_KEEPALIVE_S;
+  // The broker may have published the will since the last connection
+  if (willTopic)
+    _session.forgetRetained(willTopic);
+  size_t len = mqttEncodeConnect(_txBuf, sizeof(_txBuf), opt);
+  if (len == 0) {
+    _state = MQTT_STATE_CONNECT_FAILED;
+    return false;
+  }
+  _txEnd = len;
+  queue(nullptr, _txBuf, len);
+
+  _connecting = true;
+  _tcpUp = false;
+  _connectStart = millis();
+  // Name resolution and the TCP handshake continue in the background
+  if (!_tcp.connect(_host.c_str(), _port)) {
+    lost(MQTT_STATE_CONNECT_FAILED);
+    return false;
+  }
+  return false;
+}
+
+void MqttClient::disconnect() {
+  // A graceful close would leave TCP sending from our buffers after they
+  // are reused, so it is only used once everything queued is acknowledged
+  bool graceful = _state == MQTT_STATE_CONNECTED && _txCount == 0;
+  if (graceful) {
+    uint8_t packet[2];
+    _tcp.write((const char *)packet,
+               mqttEncodeEmpty(packet, MQTT_PKT_DISCONNECT),
+               ASYNC_WRITE_FLAG_COPY);
+  }
+  _tcp.close(!graceful);
+  _eventConnected = false;
+  _eventDisconnected = false;
+  _connecting = false;
+  _tcpUp = false;
+  resetTx();
+  _outbox.requeueInFlight();
+  _state = MQTT_STATE_DISCONNECTED;
+}
+
+bool MqttClient::loop() {
+  if (_eventConnected) {
+    _eventConnected = false;
+    if (_connecting)
+      _tcpUp = true;
+  }
+  if (_eventDisconnected) {
+    _eventDisconnected = false;
+    if (_connecting)
+      lost(MQTT_STATE_CONNECT_FAILED);
+    else if (_state == MQTT_STATE_CONNECTED)
+      lost(MQTT_STATE_CONNECTION_LOST);
+  }
+  if (_rxOverflow) {
+    Serial.println("MQTT receive buffer overflow, reconnecting");
+    lost(MQTT_STATE_CONNECTION_LOST);
+  }
+
+  portENTER_CRITICAL(&_mux);
+  size_t acked = _ackedBytes;
+  _ackedBytes = 0;
+  portEXIT_CRITICAL(&_mux);
+  releaseAcked(acked);
+
+  receive();
+
+  unsigned long now = millis();
+  if (_connecting && now - _connectStart > MQTT_CONNECT_TIMEOUT_MS)
+    lost(MQTT_STATE_CONNECTION_TIMEOUT);
+
+  if (connected()) {
+    unsigned long keepAliveMs = MQTT_KEEPALIVE_S * 1000UL;
+    if (now - _lastIn > keepAliveMs || now - _lastOut > keepAliveMs) {
+      if (_pingOutstanding) {
+        lost(MQTT_STATE_CONNECTION_TIMEOUT);
+        return false;
+      }
+      uint8_t *packet = reserve(2);
+      if (packet) {
+        queue(nullptr, packet, mqttEncodeEmpty(packet, MQTT_PKT_PINGREQ));
+        _lastIn = now;
+        _pingOutstanding = true;
+      }
+    }
+    sendOutbox();
+  }
+
+  flush();
+  return connected();
+}
+
+bool MqttClient::publish(const char *topic, const char *payload,
+                         bool retained, uint8_t qos) {
+  return publish(topic, (const uint8_t *)payload, strlen(payload), retained,
+                 qos);
+}
+
+bool MqttClient::publish(const char *topic, const uint8_t *payload,
+                         size_t length, bool retained, uint8_t qos) {
+  if (retained) {
+    if (qos > 0 && connected() &&
+        _session.retainedCurrent(topic, payload, length)) {
+      _skipped++;
+      return true;
+    }
+    _session.retainedQueued(topic, payload, length);
+  }
+
+  if (qos > 0) {
+    if (_outbox.push(topic, payload, length, retained) == 0)
+      return false;
+    // Pipelined: goes out now if the window has room, no wait for PUBACK
+    sendOutbox();
+    flush();
+    return true;
+  }
+
+  if (!connected())
+    return false;
+  size_t len = mqttPublishLength(topic, length, 0);
+  uint8_t *packet = reserve(len);
+  if (!packet)
+    return false;
+  mqttEncodePublish(packet, len, topic, payload, length, 0, retained, 0);
+  queue(nullptr, packet, len);
+  flush();
+  return true;
+}
+
+bool MqttClient::subscribe(const char *topic, uint8_t qos) {
+  if (!connected())
+    return false;
+  if (_session.subscribed(topic)) {
+    _skipped++;
+    return true;
+  }
+  size_t len = mqttSubscribeLength(topic);
+  uint8_t *packet = reserve(len);
+  if (!packet)
+    return false;
+  mqttEncodeSubscribe(packet, len, _outbox.allocateId(), topic, qos);
+  queue(nullptr, packet, len);
+  _session.addSubscription(topic);
+  flush();
+  return true;
+}
+
+// Space for a packet in the transmit buffer, which is used as a ring of
+// whole packets: one that does not fit before the end starts again at 0
+uint8_t *MqttClient::reserve(size_t len) {
+  if (_txCount == MQTT_TX_QUEUE_LEN || len > MQTT_TX_BUFFER_SIZE)
+    return nullptr;
+
+  size_t offset;
+  if (_txEnd >= _txStart) {
+    if (_txEnd + len <= MQTT_TX_BUFFER_SIZE)
+      offset = _txEnd;
+    else if (len < _txStart) // Strictly less: _txEnd == _txStart means empty
+      offset = 0;
+    else
+      return nullptr;
+  } else {
+    if (_txEnd + len < _txStart)
+      offset = _txEnd;
+    else
+      return nullptr;
+  }
+  _txEnd = offset + len;
+  return _txBuf + offset;
+}
+
+// Add a packet to the transmit queue: ptr for memory outside the transmit
+// buffer, or buffered for memory returned by reserve()
+bool MqttClient::queue(const uint8_t *ptr, const uint8_t *buffered,
+                       size_t len) {
+  if (_txCount == MQTT_TX_QUEUE_LEN)
+    return false;
+  TxEntry &entry = _txQueue[(_txHead + _txCount) % MQTT_TX_QUEUE_LEN];
+  entry.ptr = ptr;
+  entry.offset = buffered ? buffered - _txBuf : 0;
+  entry.len = len;
+  _txCount++;
+  return true;
+}
+
+bool MqttClient::queueAck(uint8_t type, uint16_t packetId) {
+  uint8_t *packet = reserve(4);
+  if (!packet)
+    return false;
+  return queue(nullptr, packet, mqttEncodeAck(packet, type, packetId));
+}
+
+// Hand queued packets to TCP without copying, as far as its send window
+// allows; the memory must stay untouched until TCP acknowledges it
+void MqttClient::flush() {
+  if (!_tcpUp)
+    return;
+  bool added = false;
+  while (_txSent < _txCount) {
+    const TxEntry &entry = _txQueue[(_txHead + _txSent) % MQTT_TX_QUEUE_LEN];
+    const uint8_t *data = entry.ptr ? entry.ptr : _txBuf + entry.offset;
+    if (_tcp.space() < entry.len ||
+        _tcp.add((const char *)data, entry.len, 0) != entry.len)
+      break;
+    _txSent++;
+    added = true;
+  }
+  if (added && _tcp.send())
+    _lastOut = millis();
+}
+
+// Free the packets covered by bytes newly acknowledged by the peer
+void MqttClient::releaseAcked(size_t bytes) {
+  while (bytes > 0 && _txSent > 0) {
+    const TxEntry &entry = _txQueue[_txHead];
+    size_t remaining = entry.len - _txHeadAcked;
+    if (bytes < remaining) {
+      _txHeadAcked += bytes;
+      return;
+    }
+    bytes -= remaining;
+    _txHeadAcked = 0;
+    bool buffered = !entry.ptr;
+    _txHead = (_txHead + 1) % MQTT_TX_QUEUE_LEN;
+    _txCount--;
+    _txSent--;
+    if (!buffered)
+      continue;
+
+    // The oldest buffered byte still needed is now the next buffered
+    // packet; with none left the buffer starts over
+    size_t saveEnd = _txEnd;
+    _txStart = _txEnd = 0;
+    for (size_t i = 0; i < _txCount; i++) {
+      const TxEntry &next = _txQueue[(_txHead + i) % MQTT_TX_QUEUE_LEN];
+      if (!next.ptr) {
+        _txStart = next.offset;
+        _txEnd = saveEnd;
+        break;
+      }
+    }
+  }
+}
+
+void MqttClient::resetTx() {
+  _txStart = 0;
+  _txEnd = 0;
+  _txHead = 0;
+  _txCount = 0;
+  _txSent = 0;
+  _txHeadAcked = 0;
+  portENTER_CRITICAL(&_mux);
+  _ackedBytes = 0;
+  portEXIT_CRITICAL(&_mux);
+}
+
+void MqttClient::sendOutbox() {
+  if (_state != MQTT_STATE_CONNECTED)
+    return;
+  _outbox.poll(millis(), [this](const uint8_t *data, size_t len, bool dup) {
+    if (!dup)
+      return queue(data, nullptr, len);
+    // A resend may share its slot with a copy TCP still holds, so DUP is
+    // set on a copy in the transmit buffer
+    uint8_t *packet = reserve(len);
+    if (!packet)
+      return false;
+    memcpy(packet, data, len);
+    packet[0] |= MQTT_FLAG_DUP;
+    return queue(nullptr, packet, len);
+  });
+}
+
+void MqttClient::receive() {
+  uint8_t chunk[128];
+  for (;;) {
+    portENTER_CRITICAL(&_mux);
+    size_t n = _rxCount;
+    if (n > sizeof(chunk))
+      n = sizeof(chunk);
+    if (n > MQTT_RX_BUFFER_SIZE - _rxHead)
+      n = MQTT_RX_BUFFER_SIZE - _rxHead;
+    memcpy(chunk, _rxBuf + _rxHead, n);
+    _rxHead = (_rxHead + n) % MQTT_RX_BUFFER_SIZE;
+    _rxCount -= n;
+    portEXIT_CRITICAL(&_mux);
+    if (n == 0)
+      break;
+    _lastIn = millis();
+
+    size_t used = 0;
+    while (used < n) {
+      used += _reader.feed(chunk + used, n - used);
+      if (_reader.ready()) {
+        handlePacket();
+        _reader.next();
+      }
+    }
+  }
+}
+
+void MqttClient::handlePacket() {
+  uint8_t *body = _reader.body();
+  size_t len = _reader.bodyLength();
+
+  switch (_reader.type()) {
+  case MQTT_PKT_CONNACK:
+    if (_connecting && len >= 2) {
+      _connecting = false;
+      if (body[1] != 0) { // Refused: body[1] is the reason
+        lost(body[1]);
+        break;
+      }
+      _state = MQTT_STATE_CONNECTED;
+      _sessionPresent = _persistent && (body[0] & 0x01);
+      if (!_sessionPresent)
+        _session.clear();
+      _lastIn = _lastOut = millis();
+      _pingOutstanding = false;
+      // Messages left in flight by the previous connection go out first
+      sendOutbox();
+    }
+    break;
+
+  case MQTT_PKT_PUBLISH: {
+    char *topic;
+    uint16_t packetId;
+    uint8_t *payload;
+    size_t payloadLen;
+    if (!mqttParsePublish(_reader.flags(), body, len, topic, packetId,
+                          payload, payloadLen))
+      break;
+    if (_callback)
+      _callback(topic, payload, payloadLen);
+    if (packetId != 0)
+      queueAck(MQTT_PKT_PUBACK, packetId);
+    break;
+  }
+
+  case MQTT_PKT_PUBACK: {
+    if (len < 2)
+      break;
+    uint16_t packetId = ((uint16_t)body[0] << 8) | body[1];
+    size_t packetLen;
+    const uint8_t *packet = _outbox.inFlightPacket(packetId, packetLen);
+    const char *topic;
+    size_t topicLen;
+    const uint8_t *payload;
+    size_t payloadLen;
+    if (packet && (packet[0] & 0x01) &&
+        mqttSplitPublish(packet, packetLen, topic, topicLen, payload,
+                         payloadLen))
+      _session.retainedAcked(topic, topicLen, payload, payloadLen);
+    _outbox.ack(packetId, millis());
+    break;
+  }
+
+  case MQTT_PKT_PINGRESP:
+    _pingOutstanding = false;
+    break;
+
+  default:
+    break;
+  }
+}
+
+// Drop the connection; unacknowledged messages are resent on the next one.
+// The abort makes TCP let go of our buffers before they are reused.
+void MqttClient::lost(int state) {
+  _tcp.close(true);
+  // close() reports the disconnect synchronously; it is handled here
+  _eventConnected = false;
+  _eventDisconnected = false;
+  _connecting = false;
+  _tcpUp = false;
+  resetTx();
+  _outbox.requeueInFlight();
+  _state = state;
+}
@@ -0,0 +1,166 @@
+#ifndef MQTT_CLIENT_H
+#define MQTT_CLIENT_H
+
+#include "MqttOutbox.h"
+#include "MqttPacket.h"
+#include "MqttSession.h"
+#include <Arduino.h>
+#include <AsyncTCP.h>
+#include <freertos/FreeRTOS.h>
+#include <functional>
+
+// --- MQTT Client Tuning ---
+static const uint16_t MQTT_KEEPALIVE_S = 15;
+// Time allowed for the TCP connection and the broker's CONNACK
+static const unsigned long MQTT_CONNECT_TIMEOUT_MS = 15000;
+// Outgoing packets other than first sends of QoS 1 messages, which go out
+// straight from their outbox slot
+static const size_t MQTT_TX_BUFFER_SIZE = 2048;
+// Packets handed to TCP and not yet acknowledged, plus those waiting for
+// send space
+static const size_t MQTT_TX_QUEUE_LEN = 32;
+// Received bytes waiting for loop()
+static const size_t MQTT_RX_BUFFER_SIZE = 2048;
+
+// Same values as PubSubClient's state(), so logged codes keep their meaning
+enum MqttState : int8_t {
+  MQTT_STATE_CONNECTION_TIMEOUT = -4,
+  MQTT_STATE_CONNECTION_LOST = -3,
+  MQTT_STATE_CONNECT_FAILED = -2,
+  MQTT_STATE_DISCONNECTED = -1,
+  MQTT_STATE_CONNECTED = 0,
+  MQTT_STATE_BAD_PROTOCOL = 1,
+  MQTT_STATE_BAD_CLIENT_ID = 2,
+  MQTT_STATE_UNAVAILABLE = 3,
+  MQTT_STATE_BAD_CREDENTIALS = 4,
+  MQTT_STATE_UNAUTHORIZED = 5,
+};
+
+// MQTT 3.1.1 client on AsyncTCP with the PubSubClient calls used by
+// HSC_Base and the application, plus QoS 1 publishing. No call waits on the
+// network: connect() only starts the attempt, publish() queues the packet.
+//
+// Outgoing packets are encoded once into preallocated memory and handed to
+// TCP without copying; the memory is reused after the peer acknowledges
+// it. The AsyncTCP callbacks only move received bytes, acknowledgements
+// and connection events into buffers that loop() processes, so protocol
+// state and the message callback stay on the caller's task.
+//
+// QoS 1 messages go through an MqttOutbox: they are pipelined up to
+// MQTT_INFLIGHT_WINDOW deep, resent if no PUBACK arrives within
+// MQTT_RETRY_MS, and resent with DUP set after a reconnect, before anything
+// the application publishes on the new connection.
+//
+// With a persistent session (clean session off) the broker keeps the
+// subscriptions across reconnects. An MqttSession remembers them and the
+// last acknowledged value of each retained QoS 1 topic, so SUBSCRIBEs and
+// retained publishes that would change nothing on the broker are skipped.
+// All of it is forgotten when the broker does not resume the session.
+class MqttClient {
+public:
+  typedef std::function<void(char *topic, uint8_t *payload,
+                             unsigned int length)>
+      Callback;
+
+  MqttClient();
+
+  void setServer(const char *host, uint16_t port);
+  void setPersistentSession(bool persistent) { _persistent = persistent; }
+  void setCallback(Callback callback) { _callback = callback; }
+
+  // Start connecting. Returns true only if already connected; otherwise
+  // watch connecting() and connected() for the outcome.
+  bool connect(const char *clientId, const char *user, const char *password,
+               const char *willTopic, uint8_t willQos, bool willRetain,
+               const char *willMessage);
+  bool connecting() const { return _connecting; }
+  // Close the connection. DISCONNECT is sent, and the will suppressed, only
+  // if all earlier output has been acknowledged.
+  void disconnect();
+  bool connected() const { return _state == MQTT_STATE_CONNECTED; }
+  // The broker resumed the previous session on the last connect
+  bool sessionPresent() const { return _sessionPresent; }
+
+  // Process received packets, connection events, keep-alive and queued
+  // output; call every loop
+  bool loop();
+
+  // QoS 1 messages are accepted while the outbox has room and delivered
+  // even across a reconnect; QoS 0 messages are queued for sending and
+  // refused when the transmit buffer is full. A retained QoS 1 value the
+  // broker already holds is skipped and reported as published.
+  bool publish(const char *topic, const char *payload, bool retained = false,
+               uint8_t qos = 0);
+  bool publish(const char *topic, const uint8_t *payload, size_t length,
+               bool retained = false, uint8_t qos = 0);
+
+  // Skipped if the topic is already subscribed in this session
+  bool subscribe(const char *topic, uint8_t qos = 0);
+
+  // QoS 1 messages sent ahead of their PUBACK (MQTT_INFLIGHT_WINDOW)
+  void setInflightWindow(size_t window) { _outbox.setWindow(window); }
+
+  int state() const { return _state; }
+  const MqttOutboxStats &outboxStats() const { return _outbox.stats(); }
+  // Publishes and subscriptions skipped because the broker had them
+  uint32_t skippedCount() const { return _skipped; }
+
+private:
+  // A packet in the transmit queue: in the transmit buffer at offset, or
+  // outside it (an outbox slot) when ptr is set
+  struct TxEntry {
+    const uint8_t *ptr;
+    uint16_t offset;
+    uint16_t len;
+  };
+
+  AsyncClient _tcp;
+  String _host;
+  uint16_t _port = 1883;
+  Callback _callback;
+  int _state = MQTT_STATE_DISCONNECTED;
+  bool _connecting = false;
+  bool _tcpUp = false;
+  bool _pingOutstanding = false;
+  bool _persistent = false;
+  bool _sessionPresent = false;
+  uint32_t _skipped = 0;
+  unsigned long _connectStart = 0;
+  unsigned long _lastIn = 0;
+  unsigned long _lastOut = 0;
+  MqttReader _reader;
+  MqttOutbox _outbox;
+  MqttSession _session;
+
+  // Written by the AsyncTCP task, read by loop(); guarded by _mux
+  portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+  volatile bool _eventConnected = false;
+  volatile bool _eventDisconnected = false;
+  volatile bool _rxOverflow = false;
+  size_t _ackedBytes = 0;
+  uint8_t _rxBuf[MQTT_RX_BUFFER_SIZE];
+  size_t _rxHead = 0;
+  size_t _rxCount = 0;
+
+  uint8_t _txBuf[MQTT_TX_BUFFER_SIZE];
+  size_t _txStart = 0; // Oldest buffered byte still needed
+  size_t _txEnd = 0;   // Where the next packet goes
+  TxEntry _txQueue[MQTT_TX_QUEUE_LEN];
+  size_t _txHead = 0;   // Oldest entry not yet acknowledged by TCP
+  size_t _txCount = 0;
+  size_t _txSent = 0;   // Entries from _txHead already handed to TCP
+  size_t _txHeadAcked = 0;
+
+  uint8_t *reserve(size_t len);
+  bool queue(const uint8_t *ptr, const uint8_t *buffered, size_t len);
+  bool queueAck(uint8_t type, uint16_t packetId);
+  void flush();
+  void releaseAcked(size_t bytes);
+  void resetTx();
+  void receive();
+  void handlePacket();
+  void sendOutbox();
+  void lost(int state);
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include "MqttOutbox.h"
+#include "MqttPacket.h"
+
+MqttOutbox::MqttOutbox() { clear(); }
+
+void MqttOutbox::clear() {
+  for (size_t i = 0; i < MQTT_OUTBOX_SLOTS; i++) {
+    _slots[i].state = SLOT_FREE;
+  }
+  _head = 0;
+  _count = 0;
+  _stats.inFlight = 0;
+  _stats.pending = 0;
+}
+
+uint16_t MqttOutbox::push(const char *topic, const uint8_t *payload,
+                          size_t len, bool retained) {
+  if (_count == MQTT_OUTBOX_SLOTS) {
+    _stats.dropped++;
+    return 0;
+  }
+
+  Slot &slot = _slots[(_head + _count) % MQTT_OUTBOX_SLOTS];
+  uint16_t packetId = allocateId();
+
+  slot.len = mqttEncodePublish(slot.data, sizeof(slot.data), topic, payload,
+                               len, 1, retained, packetId);
+  if (slot.len == 0) {
+    _stats.dropped++;
+    return 0;
+  }
+  slot.packetId = packetId;
+  slot.state = SLOT_PENDING;
+  slot.sentBefore = false;
+  slot.resent = false;
+  slot.sentMs = 0;
+  _count++;
+  _stats.queued++;
+  _stats.pending++;
+  return packetId;
+}
+
+uint16_t MqttOutbox::allocateId() {
+  // Ids wrap after 65535 messages, long after the few held here are done
+  uint16_t packetId = _nextId++;
+  if (_nextId == 0)
+    _nextId = 1;
+  return packetId;
+}
+
+void MqttOutbox::poll(uint32_t nowMs, const Sender &send) {
+  for (size_t i = 0; i < _count; i++) {
+    Slot &slot = _slots[(_head + i) % MQTT_OUTBOX_SLOTS];
+    if (slot.state == SLOT_IN_FLIGHT) {
+      if (nowMs - slot.sentMs >= MQTT_RETRY_MS &&
+          !transmit(slot, nowMs, send))
+        return;
+    } else if (slot.state == SLOT_PENDING) {
+      // Later messages wait too, so the broker sees them in order
+      if (_stats.inFlight >= _window)
+        return;
+      if (!transmit(slot, nowMs, send))
+        return;
+    }
+  }
+}
+
+bool MqttOutbox::transmit(Slot &slot, uint32_t nowMs, const Sender &send) {
+  if (!send(slot.data, slot.len, slot.sentBefore))
+    return false;
+
+  if (slot.sentBefore) {
+    _stats.retransmits++;
+    slot.resent = true;
+  }
+  if (slot.state == SLOT_PENDING) {
+    slot.state = SLOT_IN_FLIGHT;
+    _stats.pending--;
+    _stats.inFlight++;
+    if (_stats.inFlight > _stats.maxInFlight)
+      _stats.maxInFlight = _stats.inFlight;
+  }
+  slot.sentBefore = true;
+  slot.sentMs = nowMs;
+  return true;
+}
+
+const uint8_t *MqttOutbox::inFlightPacket(uint16_t packetId,
+                                          size_t &len) const {
+  for (size_t i = 0; i < _count; i++) {
+    const Slot &slot = _slots[(_head + i) % MQTT_OUTBOX_SLOTS];
+    if (slot.state == SLOT_IN_FLIGHT && slot.packetId == packetId) {
+      len = slot.len;
+      return slot.data;
+    }
+  }
+  return nullptr;
+}
+
+bool MqttOutbox::ack(uint16_t packetId, uint32_t nowMs) {
+  for (size_t i = 0; i < _count; i++) {
+    Slot &slot = _slots[(_head + i) % MQTT_OUTBOX_SLOTS];
+    if (slot.state == SLOT_IN_FLIGHT && slot.packetId == packetId) {
+      if (!slot.resent)
+        _stats.lastRttMs = nowMs - slot.sentMs;
+      slot.state = SLOT_FREE;
+      _stats.inFlight--;
+      _stats.acked++;
+      dropAckedHead();
+      return true;
+    }
+  }
+  return false;
+}
+
+// Acks normally arrive in order; one that overtakes leaves a free slot
+// behind the head until the older messages are acknowledged too
+void MqttOutbox::dropAckedHead() {
+  while (_count > 0 && _slots[_head].state == SLOT_FREE) {
+    _head = (_head + 1) % MQTT_OUTBOX_SLOTS;
+    _count--;
+  }
+}
+
+void MqttOutbox::requeueInFlight() {
+  for (size_t i = 0; i < _count; i++) {
+    Slot &slot = _slots[(_head + i) % MQTT_OUTBOX_SLOTS];
+    if (slot.state == SLOT_IN_FLIGHT) {
+      slot.state = SLOT_PENDING;
+      _stats.inFlight--;
+      _stats.pending++;
+    }
+  }
+}
@@ -0,0 +1,102 @@
+#ifndef MQTT_OUTBOX_H
+#define MQTT_OUTBOX_H
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+
+// --- MQTT Outbox Tuning ---
+// QoS 1 messages held until acknowledged (queued + in flight)
+static const size_t MQTT_OUTBOX_SLOTS = 16;
+// Largest encoded QoS 1 PUBLISH; fits the retained device info message
+static const size_t MQTT_OUTBOX_MSG_SIZE = 256;
+// Messages sent without waiting for their PUBACK
+static const size_t MQTT_INFLIGHT_WINDOW = 8;
+// Window while the heap is low: fewer segments held by TCP
+static const size_t MQTT_INFLIGHT_WINDOW_LOW_HEAP = 2;
+// Resend a message not acknowledged within this time
+static const uint32_t MQTT_RETRY_MS = 10000;
+
+struct MqttOutboxStats {
+  uint32_t queued = 0;      // Accepted by push()
+  uint32_t acked = 0;
+  uint32_t retransmits = 0; // Resent after a timeout or reconnect
+  uint32_t dropped = 0;     // Refused because the outbox was full
+  uint16_t inFlight = 0;    // Sent, waiting for PUBACK
+  uint16_t maxInFlight = 0; // High-water mark of inFlight
+  uint16_t pending = 0;     // Queued, not sent yet
+  uint32_t lastRttMs = 0;   // Send to PUBACK of the last message sent once
+};
+
+// QoS 1 PUBLISH packets waiting to be sent or acknowledged, in preallocated
+// slots. Up to MQTT_INFLIGHT_WINDOW messages are pipelined before the first
+// PUBACK arrives; messages are always sent in the order they were queued.
+// No Arduino dependencies, so it can be tested on the host.
+class MqttOutbox {
+public:
+  // Send a packet; dup asks for the DUP flag to be set in what goes out.
+  // The slot data may be sent without copying: it is not modified and
+  // stays in place until the message is acknowledged or cleared.
+  // Returns false if the packet cannot be taken now.
+  typedef std::function<bool(const uint8_t *data, size_t len, bool dup)>
+      Sender;
+
+  MqttOutbox();
+
+  // Queue a message; returns its packet id, or 0 if the outbox is full or
+  // the message does not fit in a slot
+  uint16_t push(const char *topic, const uint8_t *payload, size_t len,
+                bool retained);
+
+  // Send queued messages while the window has room and resend timed-out
+  // ones. Stops at the first packet the sender refuses.
+  void poll(uint32_t nowMs, const Sender &send);
+
+  // Packet id not used by any message in the outbox, also for SUBSCRIBE
+  uint16_t allocateId();
+
+  // Encoded PUBLISH of a message waiting for its PUBACK, or nullptr
+  const uint8_t *inFlightPacket(uint16_t packetId, size_t &len) const;
+
+  // PUBACK received; false for an unknown packet id
+  bool ack(uint16_t packetId, uint32_t nowMs);
+
+  // The connection was lost: everything in flight goes out again (with
+  // DUP set) once the next connection is up
+  void requeueInFlight();
+
+  void clear();
+
+  // Messages already in flight stay; new ones wait until the count is
+  // under the window again
+  void setWindow(size_t window) { _window = window ? window : 1; }
+  size_t window() const { return _window; }
+
+  const MqttOutboxStats &stats() const { return _stats; }
+  bool empty() const { return _count == 0; }
+
+private:
+  enum SlotState : uint8_t { SLOT_FREE, SLOT_PENDING, SLOT_IN_FLIGHT };
+
+  struct Slot {
+    SlotState state;
+    bool sentBefore; // Sent again with DUP set
+    bool resent;     // Round trip is ambiguous, not measured
+    uint16_t packetId;
+    uint16_t len;
+    uint32_t sentMs;
+    uint8_t data[MQTT_OUTBOX_MSG_SIZE];
+  };
+
+  Slot _slots[MQTT_OUTBOX_SLOTS];
+  size_t _head = 0; // Oldest message
+  size_t _count = 0;
+  uint16_t _nextId = 1;
+  size_t _window = MQTT_INFLIGHT_WINDOW;
+  MqttOutboxStats _stats;
+
+  bool transmit(Slot &slot, uint32_t nowMs, const Sender &send);
+  void dropAckedHead();
+};
+
+#endif
@@ -0,0 +1,243 @@
+#include "MqttPacket.h"
+#include <string.h>
+
+// Fixed header: type/flags byte plus 1-4 byte remaining length
+static size_t writeHeader(uint8_t *buf, uint8_t first, uint32_t length) {
+  size_t pos = 0;
+  buf[pos++] = first;
+  do {
+    uint8_t byte = length & 0x7F;
+    length >>= 7;
+    buf[pos++] = length ? (byte | 0x80) : byte;
+  } while (length);
+  return pos;
+}
+
+static size_t headerSize(uint32_t length) {
+  return (length < 128) ? 2 : (length < 16384) ? 3 : (length < 2097152) ? 4 : 5;
+}
+
+static size_t writeString(uint8_t *buf, const char *str, size_t len) {
+  buf[0] = len >> 8;
+  buf[1] = len & 0xFF;
+  memcpy(buf + 2, str, len);
+  return len + 2;
+}
+
+size_t mqttPublishLength(const char *topic, size_t len, uint8_t qos) {
+  uint32_t length = 2 + strlen(topic) + (qos ? 2 : 0) + len;
+  return headerSize(length) + length;
+}
+
+size_t mqttSubscribeLength(const char *topic) {
+  uint32_t length = 2 + 2 + strlen(topic) + 1;
+  return headerSize(length) + length;
+}
+
+size_t mqttEncodeConnect(uint8_t *buf, size_t cap,
+                         const MqttConnectOptions &opt) {
+  size_t idLen = strlen(opt.clientId);
+  bool will = opt.willTopic && opt.willMessage;
+  bool user = opt.user && opt.user[0];
+  bool password = user && opt.password && opt.password[0];
+
+  uint32_t length = 10 + 2 + idLen;
+  if (will)
+    length += 4 + strlen(opt.willTopic) + strlen(opt.willMessage);
+  if (user)
+    length += 2 + strlen(opt.user);
+  if (password)
+    length += 2 + strlen(opt.password);
+  if (headerSize(length) + length > cap)
+    return 0;
+
+  uint8_t flags = 0;
+  if (opt.cleanSession)
+    flags |= 0x02;
+  if (will) {
+    flags |= 0x04 | ((opt.willQos & 0x03) << 3);
+    if (opt.willRetain)
+      flags |= 0x20;
+  }
+  if (user)
+    flags |= 0x80;
+  if (password)
+    flags |= 0x40;
+
+  size_t pos = writeHeader(buf, MQTT_PKT_CONNECT << 4, length);
+  pos += writeString(buf + pos, "MQTT", 4);
+  buf[pos++] = 4; // Protocol level 3.1.1
+  buf[pos++] = flags;
+  buf[pos++] = opt.keepAliveS >> 8;
+  buf[pos++] = opt.keepAliveS & 0xFF;
+  pos += writeString(buf + pos, opt.clientId, idLen);
+  if (will) {
+    pos += writeString(buf + pos, opt.willTopic, strlen(opt.willTopic));
+    pos += writeString(buf + pos, opt.willMessage, strlen(opt.willMessage));
+  }
+  if (user)
+    pos += writeString(buf + pos, opt.user, strlen(opt.user));
+  if (password)
+    pos += writeString(buf + pos, opt.password, strlen(opt.password));
+  return pos;
+}
+
+size_t mqttEncodePublish(uint8_t *buf, size_t cap, const char *topic,
+                         const uint8_t *payload, size_t len, uint8_t qos,
+                         bool retained, uint16_t packetId) {
+  size_t topicLen = strlen(topic);
+  uint32_t length = 2 + topicLen + (qos ? 2 : 0) + len;
+  if (mqttPublishLength(topic, len, qos) > cap)
+    return 0;
+
+  uint8_t first = (MQTT_PKT_PUBLISH << 4) | ((qos & 0x03) << 1);
+  if (retained)
+    first |= 0x01;
+  size_t pos = writeHeader(buf, first, length);
+  pos += writeString(buf + pos, topic, topicLen);
+  if (qos) {
+    buf[pos++] = packetId >> 8;
+    buf[pos++] = packetId & 0xFF;
+  }
+  memcpy(buf + pos, payload, len);
+  return pos + len;
+}
+
+size_t mqttEncodeSubscribe(uint8_t *buf, size_t cap, uint16_t packetId,
+                           const char *topic, uint8_t qos) {
+  size_t topicLen = strlen(topic);
+  uint32_t length = 2 + 2 + topicLen + 1;
+  if (mqttSubscribeLength(topic) > cap)
+    return 0;
+
+  // SUBSCRIBE has reserved flags 0010
+  size_t pos = writeHeader(buf, (MQTT_PKT_SUBSCRIBE << 4) | 0x02, length);
+  buf[pos++] = packetId >> 8;
+  buf[pos++] = packetId & 0xFF;
+  pos += writeString(buf + pos, topic, topicLen);
+  buf[pos++] = qos & 0x03;
+  return pos;
+}
+
+size_t mqttEncodeAck(uint8_t *buf, uint8_t type, uint16_t packetId) {
+  buf[0] = type << 4;
+  buf[1] = 2;
+  buf[2] = packetId >> 8;
+  buf[3] = packetId & 0xFF;
+  return 4;
+}
+
+size_t mqttEncodeEmpty(uint8_t *buf, uint8_t type) {
+  buf[0] = type << 4;
+  buf[1] = 0;
+  return 2;
+}
+
+bool mqttParsePublish(uint8_t flags, uint8_t *body, size_t len, char *&topic,
+                      uint16_t &packetId, uint8_t *&payload,
+                      size_t &payloadLen) {
+  uint8_t qos = (flags >> 1) & 0x03;
+  if (len < 2)
+    return false;
+  size_t topicLen = ((size_t)body[0] << 8) | body[1];
+  size_t pos = 2 + topicLen;
+  if (pos + (qos ? 2 : 0) > len)
+    return false;
+
+  packetId = 0;
+  if (qos) {
+    packetId = ((uint16_t)body[pos] << 8) | body[pos + 1];
+    pos += 2;
+  }
+  payload = body + pos;
+  payloadLen = len - pos;
+
+  // The length prefix leaves room to shift the topic and terminate it
+  memmove(body, body + 2, topicLen);
+  body[topicLen] = '\0';
+  topic = (char *)body;
+  return true;
+}
+
+bool mqttSplitPublish(const uint8_t *packet, size_t len, const char *&topic,
+                      size_t &topicLen, const uint8_t *&payload,
+                      size_t &payloadLen) {
+  if (len < 2 || (packet[0] >> 4) != MQTT_PKT_PUBLISH)
+    return false;
+  size_t pos = 1;
+  while (pos < len && pos < 5 && (packet[pos] & 0x80))
+    pos++;
+  pos++; // Last remaining length byte
+  if (pos + 2 > len)
+    return false;
+  topicLen = ((size_t)packet[pos] << 8) | packet[pos + 1];
+  pos += 2;
+  topic = (const char *)packet + pos;
+  pos += topicLen + (((packet[0] >> 1) & 0x03) ? 2 : 0);
+  if (pos > len)
+    return false;
+  payload = packet + pos;
+  payloadLen = len - pos;
+  return true;
+}
+
+void MqttReader::reset() {
+  _state = STATE_HEADER;
+  _header = 0;
+  _length = 0;
+  _lengthShift = 0;
+  _received = 0;
+}
+
+void MqttReader::next() {
+  if (_state == STATE_READY)
+    reset();
+}
+
+size_t MqttReader::feed(const uint8_t *data, size_t len) {
+  size_t i = 0;
+  while (i < len && _state != STATE_READY) {
+    switch (_state) {
+    case STATE_HEADER:
+      _header = data[i++];
+      _length = 0;
+      _lengthShift = 0;
+      _received = 0;
+      _state = STATE_LENGTH;
+      break;
+
+    case STATE_LENGTH: {
+      uint8_t b = data[i++];
+      _length |= (uint32_t)(b & 0x7F) << _lengthShift;
+      _lengthShift += 7;
+      if ((b & 0x80) && _lengthShift < 28)
+        break;
+      if (_length > MQTT_MAX_PACKET_SIZE) {
+        _oversize++;
+        _state = STATE_SKIP;
+      } else {
+        _state = (_length == 0) ? STATE_READY : STATE_BODY;
+      }
+      break;
+    }
+
+    case STATE_BODY:
+    case STATE_SKIP: {
+      size_t n = len - i;
+      if (n > _length - _received)
+        n = _length - _received;
+      if (_state == STATE_BODY)
+        memcpy(_buf + _received, data + i, n);
+      _received += n;
+      i += n;
+      if (_received == _length)
+        _state = (_state == STATE_BODY) ? STATE_READY : STATE_HEADER;
+      break;
+    }
+
+    case STATE_READY:
+      break;
+    }
+  }
+  return i;
+}
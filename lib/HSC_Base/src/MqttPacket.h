@@ -0,0 +1,112 @@
+#ifndef MQTT_PACKET_H
+#define MQTT_PACKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- MQTT Tuning ---
+// Largest packet sent or received; longer incoming packets are skipped
+static const size_t MQTT_MAX_PACKET_SIZE = 768;
+
+// MQTT 3.1.1 control packet types (upper nibble of the first byte)
+enum MqttPacketType : uint8_t {
+  MQTT_PKT_CONNECT = 1,
+  MQTT_PKT_CONNACK = 2,
+  MQTT_PKT_PUBLISH = 3,
+  MQTT_PKT_PUBACK = 4,
+  MQTT_PKT_SUBSCRIBE = 8,
+  MQTT_PKT_SUBACK = 9,
+  MQTT_PKT_PINGREQ = 12,
+  MQTT_PKT_PINGRESP = 13,
+  MQTT_PKT_DISCONNECT = 14,
+};
+
+// DUP flag in the first byte of a PUBLISH
+static const uint8_t MQTT_FLAG_DUP = 0x08;
+
+struct MqttConnectOptions {
+  const char *clientId = "";
+  const char *user = nullptr;
+  const char *password = nullptr;
+  const char *willTopic = nullptr;
+  const char *willMessage = nullptr;
+  uint8_t willQos = 0;
+  bool willRetain = false;
+  bool cleanSession = true;
+  uint16_t keepAliveS = 15;
+};
+
+// Encoded size of a PUBLISH / SUBSCRIBE, to reserve space before encoding
+size_t mqttPublishLength(const char *topic, size_t len, uint8_t qos);
+size_t mqttSubscribeLength(const char *topic);
+
+// Encoders write a complete packet into buf and return its length, or 0
+// if it does not fit in cap bytes
+size_t mqttEncodeConnect(uint8_t *buf, size_t cap,
+                         const MqttConnectOptions &opt);
+size_t mqttEncodePublish(uint8_t *buf, size_t cap, const char *topic,
+                         const uint8_t *payload, size_t len, uint8_t qos,
+                         bool retained, uint16_t packetId);
+size_t mqttEncodeSubscribe(uint8_t *buf, size_t cap, uint16_t packetId,
+                           const char *topic, uint8_t qos);
+// PUBACK and other packets carrying only a packet id (4 bytes)
+size_t mqttEncodeAck(uint8_t *buf, uint8_t type, uint16_t packetId);
+// PINGREQ and DISCONNECT (2 bytes)
+size_t mqttEncodeEmpty(uint8_t *buf, uint8_t type);
+
+// Split a received PUBLISH body in place. The topic is moved to the start
+// of the body and NUL-terminated; false if the body is malformed.
+bool mqttParsePublish(uint8_t flags, uint8_t *body, size_t len, char *&topic,
+                      uint16_t &packetId, uint8_t *&payload,
+                      size_t &payloadLen);
+
+// Locate topic and payload in a complete encoded PUBLISH, without
+// modifying it; false if it is not a well-formed PUBLISH
+bool mqttSplitPublish(const uint8_t *packet, size_t len, const char *&topic,
+                      size_t &topicLen, const uint8_t *&payload,
+                      size_t &payloadLen);
+
+// Reassembles incoming packets from a byte stream that may arrive in
+// pieces of any size. No Arduino dependencies, so it can be tested on the
+// host.
+class MqttReader {
+public:
+  MqttReader() { reset(); }
+
+  void reset();
+
+  // Consume bytes until a packet is complete; returns the number used.
+  // While ready() the reader takes nothing until next() is called.
+  size_t feed(const uint8_t *data, size_t len);
+
+  bool ready() const { return _state == STATE_READY; }
+  uint8_t type() const { return _header >> 4; }
+  uint8_t flags() const { return _header & 0x0F; }
+  uint8_t *body() { return _buf; }
+  size_t bodyLength() const { return _length; }
+
+  // Release the current packet
+  void next();
+
+  // Packets skipped for exceeding MQTT_MAX_PACKET_SIZE
+  uint32_t oversizeCount() const { return _oversize; }
+
+private:
+  enum State : uint8_t {
+    STATE_HEADER,
+    STATE_LENGTH,
+    STATE_BODY,
+    STATE_SKIP,
+    STATE_READY,
+  };
+
+  State _state;
+  uint8_t _header;
+  uint32_t _length;
+  uint8_t _lengthShift;
+  uint32_t _received;
+  uint32_t _oversize = 0;
+  uint8_t _buf[MQTT_MAX_PACKET_SIZE];
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include "MqttSession.h"
+#include <string.h>
+
+static const uint32_t FNV_OFFSET = 2166136261u;
+static const uint32_t FNV_PRIME = 16777619u;
+
+void MqttSession::clear() {
+  _retainedCount = 0;
+  _nextEvict = 0;
+  _subCount = 0;
+}
+
+// FNV-1a; a value hash of 0 is reserved for "nothing acknowledged"
+uint32_t MqttSession::hash(const void *data, size_t len, uint32_t seed) {
+  const uint8_t *p = (const uint8_t *)data;
+  uint32_t h = seed;
+  for (size_t i = 0; i < len; i++) {
+    h ^= p[i];
+    h *= FNV_PRIME;
+  }
+  return h ? h : 1;
+}
+
+uint32_t MqttSession::topicHash(const char *topic, size_t len) {
+  return hash(topic, len, FNV_OFFSET);
+}
+
+bool MqttSession::subscribed(const char *topic) const {
+  uint32_t h = topicHash(topic, strlen(topic));
+  for (size_t i = 0; i < _subCount; i++) {
+    if (_subs[i] == h)
+      return true;
+  }
+  return false;
+}
+
+void MqttSession::addSubscription(const char *topic) {
+  if (subscribed(topic) || _subCount == MQTT_MAX_SUBSCRIPTIONS)
+    return;
+  _subs[_subCount++] = topicHash(topic, strlen(topic));
+}
+
+MqttSession::Retained *MqttSession::find(uint32_t topic) {
+  for (size_t i = 0; i < _retainedCount; i++) {
+    if (_retained[i].topic == topic)
+      return &_retained[i];
+  }
+  return nullptr;
+}
+
+const MqttSession::Retained *MqttSession::find(uint32_t topic) const {
+  return const_cast<MqttSession *>(this)->find(topic);
+}
+
+bool MqttSession::retainedCurrent(const char *topic, const uint8_t *payload,
+                                  size_t len) const {
+  const Retained *r = find(topicHash(topic, strlen(topic)));
+  if (!r)
+    return false;
+  uint32_t value = hash(payload, len, FNV_OFFSET);
+  return r->acked == value && r->queued == value;
+}
+
+void MqttSession::retainedQueued(const char *topic, const uint8_t *payload,
+                                 size_t len) {
+  uint32_t h = topicHash(topic, strlen(topic));
+  Retained *r = find(h);
+  if (!r) {
+    // Full: replace entries in turn, a forgotten topic is just resent
+    if (_retainedCount < MQTT_RETAINED_CACHE_SIZE) {
+      r = &_retained[_retainedCount++];
+    } else {
+      r = &_retained[_nextEvict];
+      _nextEvict = (_nextEvict + 1) % MQTT_RETAINED_CACHE_SIZE;
+    }
+    r->topic = h;
+    r->acked = 0;
+  }
+  r->queued = hash(payload, len, FNV_OFFSET);
+}
+
+void MqttSession::retainedAcked(const char *topic, size_t topicLen,
+                                const uint8_t *payload, size_t len) {
+  Retained *r = find(topicHash(topic, topicLen));
+  if (r)
+    r->acked = hash(payload, len, FNV_OFFSET);
+}
+
+void MqttSession::forgetRetained(const char *topic) {
+  Retained *r = find(topicHash(topic, strlen(topic)));
+  if (r)
+    r->acked = 0;
+}
@@ -0,0 +1,59 @@
+#ifndef MQTT_SESSION_H
+#define MQTT_SESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- MQTT Session Tuning ---
+// Retained topics whose last acknowledged value is remembered
+static const size_t MQTT_RETAINED_CACHE_SIZE = 16;
+// Subscriptions remembered per session
+static const size_t MQTT_MAX_SUBSCRIPTIONS = 8;
+
+// What the broker is known to hold for this client: subscriptions made in
+// the current persistent session and, per retained topic, the last value
+// it acknowledged. Lets a reconnect that resumes the session skip the
+// SUBSCRIBEs and retained PUBLISHes that would change nothing. Topics and
+// values are kept as 32-bit hashes. No Arduino dependencies, so it can be
+// tested on the host.
+class MqttSession {
+public:
+  MqttSession() { clear(); }
+
+  // Forget everything, e.g. the broker did not resume the session
+  void clear();
+
+  bool subscribed(const char *topic) const;
+  void addSubscription(const char *topic);
+
+  // True if the broker already holds this retained value and no other
+  // value for the topic is on its way
+  bool retainedCurrent(const char *topic, const uint8_t *payload,
+                       size_t len) const;
+  // A retained value was queued; it counts once acknowledged
+  void retainedQueued(const char *topic, const uint8_t *payload, size_t len);
+  void retainedAcked(const char *topic, size_t topicLen,
+                     const uint8_t *payload, size_t len);
+  // The broker may have replaced the value, e.g. with the will message
+  void forgetRetained(const char *topic);
+
+private:
+  struct Retained {
+    uint32_t topic;
+    uint32_t queued; // Last value queued
+    uint32_t acked;  // Last value acknowledged, 0 if none
+  };
+
+  Retained _retained[MQTT_RETAINED_CACHE_SIZE];
+  size_t _retainedCount;
+  size_t _nextEvict;
+  uint32_t _subs[MQTT_MAX_SUBSCRIPTIONS];
+  size_t _subCount;
+
+  static uint32_t hash(const void *data, size_t len, uint32_t seed);
+  static uint32_t topicHash(const char *topic, size_t len);
+  Retained *find(uint32_t topic);
+  const Retained *find(uint32_t topic) const;
+};
+
+#endif
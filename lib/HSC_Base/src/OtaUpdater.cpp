@@ -0,0 +1,575 @@
+#include "OtaUpdater.h"
+#include "DeltaPatch.h"
+#include <SPIFFS.h>
+#include <Update.h>
+#include <WiFi.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <freertos/task.h>
+#include <mbedtls/md.h>
+
+static portMUX_TYPE otaMux = portMUX_INITIALIZER_UNLOCKED;
+
+OtaUpdater::OtaUpdater() { _session.setCACert(&_caCert); }
+
+void OtaUpdater::onFilesystemUpdate(std::function<void()> before,
+                                    std::function<void()> after) {
+  _beforeFs = before;
+  _afterFs = after;
+}
+
+bool OtaUpdater::start(const String &firmwareUrl,
+                       const String &expectVersion) {
+  if (_running)
+    return false;
+
+  _url = firmwareUrl;
+  _expectVersion = expectVersion;
+
+  // Load the CA here while SPIFFS is still mounted; it is needed again for
+  // the firmware download after a filesystem update
+  loadCaCert();
+  if (_url.startsWith("https") && _caCert.length() == 0) {
+    Serial.println("OTA: no CA certificate, server identity not verified");
+  }
+
+  portENTER_CRITICAL(&otaMux);
+  _status = OtaStatus();
+  _status.state = OTA_CHECKING;
+  portEXIT_CRITICAL(&otaMux);
+
+  _running = true;
+  if (xTaskCreatePinnedToCore(taskEntry, "ota", OTA_TASK_STACK, this,
+                              OTA_TASK_PRIORITY, nullptr,
+                              OTA_TASK_CORE) != pdPASS) {
+    _running = false;
+    fail(OTA_ERR_BEGIN, "Could not start OTA task");
+    return false;
+  }
+  return true;
+}
+
+OtaStatus OtaUpdater::status() const {
+  portENTER_CRITICAL(&otaMux);
+  OtaStatus copy = _status;
+  portEXIT_CRITICAL(&otaMux);
+  return copy;
+}
+
+void OtaUpdater::taskEntry(void *arg) {
+  OtaUpdater *self = static_cast<OtaUpdater *>(arg);
+  self->run();
+  self->_running = false;
+  vTaskDelete(nullptr);
+}
+
+void OtaUpdater::loadCaCert() {
+  _caCert = "";
+  if (SPIFFS.exists(OTA_CA_CERT_PATH)) {
+    File f = SPIFFS.open(OTA_CA_CERT_PATH, FILE_READ);
+    _caCert = f.readString();
+    f.close();
+  }
+  _caLoaded = true;
+}
+
+MetadataResult OtaUpdater::checkMetadata(const String &firmwareUrl,
+                                         FirmwareMetadata &out) {
+  // SPIFFS may be unmounted while an update runs; start() loaded the CA then
+  if (!_caLoaded && !_running)
+    loadCaCert();
+  // Don't wait for a running download to release the connection
+  return _metadata.fetch(metadataUrl(firmwareUrl), _session, out, 0);
+}
+
+void OtaUpdater::setCurrentVersion(const String &version) {
+  _currentVersion = version;
+}
+
+void OtaUpdater::run() {
+  Image firmware = {_url, "", 0, 0, false};
+  Image spiffs = {"", "", 0, 0, false};
+  Image delta = {"", "", 0, 0, true};
+  bool updateSpiffs = false;
+  OtaError error;
+  String message;
+
+  Serial.println("Starting Firmware Update...");
+  Serial.println("URL: " + _url);
+
+  if (!fetchMetadata(firmware, spiffs, delta, updateSpiffs))
+    return;
+
+  if (updateSpiffs) {
+    Serial.println("Filesystem update requested...");
+    Serial.println("SPIFFS URL: " + spiffs.url);
+    setStage(OTA_STAGE_SPIFFS);
+
+    // Unmount SPIFFS to ensure safe update
+    if (_beforeFs)
+      _beforeFs();
+    error = download(spiffs, U_SPIFFS, message);
+    if (_afterFs)
+      _afterFs();
+    if (error != OTA_ERR_NONE) {
+      fail(error, message.c_str());
+      return;
+    }
+    Serial.println("SPIFFS Update OK");
+  }
+
+  error = OTA_ERR_NONE;
+  if (delta.url.length() > 0) {
+    Serial.println("Delta URL: " + delta.url);
+    setStage(OTA_STAGE_FIRMWARE, true);
+    error = download(delta, U_FLASH, message);
+    if (error != OTA_ERR_NONE) {
+      Serial.println("OTA: delta failed (" + message +
+                     "), downloading full image");
+    }
+  }
+  if (delta.url.length() == 0 || error != OTA_ERR_NONE) {
+    setStage(OTA_STAGE_FIRMWARE, false);
+    error = download(firmware, U_FLASH, message);
+  }
+  if (error != OTA_ERR_NONE) {
+    fail(error, message.c_str());
+    return;
+  }
+
+  Serial.println("Firmware Update OK");
+  setState(OTA_SUCCESS);
+}
+
+bool OtaUpdater::fetchMetadata(Image &firmware, Image &spiffs, Image &delta,
+                               bool &updateSpiffs) {
+  FirmwareMetadata meta;
+  MetadataResult result = _metadata.fetch(metadataUrl(_url), _session, meta);
+  if (result == METADATA_ERR_HTTP) {
+    fail(OTA_ERR_METADATA, "Failed to fetch update metadata");
+    return false;
+  } else if (result == METADATA_ERR_JSON) {
+    fail(OTA_ERR_METADATA, "Invalid JSON from server");
+    return false;
+  }
+
+  portENTER_CRITICAL(&otaMux);
+  strlcpy(_status.version, meta.version.c_str(), sizeof(_status.version));
+  portEXIT_CRITICAL(&otaMux);
+
+  if (_expectVersion.length() > 0 && meta.version != _expectVersion) {
+    String message =
+        "Server has " + meta.version + ", expected " + _expectVersion;
+    fail(OTA_ERR_METADATA, message.c_str());
+    return false;
+  }
+
+  firmware.sha256 = meta.sha256;
+  firmware.size = meta.size;
+  if (firmware.sha256.length() != 64) {
+    fail(OTA_ERR_NO_DIGEST, "Metadata has no firmware sha256");
+    return false;
+  }
+
+  updateSpiffs = meta.updateSpiffs;
+  if (updateSpiffs) {
+    String spiffsUrl = _url;
+    int dotIndex = spiffsUrl.lastIndexOf('.');
+    if (dotIndex != -1) {
+      spiffsUrl = spiffsUrl.substring(0, dotIndex) + ".spiffs.bin";
+    } else {
+      spiffsUrl += ".spiffs.bin";
+    }
+    spiffs.url = spiffsUrl;
+    spiffs.sha256 = meta.spiffsSha256;
+    spiffs.size = meta.spiffsSize;
+    if (spiffs.sha256.length() != 64) {
+      fail(OTA_ERR_NO_DIGEST, "Metadata has no spiffs_sha256");
+      return false;
+    }
+  }
+
+  // Use a delta when one was made from exactly the image we are running
+  const DeltaInfo *entry = meta.deltaFrom(_currentVersion);
+  if (entry && !runningImageMatches(entry->sourceSize, entry->sourceSha256)) {
+    Serial.println("OTA: running image does not match delta source");
+    entry = nullptr;
+  }
+  if (entry && firmware.size == 0) {
+    Serial.println("OTA: metadata has no size, delta not used");
+    entry = nullptr;
+  }
+  if (entry) {
+    delta.url = entry->url;
+    if (delta.url.indexOf("://") == -1) {
+      // Relative to the directory of the firmware image
+      delta.url = _url.substring(0, _url.lastIndexOf('/') + 1) + delta.url;
+    }
+    delta.sha256 = firmware.sha256;
+    delta.size = entry->size;
+    delta.targetSize = firmware.size;
+  }
+  return true;
+}
+
+OtaError OtaUpdater::download(const Image &image, int command,
+                              String &message) {
+  uint8_t expected[32];
+  if (!parseDigest(image.sha256, expected)) {
+    message = "Malformed sha256 in metadata";
+    return OTA_ERR_NO_DIGEST;
+  }
+
+  uint8_t *buf = (uint8_t *)malloc(OTA_CHUNK_SIZE);
+  if (!buf) {
+    message = "Out of memory";
+    return OTA_ERR_BEGIN;
+  }
+
+  // The digest always covers the installed image, whether it arrives whole
+  // or is rebuilt from a delta
+  mbedtls_md_context_t md;
+  mbedtls_md_init(&md);
+  mbedtls_md_setup(&md, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0);
+  mbedtls_md_starts(&md);
+  auto writeImage = [&md](const uint8_t *data, size_t len) {
+    if (Update.write(const_cast<uint8_t *>(data), len) != len)
+      return false;
+    mbedtls_md_update(&md, data, len);
+    return true;
+  };
+
+  std::unique_ptr<DeltaPatch> patch;
+  if (image.delta) {
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    patch.reset(new DeltaPatch(
+        [running](uint32_t offset, uint8_t *data, size_t len) {
+          return esp_partition_read(running, offset, data, len) == ESP_OK;
+        },
+        writeImage));
+  }
+
+  OtaError error = OTA_ERR_NONE;
+  uint32_t total = image.size;
+  uint32_t written = 0; // Bytes received (patch bytes for a delta)
+  int failures = 0;
+
+  setState(OTA_DOWNLOADING);
+  setProgress(0, total);
+
+  while (total == 0 || written < total) {
+    if (failures > 0) {
+      if (failures > OTA_MAX_RETRIES) {
+        error = OTA_ERR_RETRIES;
+        message = "Download failed after " + String(OTA_MAX_RETRIES) +
+                  " retries";
+        break;
+      }
+      uint32_t wait = OTA_RETRY_DELAY_MS * failures;
+      if (wait > OTA_RETRY_DELAY_MAX_MS)
+        wait = OTA_RETRY_DELAY_MAX_MS;
+      Serial.printf("OTA: connection lost at %u/%u bytes, retrying in %u ms\n",
+                    (unsigned)written, (unsigned)total, (unsigned)wait);
+      vTaskDelay(pdMS_TO_TICKS(wait));
+      if (WiFi.status() != WL_CONNECTED) {
+        failures++;
+        continue;
+      }
+      if (written > 0)
+        countResume();
+    }
+
+    HTTPClient *http = _session.begin(image.url);
+    if (!http) {
+      error = OTA_ERR_HTTP;
+      message = "Invalid image URL";
+      break;
+    }
+    const char *headerKeys[] = {"Content-Range"};
+    http->collectHeaders(headerKeys, 1);
+    if (written > 0) {
+      http->addHeader("Range", "bytes=" + String(written) + "-");
+    }
+
+    int httpCode = _session.GET();
+    uint32_t bodyTotal = 0;
+    uint32_t skip = 0; // Bytes already written that the server resends
+    if (httpCode == HTTP_CODE_OK) {
+      // Whole image: first request, or a server that ignores Range
+      int size = http->getSize();
+      if (size <= 0) {
+        error = OTA_ERR_SIZE;
+        message = "Server did not send Content-Length";
+      }
+      bodyTotal = size;
+      skip = written;
+    } else if (httpCode == HTTP_CODE_PARTIAL_CONTENT && written > 0) {
+      uint32_t start = 0;
+      if (!parseContentRange(http->header("Content-Range").c_str(), start,
+                             bodyTotal) ||
+          start > written) {
+        error = OTA_ERR_HTTP;
+        message = "Bad Content-Range: " + http->header("Content-Range");
+      }
+      skip = written - start;
+    } else if (httpCode > 0 && httpCode < 500) {
+      // Client errors will not go away by retrying
+      error = OTA_ERR_HTTP;
+      message = "HTTP error " + String(httpCode);
+    } else {
+      // Connection failure or server error, try again
+      _session.end(false);
+      failures++;
+      continue;
+    }
+
+    if (error == OTA_ERR_NONE) {
+      if (total == 0) {
+        total = bodyTotal;
+        setProgress(written, total);
+      } else if (bodyTotal != total) {
+        error = OTA_ERR_SIZE;
+        message = "Image is " + String(bodyTotal) + " bytes, expected " +
+                  String(total);
+      }
+    }
+    if (error == OTA_ERR_NONE && !Update.isRunning() &&
+        !Update.begin(image.delta ? image.targetSize : total, command)) {
+      error = OTA_ERR_BEGIN;
+      message = Update.errorString();
+    }
+    if (error != OTA_ERR_NONE) {
+      _session.end(false);
+      break;
+    }
+
+    // Stream the body into flash. The loop ends when the server closes the
+    // connection or stops sending; the outer loop then resumes from written.
+    WiFiClient *stream = http->getStreamPtr();
+    unsigned long lastData = millis();
+    bool progressed = false;
+    while (written < total) {
+      size_t avail = stream->available();
+      if (avail == 0) {
+        if (!stream->connected() ||
+            millis() - lastData > OTA_READ_TIMEOUT_MS)
+          break;
+        vTaskDelay(pdMS_TO_TICKS(2));
+        continue;
+      }
+
+      size_t want = avail < OTA_CHUNK_SIZE ? avail : OTA_CHUNK_SIZE;
+      if (skip > 0 && want > skip)
+        want = skip;
+      int n = stream->read(buf, want);
+      if (n <= 0)
+        continue;
+      lastData = millis();
+
+      if (skip > 0) {
+        skip -= n;
+        continue;
+      }
+
+      if (patch) {
+        DeltaResult result = patch->feed(buf, n);
+        if (result == DELTA_ERR_WRITE) {
+          error = OTA_ERR_WRITE;
+          message = Update.errorString();
+          break;
+        } else if (result != DELTA_OK && result != DELTA_DONE) {
+          error = OTA_ERR_PATCH;
+          message = "Delta patch error " + String(result);
+          break;
+        }
+      } else if (!writeImage(buf, n)) {
+        error = OTA_ERR_WRITE;
+        message = Update.errorString();
+        break;
+      }
+      written += n;
+      progressed = true;
+      setProgress(written, total);
+    }
+    // Keep the connection for the next image only if the body was consumed
+    _session.end(error == OTA_ERR_NONE && written == total);
+
+    if (error != OTA_ERR_NONE)
+      break;
+    failures = progressed ? 1 : failures + 1;
+  }
+
+  free(buf);
+
+  if (error == OTA_ERR_NONE && patch && !patch->isDone()) {
+    error = OTA_ERR_PATCH;
+    message = "Delta patch ended early";
+  }
+
+  if (error == OTA_ERR_NONE) {
+    setState(OTA_VERIFYING);
+    uint8_t digest[32];
+    mbedtls_md_finish(&md, digest);
+    if (memcmp(digest, expected, sizeof(digest)) != 0) {
+      error = OTA_ERR_DIGEST;
+      message = "SHA-256 mismatch";
+    }
+  }
+  mbedtls_md_free(&md);
+
+  // Update.end() writes the held-back image header and, for firmware, sets
+  // the boot partition. Nothing is bootable until the digest has matched.
+  if (error == OTA_ERR_NONE && !Update.end()) {
+    error = OTA_ERR_FINALIZE;
+    message = Update.errorString();
+  }
+
+  if (error != OTA_ERR_NONE && Update.isRunning()) {
+    Update.abort();
+  }
+  return error;
+}
+
+// Check that the first size bytes of the running partition hash to sha256,
+// i.e. that a delta made against that image can be applied
+bool OtaUpdater::runningImageMatches(uint32_t size, const String &sha256) {
+  uint8_t expected[32];
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  if (!parseDigest(sha256, expected) || !running || size > running->size)
+    return false;
+
+  uint8_t *buf = (uint8_t *)malloc(OTA_CHUNK_SIZE);
+  if (!buf)
+    return false;
+
+  mbedtls_md_context_t md;
+  mbedtls_md_init(&md);
+  mbedtls_md_setup(&md, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0);
+  mbedtls_md_starts(&md);
+  bool ok = true;
+  for (uint32_t offset = 0; offset < size && ok; offset += OTA_CHUNK_SIZE) {
+    size_t len = size - offset;
+    if (len > OTA_CHUNK_SIZE)
+      len = OTA_CHUNK_SIZE;
+    ok = esp_partition_read(running, offset, buf, len) == ESP_OK;
+    mbedtls_md_update(&md, buf, len);
+  }
+  uint8_t digest[32];
+  mbedtls_md_finish(&md, digest);
+  mbedtls_md_free(&md);
+  free(buf);
+
+  return ok && memcmp(digest, expected, sizeof(digest)) == 0;
+}
+
+String OtaUpdater::metadataUrl(const String &firmwareUrl) {
+  String checkUrl = firmwareUrl;
+  int dotIndex = checkUrl.lastIndexOf('.');
+  if (dotIndex != -1) {
+    checkUrl = checkUrl.substring(0, dotIndex) + ".json";
+  } else {
+    checkUrl += ".json";
+  }
+  return checkUrl;
+}
+
+bool OtaUpdater::parseContentRange(const char *value, uint32_t &start,
+                                   uint32_t &total) {
+  unsigned long first, last, length;
+  if (sscanf(value, "bytes %lu-%lu/%lu", &first, &last, &length) != 3)
+    return false;
+  if (first > last || last >= length)
+    return false;
+  start = first;
+  total = length;
+  return true;
+}
+
+bool OtaUpdater::parseDigest(const String &hex, uint8_t out[32]) {
+  if (hex.length() != 64)
+    return false;
+  for (int i = 0; i < 32; i++) {
+    uint8_t byte = 0;
+    for (int j = 0; j < 2; j++) {
+      char c = hex[i * 2 + j];
+      byte <<= 4;
+      if (c >= '0' && c <= '9')
+        byte |= c - '0';
+      else if (c >= 'a' && c <= 'f')
+        byte |= c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F')
+        byte |= c - 'A' + 10;
+      else
+        return false;
+    }
+    out[i] = byte;
+  }
+  return true;
+}
+
+const char *OtaUpdater::stateName(OtaState state) {
+  switch (state) {
+  case OTA_IDLE:
+    return "idle";
+  case OTA_CHECKING:
+    return "checking";
+  case OTA_DOWNLOADING:
+    return "downloading";
+  case OTA_VERIFYING:
+    return "verifying";
+  case OTA_SUCCESS:
+    return "success";
+  case OTA_FAILED:
+    return "failed";
+  default:
+    return "";
+  }
+}
+
+const char *OtaUpdater::stageName(OtaStage stage) {
+  switch (stage) {
+  case OTA_STAGE_SPIFFS:
+    return "spiffs";
+  case OTA_STAGE_FIRMWARE:
+    return "firmware";
+  default:
+    return "";
+  }
+}
+
+void OtaUpdater::setState(OtaState state) {
+  portENTER_CRITICAL(&otaMux);
+  _status.state = state;
+  portEXIT_CRITICAL(&otaMux);
+}
+
+void OtaUpdater::setStage(OtaStage stage, bool delta) {
+  portENTER_CRITICAL(&otaMux);
+  _status.stage = stage;
+  _status.delta = delta;
+  _status.written = 0;
+  _status.total = 0;
+  portEXIT_CRITICAL(&otaMux);
+}
+
+void OtaUpdater::setProgress(uint32_t written, uint32_t total) {
+  portENTER_CRITICAL(&otaMux);
+  _status.written = written;
+  _status.total = total;
+  portEXIT_CRITICAL(&otaMux);
+}
+
+void OtaUpdater::countResume() {
+  portENTER_CRITICAL(&otaMux);
+  _status.resumes++;
+  portEXIT_CRITICAL(&otaMux);
+}
+
+void OtaUpdater::fail(OtaError error, const char *message) {
+  Serial.printf("OTA Error (%d): %s\n", error, message);
+  portENTER_CRITICAL(&otaMux);
+  _status.state = OTA_FAILED;
+  _status.error = error;
+  strlcpy(_status.message, message, sizeof(_status.message));
+  portEXIT_CRITICAL(&otaMux);
+}
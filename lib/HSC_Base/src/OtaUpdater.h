@@ -0,0 +1,163 @@
+#ifndef OTA_UPDATER_H
+#define OTA_UPDATER_H
+
+#include "HttpSession.h"
+#include "MetadataCache.h"
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <functional>
+#include <memory>
+
+// --- OTA Tuning ---
+// Bytes read from the stream and written to flash per step
+static const size_t OTA_CHUNK_SIZE = 4096;
+// A connection that delivers nothing for this long is dropped and resumed
+static const uint32_t OTA_READ_TIMEOUT_MS = 10000;
+// Consecutive attempts without receiving data before the update is abandoned
+static const int OTA_MAX_RETRIES = 10;
+// Wait before resuming; grows linearly per attempt up to the maximum
+static const uint32_t OTA_RETRY_DELAY_MS = 1000;
+static const uint32_t OTA_RETRY_DELAY_MAX_MS = 10000;
+static const uint32_t OTA_TASK_STACK = 8192;
+static const UBaseType_t OTA_TASK_PRIORITY = 1;
+// Run next to the WiFi stack so the Arduino loop core stays free for sensing
+static const BaseType_t OTA_TASK_CORE = 0;
+// Minimum interval between MQTT progress messages
+static const unsigned long OTA_PROGRESS_INTERVAL_MS = 1000;
+// Optional PEM CA certificate used to verify https update servers
+static const char OTA_CA_CERT_PATH[] = "/ota_ca.pem";
+
+enum OtaState : uint8_t {
+  OTA_IDLE,
+  OTA_CHECKING,    // Fetching the .json metadata
+  OTA_DOWNLOADING, // Streaming an image to flash
+  OTA_VERIFYING,   // Checking the SHA-256 digest
+  OTA_SUCCESS,     // Firmware verified and marked bootable, reboot pending
+  OTA_FAILED,
+};
+
+enum OtaStage : uint8_t {
+  OTA_STAGE_NONE,
+  OTA_STAGE_SPIFFS,
+  OTA_STAGE_FIRMWARE,
+};
+
+enum OtaError : uint8_t {
+  OTA_ERR_NONE,
+  OTA_ERR_METADATA, // Metadata missing or not valid JSON
+  OTA_ERR_NO_DIGEST,
+  OTA_ERR_HTTP,     // Unexpected HTTP status or Content-Range
+  OTA_ERR_SIZE,     // Image size unknown or different from the metadata
+  OTA_ERR_BEGIN,    // Update.begin failed (image too large for the partition)
+  OTA_ERR_WRITE,
+  OTA_ERR_DIGEST,   // SHA-256 mismatch
+  OTA_ERR_FINALIZE, // Update.end rejected the image
+  OTA_ERR_RETRIES,
+  OTA_ERR_PATCH, // Delta could not be applied
+};
+
+struct OtaStatus {
+  OtaState state = OTA_IDLE;
+  OtaStage stage = OTA_STAGE_NONE;
+  OtaError error = OTA_ERR_NONE;
+  uint32_t written = 0;
+  uint32_t total = 0;
+  uint16_t resumes = 0;
+  bool delta = false; // Downloading a delta patch instead of the full image
+  char version[24] = "";
+  char message[64] = "";
+};
+
+// Downloads and installs firmware (and optionally the SPIFFS image) on a
+// background task so the main loop keeps running during the update.
+//
+// Images are streamed in OTA_CHUNK_SIZE steps straight into the update
+// partition while a SHA-256 digest is computed. A dropped connection is
+// resumed with an HTTP Range request from the last written byte. Metadata
+// and images share one keep-alive connection (HttpSession). The digest
+// must match the "sha256" field of the .json metadata before Update.end()
+// marks the partition bootable; an image without a digest is refused.
+//
+// If the metadata lists a delta from the running version (see DeltaPatch.h)
+// and the running partition matches its source digest, the patch is
+// downloaded instead and applied on the fly; any failure falls back to the
+// full image.
+class OtaUpdater {
+public:
+  OtaUpdater();
+
+  // Called on the OTA task around the SPIFFS image write, e.g. to close
+  // files before the filesystem is replaced and remount it afterwards
+  void onFilesystemUpdate(std::function<void()> before,
+                          std::function<void()> after);
+
+  // Version of the running firmware, used to pick a delta
+  void setCurrentVersion(const String &version);
+
+  // Start an update from a resolved firmware URL; false if already running.
+  // With expectVersion set, metadata announcing another version is refused.
+  bool start(const String &firmwareUrl, const String &expectVersion = "");
+
+  bool isRunning() const { return _running; }
+
+  // Fetch the metadata for a resolved firmware URL through the shared
+  // cache; an unchanged file is revalidated without being downloaded
+  MetadataResult checkMetadata(const String &firmwareUrl,
+                               FirmwareMetadata &out);
+
+  // Snapshot of the current progress; safe to call from any task
+  OtaStatus status() const;
+
+  // Release the update server connection once it has been idle for a while
+  void closeIdleConnection(uint32_t idleMs = HTTP_SESSION_IDLE_MS) {
+    _session.closeIfIdle(idleMs);
+  }
+
+  // Derive the metadata URL (firmware.bin -> firmware.json)
+  static String metadataUrl(const String &firmwareUrl);
+
+  // Parse "bytes start-end/total"; false if malformed
+  static bool parseContentRange(const char *value, uint32_t &start,
+                                uint32_t &total);
+
+  static const char *stateName(OtaState state);
+  static const char *stageName(OtaStage stage);
+
+private:
+  volatile bool _running = false;
+  OtaStatus _status;
+  String _url;
+  String _expectVersion;
+  String _currentVersion;
+  String _caCert;
+  bool _caLoaded = false;
+  MetadataCache _metadata;
+  HttpSession _session;
+  std::function<void()> _beforeFs;
+  std::function<void()> _afterFs;
+
+  struct Image {
+    String url;
+    String sha256;       // Digest of the installed image
+    uint32_t size;       // Bytes to download (0 = take it from the server)
+    uint32_t targetSize; // Delta only: size of the patched image
+    bool delta;
+  };
+
+  static void taskEntry(void *arg);
+  void run();
+  bool fetchMetadata(Image &firmware, Image &spiffs, Image &delta,
+                     bool &updateSpiffs);
+  OtaError download(const Image &image, int command, String &message);
+  bool runningImageMatches(uint32_t size, const String &sha256);
+  void loadCaCert();
+  static bool parseDigest(const String &hex, uint8_t out[32]);
+
+  void setState(OtaState state);
+  void setStage(OtaStage stage, bool delta = false);
+  void setProgress(uint32_t written, uint32_t total);
+  void countResume();
+  void fail(OtaError error, const char *message);
+};
+
+#endif
@@ -0,0 +1,150 @@
+#include "PeerLink.h"
+#include "config.h"
+#include <esp_system.h>
+#include <esp_timer.h>
+
+PeerLink::PeerLink()
+    : _clock(nullptr), _started(false), _repeatDue(false), _changedAt(0),
+      _lastSend(0), _rxHead(0), _rxCount(0), _received(0), _invalid(0),
+      _overflow(0), _sent(0), _latencySamples(0), _lastLatencyUs(0),
+      _maxLatencyUs(0), _latencySumUs(0) {
+  memset(&_self, 0, sizeof(_self));
+}
+
+bool PeerLink::begin(uint16_t boardId, const ClockService &clock) {
+  IPAddress group;
+  group.fromString(PEER_GROUP);
+  if (!_udp.listenMulticast(group, PEER_PORT)) {
+    Serial.println("Peer link: could not join multicast group");
+    return false;
+  }
+  _udp.onPacket([this](AsyncUDPPacket &packet) { onPacket(packet); });
+
+  _clock = &clock;
+  _self.boardId = boardId;
+  _self.epoch = esp_random() & 0xFFFF;
+  _started = true;
+  Serial.printf("Peer link: board %u on %s:%d\n", boardId, PEER_GROUP,
+                PEER_PORT);
+  send(false);
+  return true;
+}
+
+void PeerLink::publish(uint64_t mask, uint8_t count) {
+  if (mask == _self.mask && count == _self.count)
+    return;
+  _self.mask = mask;
+  _self.count = count;
+  if (!_started)
+    return;
+  send(false);
+  _repeatDue = true;
+  _changedAt = millis();
+}
+
+// A repeat keeps the sequence number, so receivers drop whichever copy
+// arrives second
+void PeerLink::send(bool repeat) {
+  if (!repeat)
+    _self.seq++;
+  _self.sentUs = _clock->nowUtcMicros();
+
+  uint8_t buf[PEER_FRAME_SIZE];
+  encodePeerFrame(_self, buf);
+  IPAddress group;
+  group.fromString(PEER_GROUP);
+  if (_udp.writeTo(buf, sizeof(buf), group, PEER_PORT) == sizeof(buf))
+    _sent++;
+  _lastSend = millis();
+}
+
+// Runs on the AsyncUDP task
+void PeerLink::onPacket(AsyncUDPPacket &packet) {
+  RxEntry entry;
+  entry.receivedUs = esp_timer_get_time();
+  bool valid = decodePeerFrame(packet.data(), packet.length(), entry.frame);
+
+  portENTER_CRITICAL(&_mux);
+  if (!valid) {
+    _invalid++;
+  } else if (entry.frame.boardId == _self.boardId) {
+    // Our own frame looped back
+  } else if (_rxCount == PEER_RX_QUEUE_LEN) {
+    _overflow++;
+  } else {
+    _rx[(_rxHead + _rxCount) % PEER_RX_QUEUE_LEN] = entry;
+    _rxCount++;
+    _received++;
+  }
+  portEXIT_CRITICAL(&_mux);
+}
+
+void PeerLink::loop() {
+  if (!_started)
+    return;
+
+  for (;;) {
+    RxEntry entry;
+    portENTER_CRITICAL(&_mux);
+    bool any = _rxCount > 0;
+    if (any) {
+      entry = _rx[_rxHead];
+      _rxHead = (_rxHead + 1) % PEER_RX_QUEUE_LEN;
+      _rxCount--;
+    }
+    portEXIT_CRITICAL(&_mux);
+    if (!any)
+      break;
+    dispatch(entry);
+  }
+
+  uint32_t now = millis();
+  PeerState *gone;
+  while ((gone = _table.expire(now)) != nullptr) {
+    Serial.printf("Peer link: board %u offline\n", gone->boardId);
+    if (_handler)
+      _handler(*gone);
+  }
+
+  if (_repeatDue && now - _changedAt >= PEER_REPEAT_MS) {
+    send(true);
+    _repeatDue = false;
+  } else if (now - _lastSend >= PEER_HEARTBEAT_MS) {
+    send(false);
+  }
+}
+
+void PeerLink::dispatch(const RxEntry &entry) {
+  PeerState *peer = _table.apply(entry.frame, millis());
+  if (!peer)
+    return;
+
+  // One-way latency needs both clocks on NTP; only changes are counted so
+  // heartbeats do not swamp the figure
+  if (peer->changed && entry.frame.sentUs && _clock->synced()) {
+    int64_t latency = _clock->utcAt(entry.receivedUs) - entry.frame.sentUs;
+    if (latency >= 0) {
+      _lastLatencyUs = latency;
+      if (_lastLatencyUs > _maxLatencyUs)
+        _maxLatencyUs = _lastLatencyUs;
+      _latencySumUs += _lastLatencyUs;
+      _latencySamples++;
+    }
+  }
+  if (_handler)
+    _handler(*peer);
+}
+
+PeerLinkStats PeerLink::stats() const {
+  PeerLinkStats st;
+  portENTER_CRITICAL(&_mux);
+  st.received = _received;
+  st.invalid = _invalid;
+  st.overflow = _overflow;
+  portEXIT_CRITICAL(&_mux);
+  st.sent = _sent;
+  st.lastLatencyUs = _lastLatencyUs;
+  st.maxLatencyUs = _maxLatencyUs;
+  st.avgLatencyUs = _latencySamples ? _latencySumUs / _latencySamples : 0;
+  return st;
+}
@@ -0,0 +1,100 @@
+#ifndef PEER_LINK_H
+#define PEER_LINK_H
+
+#include "ClockService.h"
+#include "PeerTable.h"
+#include <Arduino.h>
+#include <AsyncUDP.h>
+#include <freertos/FreeRTOS.h>
+#include <functional>
+
+// --- Peer Link Tuning ---
+// Frames are resent unchanged (same sequence) this long after a change, so
+// one lost datagram does not hold a neighbour up until the heartbeat
+static const uint32_t PEER_REPEAT_MS = 30;
+// Current state is resent this often without a change
+static const uint32_t PEER_HEARTBEAT_MS = 1000;
+// Received frames waiting for loop()
+static const int PEER_RX_QUEUE_LEN = 16;
+
+struct PeerLinkStats {
+  uint32_t sent;
+  uint32_t received;
+  uint32_t invalid;       // Not a peer frame (other traffic on the group)
+  uint32_t overflow;      // Dropped because loop() fell behind
+  uint32_t lastLatencyUs; // Send to receive, only with both clocks synced
+  uint32_t maxLatencyUs;
+  uint32_t avgLatencyUs;
+};
+
+// Occupancy exchange between boards over UDP multicast on the LAN, without
+// a round trip through the MQTT broker. Each board sends its track bitmask
+// on every change (plus one repeat) and as a heartbeat; subscribers hear
+// about neighbours' changes on the loop() task.
+//
+// The AsyncUDP callback only queues decoded frames; the table and the
+// subscriber run in loop(), like MqttClient.
+class PeerLink {
+public:
+  typedef std::function<void(const PeerState &peer)> Handler;
+
+  PeerLink();
+
+  // Join the group and start sending as boardId; call once WiFi is up
+  bool begin(uint16_t boardId, const ClockService &clock);
+  bool started() const { return _started; }
+
+  // Set this board's occupancy; sent at once if it changed
+  void publish(uint64_t mask, uint8_t count);
+
+  // Called on a neighbour's first frame, each change (peer.changed has the
+  // bits) and when it goes offline or comes back (peer.online)
+  void onState(Handler handler) { _handler = handler; }
+
+  // Last state of a neighbour, null if it was never heard
+  const PeerState *peer(uint16_t boardId) const {
+    return _table.find(boardId);
+  }
+  const PeerTable &table() const { return _table; }
+  PeerLinkStats stats() const;
+
+  void loop();
+
+private:
+  struct RxEntry {
+    PeerFrame frame;
+    int64_t receivedUs; // esp_timer time
+  };
+
+  AsyncUDP _udp;
+  const ClockService *_clock;
+  bool _started;
+  Handler _handler;
+  PeerTable _table;
+
+  PeerFrame _self;
+  bool _repeatDue;
+  uint32_t _changedAt;
+  uint32_t _lastSend;
+
+  // Written by the AsyncUDP task, read by loop(); guarded by _mux
+  mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+  RxEntry _rx[PEER_RX_QUEUE_LEN];
+  int _rxHead;
+  int _rxCount;
+  uint32_t _received;
+  uint32_t _invalid;
+  uint32_t _overflow;
+
+  uint32_t _sent;
+  uint32_t _latencySamples;
+  uint32_t _lastLatencyUs;
+  uint32_t _maxLatencyUs;
+  uint64_t _latencySumUs;
+
+  void send(bool repeat);
+  void onPacket(AsyncUDPPacket &packet);
+  void dispatch(const RxEntry &entry);
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "PeerTable.h"
+#include <string.h>
+
+static const uint8_t PEER_MAGIC[2] = {'H', 'P'};
+
+static void putLE(uint8_t *p, uint64_t v, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    p[i] = v & 0xFF;
+    v >>= 8;
+  }
+}
+
+static uint64_t getLE(const uint8_t *p, int bytes) {
+  uint64_t v = 0;
+  for (int i = bytes - 1; i >= 0; i--) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+void encodePeerFrame(const PeerFrame &frame, uint8_t *out) {
+  out[0] = PEER_MAGIC[0];
+  out[1] = PEER_MAGIC[1];
+  out[2] = PEER_FRAME_VERSION;
+  out[3] = frame.count;
+  putLE(out + 4, frame.boardId, 2);
+  putLE(out + 6, frame.epoch, 2);
+  putLE(out + 8, frame.seq, 4);
+  putLE(out + 12, frame.mask, 8);
+  putLE(out + 20, (uint64_t)frame.sentUs, 8);
+}
+
+bool decodePeerFrame(const uint8_t *in, size_t len, PeerFrame &frame) {
+  if (len != PEER_FRAME_SIZE || in[0] != PEER_MAGIC[0] ||
+      in[1] != PEER_MAGIC[1] || in[2] != PEER_FRAME_VERSION || in[3] > 64)
+    return false;
+
+  frame.count = in[3];
+  frame.boardId = getLE(in + 4, 2);
+  frame.epoch = getLE(in + 6, 2);
+  frame.seq = getLE(in + 8, 4);
+  frame.mask = getLE(in + 12, 8);
+  frame.sentUs = (int64_t)getLE(in + 20, 8);
+  return true;
+}
+
+PeerTable::PeerTable() : _count(0), _rejected(0) {
+  memset(_peers, 0, sizeof(_peers));
+}
+
+PeerState *PeerTable::apply(const PeerFrame &frame, uint32_t nowMs) {
+  PeerState *p = (PeerState *)find(frame.boardId);
+  bool first = p == nullptr;
+  if (first) {
+    if (_count == PEER_MAX_BOARDS) {
+      _rejected++;
+      return nullptr;
+    }
+    p = &_peers[_count++];
+    memset(p, 0, sizeof(*p));
+    p->boardId = frame.boardId;
+  } else if (frame.epoch == p->epoch) {
+    // Serial number arithmetic, so the wrap at 2^32 is harmless
+    int32_t ahead = (int32_t)(frame.seq - p->seq);
+    if (ahead <= 0) {
+      p->duplicates++;
+      return nullptr;
+    }
+    p->lost += ahead - 1;
+  }
+  // A new epoch is a restarted board: take its sequence as it comes
+
+  bool wasOnline = p->online;
+  uint64_t changed = first ? frame.mask : p->mask ^ frame.mask;
+  p->epoch = frame.epoch;
+  p->seq = frame.seq;
+  p->count = frame.count;
+  p->mask = frame.mask;
+  p->online = true;
+  p->lastSeenMs = nowMs;
+  p->frames++;
+
+  if (!first && wasOnline && changed == 0)
+    return nullptr;
+  p->changed = changed;
+  return p;
+}
+
+PeerState *PeerTable::expire(uint32_t nowMs) {
+  for (int i = 0; i < _count; i++) {
+    PeerState &p = _peers[i];
+    if (p.online && nowMs - p.lastSeenMs >= PEER_TIMEOUT_MS) {
+      p.online = false;
+      p.changed = 0;
+      return &p;
+    }
+  }
+  return nullptr;
+}
+
+const PeerState *PeerTable::find(uint16_t boardId) const {
+  for (int i = 0; i < _count; i++) {
+    if (_peers[i].boardId == boardId)
+      return &_peers[i];
+  }
+  return nullptr;
+}
@@ -0,0 +1,78 @@
+#ifndef PEER_TABLE_H
+#define PEER_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Occupancy frames exchanged directly between boards, and the table of
+// what each neighbour last reported. No Arduino dependencies, so it can be
+// compiled on the host.
+
+// --- Peer Tuning ---
+// Neighbours tracked at once
+static const int PEER_MAX_BOARDS = 16;
+// A neighbour without a frame for this long is reported offline (three
+// missed heartbeats)
+static const uint32_t PEER_TIMEOUT_MS = 3500;
+
+struct PeerFrame {
+  uint16_t boardId;
+  uint16_t epoch; // Random per boot, so a restarted sequence is accepted
+  uint32_t seq;   // New per state change and per heartbeat
+  uint8_t count;  // Tracks in mask
+  uint64_t mask;  // Bit i = track i occupied
+  int64_t sentUs; // Sender's UTC at send in µs, 0 if its clock is not set
+};
+
+// magic(2) version(1) count(1) board(2) epoch(2) seq(4) mask(8) sent(8)
+static const size_t PEER_FRAME_SIZE = 28;
+static const uint8_t PEER_FRAME_VERSION = 1;
+
+// Encode into exactly PEER_FRAME_SIZE bytes (little-endian)
+void encodePeerFrame(const PeerFrame &frame, uint8_t *out);
+
+// Decode; false if the length, magic or version does not match
+bool decodePeerFrame(const uint8_t *in, size_t len, PeerFrame &frame);
+
+struct PeerState {
+  uint16_t boardId;
+  uint16_t epoch;
+  uint32_t seq;
+  uint8_t count;
+  uint64_t mask;
+  uint64_t changed; // Bits that changed with the last update
+  bool online;
+  uint32_t lastSeenMs;
+  uint32_t frames;
+  uint32_t lost;       // Sequence numbers never seen
+  uint32_t duplicates; // Repeats and late frames, dropped
+};
+
+// What each neighbour last reported. Frames are applied in sequence order
+// per board; repeats and reordered frames are dropped and gaps counted as
+// lost.
+class PeerTable {
+public:
+  PeerTable();
+
+  // Apply a frame received at nowMs. Returns the neighbour when there is
+  // something to tell subscribers: first frame, changed mask or back
+  // online. Heartbeats, duplicates and frames that do not fit return null.
+  PeerState *apply(const PeerFrame &frame, uint32_t nowMs);
+
+  // Take the next neighbour that has been silent for PEER_TIMEOUT_MS and
+  // mark it offline; null when there is none
+  PeerState *expire(uint32_t nowMs);
+
+  const PeerState *find(uint16_t boardId) const;
+  int count() const { return _count; }
+  const PeerState &at(int index) const { return _peers[index]; }
+  uint32_t rejected() const { return _rejected; }
+
+private:
+  PeerState _peers[PEER_MAX_BOARDS];
+  int _count;
+  uint32_t _rejected; // Frames from boards beyond PEER_MAX_BOARDS
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include "ProvisionBundle.h"
+#include <mbedtls/md.h>
+#include <string.h>
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+bool provisionSignatureValid(const char *data, size_t len, const char *key,
+                             size_t keyLen, const char *hexSignature) {
+  if (!hexSignature || strlen(hexSignature) != 64 || keyLen == 0)
+    return false;
+
+  uint8_t digest[32];
+  mbedtls_md_context_t md;
+  mbedtls_md_init(&md);
+  bool ok =
+      mbedtls_md_setup(&md, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                       1) == 0 &&
+      mbedtls_md_hmac_starts(&md, (const unsigned char *)key, keyLen) == 0 &&
+      mbedtls_md_hmac_update(&md, (const unsigned char *)data, len) == 0 &&
+      mbedtls_md_hmac_finish(&md, digest) == 0;
+  mbedtls_md_free(&md);
+  if (!ok)
+    return false;
+
+  uint8_t diff = 0;
+  for (int i = 0; i < 32; i++) {
+    int hi = hexValue(hexSignature[i * 2]);
+    int lo = hexValue(hexSignature[i * 2 + 1]);
+    if (hi < 0 || lo < 0)
+      return false;
+    diff |= digest[i] ^ (uint8_t)(hi << 4 | lo);
+  }
+  return diff == 0;
+}
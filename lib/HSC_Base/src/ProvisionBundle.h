@@ -0,0 +1,35 @@
+#ifndef PROVISION_BUNDLE_H
+#define PROVISION_BUNDLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Provisioning Limits ---
+// Largest request accepted by /api/provision; room for the common settings
+// plus a board_id and location for about a hundred boards
+static const size_t PROVISION_MAX_BYTES = 8192;
+
+// A provisioning request carries the bundle as a JSON string and its
+// HMAC-SHA256, keyed with the fleet's provisioning key:
+//
+//   {"bundle": "{\"seq\":...,\"config\":{...},\"boards\":{...}}",
+//    "hmac": "<64 hex digits>"}
+//
+// Signing the bundle text rather than parsed JSON means the signer and the
+// board never have to agree on a canonical form. The bundle itself holds
+//
+//   seq     increasing number; a board refuses one not above the last it
+//           applied, so an old bundle cannot be replayed
+//   config  settings for every board, as in /api/settings
+//   boards  optional per-board settings by MAC address ("AA:BB:..") or
+//           device id, applied over config; a board not listed refuses the
+//           bundle
+//
+// so one signed bundle can be sent unchanged to every board of a layout.
+
+// True if hexSignature is the HMAC-SHA256 of data under key. The
+// comparison takes the same time wherever the first difference is.
+bool provisionSignatureValid(const char *data, size_t len, const char *key,
+                             size_t keyLen, const char *hexSignature);
+
+#endif
@@ -0,0 +1,100 @@
+#include "RequestLimiter.h"
+#include <string.h>
+
+static const uint32_t TOKEN = 1000;
+
+RequestLimiter::RequestLimiter() : _open(0), _heavy(0) {
+  memset(_clients, 0, sizeof(_clients));
+  memset(&_stats, 0, sizeof(_stats));
+  _global.tokens = WEB_GLOBAL_BURST * TOKEN;
+  _global.lastMs = 0;
+}
+
+void RequestLimiter::refill(Bucket &bucket, uint16_t rate, uint16_t burst,
+                            uint32_t nowMs) {
+  uint32_t elapsed = nowMs - bucket.lastMs;
+  bucket.lastMs = nowMs;
+  uint32_t cap = burst * TOKEN;
+  // rate tokens per 1000 ms is rate thousandths per ms
+  if (elapsed >= cap / rate)
+    bucket.tokens = cap;
+  else if (bucket.tokens + elapsed * rate < cap)
+    bucket.tokens += elapsed * rate;
+  else
+    bucket.tokens = cap;
+}
+
+// A new client starts with a full burst; the slot of the one seen least
+// recently is taken when the table is full
+RequestLimiter::Client &RequestLimiter::clientFor(uint32_t address,
+                                                  uint32_t nowMs) {
+  Client *oldest = &_clients[0];
+  for (int i = 0; i < WEB_MAX_CLIENTS; i++) {
+    Client &c = _clients[i];
+    if (c.address == address)
+      return c;
+    if (c.address == 0 ||
+        (oldest->address != 0 &&
+         nowMs - c.bucket.lastMs > nowMs - oldest->bucket.lastMs))
+      oldest = &c;
+  }
+  oldest->address = address;
+  oldest->bucket.tokens = WEB_CLIENT_BURST * TOKEN;
+  oldest->bucket.lastMs = nowMs;
+  return *oldest;
+}
+
+RequestVerdict RequestLimiter::admit(uint32_t client, RequestClass cls,
+                                     uint32_t nowMs) {
+  int slots = cls == REQUEST_CHEAP ? WEB_MAX_OPEN
+                                   : WEB_MAX_OPEN - WEB_CHEAP_RESERVED;
+  if (_open >= slots) {
+    _stats.busy++;
+    return REQUEST_BUSY;
+  }
+  if (cls == REQUEST_HEAVY && _heavy >= WEB_MAX_HEAVY) {
+    _stats.deferred++;
+    return REQUEST_DEFERRED;
+  }
+
+  // Nothing is taken from a bucket for a refused request
+  Client &c = clientFor(client, nowMs);
+  refill(c.bucket, WEB_CLIENT_RATE, WEB_CLIENT_BURST, nowMs);
+  if (c.bucket.tokens < TOKEN) {
+    _stats.clientLimited++;
+    return REQUEST_CLIENT_LIMITED;
+  }
+  if (cls != REQUEST_CHEAP) {
+    refill(_global, WEB_GLOBAL_RATE, WEB_GLOBAL_BURST, nowMs);
+    if (_global.tokens < TOKEN) {
+      _stats.globalLimited++;
+      return REQUEST_GLOBAL_LIMITED;
+    }
+    _global.tokens -= TOKEN;
+  }
+  c.bucket.tokens -= TOKEN;
+
+  _open++;
+  if (cls == REQUEST_HEAVY)
+    _heavy++;
+  if (_open > _stats.peakOpen)
+    _stats.peakOpen = _open;
+  _stats.admitted++;
+  return REQUEST_ADMITTED;
+}
+
+void RequestLimiter::release(RequestClass cls) {
+  if (_open > 0)
+    _open--;
+  if (cls == REQUEST_HEAVY && _heavy > 0)
+    _heavy--;
+}
+
+int RequestLimiter::clients() const {
+  int n = 0;
+  for (int i = 0; i < WEB_MAX_CLIENTS; i++) {
+    if (_clients[i].address != 0)
+      n++;
+  }
+  return n;
+}
@@ -0,0 +1,92 @@
+#ifndef REQUEST_LIMITER_H
+#define REQUEST_LIMITER_H
+
+#include <stdint.h>
+
+// --- Web Limit Tuning ---
+// Every web request is handled on the one AsyncTCP task and holds a lwIP
+// connection (16 in all, shared with MQTT and the update server) until it
+// is answered, so a few polling tabs and scripts can starve the rest.
+// Clients tracked by address; the least recently seen is replaced
+static const int WEB_MAX_CLIENTS = 8;
+// Per-client budget: a page load with its assets and first API calls fits
+// in the burst, polling every second stays under the rate
+static const uint16_t WEB_CLIENT_RATE = 4; // Requests per second
+static const uint16_t WEB_CLIENT_BURST = 12;
+// Budget for all clients together; cheap requests are not counted
+static const uint16_t WEB_GLOBAL_RATE = 12;
+static const uint16_t WEB_GLOBAL_BURST = 24;
+// Requests in progress at once, of which the last few are kept for cheap
+// requests, so status and metrics are answered even when the rest is full
+static const int WEB_MAX_OPEN = 8;
+static const int WEB_CHEAP_RESERVED = 2;
+// Heavy requests (settings save, firmware check, event log download) in
+// progress; another one is told to come back after WEB_RETRY_AFTER_S
+static const int WEB_MAX_HEAVY = 1;
+static const uint8_t WEB_RETRY_AFTER_S = 1;
+
+enum RequestClass : uint8_t {
+  REQUEST_CHEAP = 0,  // Status, metrics: served from memory
+  REQUEST_NORMAL = 1, // Pages and the rest of the API
+  REQUEST_HEAVY = 2,  // Flash writes, long streams, updates
+};
+
+enum RequestVerdict : uint8_t {
+  REQUEST_ADMITTED = 0,
+  REQUEST_CLIENT_LIMITED = 1, // 429: this client is over its rate
+  REQUEST_GLOBAL_LIMITED = 2, // 429: all clients together are
+  REQUEST_BUSY = 3,           // 503: no connection slot for the class
+  REQUEST_DEFERRED = 4,       // 503: a heavy request is already running
+};
+
+struct RequestLimiterStats {
+  uint32_t admitted;
+  uint32_t clientLimited;
+  uint32_t globalLimited;
+  uint32_t busy;
+  uint32_t deferred;
+  uint16_t peakOpen;
+};
+
+// Admission control for the web server: a token bucket per client address
+// and one for all of them, plus caps on the requests in progress. Not
+// locked: admit() and release() are meant to be called from the AsyncTCP
+// task only. No Arduino dependencies, so it can be driven by simulated
+// clients on the host.
+class RequestLimiter {
+public:
+  RequestLimiter();
+
+  // Decide on a new request from client (IPv4 address). An admitted
+  // request must be released once its connection closes.
+  RequestVerdict admit(uint32_t client, RequestClass cls, uint32_t nowMs);
+  void release(RequestClass cls);
+
+  int open() const { return _open; }
+  int heavy() const { return _heavy; }
+  int clients() const;
+  const RequestLimiterStats &stats() const { return _stats; }
+
+private:
+  // Tokens are kept in thousandths, so refilling needs no division
+  struct Bucket {
+    uint32_t tokens;
+    uint32_t lastMs;
+  };
+  struct Client {
+    uint32_t address; // 0 = unused
+    Bucket bucket;
+  };
+
+  Client _clients[WEB_MAX_CLIENTS];
+  Bucket _global;
+  int _open;
+  int _heavy;
+  RequestLimiterStats _stats;
+
+  Client &clientFor(uint32_t address, uint32_t nowMs);
+  static void refill(Bucket &bucket, uint16_t rate, uint16_t burst,
+                     uint32_t nowMs);
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "RolloutScheduler.h"
+#include <string.h>
+
+// FNV-1a over the MAC, so neighbouring addresses spread out
+static uint32_t macHash(const uint8_t mac[6]) {
+  uint32_t hash = 2166136261u;
+  for (int i = 0; i < 6; i++) {
+    hash ^= mac[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+uint32_t rolloutOffset(const uint8_t mac[6], int boardId, uint32_t windowS,
+                       uint32_t slotS) {
+  if (slotS == 0)
+    slotS = 1;
+  uint32_t slotCount = windowS / slotS;
+  if (slotCount == 0)
+    slotCount = 1;
+
+  uint32_t hash = macHash(mac);
+  uint32_t slot = (boardId > 0) ? (uint32_t)(boardId - 1) % slotCount
+                                : hash % slotCount;
+  uint32_t jitterRange = slotS / 4;
+  uint32_t jitter = jitterRange ? (hash >> 8) % jitterRange : 0;
+  return slot * slotS + jitter;
+}
+
+RolloutScheduler::RolloutScheduler() { cancel(); }
+
+void RolloutScheduler::schedule(const char *version, uint32_t offsetS,
+                                uint32_t startEpoch, uint32_t nowEpoch,
+                                uint32_t nowMs, bool force) {
+  strncpy(_version, version, sizeof(_version) - 1);
+  _version[sizeof(_version) - 1] = '\0';
+
+  uint32_t delayS = offsetS;
+  if (startEpoch != 0 && nowEpoch != 0) {
+    // Absolute start: a board that hears the command late (e.g. a retained
+    // message after a reboot) keeps its original slot
+    uint32_t due = startEpoch + offsetS;
+    delayS = (due > nowEpoch) ? due - nowEpoch : 0;
+  }
+
+  _scheduledMs = nowMs;
+  _delayMs = delayS * 1000;
+  _force = force;
+  _state = ROLLOUT_WAITING;
+}
+
+void RolloutScheduler::cancel() {
+  _state = ROLLOUT_NONE;
+  _version[0] = '\0';
+  _scheduledMs = 0;
+  _delayMs = 0;
+  _force = false;
+}
+
+bool RolloutScheduler::poll(uint32_t nowMs, bool idle) {
+  if (_state != ROLLOUT_WAITING && _state != ROLLOUT_DEFERRED)
+    return false;
+  if (nowMs - _scheduledMs < _delayMs)
+    return false;
+
+  if (!idle && !_force) {
+    _state = ROLLOUT_DEFERRED;
+    return false;
+  }
+  _state = ROLLOUT_DUE;
+  return true;
+}
+
+uint32_t RolloutScheduler::secondsUntilDue(uint32_t nowMs) const {
+  if (_state != ROLLOUT_WAITING)
+    return 0;
+  uint32_t elapsed = nowMs - _scheduledMs;
+  return (elapsed < _delayMs) ? (_delayMs - elapsed + 999) / 1000 : 0;
+}
+
+const char *RolloutScheduler::stateName(RolloutState state) {
+  switch (state) {
+  case ROLLOUT_NONE:
+    return "none";
+  case ROLLOUT_WAITING:
+    return "scheduled";
+  case ROLLOUT_DEFERRED:
+    return "deferred";
+  case ROLLOUT_DUE:
+    return "started";
+  default:
+    return "";
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef ROLLOUT_SCHEDULER_H
+#define ROLLOUT_SCHEDULER_H
+
+#include <stdint.h>
+
+// --- Rollout Defaults ---
+// Used when the broadcast command does not carry window_s / slot_s
+static const uint32_t ROLLOUT_DEFAULT_WINDOW_S = 1800;
+static const uint32_t ROLLOUT_DEFAULT_SLOT_S = 60;
+
+enum RolloutState : uint8_t {
+  ROLLOUT_NONE,
+  ROLLOUT_WAITING,  // Slot not reached yet
+  ROLLOUT_DEFERRED, // Slot reached but the device is busy
+  ROLLOUT_DUE,      // Slot reached and idle (or forced): start the update
+};
+
+// Start offset of a board within a rollout window, in seconds.
+//
+// The window is split into slots of slotS seconds. Boards take the slot of
+// their board_id (ids are unique within a yard, so up to windowS / slotS
+// boards never share a slot); boards without an id fall back to a hash of
+// the MAC. A MAC-derived jitter within the first quarter of the slot keeps
+// boards that do collide from starting on the same second.
+uint32_t rolloutOffset(const uint8_t mac[6], int boardId, uint32_t windowS,
+                       uint32_t slotS);
+
+// Tracks one pending rollout on a board. Pure logic with no Arduino
+// dependencies, so whole fleets can be simulated on the host.
+class RolloutScheduler {
+public:
+  RolloutScheduler();
+
+  // Schedule the update offsetS seconds after the rollout start. startEpoch
+  // and nowEpoch are Unix times; with startEpoch or nowEpoch 0 (no NTP yet)
+  // the offset counts from now.
+  void schedule(const char *version, uint32_t offsetS, uint32_t startEpoch,
+                uint32_t nowEpoch, uint32_t nowMs, bool force);
+
+  void cancel();
+
+  // Advance the schedule. idle reports whether the device can be
+  // interrupted right now; returns true once when the update should start.
+  bool poll(uint32_t nowMs, bool idle);
+
+  RolloutState state() const { return _state; }
+  const char *version() const { return _version; }
+  bool isForced() const { return _force; }
+
+  // Seconds until the slot (0 once reached)
+  uint32_t secondsUntilDue(uint32_t nowMs) const;
+
+  static const char *stateName(RolloutState state);
+
+private:
+  RolloutState _state;
+  char _version[24];
+  uint32_t _scheduledMs;
+  uint32_t _delayMs;
+  bool _force;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#include "StallDetector.h"
+#include <string.h>
+
+StallDetector::StallDetector() : _count(0) {
+  memset(_sections, 0, sizeof(_sections));
+}
+
+int StallDetector::add(const char *name, uint32_t timeoutMs) {
+  if (_count == SUPERVISOR_MAX_SECTIONS)
+    return -1;
+  Section &s = _sections[_count];
+  strncpy(s.name, name, SUPERVISOR_NAME_LEN - 1);
+  s.timeoutMs = timeoutMs;
+  return _count++;
+}
+
+void StallDetector::progress(int section, uint32_t nowMs) {
+  if (section < 0)
+    return;
+  Section &s = _sections[section];
+  s.lastMs = nowMs;
+  s.armed = true;
+}
+
+void StallDetector::enter(int section, uint32_t nowMs) {
+  if (section < 0)
+    return;
+  Section &s = _sections[section];
+  s.enteredMs = nowMs;
+  s.busy = true;
+}
+
+void StallDetector::leave(int section) {
+  if (section >= 0)
+    _sections[section].busy = false;
+}
+
+uint32_t StallDetector::ageMs(int section, uint32_t nowMs) const {
+  const Section &s = _sections[section];
+  return s.armed ? nowMs - s.lastMs : 0;
+}
+
+uint32_t StallDetector::busyMs(int section, uint32_t nowMs) const {
+  const Section &s = _sections[section];
+  return s.busy ? nowMs - s.enteredMs : 0;
+}
+
+bool StallDetector::check(uint32_t nowMs, StallInfo &worst) const {
+  worst.section = -1;
+  worst.name[0] = '\0';
+  worst.stalledMs = 0;
+  worst.busy = false;
+  worst.inside[0] = '\0';
+
+  for (int i = 0; i < _count; i++) {
+    const Section &s = _sections[i];
+    // A scoped section is judged by its scope while inside one
+    bool busy = s.busy;
+    uint32_t ms = busy ? busyMs(i, nowMs) : ageMs(i, nowMs);
+    if (ms <= s.timeoutMs || ms <= worst.stalledMs)
+      continue;
+    worst.section = i;
+    memcpy(worst.name, s.name, SUPERVISOR_NAME_LEN);
+    worst.stalledMs = ms;
+    worst.busy = busy;
+  }
+  if (worst.section < 0)
+    return true;
+
+  // A loop that stopped reporting is probably stuck in a scope it entered
+  // after its last report, even one that is not overdue yet
+  if (!worst.busy) {
+    uint32_t longest = 0;
+    for (int i = 0; i < _count; i++) {
+      uint32_t ms = busyMs(i, nowMs);
+      if (i == worst.section || !_sections[i].busy || ms > worst.stalledMs ||
+          ms <= longest)
+        continue;
+      longest = ms;
+      memcpy(worst.inside, _sections[i].name, SUPERVISOR_NAME_LEN);
+    }
+  }
+  return false;
+}
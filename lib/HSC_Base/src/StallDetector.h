@@ -0,0 +1,70 @@
+#ifndef STALL_DETECTOR_H
+#define STALL_DETECTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Stall Detector Limits ---
+static const int SUPERVISOR_MAX_SECTIONS = 6;
+static const size_t SUPERVISOR_NAME_LEN = 16;
+
+// The worst overdue section
+struct StallInfo {
+  int section; // -1 if none
+  char name[SUPERVISOR_NAME_LEN];
+  uint32_t stalledMs; // Since the last progress, or inside a scope
+  bool busy;          // Stuck inside a scope rather than not reporting
+  // A section entered since the stalled one last reported and still busy,
+  // i.e. where a loop is most likely stuck; empty if none
+  char inside[SUPERVISOR_NAME_LEN];
+};
+
+// Tracks whether each part of the firmware is still making progress.
+//
+// A section is reported with progress() on every pass of its loop, and/or
+// wrapped in enter()/leave() around work that must finish in time (e.g. a
+// web handler that blocks on a server). It is stalled when it has not
+// reported progress for longer than its timeout, or has been inside a scope
+// that long. Progress only counts from the first report, so slow start-up
+// is not a stall and a section used only with scopes may be idle for any
+// time. Pure logic: sections are updated from any task with single 32-bit
+// stores, and the clock is passed in, so stalls can be injected on the host.
+class StallDetector {
+public:
+  StallDetector();
+
+  // Register a section; returns its id, or -1 when full
+  int add(const char *name, uint32_t timeoutMs);
+
+  void progress(int section, uint32_t nowMs);
+  void enter(int section, uint32_t nowMs);
+  void leave(int section);
+
+  // True if no section is stalled; otherwise worst has the longest stall
+  bool check(uint32_t nowMs, StallInfo &worst) const;
+
+  int count() const { return _count; }
+  const char *name(int section) const { return _sections[section].name; }
+  uint32_t timeoutMs(int section) const {
+    return _sections[section].timeoutMs;
+  }
+  // Time since the last report, 0 before the first
+  uint32_t ageMs(int section, uint32_t nowMs) const;
+  // Time inside the current scope, 0 outside
+  uint32_t busyMs(int section, uint32_t nowMs) const;
+
+private:
+  struct Section {
+    char name[SUPERVISOR_NAME_LEN];
+    uint32_t timeoutMs;
+    volatile uint32_t lastMs;
+    volatile uint32_t enteredMs;
+    volatile bool armed;
+    volatile bool busy;
+  };
+
+  Section _sections[SUPERVISOR_MAX_SECTIONS];
+  int _count;
+};
+
+#endif
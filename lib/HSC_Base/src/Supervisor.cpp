@@ -0,0 +1,133 @@
+#include "Supervisor.h"
+#include "EventRecord.h"
+#include <Arduino.h>
+#include <esp_attr.h>
+#include <esp_system.h>
+#include <esp_task_wdt.h>
+#include <freertos/task.h>
+#include <string.h>
+
+// Survives the watchdog reset (not a power cycle); the CRC tells a record
+// from whatever RAM held at power-up
+struct RtcStall {
+  uint32_t magic;
+  int32_t sectionId;
+  char section[SUPERVISOR_NAME_LEN];
+  char inside[SUPERVISOR_NAME_LEN];
+  uint32_t stalledMs;
+  uint32_t uptimeMs;
+  uint32_t busy;
+  uint32_t crc;
+};
+static const uint32_t RTC_STALL_MAGIC = 0x57A11ED0;
+static RTC_NOINIT_ATTR RtcStall rtcStall;
+
+static uint32_t rtcStallCrc() {
+  return eventCrc32((const uint8_t *)&rtcStall, offsetof(RtcStall, crc));
+}
+
+Supervisor::Supervisor()
+    : _mux(portMUX_INITIALIZER_UNLOCKED), _stalled(false), _newStall(false),
+      _stalls(0) {
+  memset(&_last, 0, sizeof(_last));
+}
+
+void Supervisor::begin() {
+  if (rtcStall.magic == RTC_STALL_MAGIC && rtcStall.crc == rtcStallCrc()) {
+    _last.valid = true;
+    _last.sectionId = rtcStall.sectionId;
+    memcpy(_last.section, rtcStall.section, SUPERVISOR_NAME_LEN);
+    _last.section[SUPERVISOR_NAME_LEN - 1] = '\0';
+    memcpy(_last.inside, rtcStall.inside, SUPERVISOR_NAME_LEN);
+    _last.inside[SUPERVISOR_NAME_LEN - 1] = '\0';
+    _last.stalledMs = rtcStall.stalledMs;
+    _last.uptimeMs = rtcStall.uptimeMs;
+    _last.busy = rtcStall.busy;
+    _last.beforeReset = true;
+    _last.resetReason = esp_reset_reason();
+    _newStall = true;
+    Serial.printf("Supervisor: %s stalled for %u ms before reset %d\n",
+                  _last.section, _last.stalledMs, _last.resetReason);
+  }
+  rtcStall.magic = 0;
+
+  // Reconfigures the watchdog if the framework already started it
+  esp_task_wdt_init(SUPERVISOR_WDT_TIMEOUT_S, true);
+  if (xTaskCreate(task, "supervisor", SUPERVISOR_TASK_STACK, this,
+                  SUPERVISOR_TASK_PRIORITY, nullptr) != pdPASS)
+    Serial.println("Supervisor: could not start task");
+}
+
+void Supervisor::progress(int section) {
+  _detector.progress(section, millis());
+}
+
+void Supervisor::enter(int section) { _detector.enter(section, millis()); }
+
+void Supervisor::leave(int section) { _detector.leave(section); }
+
+void Supervisor::task(void *arg) {
+  Supervisor *self = (Supervisor *)arg;
+  esp_task_wdt_add(nullptr);
+  for (;;) {
+    self->check();
+    vTaskDelay(pdMS_TO_TICKS(SUPERVISOR_CHECK_MS));
+  }
+}
+
+void Supervisor::check() {
+  uint32_t now = millis();
+  StallInfo worst;
+  if (_detector.check(now, worst)) {
+    esp_task_wdt_reset();
+    if (_stalled) {
+      // Recovered before the watchdog fired: report it, forget the record
+      _stalled = false;
+      rtcStall.magic = 0;
+      _newStall = true;
+      Serial.printf("Supervisor: %s recovered after %u ms\n", _last.section,
+                    _last.stalledMs);
+    }
+    return;
+  }
+
+  // Not fed: unless the section recovers, the watchdog resets the board.
+  // Keep the record current so it holds the full stall.
+  if (!_stalled)
+    _stalls++;
+  _stalled = true;
+  rtcStall.sectionId = worst.section;
+  memcpy(rtcStall.section, worst.name, SUPERVISOR_NAME_LEN);
+  memcpy(rtcStall.inside, worst.inside, SUPERVISOR_NAME_LEN);
+  rtcStall.stalledMs = worst.stalledMs;
+  rtcStall.uptimeMs = now;
+  rtcStall.busy = worst.busy;
+  rtcStall.magic = RTC_STALL_MAGIC;
+  rtcStall.crc = rtcStallCrc();
+
+  portENTER_CRITICAL(&_mux);
+  _last.valid = true;
+  _last.sectionId = worst.section;
+  memcpy(_last.section, worst.name, SUPERVISOR_NAME_LEN);
+  memcpy(_last.inside, worst.inside, SUPERVISOR_NAME_LEN);
+  _last.stalledMs = worst.stalledMs;
+  _last.uptimeMs = now;
+  _last.busy = worst.busy;
+  _last.beforeReset = false;
+  _last.resetReason = 0;
+  portEXIT_CRITICAL(&_mux);
+}
+
+StallReport Supervisor::lastStall() const {
+  portENTER_CRITICAL(&_mux);
+  StallReport report = _last;
+  portEXIT_CRITICAL(&_mux);
+  return report;
+}
+
+bool Supervisor::takeNewStall() {
+  if (!_newStall)
+    return false;
+  _newStall = false;
+  return true;
+}
@@ -0,0 +1,89 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include "StallDetector.h"
+#include <freertos/FreeRTOS.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Supervisor Tuning ---
+// The task watchdog resets the chip this long after the last feed, i.e.
+// after a section has been stalled for its own timeout plus this
+static const uint32_t SUPERVISOR_WDT_TIMEOUT_S = 8;
+// How often the supervisor task checks the sections and feeds
+static const uint32_t SUPERVISOR_CHECK_MS = 250;
+static const uint32_t SUPERVISOR_TASK_STACK = 2048;
+// Above the loop and the network tasks, so a busy one cannot starve it
+static const UBaseType_t SUPERVISOR_TASK_PRIORITY = 5;
+// Sections added by HSC_Base. The web one stays under the watchdog timeout:
+// AsyncTCP subscribes its task to the watchdog while it runs a handler, so
+// a longer hang resets the board before it could be recorded.
+static const uint32_t SUPERVISOR_NETWORK_TIMEOUT_MS = 5000;
+static const uint32_t SUPERVISOR_WEB_TIMEOUT_MS = 5000;
+
+// A stall as recorded, possibly before the last reboot
+struct StallReport {
+  bool valid;
+  int sectionId;
+  char section[SUPERVISOR_NAME_LEN];
+  char inside[SUPERVISOR_NAME_LEN];
+  uint32_t stalledMs;
+  uint32_t uptimeMs; // When it was last seen
+  bool busy;
+  bool beforeReset; // Recorded before the last reboot
+  int resetReason;  // esp_reset_reason() of that reboot
+};
+
+// Feeds the task watchdog from its own task, but only while no section is
+// stalled, so a hang in any supervised path resets the board. The worst
+// stall is kept in RTC memory that survives the reset, and reported after
+// the reboot.
+class Supervisor {
+public:
+  Supervisor();
+
+  // Start the watchdog and the supervisor task, and pick up a stall
+  // recorded before the reset
+  void begin();
+
+  int addSection(const char *name, uint32_t timeoutMs) {
+    return _detector.add(name, timeoutMs);
+  }
+  void progress(int section);
+  void enter(int section);
+  void leave(int section);
+
+  // Marks a section busy for the lifetime of the object
+  class Scope {
+  public:
+    Scope(Supervisor &supervisor, int section)
+        : _supervisor(supervisor), _section(section) {
+      _supervisor.enter(_section);
+    }
+    ~Scope() { _supervisor.leave(_section); }
+
+  private:
+    Supervisor &_supervisor;
+    int _section;
+  };
+
+  const StallDetector &detector() const { return _detector; }
+  // The last stall: from before the reboot, or a later one that recovered
+  StallReport lastStall() const;
+  // True once per new stall report, to publish it
+  bool takeNewStall();
+  uint32_t stallCount() const { return _stalls; }
+
+private:
+  StallDetector _detector;
+  StallReport _last;
+  mutable portMUX_TYPE _mux;
+  volatile bool _stalled;
+  volatile bool _newStall;
+  volatile uint32_t _stalls;
+
+  static void task(void *arg);
+  void check();
+};
+
+#endif
@@ -1,14 +1,8 @@
-#ifndef CONFIG_H
-#define CONFIG_H
+#ifndef HSC_CONFIG_H
+#define HSC_CONFIG_H
 
-// --- General Configuration ---
-static const char FW_VERSION[] = "0.2.0"; // Base Template
-
-// --- Board Type ---
-// Override these in your project's src/config.h
-static const char BOARD_TYPE_DESC[] =
-    "HSC Base Device";                         // Full description for web UI
-static const char BOARD_TYPE_SHORT[] = "BASE"; // Short name for MQTT topics
+// Board type, firmware version and pins come from the application's
+// DeviceProfile (see DeviceProfile.h)
 
 // --- WiFi Configuration ---
 static const char *WIFI_SSID = "LocoNet";
@@ -19,6 +13,45 @@ static const char *MQTT_SERVER = "mqtt.internal";
 static const int MQTT_PORT = 1883;
 static const char *MQTT_USER = "";     // Leave empty if not needed
 static const char *MQTT_PASSWORD = ""; // Leave empty if not needed
+// Fallback brokers tried in order when the server above is down:
+// "host[:port],host[:port]" (port defaults to MQTT_PORT)
+static const char *MQTT_FALLBACK = "";
+// Let the broker keep subscriptions across reconnects, so a reconnect only
+// resends retained state that changed
+static const bool MQTT_PERSISTENT_SESSION = true;
+
+// --- Time Configuration ---
+// SNTP server; a local one keeps the boards of a layout closely in step.
+// pool.ntp.org stays as the fallback.
+static const char *NTP_SERVER = "pool.ntp.org";
+// POSIX TZ for local time in the web UI, e.g. "EST5EDT,M3.2.0,M11.1.0"
+static const char *NTP_TZ = "EST5";
+
+// --- Peer Link ---
+// Multicast group and port boards share occupancy on (Config peer_link).
+// Boards that should hear each other must use the same pair.
+static const char *PEER_GROUP = "239.255.72.67";
+static const int PEER_PORT = 47267;
+
+// --- Provisioning ---
+// Key that signs provisioning bundles (see provision.py). Boards flashed
+// with it accept bundles out of the box; it can also be set per board
+// through /api/settings. Empty refuses bundles until a key is set.
+static const char *PROVISION_KEY = "";
+
+// --- Fault Injection ---
+// Adds /api/fault?section=loop|network|web&ms=N, which blocks that path
+// once for N ms to exercise the supervisor, and
+// /api/fault?section=heap&bytes=N, which fragments the heap into holes of
+// N bytes (0 undoes it) to exercise the heap guard. Never enable in
+// production.
+// #define HSC_FAULT_INJECTION
+
+// --- Track Debounce ---
+// Limits of a track's debounce window, set per track or adapted to the
+// measured bounce; a configured 0 means the application default
+static const unsigned long DEBOUNCE_MIN_MS = 10;
+static const unsigned long DEBOUNCE_MAX_MS = 500;
 
 // --- Device Configuration ---
 // CHANGE THIS ID FOR EACH BOARD
@@ -0,0 +1,303 @@
+#!/usr/bin/env python3
+"""Create a delta patch between two firmware images for HSC_Base OTA.
+
+The patch format is described in lib/HSC_Base/src/DeltaPatch.h. Matching
+follows bsdiff: regions of the new image are aligned with the old image and
+stored as byte differences (mostly zero when code only moved), everything
+else is inserted literally.
+
+Usage:
+    mkdelta.py OLD.bin NEW.bin -o PATCH.delta
+    mkdelta.py OLD.bin NEW.bin -o PATCH.delta --from-version 0.2.0 \\
+        --manifest firmware_YARD.json
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import struct
+import sys
+import time
+
+MAGIC = b"HSCD"
+FORMAT_VERSION = 1
+
+OP_END = 0
+OP_COPY = 1
+OP_ADD = 2
+OP_INSERT = 3
+OP_SEEK = 4
+
+BLOCK = 8  # Bytes hashed to find match candidates
+MIN_MATCH = 16  # Exact bytes needed to start a new alignment
+MIN_ZERO_RUN = 4  # Equal bytes worth a COPY instead of zeros inside an ADD
+EXTEND_WINDOW = 256  # Give up extending after this many bytes without gain
+MAX_DELTAS = 3  # Entries kept in a manifest
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value) << 1) - 1
+
+
+def match_length(old, old_pos, new, new_pos):
+    """Length of the exact match between old[old_pos:] and new[new_pos:]."""
+    limit = min(len(old) - old_pos, len(new) - new_pos)
+    length = 0
+    step = 64
+    while length < limit:
+        n = min(step, limit - length)
+        if old[old_pos + length:old_pos + length + n] == \
+                new[new_pos + length:new_pos + length + n]:
+            length += n
+            continue
+        if n == 1:
+            break
+        step = max(1, n // 8)
+    return length
+
+
+def extend_forward(old, new, old_pos, new_pos):
+    """bsdiff-style approximate extension: the end maximising 2*equal - len."""
+    best_len = 0
+    best_score = 0
+    equal = 0
+    i = 0
+    limit = min(len(old) - old_pos, len(new) - new_pos)
+    while i < limit and i - best_len <= EXTEND_WINDOW:
+        run = match_length(old, old_pos + i, new, new_pos + i)
+        if run:
+            equal += run
+            i += run
+            score = 2 * equal - i
+            if score > best_score:
+                best_score = score
+                best_len = i
+        else:
+            i += 1
+    return best_len
+
+
+def extend_backward(old, new, old_pos, new_pos, new_floor):
+    """How far an alignment can be extended back into unmatched bytes."""
+    best_len = 0
+    best_score = 0
+    equal = 0
+    i = 1
+    limit = min(old_pos, new_pos - new_floor)
+    while i <= limit and i - best_len <= EXTEND_WINDOW:
+        if old[old_pos - i] == new[new_pos - i]:
+            equal += 1
+            score = 2 * equal - i
+            if score > best_score:
+                best_score = score
+                best_len = i
+        i += 1
+    return best_len
+
+
+class PatchWriter:
+    def __init__(self, old_size, new_size):
+        self.out = bytearray(MAGIC)
+        self.out += bytes([FORMAT_VERSION, 0, 0, 0])
+        self.out += struct.pack("<II", old_size, new_size)
+        self.src = 0
+
+    def _op(self, op, arg, data=b""):
+        self.out.append(op)
+        self.out += varint(arg)
+        self.out += data
+
+    def insert(self, data):
+        if data:
+            self._op(OP_INSERT, len(data), data)
+
+    def seek(self, position):
+        if position != self.src:
+            self._op(OP_SEEK, zigzag(position - self.src))
+            self.src = position
+
+    def aligned(self, old, new, old_pos, new_start, new_end):
+        """Emit new[new_start:new_end] against old from old_pos."""
+        self.seek(old_pos)
+        pending = bytearray()
+        i = new_start
+        while i < new_end:
+            o = old_pos + (i - new_start)
+            run = min(match_length(old, o, new, i), new_end - i)
+            if run >= MIN_ZERO_RUN:
+                if pending:
+                    self._op(OP_ADD, len(pending), bytes(pending))
+                    pending = bytearray()
+                self._op(OP_COPY, run)
+                i += run
+            elif run:
+                pending += bytes(run)
+                i += run
+            else:
+                pending.append((new[i] - old[o]) & 0xFF)
+                i += 1
+        if pending:
+            self._op(OP_ADD, len(pending), bytes(pending))
+        self.src = old_pos + (new_end - new_start)
+
+    def finish(self):
+        self.out.append(OP_END)
+        return bytes(self.out)
+
+
+def make_delta(old, new):
+    index = {}
+    for i in range(len(old) - BLOCK + 1):
+        index.setdefault(old[i:i + BLOCK], i)
+
+    writer = PatchWriter(len(old), len(new))
+    pos = 0
+    literal_start = 0
+    offset = 0  # Current alignment: old position = new position + offset
+    while pos <= len(new) - BLOCK:
+        best_len = 0
+        best_old = -1
+
+        # Prefer continuing the current alignment, then try the index
+        candidates = [pos + offset]
+        found = index.get(new[pos:pos + BLOCK])
+        if found is not None and found != pos + offset:
+            candidates.append(found)
+        for cand in candidates:
+            if 0 <= cand < len(old):
+                length = match_length(old, cand, new, pos)
+                if length > best_len:
+                    best_len = length
+                    best_old = cand
+
+        if best_len < MIN_MATCH:
+            pos += 1
+            continue
+
+        back = extend_backward(old, new, best_old, pos, literal_start)
+        forward = extend_forward(old, new, best_old, pos)
+        start = pos - back
+        end = pos + max(forward, best_len)
+
+        writer.insert(new[literal_start:start])
+        writer.aligned(old, new, best_old - back, start, end)
+        offset = best_old - pos
+        pos = end
+        literal_start = end
+
+    writer.insert(new[literal_start:])
+    return writer.finish()
+
+
+def apply_delta(old, patch):
+    """Reference applier, used to verify a freshly made patch."""
+    if patch[:4] != MAGIC or patch[4] != FORMAT_VERSION:
+        raise ValueError("not an HSCD patch")
+    old_size, new_size = struct.unpack_from("<II", patch, 8)
+    if old_size != len(old):
+        raise ValueError("patch was made for a different source image")
+    out = bytearray()
+    src = 0
+    i = 16
+    while True:
+        op = patch[i]
+        i += 1
+        if op == OP_END:
+            break
+        arg = 0
+        shift = 0
+        while True:
+            byte = patch[i]
+            i += 1
+            arg |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                break
+        if op == OP_COPY:
+            out += old[src:src + arg]
+            src += arg
+        elif op == OP_ADD:
+            out += bytes((old[src + k] + patch[i + k]) & 0xFF
+                         for k in range(arg))
+            src += arg
+            i += arg
+        elif op == OP_INSERT:
+            out += patch[i:i + arg]
+            i += arg
+        elif op == OP_SEEK:
+            src += (arg >> 1) ^ -(arg & 1)
+        else:
+            raise ValueError("bad opcode %d" % op)
+    if len(out) != new_size:
+        raise ValueError("patch produced %d bytes, expected %d" %
+                         (len(out), new_size))
+    return bytes(out)
+
+
+def update_manifest(path, from_version, old, patch_name, patch):
+    with open(path) as f:
+        manifest = json.load(f)
+    deltas = [d for d in manifest.get("deltas", [])
+              if d.get("from") != from_version]
+    deltas.insert(0, {
+        "from": from_version,
+        "source_size": len(old),
+        "source_sha256": hashlib.sha256(old).hexdigest(),
+        "url": patch_name,
+        "size": len(patch),
+    })
+    manifest["deltas"] = deltas[:MAX_DELTAS]
+    with open(path, "w") as f:
+        json.dump(manifest, f, indent=2)
+        f.write("\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("old", help="image currently running on the devices")
+    parser.add_argument("new", help="new image")
+    parser.add_argument("-o", "--output", required=True, help="patch file")
+    parser.add_argument("--from-version", help="version of the old image")
+    parser.add_argument("--manifest", help="OTA .json to add the delta to")
+    args = parser.parse_args()
+
+    with open(args.old, "rb") as f:
+        old = f.read()
+    with open(args.new, "rb") as f:
+        new = f.read()
+
+    started = time.time()
+    patch = make_delta(old, new)
+    elapsed = time.time() - started
+
+    if apply_delta(old, patch) != new:
+        sys.exit("Error: patch does not reproduce the new image")
+
+    with open(args.output, "wb") as f:
+        f.write(patch)
+    print("Delta %s: %d bytes (%.1f%% of %d), made in %.1fs" %
+          (args.output, len(patch), 100.0 * len(patch) / len(new), len(new),
+           elapsed))
+
+    if args.manifest:
+        if not args.from_version:
+            sys.exit("Error: --manifest needs --from-version")
+        update_manifest(args.manifest, args.from_version, old,
+                        os.path.basename(args.output), patch)
+
+
+if __name__ == "__main__":
+    main()
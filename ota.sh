@@ -78,12 +78,61 @@ echo "OTA Artifacts prepared:"
 JSON_NAME="firmware_${BOARD_NAME}.json"
 CURRENT_DATE=$(date "+%Y-%m-%d %H:%M:%S")
 
-cat <<EOF > "$JSON_NAME"
+# The device checks these digests before making the new image bootable
+sha256_of() {
+    if command -v sha256sum >/dev/null 2>&1; then
+        sha256sum "$1" | awk '{print $1}'
+    else
+        shasum -a 256 "$1" | awk '{print $1}'
+    fi
+}
+
+FW_SHA256=$(sha256_of "$FW_NAME")
+FW_SIZE=$(wc -c < "$FW_NAME" | tr -d ' ')
+
+if [ -f "$FS_NAME" ]; then
+    FS_SHA256=$(sha256_of "$FS_NAME")
+    FS_SIZE=$(wc -c < "$FS_NAME" | tr -d ' ')
+    cat <<EOF > "$JSON_NAME"
 {
   "version": "$VERSION",
   "notes": "Build created on $CURRENT_DATE",
-  "update_spiffs": true
+  "sha256": "$FW_SHA256",
+  "size": $FW_SIZE,
+  "update_spiffs": true,
+  "spiffs_sha256": "$FS_SHA256",
+  "spiffs_size": $FS_SIZE
 }
 EOF
+else
+    cat <<EOF > "$JSON_NAME"
+{
+  "version": "$VERSION",
+  "notes": "Build created on $CURRENT_DATE",
+  "sha256": "$FW_SHA256",
+  "size": $FW_SIZE,
+  "update_spiffs": false
+}
+EOF
+fi
+
+# Keep each release's image so later builds can ship deltas against it.
+# Devices running one of the last few releases download only the patch.
+RELEASE_DIR="releases/${BOARD_NAME}"
+mkdir -p "$RELEASE_DIR"
+for OLD in $(ls -t "$RELEASE_DIR"/*.bin 2>/dev/null | head -n 3); do
+    OLD_VERSION=$(basename "$OLD" .bin)
+    if [ "$OLD_VERSION" = "$VERSION" ]; then
+        continue
+    fi
+    DELTA_NAME="firmware_${BOARD_NAME}_from_${OLD_VERSION}.delta"
+    python3 mkdelta.py "$OLD" "$FW_NAME" -o "$DELTA_NAME" \
+        --from-version "$OLD_VERSION" --manifest "$JSON_NAME"
+    if [ $? -ne 0 ]; then
+        echo "Warning: could not create $DELTA_NAME, devices will use the full image"
+        rm -f "$DELTA_NAME"
+    fi
+done
+cp "$FW_NAME" "$RELEASE_DIR/$VERSION.bin"
 
-ls -l "$FW_NAME" "$FS_NAME" "$JSON_NAME" 2>/dev/null
+ls -l "$FW_NAME" "$FS_NAME" "$JSON_NAME" firmware_${BOARD_NAME}_from_*.delta 2>/dev/null
@@ -0,0 +1,258 @@
+#!/usr/bin/env python3
+"""Update server stand-in for testing OTA on an HSC_Base board.
+
+Serves the files ota.sh leaves behind (firmware_<board>.bin, .json,
+.spiffs.bin and .delta) over HTTP/1.1 keep-alive with Range and ETag
+support, like the real update server, and breaks image downloads on
+purpose so the board's resume path is exercised.
+
+Usage:
+    otaserver.py --dir . --drop-every 65536
+    otaserver.py --dir . --drop-every 65536 --board 192.168.1.50
+    otaserver.py --dir . --stall-after 200000 --board 192.168.1.50
+    otaserver.py --dir . --corrupt 4096 --board 192.168.1.50
+
+Point the board's update_url at this host, e.g.
+http://192.168.1.10:8080/firmware_%BOARD_TYPE%.bin. Faults only apply to
+images (.bin, .delta); metadata is always served intact:
+
+--drop-every N    close the connection after every N bytes of image body,
+                  so the board has to resume with a Range request
+--drops K         stop dropping after K drops (default: no limit)
+--stall-after N   stop sending after N bytes of the first image response
+                  and hold the connection until the board gives up on it
+--ignore-range    answer Range requests with the whole image (200)
+--corrupt OFFSET  flip the byte at OFFSET of every image, which the board
+                  must refuse on the digest
+
+With --board, it starts the update through /api/update and follows
+/api/update/status until it ends. The run passes if the update succeeds
+(after at least one resume when connections were dropped or stalled) or,
+with --corrupt, if it fails; the exit status says which.
+"""
+
+import argparse
+import json
+import os
+import re
+import socket
+import sys
+import threading
+import time
+import urllib.error
+import urllib.request
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+IMAGE_SUFFIXES = (".bin", ".delta")
+CHUNK = 4096
+TIMEOUT_S = 10
+
+
+class Faults:
+    def __init__(self, args):
+        self.drop_every = args.drop_every
+        self.drops_left = args.drops
+        self.stall_after = args.stall_after
+        self.ignore_range = args.ignore_range
+        self.corrupt = args.corrupt
+        self.stall_s = args.stall_s
+        self.lock = threading.Lock()
+        self.counts = {"requests": 0, "ranges": 0, "drops": 0, "stalls": 0,
+                       "not_modified": 0, "bytes": 0}
+
+    def count(self, key, n=1):
+        with self.lock:
+            self.counts[key] += n
+
+    # Bytes of a response of length after which it is cut, or None
+    def cut_at(self, length):
+        with self.lock:
+            if self.stall_after is not None and self.counts["stalls"] == 0 \
+                    and self.stall_after < length:
+                self.counts["stalls"] += 1
+                return self.stall_after, True
+            if self.drop_every and self.drops_left != 0 and \
+                    self.drop_every < length:
+                if self.drops_left:
+                    self.drops_left -= 1
+                self.counts["drops"] += 1
+                return self.drop_every, False
+        return None, False
+
+
+def make_handler(root, faults):
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def log_message(self, fmt, *args):
+            sys.stderr.write(f"{self.address_string()} {fmt % args}\n")
+
+        def do_GET(self):
+            faults.count("requests")
+            name = os.path.basename(self.path.split("?")[0])
+            path = os.path.join(root, name)
+            if not name or not os.path.isfile(path):
+                self.reply(404, b"not found")
+                return
+
+            with open(path, "rb") as f:
+                data = bytearray(f.read())
+            st = os.stat(path)
+            etag = '"%x-%x"' % (st.st_size, int(st.st_mtime))
+            if self.headers.get("If-None-Match") == etag:
+                faults.count("not_modified")
+                self.send_response(304)
+                self.send_header("ETag", etag)
+                self.send_header("Content-Length", "0")
+                self.end_headers()
+                return
+
+            image = name.endswith(IMAGE_SUFFIXES)
+            if image and faults.corrupt is not None and \
+                    faults.corrupt < len(data):
+                data[faults.corrupt] ^= 0xFF
+
+            start = 0
+            m = re.match(r"bytes=(\d+)-$", self.headers.get("Range", ""))
+            if m and not (image and faults.ignore_range):
+                faults.count("ranges")
+                start = int(m.group(1))
+                if start >= len(data):
+                    self.reply(416, b"range not satisfiable")
+                    return
+                self.send_response(206)
+                self.send_header("Content-Range",
+                                 f"bytes {start}-{len(data) - 1}/{len(data)}")
+            else:
+                self.send_response(200)
+            self.send_header("Content-Length", str(len(data) - start))
+            self.send_header("Content-Type", "application/json"
+                             if name.endswith(".json")
+                             else "application/octet-stream")
+            self.send_header("ETag", etag)
+            self.end_headers()
+
+            cut, stall = faults.cut_at(len(data) - start) if image \
+                else (None, False)
+            end = len(data) if cut is None else start + cut
+            pos = start
+            while pos < end:
+                n = min(CHUNK, end - pos)
+                self.wfile.write(data[pos:pos + n])
+                pos += n
+                faults.count("bytes", n)
+            if pos < len(data):
+                self.cut(pos, len(data), stall)
+
+        def cut(self, pos, total, stall):
+            self.wfile.flush()
+            if stall:
+                self.log_message("stalling at %d/%d for %d s", pos, total,
+                                 faults.stall_s)
+                time.sleep(faults.stall_s)
+            else:
+                self.log_message("dropping at %d/%d", pos, total)
+            self.close_connection = True
+            try:
+                self.connection.shutdown(socket.SHUT_RDWR)
+            except OSError:
+                pass
+
+        def reply(self, code, body):
+            self.send_response(code)
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+    return Handler
+
+
+def board_request(base, path, method="GET"):
+    req = urllib.request.Request(base + path, method=method)
+    with urllib.request.urlopen(req, timeout=TIMEOUT_S) as resp:
+        return json.loads(resp.read())
+
+
+# Start the update and follow it; returns the last status seen
+def drive_board(host, timeout_s):
+    base = "http://" + host
+    try:
+        board_request(base, "/api/update", "POST")
+    except urllib.error.HTTPError as e:
+        sys.exit(f"/api/update refused: {e.code}")
+    except OSError as e:
+        sys.exit(f"{host}: {e}")
+
+    last = {}
+    end = time.monotonic() + timeout_s
+    while time.monotonic() < end:
+        time.sleep(1)
+        try:
+            st = board_request(base, "/api/update/status")
+        except (OSError, ValueError):
+            if last.get("state") == "success":
+                break  # Rebooting into the new image
+            print("status unavailable")
+            continue
+        last = st
+        print(f"{st['state']:11} {st['stage']:8} {st['percent']:3}% "
+              f"{st['written']}/{st['total']} resumes {st['resumes']}"
+              f"{' delta' if st.get('delta') else ''}")
+        if st["state"] in ("success", "failed"):
+            break
+    return last
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--dir", default=".",
+                        help="directory with the ota.sh artifacts")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--drop-every", type=int, metavar="N")
+    parser.add_argument("--drops", type=int, default=-1, metavar="K")
+    parser.add_argument("--stall-after", type=int, metavar="N")
+    parser.add_argument("--stall-s", type=int, default=15,
+                        help="how long a stall holds the connection")
+    parser.add_argument("--ignore-range", action="store_true")
+    parser.add_argument("--corrupt", type=int, metavar="OFFSET")
+    parser.add_argument("--board", metavar="HOST",
+                        help="start the update on this board and check it")
+    parser.add_argument("--timeout", type=float, default=600,
+                        help="seconds to wait for the board's update")
+    args = parser.parse_args()
+
+    faults = Faults(args)
+    server = ThreadingHTTPServer(("", args.port),
+                                 make_handler(args.dir, faults))
+    server.daemon_threads = True
+    print(f"serving {os.path.abspath(args.dir)} on port {args.port}")
+
+    if not args.board:
+        try:
+            server.serve_forever()
+        except KeyboardInterrupt:
+            pass
+        print(faults.counts)
+        return
+
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    st = drive_board(args.board, args.timeout)
+    server.shutdown()
+    print(f"server: {faults.counts}")
+
+    interrupted = faults.counts["drops"] or faults.counts["stalls"]
+    if args.corrupt is not None:
+        ok = st.get("state") == "failed"
+        expected = "refused"
+    else:
+        ok = st.get("state") == "success" and \
+            (not interrupted or st.get("resumes", 0) > 0)
+        expected = "resumed and installed" if interrupted else "installed"
+    print(f"{'PASS' if ok else 'FAIL'}: expected the image to be {expected}, "
+          f"board ended {st.get('state', 'unknown')}"
+          f"{': ' + st['message'] if st.get('message') else ''}")
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
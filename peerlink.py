@@ -0,0 +1,219 @@
+#!/usr/bin/env python3
+"""Host-side stand-in for the HSC_Base peer link.
+
+Speaks the occupancy frames from lib/HSC_Base/src/PeerTable.h over UDP
+multicast, so the link can be exercised without a second board, and
+compares it with the MQTT broker path.
+
+Usage:
+    peerlink.py listen
+    peerlink.py send --board 9 --tracks 8 --interval 2
+    peerlink.py compare --broker mqtt.internal [--prefix HSC/yard]
+
+listen   prints every frame with its one-way latency (needs the host clock
+         on the same NTP server as the boards).
+send     acts as board --board: heartbeats every second and toggles a random
+         track every --interval seconds, with the repeat a board sends.
+compare  needs paho-mqtt. For every track change seen on both the peer link
+         and the <prefix>/track/N/section/B/event topic, prints how much
+         later the broker delivered it. Both arrival times are taken on this
+         host, so no clock sync is needed.
+"""
+
+import argparse
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+
+GROUP = "239.255.72.67"  # PEER_GROUP in lib/HSC_Base/src/config.h
+PORT = 47267  # PEER_PORT
+MAGIC = b"HP"
+VERSION = 1
+FRAME = struct.Struct("<2sBBHHIQq")  # PEER_FRAME_SIZE = 28
+HEARTBEAT_S = 1.0
+REPEAT_S = 0.03
+
+
+def now_us():
+    return time.time_ns() // 1000
+
+
+def decode(data):
+    if len(data) != FRAME.size:
+        return None
+    magic, version, count, board, epoch, seq, mask, sent = FRAME.unpack(data)
+    if magic != MAGIC or version != VERSION or count > 64:
+        return None
+    return dict(board=board, epoch=epoch, seq=seq, count=count, mask=mask,
+                sent=sent)
+
+
+def encode(board, epoch, seq, count, mask):
+    return FRAME.pack(MAGIC, VERSION, count, board, epoch, seq, mask,
+                      now_us())
+
+
+def open_socket(group, port):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM,
+                         socket.IPPROTO_UDP)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind(("", port))
+    mreq = struct.pack("4s4s", socket.inet_aton(group),
+                       socket.inet_aton("0.0.0.0"))
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, mreq)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 1)
+    return sock
+
+
+class Changes:
+    """Turns frames into per-track changes, dropping repeats."""
+
+    def __init__(self):
+        self.last = {}
+
+    def apply(self, frame):
+        prev = self.last.get(frame["board"])
+        if prev and prev["epoch"] == frame["epoch"]:
+            ahead = (frame["seq"] - prev["seq"]) & 0xFFFFFFFF
+            if ahead == 0 or ahead >= 0x80000000:
+                return []
+            old = prev["mask"]
+        else:
+            old = None
+        self.last[frame["board"]] = frame
+        if old is None:
+            return []
+        changed = old ^ frame["mask"]
+        return [(frame["board"], i + 1, bool(frame["mask"] >> i & 1))
+                for i in range(frame["count"]) if changed >> i & 1]
+
+
+def listen(args):
+    sock = open_socket(args.group, args.port)
+    changes = Changes()
+    while True:
+        data, addr = sock.recvfrom(64)
+        frame = decode(data)
+        if not frame:
+            print(f"{addr[0]}: not a peer frame ({len(data)} bytes)")
+            continue
+        latency = ""
+        if frame["sent"]:
+            latency = f" latency {(now_us() - frame['sent']) / 1000:.1f} ms"
+        print(f"{addr[0]} board {frame['board']} seq {frame['seq']} "
+              f"tracks {frame['count']} mask {frame['mask']:x}{latency}")
+        for board, track, occupied in changes.apply(frame):
+            print(f"  track {track} {'OCCUPIED' if occupied else 'FREE'}")
+
+
+def send(args):
+    sock = open_socket(args.group, args.port)
+    epoch = random.getrandbits(16)
+    seq = 0
+    mask = 0
+    next_toggle = time.monotonic() + args.interval
+    while True:
+        seq = (seq + 1) & 0xFFFFFFFF
+        frame = encode(args.board, epoch, seq, args.tracks, mask)
+        sock.sendto(frame, (args.group, args.port))
+        if time.monotonic() >= next_toggle:
+            mask ^= 1 << random.randrange(args.tracks)
+            next_toggle += args.interval
+            seq = (seq + 1) & 0xFFFFFFFF
+            frame = encode(args.board, epoch, seq, args.tracks, mask)
+            sock.sendto(frame, (args.group, args.port))
+            print(f"board {args.board} seq {seq} mask {mask:x}")
+            time.sleep(REPEAT_S)
+            sock.sendto(frame, (args.group, args.port))
+        time.sleep(min(HEARTBEAT_S, max(0, next_toggle - time.monotonic())))
+
+
+def compare(args):
+    try:
+        import paho.mqtt.client as mqtt
+    except ImportError:
+        sys.exit("compare needs paho-mqtt (pip install paho-mqtt)")
+
+    lock = threading.Lock()
+    pending = {}  # (board, track, occupied) -> (path, host arrival in µs)
+    deltas = []
+
+    def seen(key, path):
+        t = now_us()
+        with lock:
+            other = pending.pop(key, None)
+            if other is None or other[0] == path:
+                pending[key] = (path, t)
+                return
+            udp_t, mqtt_t = (other[1], t) if path == "mqtt" else (t, other[1])
+            deltas.append((mqtt_t - udp_t) / 1000)
+            board, track, occupied = key
+            print(f"section {board} track {track} "
+                  f"{'OCCUPIED' if occupied else 'FREE'}: broker "
+                  f"{deltas[-1]:+.1f} ms vs peer link")
+
+    def on_message(client, userdata, msg):
+        parts = msg.topic.split("/")
+        try:
+            track = int(parts[-4])
+            board = int(parts[-2])
+        except (ValueError, IndexError):
+            return
+        occupied = b'"OCCUPIED"' in msg.payload
+        seen((board, track, occupied), "mqtt")
+
+    client = mqtt.Client()
+    client.on_message = on_message
+    client.connect(args.broker, args.mqtt_port)
+    client.subscribe(f"{args.prefix}/track/+/section/+/event", qos=1)
+    client.loop_start()
+
+    sock = open_socket(args.group, args.port)
+    sock.settimeout(1.0)
+    changes = Changes()
+    try:
+        while True:
+            try:
+                data, _ = sock.recvfrom(64)
+            except socket.timeout:
+                continue
+            frame = decode(data)
+            if frame:
+                for key in changes.apply(frame):
+                    seen(key, "udp")
+    except KeyboardInterrupt:
+        pass
+    client.loop_stop()
+
+    if deltas:
+        deltas.sort()
+        n = len(deltas)
+        print(f"{n} changes: broker later by median {deltas[n // 2]:.1f} ms, "
+              f"p95 {deltas[min(n - 1, n * 95 // 100)]:.1f} ms, "
+              f"max {deltas[-1]:.1f} ms")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--group", default=GROUP)
+    parser.add_argument("--port", type=int, default=PORT)
+    sub = parser.add_subparsers(dest="command", required=True)
+    sub.add_parser("listen")
+    p = sub.add_parser("send")
+    p.add_argument("--board", type=int, required=True)
+    p.add_argument("--tracks", type=int, default=8)
+    p.add_argument("--interval", type=float, default=2.0,
+                   help="seconds between track changes")
+    p = sub.add_parser("compare")
+    p.add_argument("--broker", required=True)
+    p.add_argument("--mqtt-port", type=int, default=1883)
+    p.add_argument("--prefix", default="HSC/yard")
+    args = parser.parse_args()
+    {"listen": listen, "send": send, "compare": compare}[args.command](args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+"""Finds HSC_Base boards on the network and provisions them in one go.
+
+Usage:
+    provision.py discover
+    provision.py push yard.json --key-file fleet.key
+    provision.py push yard.json --key-file fleet.key --hosts 192.168.1.50
+
+discover  lists the boards advertising _hsc._tcp over mDNS, with their
+          board type, board_id and firmware (needs python-zeroconf).
+push      signs the settings in the given file and sends them to every
+          board found, or to --hosts. The file holds the settings for all
+          boards and, optionally, per-board ones by MAC address or device
+          id, with the names used by /api/settings:
+
+              {"config": {"ntp_server": "10.0.0.1", "rules": "..."},
+               "boards": {"AA:BB:CC:DD:EE:01": {"board_id": 1},
+                          "yard-ddee02": {"board_id": 2,
+                                          "location": "North"}}}
+
+          With "boards" present, a board not listed refuses the bundle.
+          Boards apply what they can at once and reboot for the rest
+          (WiFi, MQTT, board_id, track pins). The bundle is numbered with
+          the current time, so a board refuses it being sent again.
+
+The key is the board's provision_key. A board without one refuses bundles;
+set it once through /api/settings, after which it only changes through a
+bundle signed with the current key.
+"""
+
+import argparse
+import hashlib
+import hmac
+import json
+import socket
+import sys
+import time
+import urllib.error
+import urllib.request
+
+SERVICE = "_hsc._tcp.local."
+TIMEOUT_S = 10
+
+
+def discover_boards(wait_s):
+    try:
+        from zeroconf import ServiceBrowser, Zeroconf
+    except ImportError:
+        sys.exit("discover needs python-zeroconf (pip install zeroconf), "
+                 "or give the boards with --hosts")
+
+    found = {}
+
+    class Listener:
+        def add_service(self, zc, type_, name):
+            info = zc.get_service_info(type_, name)
+            if not info or not info.addresses:
+                return
+            txt = {k.decode(): (v or b"").decode()
+                   for k, v in info.properties.items()}
+            found[name] = dict(txt, host=socket.inet_ntoa(info.addresses[0]),
+                               name=name.split(".")[0])
+
+        def update_service(self, zc, type_, name):
+            self.add_service(zc, type_, name)
+
+        def remove_service(self, zc, type_, name):
+            pass
+
+    zc = Zeroconf()
+    try:
+        ServiceBrowser(zc, SERVICE, Listener())
+        time.sleep(wait_s)
+    finally:
+        zc.close()
+    return sorted(found.values(), key=lambda b: b["name"])
+
+
+def discover(args):
+    boards = discover_boards(args.wait)
+    for b in boards:
+        print(f"{b['name']:16} {b['host']:15} {b.get('board', '?'):8} "
+              f"id {b.get('board_id', '?'):>3}  fw {b.get('fw', '?'):8} "
+              f"{b.get('mac', '')}  {b.get('location', '')}")
+    print(f"{len(boards)} board(s)")
+
+
+def sign(settings, key, seq):
+    bundle = json.dumps(dict(settings, seq=seq), separators=(",", ":"))
+    digest = hmac.new(key, bundle.encode(), hashlib.sha256).hexdigest()
+    return json.dumps({"bundle": bundle, "hmac": digest}).encode()
+
+
+def post(host, body):
+    req = urllib.request.Request(f"http://{host}/api/provision", data=body,
+                                 headers={"Content-Type": "application/json"},
+                                 method="POST")
+    try:
+        with urllib.request.urlopen(req, timeout=TIMEOUT_S) as resp:
+            return resp.status, json.loads(resp.read())
+    except urllib.error.HTTPError as e:
+        try:
+            return e.code, json.loads(e.read())
+        except ValueError:
+            return e.code, {}
+
+
+def push(args):
+    with open(args.file) as f:
+        settings = json.load(f)
+    unknown = set(settings) - {"config", "boards"}
+    if unknown:
+        sys.exit(f"{args.file}: unknown keys {sorted(unknown)}")
+    with open(args.key_file, "rb") as f:
+        key = f.read().strip()
+
+    seq = args.seq or int(time.time())
+    body = sign(settings, key, seq)
+    if len(body) > 8192:  # PROVISION_MAX_BYTES
+        sys.exit(f"bundle is {len(body)} bytes, boards accept 8192")
+
+    hosts = args.hosts or [b["host"] for b in discover_boards(args.wait)]
+    if not hosts:
+        sys.exit("no boards found")
+
+    failed = 0
+    for host in hosts:
+        try:
+            status, reply = post(host, body)
+        except OSError as e:
+            status, reply = None, {"message": str(e)}
+        if status == 200:
+            action = "rebooting" if reply.get("reboot") else "applied"
+            print(f"{host:15} {action} (seq {reply.get('seq')})")
+        else:
+            failed += 1
+            print(f"{host:15} failed: {status or ''} "
+                  f"{reply.get('message', '')}")
+    print(f"bundle {seq}: {len(hosts) - failed} of {len(hosts)} boards")
+    sys.exit(1 if failed else 0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--wait", type=float, default=3.0,
+                        help="seconds to listen for mDNS announcements")
+    sub = parser.add_subparsers(dest="command", required=True)
+    sub.add_parser("discover")
+    p = sub.add_parser("push")
+    p.add_argument("file")
+    p.add_argument("--key-file", required=True)
+    p.add_argument("--hosts", nargs="+")
+    p.add_argument("--seq", type=int,
+                   help="bundle number (default: current Unix time)")
+    args = parser.parse_args()
+    {"discover": discover, "push": push}[args.command](args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,99 @@
+#include "EdgeCapture.h"
+#include <driver/gpio.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <hal/gpio_ll.h>
+
+EdgeCapture::EdgeCapture()
+    : _pinCount(0), _inputs(0), _task(nullptr),
+      _mux(portMUX_INITIALIZER_UNLOCKED), _anyUs(0) {
+  memset(_firstUs, 0, sizeof(_firstUs));
+}
+
+bool EdgeCapture::begin(const uint8_t *pins, int count) {
+  esp_err_t err = gpio_install_isr_service(0);
+  // Already installed by another driver is fine
+  if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+    Serial.printf("Edge capture: no GPIO interrupts (%d)\n", err);
+    return false;
+  }
+  for (int i = 0; i < count; i++) {
+    if (!attach(pins[i], i))
+      return false;
+  }
+  _inputs = count;
+  return true;
+}
+
+bool EdgeCapture::addWakePin(uint8_t pin) { return attach(pin, -1); }
+
+bool EdgeCapture::attach(uint8_t gpio, int input) {
+  if (_pinCount == EDGE_MAX_PINS)
+    return false;
+  Pin &p = _pins[_pinCount++];
+  p.owner = this;
+  p.gpio = gpio;
+  p.input = input;
+
+  gpio_num_t num = (gpio_num_t)gpio;
+  gpio_set_intr_type(num, gpio_get_level(num) ? GPIO_INTR_LOW_LEVEL
+                                              : GPIO_INTR_HIGH_LEVEL);
+  gpio_isr_handler_add(num, onEdge, &p);
+  gpio_intr_enable(num);
+  return true;
+}
+
+void EdgeCapture::enableWakeup() {
+  for (int i = 0; i < _pinCount; i++) {
+    gpio_num_t num = (gpio_num_t)_pins[i].gpio;
+    gpio_wakeup_enable(num, gpio_get_level(num) ? GPIO_INTR_LOW_LEVEL
+                                                : GPIO_INTR_HIGH_LEVEL);
+  }
+  esp_sleep_enable_gpio_wakeup();
+}
+
+void IRAM_ATTR EdgeCapture::onEdge(void *arg) {
+  int64_t now = esp_timer_get_time();
+  Pin *p = (Pin *)arg;
+  EdgeCapture *self = p->owner;
+  gpio_num_t num = (gpio_num_t)p->gpio;
+  gpio_ll_set_intr_type(&GPIO, num,
+                        gpio_ll_get_level(&GPIO, num) ? GPIO_INTR_LOW_LEVEL
+                                                      : GPIO_INTR_HIGH_LEVEL);
+
+  portENTER_CRITICAL_ISR(&self->_mux);
+  if (p->input >= 0 && self->_firstUs[p->input] == 0)
+    self->_firstUs[p->input] = now;
+  if (self->_anyUs == 0)
+    self->_anyUs = now;
+  portEXIT_CRITICAL_ISR(&self->_mux);
+
+  TaskHandle_t task = self->_task;
+  if (task) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(task, &woken);
+    if (woken)
+      portYIELD_FROM_ISR();
+  }
+}
+
+void EdgeCapture::take(int64_t *firstUs, int count) {
+  portENTER_CRITICAL(&_mux);
+  for (int i = 0; i < count; i++) {
+    if (i < _inputs) {
+      firstUs[i] = _firstUs[i];
+      _firstUs[i] = 0;
+    } else {
+      firstUs[i] = 0;
+    }
+  }
+  portEXIT_CRITICAL(&_mux);
+}
+
+int64_t EdgeCapture::takeAny() {
+  portENTER_CRITICAL(&_mux);
+  int64_t us = _anyUs;
+  _anyUs = 0;
+  portEXIT_CRITICAL(&_mux);
+  return us;
+}
@@ -0,0 +1,60 @@
+#ifndef EDGE_CAPTURE_H
+#define EDGE_CAPTURE_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static const int EDGE_MAX_PINS = 33;
+
+// Timestamps input edges in a GPIO interrupt with esp_timer_get_time(), so
+// a transition is dated when it happened rather than when loop() got round
+// to sampling it. Only native pins are captured; expander inputs have no
+// per-pin interrupt and keep their sample time.
+//
+// Pins use level interrupts that are re-armed on the opposite level each
+// time they fire: one interrupt per change, like an edge interrupt, and if
+// the input bounced back meanwhile it fires again at once, so the last
+// level is never missed. Unlike an edge interrupt it can also wake the
+// chip from light sleep (see PowerSaver).
+class EdgeCapture {
+public:
+  EdgeCapture();
+
+  // Capture edges of pins[i] as input i. Pins must already be inputs.
+  bool begin(const uint8_t *pins, int count);
+  // Watch a pin only to wake the loop, e.g. the expanders' INT line
+  bool addWakePin(uint8_t pin);
+  int count() const { return _inputs; }
+
+  // Notify the task on every edge
+  void notify(TaskHandle_t task) { _task = task; }
+  // Let the pins wake the chip from light sleep
+  void enableWakeup();
+
+  // Time of the first edge on each input since the last call, 0 if none
+  void take(int64_t *firstUs, int count);
+  // First edge on any pin since the last call, 0 if none
+  int64_t takeAny();
+
+private:
+  struct Pin {
+    EdgeCapture *owner;
+    uint8_t gpio;
+    int8_t input; // -1 for a wake-only pin
+  };
+
+  Pin _pins[EDGE_MAX_PINS];
+  int _pinCount;
+  int _inputs;
+  volatile TaskHandle_t _task;
+
+  portMUX_TYPE _mux;
+  int64_t _firstUs[EDGE_MAX_PINS];
+  int64_t _anyUs;
+
+  bool attach(uint8_t gpio, int input);
+  static void IRAM_ATTR onEdge(void *arg);
+};
+
+#endif
@@ -0,0 +1,32 @@
+#include "GpioInputSource.h"
+#include <soc/gpio_reg.h>
+#include <soc/soc.h>
+
+GpioInputSource::GpioInputSource() : _count(0) {}
+
+void GpioInputSource::setPins(const uint8_t *pins, int count) {
+  _count = (count > 32) ? 32 : count;
+  memcpy(_pins, pins, _count);
+}
+
+bool GpioInputSource::begin() {
+  for (int i = 0; i < _count; i++) {
+    // OI-IB-8 uses open-collector/active-low output:
+    // - When train is present (OCCUPIED): pulls pin to GND (LOW)
+    // - When no train (FREE): releases pin (floating)
+    // INPUT_PULLUP pulls the pin HIGH when floating, LOW when grounded
+    pinMode(_pins[i], INPUT_PULLUP);
+  }
+  return _count > 0;
+}
+
+uint32_t GpioInputSource::read(uint32_t nowMs) {
+  // GPIO 0-31 and 32-39 live in two registers
+  uint64_t in = REG_READ(GPIO_IN_REG) |
+                ((uint64_t)REG_READ(GPIO_IN1_REG) << 32);
+  uint32_t levels = 0;
+  for (int i = 0; i < _count; i++) {
+    levels |= (uint32_t)((in >> _pins[i]) & 1) << i;
+  }
+  return levels;
+}
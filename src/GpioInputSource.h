@@ -0,0 +1,28 @@
+#ifndef GPIO_INPUT_SOURCE_H
+#define GPIO_INPUT_SOURCE_H
+
+#include "InputSource.h"
+#include <Arduino.h>
+
+// Native ESP32 GPIO inputs. All pins are sampled from the two GPIO input
+// registers in one read instead of one digitalRead() per pin.
+class GpioInputSource : public InputSource {
+public:
+  GpioInputSource();
+
+  // Pins must already be validated (see ConfigManager::validateTrackPins)
+  void setPins(const uint8_t *pins, int count);
+
+  bool begin() override;
+  int count() const override { return _count; }
+  uint32_t read(uint32_t nowMs) override;
+  const char *name() const override { return "gpio"; }
+
+  uint8_t pin(int index) const { return _pins[index]; }
+
+private:
+  uint8_t _pins[32];
+  int _count;
+};
+
+#endif
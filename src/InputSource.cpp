@@ -0,0 +1,39 @@
+#include "InputSource.h"
+
+InputBank::InputBank() : _sourceCount(0), _count(0) {}
+
+bool InputBank::add(InputSource *source) {
+  if (_sourceCount >= MAX_INPUT_SOURCES)
+    return false;
+  if (_count + source->count() > MAX_INPUTS)
+    return false;
+
+  _sources[_sourceCount] = source;
+  _offsets[_sourceCount] = _count;
+  _sourceCount++;
+  _count += source->count();
+  return true;
+}
+
+void InputBank::begin() {
+  int kept = 0;
+  _count = 0;
+  for (int i = 0; i < _sourceCount; i++) {
+    if (!_sources[i]->begin())
+      continue;
+    _sources[kept] = _sources[i];
+    _offsets[kept] = _count;
+    _count += _sources[i]->count();
+    kept++;
+  }
+  _sourceCount = kept;
+}
+
+uint64_t InputBank::sample(uint32_t nowMs) {
+  uint64_t levels = 0;
+  for (int i = 0; i < _sourceCount; i++) {
+    uint64_t mask = (1ULL << _sources[i]->count()) - 1;
+    levels |= (_sources[i]->read(nowMs) & mask) << _offsets[i];
+  }
+  return levels;
+}
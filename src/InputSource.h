@@ -0,0 +1,58 @@
+#ifndef INPUT_SOURCE_H
+#define INPUT_SOURCE_H
+
+#include <stdint.h>
+
+// Upper bound on inputs across all sources (one bit each in a uint64_t)
+static const int MAX_INPUTS = 64;
+static const int MAX_INPUT_SOURCES = 4;
+
+// A group of digital detector inputs that can be sampled together.
+// Implementations read all of their inputs in one go (a register read or a
+// single bus transaction) so the sampling cost does not grow per input.
+// This header has no Arduino dependencies so it can be used on the host.
+class InputSource {
+public:
+  virtual ~InputSource() {}
+
+  virtual bool begin() = 0;
+
+  // Number of inputs provided by this source (at most 32)
+  virtual int count() const = 0;
+
+  // Raw levels, bit i = input i (1 = HIGH). Sources may return a cached
+  // value when their hardware reports nothing has changed.
+  virtual uint32_t read(uint32_t nowMs) = 0;
+
+  // Short name for logs and the API (e.g. "gpio", "mcp23017@0x20")
+  virtual const char *name() const = 0;
+};
+
+// Concatenates several sources into one input index space:
+// source 0 provides inputs [0, n0), source 1 provides [n0, n0 + n1), ...
+class InputBank {
+public:
+  InputBank();
+
+  // Add a source; fails once MAX_INPUT_SOURCES or MAX_INPUTS is reached
+  bool add(InputSource *source);
+
+  // Begin all sources, dropping any that fail to start
+  void begin();
+
+  int count() const { return _count; }
+  int sourceCount() const { return _sourceCount; }
+  InputSource *source(int index) const { return _sources[index]; }
+  int sourceOffset(int index) const { return _offsets[index]; }
+
+  // Sample every source, bit i = input i (1 = HIGH)
+  uint64_t sample(uint32_t nowMs);
+
+private:
+  InputSource *_sources[MAX_INPUT_SOURCES];
+  int _offsets[MAX_INPUT_SOURCES];
+  int _sourceCount;
+  int _count;
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "Mcp23x17InputSource.h"
+
+// Register addresses with IOCON.BANK = 0 (A/B pairs are adjacent)
+static const uint8_t MCP_IODIRA = 0x00;
+static const uint8_t MCP_IODIRB = 0x01;
+static const uint8_t MCP_GPINTENA = 0x04;
+static const uint8_t MCP_GPINTENB = 0x05;
+static const uint8_t MCP_INTCONA = 0x08;
+static const uint8_t MCP_INTCONB = 0x09;
+static const uint8_t MCP_IOCON = 0x0A;
+static const uint8_t MCP_GPPUA = 0x0C;
+static const uint8_t MCP_GPPUB = 0x0D;
+static const uint8_t MCP_GPIOA = 0x12;
+
+// IOCON: MIRROR (one INT for both ports), HAEN (SPI address pins),
+// ODR (open-drain INT so several expanders can share one line)
+static const uint8_t MCP_IOCON_VALUE = 0x40 | 0x08 | 0x04;
+
+static const uint32_t MCP_SPI_CLOCK = 8000000;
+
+Mcp23x17InputSource::Mcp23x17InputSource(TwoWire &wire, uint8_t address,
+                                         int intPin)
+    : _wire(&wire), _spi(nullptr), _csPin(-1), _address(address),
+      _intPin(intPin), _levels(0xFFFF), _lastRead(0), _busReads(0) {
+  snprintf(_name, sizeof(_name), "mcp23017@0x%02x", address);
+}
+
+Mcp23x17InputSource::Mcp23x17InputSource(SPIClass &spi, int csPin,
+                                         uint8_t address, int intPin)
+    : _wire(nullptr), _spi(&spi), _csPin(csPin), _address(address & 0x07),
+      _intPin(intPin), _levels(0xFFFF), _lastRead(0), _busReads(0) {
+  snprintf(_name, sizeof(_name), "mcp23s17@%d", _address);
+}
+
+bool Mcp23x17InputSource::probe(TwoWire &wire, uint8_t address) {
+  wire.beginTransmission(address);
+  return wire.endTransmission() == 0;
+}
+
+bool Mcp23x17InputSource::begin() {
+  if (_spi) {
+    pinMode(_csPin, OUTPUT);
+    digitalWrite(_csPin, HIGH);
+    // Until HAEN is set an MCP23S17 ignores its address pins and only
+    // answers to address 0, so IOCON goes there first; every expander on
+    // this chip select takes it at once
+    spiWrite(0, MCP_IOCON, MCP_IOCON_VALUE);
+  } else if (!probe(*_wire, _address)) {
+    Serial.printf("%s not responding\n", _name);
+    return false;
+  }
+
+  writeReg(MCP_IOCON, MCP_IOCON_VALUE);
+  writeReg(MCP_IODIRA, 0xFF); // All inputs
+  writeReg(MCP_IODIRB, 0xFF);
+  writeReg(MCP_GPPUA, 0xFF); // Pull-ups for open-collector detectors
+  writeReg(MCP_GPPUB, 0xFF);
+  writeReg(MCP_INTCONA, 0x00); // Interrupt on any change
+  writeReg(MCP_INTCONB, 0x00);
+  writeReg(MCP_GPINTENA, 0xFF);
+  writeReg(MCP_GPINTENB, 0xFF);
+
+  if (_intPin >= 0) {
+    pinMode(_intPin, INPUT_PULLUP);
+  }
+
+  // Initial read also clears any pending interrupt
+  uint16_t value;
+  if (!readPorts(value)) {
+    Serial.printf("%s read failed\n", _name);
+    return false;
+  }
+  _levels = value;
+  _lastRead = millis();
+  return true;
+}
+
+uint32_t Mcp23x17InputSource::read(uint32_t nowMs) {
+  // INT idle (high) means no input changed since the last port read
+  if (_intPin >= 0 && digitalRead(_intPin) == HIGH &&
+      nowMs - _lastRead < MCP_POLL_INTERVAL_MS) {
+    return _levels;
+  }
+
+  uint16_t value;
+  if (readPorts(value)) {
+    _levels = value;
+  }
+  _lastRead = nowMs;
+  return _levels;
+}
+
+void Mcp23x17InputSource::spiWrite(uint8_t address, uint8_t reg,
+                                   uint8_t value) {
+  _spi->beginTransaction(SPISettings(MCP_SPI_CLOCK, MSBFIRST, SPI_MODE0));
+  digitalWrite(_csPin, LOW);
+  _spi->transfer(0x40 | (address << 1)); // Write opcode
+  _spi->transfer(reg);
+  _spi->transfer(value);
+  digitalWrite(_csPin, HIGH);
+  _spi->endTransaction();
+}
+
+void Mcp23x17InputSource::writeReg(uint8_t reg, uint8_t value) {
+  if (_spi) {
+    spiWrite(_address, reg, value);
+  } else {
+    _wire->beginTransmission(_address);
+    _wire->write(reg);
+    _wire->write(value);
+    _wire->endTransmission();
+  }
+}
+
+bool Mcp23x17InputSource::readPorts(uint16_t &value) {
+  uint8_t a, b;
+  _busReads++;
+
+  if (_spi) {
+    // GPIOA then GPIOB via sequential addressing in one CS cycle
+    _spi->beginTransaction(SPISettings(MCP_SPI_CLOCK, MSBFIRST, SPI_MODE0));
+    digitalWrite(_csPin, LOW);
+    _spi->transfer(0x41 | (_address << 1)); // Read opcode
+    _spi->transfer(MCP_GPIOA);
+    a = _spi->transfer(0x00);
+    b = _spi->transfer(0x00);
+    digitalWrite(_csPin, HIGH);
+    _spi->endTransaction();
+  } else {
+    // Register pointer write + repeated start + 2 byte read
+    _wire->beginTransmission(_address);
+    _wire->write(MCP_GPIOA);
+    if (_wire->endTransmission(false) != 0)
+      return false;
+    if (_wire->requestFrom(_address, (uint8_t)2) != 2)
+      return false;
+    a = _wire->read();
+    b = _wire->read();
+  }
+
+  value = a | (b << 8);
+  return true;
+}
@@ -0,0 +1,52 @@
+#ifndef MCP23X17_INPUT_SOURCE_H
+#define MCP23X17_INPUT_SOURCE_H
+
+#include "InputSource.h"
+#include <Arduino.h>
+#include <SPI.h>
+#include <Wire.h>
+
+// Full re-read interval even when the INT line is idle, so a missed
+// interrupt cannot leave a stale state for long
+static const uint32_t MCP_POLL_INTERVAL_MS = 100;
+
+// 16 inputs on an MCP23017 (I2C) or MCP23S17 (SPI) port expander.
+// Both ports are read with one bus transaction. When an INT pin is given
+// (open-drain, may be shared by several expanders) the bus is only touched
+// while INT is asserted, plus a slow safety poll.
+class Mcp23x17InputSource : public InputSource {
+public:
+  // MCP23017 at address 0x20-0x27
+  Mcp23x17InputSource(TwoWire &wire, uint8_t address, int intPin = -1);
+  // MCP23S17 with hardware address 0-7 behind a chip select
+  Mcp23x17InputSource(SPIClass &spi, int csPin, uint8_t address,
+                      int intPin = -1);
+
+  // True if an MCP23017 acknowledges at the address
+  static bool probe(TwoWire &wire, uint8_t address);
+
+  bool begin() override;
+  int count() const override { return 16; }
+  uint32_t read(uint32_t nowMs) override;
+  const char *name() const override { return _name; }
+
+  uint8_t address() const { return _address; }
+  uint32_t busReads() const { return _busReads; }
+
+private:
+  TwoWire *_wire;
+  SPIClass *_spi;
+  int _csPin;
+  uint8_t _address;
+  int _intPin;
+  char _name[20];
+  uint16_t _levels;
+  uint32_t _lastRead;
+  uint32_t _busReads;
+
+  void writeReg(uint8_t reg, uint8_t value);
+  void spiWrite(uint8_t address, uint8_t reg, uint8_t value);
+  bool readPorts(uint16_t &value);
+};
+
+#endif
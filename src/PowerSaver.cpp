@@ -0,0 +1,78 @@
+#include "PowerSaver.h"
+#include <esp_pm.h>
+#include <esp_timer.h>
+
+PowerSaver::PowerSaver()
+    : _edges(nullptr), _enabled(false), _lightSleep(false), _wokeAt(0),
+      _awakeUs(0), _asleepUs(0), _edgeWakes(0), _timerWakes(0),
+      _lastWakeUs(0), _maxWakeUs(0), _wakeUsSum(0) {}
+
+bool PowerSaver::begin(EdgeCapture &edges) {
+  _edges = &edges;
+  edges.notify(xTaskGetCurrentTaskHandle());
+  edges.enableWakeup();
+
+#if CONFIG_PM_ENABLE
+  // Light sleep also needs tickless idle; without it only scale the clock
+  esp_pm_config_esp32_t pm = {};
+  pm.max_freq_mhz = getCpuFrequencyMhz();
+  pm.min_freq_mhz = POWER_MIN_CPU_MHZ;
+  pm.light_sleep_enable = true;
+  _lightSleep = esp_pm_configure(&pm) == ESP_OK;
+  if (!_lightSleep) {
+    pm.light_sleep_enable = false;
+    esp_pm_configure(&pm);
+  }
+#endif
+  Serial.printf("Low power: light sleep %s\n",
+                _lightSleep ? "on" : "unavailable");
+
+  _wokeAt = esp_timer_get_time();
+  _enabled = true;
+  return true;
+}
+
+void PowerSaver::sleep(uint32_t maxMs) {
+  if (!_enabled || maxMs == 0)
+    return;
+
+  int64_t start = esp_timer_get_time();
+  _awakeUs += start - _wokeAt;
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(maxMs));
+  int64_t now = esp_timer_get_time();
+  _asleepUs += now - start;
+  _wokeAt = now;
+
+  int64_t edge = _edges->takeAny();
+  if (edge == 0) {
+    _timerWakes++;
+    return;
+  }
+  // An edge during the last pass only waits for this call to return
+  uint32_t latency = now - (edge > start ? edge : start);
+  _edgeWakes++;
+  _lastWakeUs = latency;
+  _wakeUsSum += latency;
+  if (latency > _maxWakeUs)
+    _maxWakeUs = latency;
+}
+
+PowerStats PowerSaver::stats() const {
+  PowerStats st;
+  st.lightSleep = _lightSleep;
+  st.edgeWakes = _edgeWakes;
+  st.timerWakes = _timerWakes;
+  st.lastWakeUs = _lastWakeUs;
+  st.maxWakeUs = _maxWakeUs;
+  st.avgWakeUs = _edgeWakes ? _wakeUsSum / _edgeWakes : 0;
+
+  // Without low power the loop never sleeps
+  uint64_t awake = _enabled ? _awakeUs + (esp_timer_get_time() - _wokeAt)
+                            : 1;
+  uint64_t total = awake + _asleepUs;
+  st.awakePercent = awake * 100.0f / total;
+  float asleepMa = _lightSleep ? POWER_LIGHT_SLEEP_MA : POWER_IDLE_MA;
+  st.averageMa =
+      (awake * POWER_ACTIVE_MA + _asleepUs * asleepMa) / (float)total;
+  return st;
+}
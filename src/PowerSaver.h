@@ -0,0 +1,64 @@
+#ifndef POWER_SAVER_H
+#define POWER_SAVER_H
+
+#include "EdgeCapture.h"
+#include <Arduino.h>
+
+// --- Low Power Tuning ---
+// Longest the loop sleeps without an input edge; bounds how late MQTT,
+// statistics and the HSC_Base housekeeping run
+static const uint32_t POWER_MAX_SLEEP_MS = 50;
+// Lowest CPU clock while idle, where frequency scaling is available
+static const int POWER_MIN_CPU_MHZ = 80;
+// Supply current (mA) used to estimate the average: CPU running with the
+// radio in modem sleep, CPU waiting in the idle task, and automatic light
+// sleep (including the radio waking for beacons)
+static const float POWER_ACTIVE_MA = 45.0f;
+static const float POWER_IDLE_MA = 22.0f;
+static const float POWER_LIGHT_SLEEP_MA = 3.0f;
+
+struct PowerStats {
+  bool lightSleep; // Automatic light sleep is available and enabled
+  uint32_t edgeWakes;
+  uint32_t timerWakes;
+  uint32_t lastWakeUs; // Input edge to the loop running again
+  uint32_t maxWakeUs;
+  uint32_t avgWakeUs;
+  float awakePercent;
+  float averageMa; // Estimate from the awake/asleep split
+};
+
+// Low-power sensing. Instead of spinning, loop() blocks in sleep() until an
+// edge on one of the EdgeCapture pins, the next debounce deadline or the
+// sleep bound. While it is blocked the chip drops into automatic light
+// sleep when the framework has power management, otherwise the CPU waits in
+// the idle task.
+class PowerSaver {
+public:
+  PowerSaver();
+
+  // Call from the loop task, once the edge capture pins are set up
+  bool begin(EdgeCapture &edges);
+  bool enabled() const { return _enabled; }
+
+  // Block for up to maxMs, returning early on an edge of a wake pin
+  void sleep(uint32_t maxMs);
+
+  PowerStats stats() const;
+
+private:
+  EdgeCapture *_edges;
+  bool _enabled;
+  bool _lightSleep;
+
+  int64_t _wokeAt;
+  uint64_t _awakeUs;
+  uint64_t _asleepUs;
+  uint32_t _edgeWakes;
+  uint32_t _timerWakes;
+  uint32_t _lastWakeUs;
+  uint32_t _maxWakeUs;
+  uint64_t _wakeUsSum;
+};
+
+#endif
@@ -0,0 +1,449 @@
+#include "RuleEngine.h"
+#include <stdio.h>
+#include <string.h>
+
+enum RuleOp : uint8_t {
+  OP_FALSE,
+  OP_TRUE,
+  OP_TRACK, // bit
+  OP_PEER,  // slot, bit
+  OP_RULE,  // rule
+  OP_NOT,
+  OP_AND,
+  OP_OR,
+  OP_XOR,
+  OP_ON,  // timer
+  OP_OFF, // timer
+};
+
+// Recursive descent over the rule source, emitting straight into the
+// program. Tracks the stack depth so the VM never needs to check it.
+class RuleCompiler {
+public:
+  RuleCompiler(RuleEngine::Program &prog, char *error, size_t errorLen)
+      : _p(prog), _error(error), _errorLen(errorLen) {}
+
+  bool compile(const char *source);
+
+private:
+  RuleEngine::Program &_p;
+  char *_error;
+  size_t _errorLen;
+  const char *_s;
+  int _line;
+  int _depth;
+
+  bool fail(const char *message);
+  bool emit(uint8_t byte);
+  bool pushed();
+  void skipSpace();
+  void skipBlank();
+  bool expect(char c);
+  bool readName(char *out);
+  bool readNumber(uint32_t &value);
+  int findRule(const char *name) const;
+
+  bool parseOr();
+  bool parseXor();
+  bool parseAnd();
+  bool parseUnary();
+  bool parsePrimary();
+  bool parseTimer(bool on);
+  bool parsePeer(uint32_t board);
+};
+
+// T<n> or P<n>: returns n, or 0 if name is not of that form
+static uint32_t prefixedNumber(const char *name, char prefix) {
+  if (name[0] != prefix || name[1] == '\0')
+    return 0;
+  uint32_t n = 0;
+  for (const char *p = name + 1; *p; p++) {
+    if (*p < '0' || *p > '9' || n > 100000)
+      return 0;
+    n = n * 10 + (*p - '0');
+  }
+  return n;
+}
+
+static bool isReserved(const char *name) {
+  return prefixedNumber(name, 'T') || prefixedNumber(name, 'P') ||
+         strcmp(name, "on") == 0 || strcmp(name, "off") == 0;
+}
+
+bool RuleCompiler::fail(const char *message) {
+  if (_error && _errorLen) {
+    char near[12];
+    size_t n = strcspn(_s, "\r\n");
+    if (n >= sizeof(near))
+      n = sizeof(near) - 1;
+    memcpy(near, _s, n);
+    near[n] = '\0';
+    snprintf(_error, _errorLen, "line %d: %s%s%s%s", _line, message,
+             n ? " near '" : "", near, n ? "'" : "");
+  }
+  return false;
+}
+
+bool RuleCompiler::emit(uint8_t byte) {
+  if (_p.codeLen == RULE_MAX_CODE)
+    return fail("rules too long");
+  _p.code[_p.codeLen++] = byte;
+  return true;
+}
+
+bool RuleCompiler::pushed() {
+  if (++_depth > RULE_MAX_STACK)
+    return fail("expression too deep");
+  return true;
+}
+
+void RuleCompiler::skipSpace() {
+  while (*_s == ' ' || *_s == '\t' || *_s == '\r')
+    _s++;
+}
+
+// Whitespace, comments and statement separators between rules
+void RuleCompiler::skipBlank() {
+  for (;;) {
+    skipSpace();
+    if (*_s == '#') {
+      while (*_s && *_s != '\n')
+        _s++;
+    } else if (*_s == '\n') {
+      _line++;
+      _s++;
+    } else if (*_s == ';') {
+      _s++;
+    } else {
+      return;
+    }
+  }
+}
+
+bool RuleCompiler::expect(char c) {
+  skipSpace();
+  if (*_s != c) {
+    char message[16];
+    snprintf(message, sizeof(message), "expected '%c'", c);
+    return fail(message);
+  }
+  _s++;
+  return true;
+}
+
+bool RuleCompiler::readName(char *out) {
+  skipSpace();
+  const char *start = _s;
+  if (!((*_s >= 'a' && *_s <= 'z') || (*_s >= 'A' && *_s <= 'Z') ||
+        *_s == '_'))
+    return fail("expected a name");
+  while ((*_s >= 'a' && *_s <= 'z') || (*_s >= 'A' && *_s <= 'Z') ||
+         (*_s >= '0' && *_s <= '9') || *_s == '_')
+    _s++;
+  size_t len = _s - start;
+  if (len >= (size_t)RULE_NAME_LEN) {
+    _s = start;
+    return fail("name too long");
+  }
+  memcpy(out, start, len);
+  out[len] = '\0';
+  return true;
+}
+
+bool RuleCompiler::readNumber(uint32_t &value) {
+  skipSpace();
+  if (*_s < '0' || *_s > '9')
+    return fail("expected a number");
+  value = 0;
+  while (*_s >= '0' && *_s <= '9') {
+    if (value > 100000000)
+      return fail("number too large");
+    value = value * 10 + (*_s++ - '0');
+  }
+  return true;
+}
+
+int RuleCompiler::findRule(const char *name) const {
+  for (int i = 0; i < _p.ruleCount; i++) {
+    if (strcmp(_p.rules[i].name, name) == 0)
+      return i;
+  }
+  return -1;
+}
+
+bool RuleCompiler::compile(const char *source) {
+  memset(&_p, 0, sizeof(_p));
+  _s = source;
+  _line = 1;
+
+  for (;;) {
+    skipBlank();
+    if (!*_s)
+      return true;
+    if (_p.ruleCount == RULE_MAX_RULES)
+      return fail("too many rules");
+
+    RuleEngine::Rule &rule = _p.rules[_p.ruleCount];
+    const char *start = _s;
+    if (!readName(rule.name))
+      return false;
+    if (isReserved(rule.name) || findRule(rule.name) >= 0) {
+      _s = start;
+      return fail("name already taken");
+    }
+    if (!expect('='))
+      return false;
+
+    rule.start = _p.codeLen;
+    _depth = 0;
+    if (!parseOr())
+      return false;
+    skipSpace();
+    if (*_s && *_s != '\n' && *_s != ';' && *_s != '#')
+      return fail("unexpected input");
+    rule.end = _p.codeLen;
+    _p.ruleCount++;
+  }
+}
+
+bool RuleCompiler::parseOr() {
+  if (!parseXor())
+    return false;
+  for (;;) {
+    skipSpace();
+    if (*_s != '|')
+      return true;
+    _s++;
+    if (!parseXor() || !emit(OP_OR))
+      return false;
+    _depth--;
+  }
+}
+
+bool RuleCompiler::parseXor() {
+  if (!parseAnd())
+    return false;
+  for (;;) {
+    skipSpace();
+    if (*_s != '^')
+      return true;
+    _s++;
+    if (!parseAnd() || !emit(OP_XOR))
+      return false;
+    _depth--;
+  }
+}
+
+bool RuleCompiler::parseAnd() {
+  if (!parseUnary())
+    return false;
+  for (;;) {
+    skipSpace();
+    if (*_s != '&')
+      return true;
+    _s++;
+    if (!parseUnary() || !emit(OP_AND))
+      return false;
+    _depth--;
+  }
+}
+
+bool RuleCompiler::parseUnary() {
+  skipSpace();
+  if (*_s == '!') {
+    _s++;
+    return parseUnary() && emit(OP_NOT);
+  }
+  return parsePrimary();
+}
+
+bool RuleCompiler::parsePrimary() {
+  skipSpace();
+  if (*_s == '(') {
+    _s++;
+    return parseOr() && expect(')');
+  }
+  if (*_s >= '0' && *_s <= '9') {
+    uint32_t value;
+    if (!readNumber(value))
+      return false;
+    if (value > 1)
+      return fail("only 0 and 1 are values");
+    return emit(value ? OP_TRUE : OP_FALSE) && pushed();
+  }
+
+  const char *start = _s;
+  char name[RULE_NAME_LEN];
+  if (!readName(name))
+    return false;
+  skipSpace();
+  if (*_s == '(' && strcmp(name, "on") == 0)
+    return parseTimer(true);
+  if (*_s == '(' && strcmp(name, "off") == 0)
+    return parseTimer(false);
+
+  uint32_t track = prefixedNumber(name, 'T');
+  if (track) {
+    if (track > 64) {
+      _s = start;
+      return fail("tracks are T1 to T64");
+    }
+    return emit(OP_TRACK) && emit(track - 1) && pushed();
+  }
+  uint32_t board = prefixedNumber(name, 'P');
+  if (board)
+    return parsePeer(board);
+
+  int rule = findRule(name);
+  if (rule < 0) {
+    _s = start;
+    return fail("unknown name");
+  }
+  return emit(OP_RULE) && emit(rule) && pushed();
+}
+
+bool RuleCompiler::parseTimer(bool on) {
+  if (_p.timerCount == RULE_MAX_TIMERS)
+    return fail("too many timers");
+  uint32_t ms;
+  if (!expect('(') || !parseOr() || !expect(',') || !readNumber(ms) ||
+      !expect(')'))
+    return false;
+  uint8_t timer = _p.timerCount++;
+  _p.timerMs[timer] = ms;
+  return emit(on ? OP_ON : OP_OFF) && emit(timer);
+}
+
+bool RuleCompiler::parsePeer(uint32_t board) {
+  uint32_t track;
+  if (!expect('.') || !readNumber(track))
+    return false;
+  if (board > 0xFFFF || track < 1 || track > 64)
+    return fail("peer tracks are P<board>.1 to P<board>.64");
+
+  int slot = 0;
+  while (slot < _p.peerCount && _p.peers[slot] != board)
+    slot++;
+  if (slot == _p.peerCount) {
+    if (_p.peerCount == RULE_MAX_PEERS)
+      return fail("too many peer boards");
+    _p.peers[_p.peerCount++] = board;
+  }
+  return emit(OP_PEER) && emit(slot) && emit(track - 1) && pushed();
+}
+
+RuleEngine::RuleEngine() { clear(); }
+
+void RuleEngine::clear() {
+  memset(&_prog, 0, sizeof(_prog));
+  memset(_timers, 0, sizeof(_timers));
+  _states = 0;
+  _evaluated = false;
+  _hasDeadline = false;
+  _deadline = 0;
+}
+
+bool RuleEngine::load(const char *source, char *error, size_t errorLen) {
+  RuleCompiler compiler(_next, error, errorLen);
+  if (!compiler.compile(source))
+    return false;
+  clear();
+  _prog = _next;
+  return true;
+}
+
+bool RuleEngine::runTimer(int index, bool on, bool input, uint32_t nowMs) {
+  Timer &t = _timers[index];
+  uint32_t ms = _prog.timerMs[index];
+  bool pending;
+  if (on) {
+    if (input && !t.input)
+      t.since = nowMs;
+    t.output = input && nowMs - t.since >= ms;
+    pending = input && !t.output;
+  } else {
+    if (!input && t.input)
+      t.since = nowMs;
+    t.output = input || (t.output && nowMs - t.since < ms);
+    pending = !input && t.output;
+  }
+  t.input = input;
+
+  if (pending) {
+    uint32_t due = t.since + ms;
+    if (!_hasDeadline || (int32_t)(due - _deadline) < 0)
+      _deadline = due;
+    _hasDeadline = true;
+  }
+  return t.output;
+}
+
+uint32_t RuleEngine::evaluate(uint64_t local, const uint64_t *peers,
+                              uint32_t nowMs) {
+  uint32_t before = _states;
+  _hasDeadline = false;
+  bool stack[RULE_MAX_STACK];
+
+  for (int r = 0; r < _prog.ruleCount; r++) {
+    const uint8_t *code = _prog.code;
+    int sp = 0;
+    for (int pc = _prog.rules[r].start; pc < _prog.rules[r].end;) {
+      switch (code[pc++]) {
+      case OP_FALSE:
+        stack[sp++] = false;
+        break;
+      case OP_TRUE:
+        stack[sp++] = true;
+        break;
+      case OP_TRACK:
+        stack[sp++] = (local >> code[pc++]) & 1;
+        break;
+      case OP_PEER:
+        stack[sp++] = (peers[code[pc]] >> code[pc + 1]) & 1;
+        pc += 2;
+        break;
+      case OP_RULE:
+        stack[sp++] = (_states >> code[pc++]) & 1;
+        break;
+      case OP_NOT:
+        stack[sp - 1] = !stack[sp - 1];
+        break;
+      case OP_AND:
+        sp--;
+        stack[sp - 1] = stack[sp - 1] && stack[sp];
+        break;
+      case OP_OR:
+        sp--;
+        stack[sp - 1] = stack[sp - 1] || stack[sp];
+        break;
+      case OP_XOR:
+        sp--;
+        stack[sp - 1] = stack[sp - 1] != stack[sp];
+        break;
+      case OP_ON:
+      case OP_OFF:
+        stack[sp - 1] =
+            runTimer(code[pc], code[pc - 1] == OP_ON, stack[sp - 1], nowMs);
+        pc++;
+        break;
+      }
+    }
+    if (stack[0])
+      _states |= 1UL << r;
+    else
+      _states &= ~(1UL << r);
+  }
+
+  // The first evaluation reports every rule, so all states get published
+  uint32_t changed = _evaluated ? before ^ _states
+                                : (uint32_t)((1ULL << _prog.ruleCount) - 1);
+  _evaluated = true;
+  return changed;
+}
+
+uint32_t RuleEngine::msUntilDeadline(uint32_t nowMs) const {
+  if (!_hasDeadline)
+    return UINT32_MAX;
+  int32_t left = (int32_t)(_deadline - nowMs);
+  return left > 0 ? left : 0;
+}
@@ -0,0 +1,100 @@
+#ifndef RULE_ENGINE_H
+#define RULE_ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Rule Engine Limits ---
+// Fixed so that compiled rules need no allocation and one evaluation is
+// bounded by RULE_MAX_CODE instructions
+static const int RULE_MAX_RULES = 16;
+static const int RULE_MAX_CODE = 256;
+static const int RULE_MAX_TIMERS = 16;
+static const int RULE_MAX_PEERS = 8;
+static const int RULE_MAX_STACK = 16;
+static const int RULE_NAME_LEN = 16;
+
+// Derived occupancy states computed on the board, e.g.
+//
+//   # Track 3 and 4 both occupied
+//   pair_3_4 = T3 & T4
+//   # Ladder fouled: a ladder track occupied for 2 s, held 5 s after
+//   ladder_fouled = off(on(T1 | T2, 2000), 5000)
+//   # Our track 8 or the neighbouring section's track 1 (peer link)
+//   boundary = T8 | P2.1
+//   # Earlier rules can be used by name
+//   yard_busy = ladder_fouled | pair_3_4
+//
+// One rule per line (or separated by ';'), '#' starts a comment. Operands
+// are T<n> (track n occupied, 1-based), P<board>.<n> (track n of a
+// neighbouring board over the peer link, 0 while it is offline), 0, 1 and
+// earlier rules. Operators by precedence: !, &, ^, |. on(x, ms) is true once
+// x has been true for ms; off(x, ms) stays true until x has been false for
+// ms. Together they give delays and hysteresis.
+//
+// Rules compile to a small stack bytecode. Evaluation allocates nothing and
+// runs at most RULE_MAX_CODE instructions. No Arduino dependencies, so the
+// compiler and VM can be run on the host.
+class RuleEngine {
+public:
+  RuleEngine();
+
+  // Compile source and replace the current rules. On failure the current
+  // rules stay and error describes the problem.
+  bool load(const char *source, char *error, size_t errorLen);
+  void clear();
+
+  // Evaluate every rule. local has bit i set for track i + 1 occupied;
+  // peers[k] is the mask of board peerBoard(k). Returns the rules whose
+  // state changed as a bit mask (bit r = rule r).
+  uint32_t evaluate(uint64_t local, const uint64_t *peers, uint32_t nowMs);
+
+  // Time until a timer can change a result, or UINT32_MAX if none can
+  // without an input change
+  uint32_t msUntilDeadline(uint32_t nowMs) const;
+
+  int count() const { return _prog.ruleCount; }
+  const char *name(int rule) const { return _prog.rules[rule].name; }
+  bool state(int rule) const { return (_states >> rule) & 1; }
+  int peerCount() const { return _prog.peerCount; }
+  uint16_t peerBoard(int slot) const { return _prog.peers[slot]; }
+  int codeSize() const { return _prog.codeLen; }
+
+private:
+  struct Rule {
+    char name[RULE_NAME_LEN];
+    uint16_t start;
+    uint16_t end;
+  };
+
+  struct Program {
+    Rule rules[RULE_MAX_RULES];
+    uint8_t ruleCount;
+    uint8_t code[RULE_MAX_CODE];
+    uint16_t codeLen;
+    uint32_t timerMs[RULE_MAX_TIMERS];
+    uint8_t timerCount;
+    uint16_t peers[RULE_MAX_PEERS];
+    uint8_t peerCount;
+  };
+
+  struct Timer {
+    bool input;
+    bool output;
+    uint32_t since; // on(): input went true; off(): input went false
+  };
+
+  Program _prog;
+  Program _next; // Compile target, so a bad load keeps the current rules
+  Timer _timers[RULE_MAX_TIMERS];
+  uint32_t _states;
+  bool _evaluated;
+  uint32_t _deadline;
+  bool _hasDeadline;
+
+  bool runTimer(int index, bool on, bool input, uint32_t nowMs);
+
+  friend class RuleCompiler;
+};
+
+#endif
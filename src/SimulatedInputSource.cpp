@@ -0,0 +1,53 @@
+#include "SimulatedInputSource.h"
+
+SimulatedInputSource::SimulatedInputSource(int count, uint32_t seed,
+                                           uint32_t meanDwellMs,
+                                           uint32_t bounceMs)
+    : _count(count > 32 ? 32 : count), _rng(seed ? seed : 1),
+      _meanDwellMs(meanDwellMs ? meanDwellMs : 1), _bounceMs(bounceMs),
+      _levels(0xFFFFFFFF), _toggles(0), _started(false) {}
+
+bool SimulatedInputSource::begin() {
+  _started = false;
+  return _count > 0;
+}
+
+uint32_t SimulatedInputSource::nextRandom() {
+  // xorshift32
+  _rng ^= _rng << 13;
+  _rng ^= _rng >> 17;
+  _rng ^= _rng << 5;
+  return _rng;
+}
+
+void SimulatedInputSource::schedule(int input, uint32_t nowMs) {
+  // Uniform dwell in [mean/2, 3*mean/2)
+  _nextToggle[input] =
+      nowMs + _meanDwellMs / 2 + nextRandom() % (_meanDwellMs + 1);
+}
+
+uint32_t SimulatedInputSource::read(uint32_t nowMs) {
+  if (!_started) {
+    for (int i = 0; i < _count; i++) {
+      schedule(i, nowMs);
+      _bounceUntil[i] = nowMs;
+    }
+    _started = true;
+  }
+
+  uint32_t out = _levels;
+  for (int i = 0; i < _count; i++) {
+    if ((int32_t)(nowMs - _nextToggle[i]) >= 0) {
+      _levels ^= 1UL << i;
+      _toggles++;
+      _bounceUntil[i] = nowMs + _bounceMs;
+      schedule(i, nowMs);
+      out = (out & ~(1UL << i)) | (_levels & (1UL << i));
+    }
+    // Random chatter until the bounce period is over
+    if ((int32_t)(_bounceUntil[i] - nowMs) > 0 && (nextRandom() & 1)) {
+      out ^= 1UL << i;
+    }
+  }
+  return (_count == 32) ? out : out & ((1UL << _count) - 1);
+}
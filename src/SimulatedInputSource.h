@@ -0,0 +1,39 @@
+#ifndef SIMULATED_INPUT_SOURCE_H
+#define SIMULATED_INPUT_SOURCE_H
+
+#include "InputSource.h"
+
+// Deterministic stand-in for detector hardware, used to exercise the
+// sampling, debounce and publish pipeline without real inputs (on the
+// device with HSC_SIMULATED_INPUTS, or on the host for benchmarks).
+// Each input toggles after a pseudo-random dwell and chatters for up to
+// bounceMs around every toggle. No Arduino dependencies.
+class SimulatedInputSource : public InputSource {
+public:
+  SimulatedInputSource(int count, uint32_t seed, uint32_t meanDwellMs,
+                       uint32_t bounceMs);
+
+  bool begin() override;
+  int count() const override { return _count; }
+  uint32_t read(uint32_t nowMs) override;
+  const char *name() const override { return "simulated"; }
+
+  // Clean (post-bounce) level changes generated so far
+  uint32_t toggles() const { return _toggles; }
+
+private:
+  int _count;
+  uint32_t _rng;
+  uint32_t _meanDwellMs;
+  uint32_t _bounceMs;
+  uint32_t _levels;       // Settled levels
+  uint32_t _nextToggle[32];
+  uint32_t _bounceUntil[32];
+  uint32_t _toggles;
+  bool _started;
+
+  uint32_t nextRandom();
+  void schedule(int input, uint32_t nowMs);
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "TrackDebouncer.h"
+#include <string.h>
+
+TrackDebouncer::TrackDebouncer() {
+  memset(_ch, 0, sizeof(_ch));
+  for (int i = 0; i < MAX_TRACKS_PER_BOARD; i++) {
+    _ch[i].windowMs = DEBOUNCE_DELAY;
+    _ch[i].bounceMs = DEBOUNCE_DELAY;
+  }
+}
+
+void TrackDebouncer::reset(int ch, int raw, uint32_t nowMs) {
+  Channel &c = _ch[ch];
+  c.stable = raw;
+  c.lastRaw = raw;
+  c.inBurst = false;
+  c.burstStartMs = nowMs;
+  c.lastEdgeMs = nowMs;
+  c.changedAtUs = (int64_t)nowMs * 1000;
+}
+
+void TrackDebouncer::configure(int ch, uint16_t windowMs, bool adaptive) {
+  Channel &c = _ch[ch];
+  c.windowMs = windowMs;
+  c.adaptive = adaptive;
+  // Start the estimate so the adaptive window begins near windowMs
+  c.bounceMs = windowMs;
+}
+
+bool TrackDebouncer::update(int ch, int raw, uint32_t nowMs,
+                            int64_t edgeUs) {
+  Channel &c = _ch[ch];
+
+  if (raw != c.lastRaw) {
+    if (!c.inBurst) {
+      c.inBurst = true;
+      c.burstStartMs = nowMs;
+      c.burstStartUs = edgeUs ? edgeUs : (int64_t)nowMs * 1000;
+    }
+    c.lastEdgeMs = nowMs;
+    c.lastRaw = raw;
+  }
+
+  if (!c.inBurst || (nowMs - c.lastEdgeMs) <= c.windowMs)
+    return false;
+
+  // Input has been quiet for the whole window, the burst is over
+  c.inBurst = false;
+  if (c.adaptive) {
+    adapt(c, c.lastEdgeMs - c.burstStartMs);
+  }
+
+  if (raw != c.stable) {
+    c.stable = raw;
+    c.changedAtUs = c.burstStartUs;
+    return true;
+  }
+
+  // Signal bounced back to where it started: a glitch, not a transition
+  c.glitches++;
+  return false;
+}
+
+uint32_t TrackDebouncer::msUntilSettled(int count, uint32_t nowMs) const {
+  uint32_t wait = UINT32_MAX;
+  for (int i = 0; i < count; i++) {
+    const Channel &c = _ch[i];
+    if (!c.inBurst)
+      continue;
+    // update() ends the burst once more than windowMs has passed
+    uint32_t quiet = nowMs - c.lastEdgeMs;
+    uint32_t left = quiet > c.windowMs ? 0 : c.windowMs + 1 - quiet;
+    if (left < wait)
+      wait = left;
+  }
+  return wait;
+}
+
+void TrackDebouncer::adapt(Channel &c, uint32_t burstMs) {
+  if (burstMs > DEBOUNCE_MAX_MS)
+    burstMs = DEBOUNCE_MAX_MS;
+
+  // Fast attack so a dirty section is covered at once, slow decay so a
+  // single clean edge does not shrink the window
+  if (burstMs >= c.bounceMs) {
+    c.bounceMs = burstMs;
+  } else {
+    c.bounceMs -= (c.bounceMs - burstMs + 7) / 8;
+  }
+
+  uint32_t window = c.bounceMs + c.bounceMs / 2 + DEBOUNCE_MARGIN_MS;
+  if (window < DEBOUNCE_MIN_MS)
+    window = DEBOUNCE_MIN_MS;
+  if (window > DEBOUNCE_MAX_MS)
+    window = DEBOUNCE_MAX_MS;
+  c.windowMs = window;
+}
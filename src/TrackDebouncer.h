@@ -0,0 +1,64 @@
+#ifndef TRACK_DEBOUNCER_H
+#define TRACK_DEBOUNCER_H
+
+#include "config.h"
+#include <stdint.h>
+
+// Per-track debouncer with optional adaptive window and glitch counting.
+//
+// A burst starts at the first raw edge and ends once the input has been
+// quiet for the debounce window. If the input then differs from the stable
+// state the change is accepted; if it returned to the stable state the burst
+// is counted as a glitch. In adaptive mode the window tracks the observed
+// burst length (fast attack, slow decay) within [DEBOUNCE_MIN_MS,
+// DEBOUNCE_MAX_MS].
+class TrackDebouncer {
+public:
+  TrackDebouncer();
+
+  // Set the initial stable state of a channel
+  void reset(int ch, int raw, uint32_t nowMs);
+
+  // windowMs is the fixed window, or the starting point in adaptive mode
+  void configure(int ch, uint16_t windowMs, bool adaptive);
+
+  // Feed a raw sample; returns true when the debounced state changed.
+  // edgeUs is the captured time of the first edge since the last sample
+  // (esp_timer_get_time()), 0 to date a new burst by the sample instead.
+  bool update(int ch, int raw, uint32_t nowMs, int64_t edgeUs = 0);
+
+  // Time until the first burst among channels [0, count) can end, or
+  // UINT32_MAX if none is open. Between edges the result of update() only
+  // changes then, so sampling at that point matches sampling continuously.
+  uint32_t msUntilSettled(int count, uint32_t nowMs) const;
+
+  int state(int ch) const { return _ch[ch].stable; }
+  uint16_t windowMs(int ch) const { return _ch[ch].windowMs; }
+  uint16_t bounceMs(int ch) const { return _ch[ch].bounceMs; }
+  uint32_t glitchCount(int ch) const { return _ch[ch].glitches; }
+  bool isAdaptive(int ch) const { return _ch[ch].adaptive; }
+  // When the last accepted change happened: the first edge of the burst
+  // that settled in the new state (esp_timer_get_time() time base)
+  int64_t changedAtUs(int ch) const { return _ch[ch].changedAtUs; }
+
+private:
+  struct Channel {
+    uint8_t stable;
+    uint8_t lastRaw;
+    bool inBurst;
+    bool adaptive;
+    uint16_t windowMs;
+    uint16_t bounceMs; // Estimated bounce duration (adaptive mode)
+    uint32_t burstStartMs;
+    uint32_t lastEdgeMs;
+    uint32_t glitches;
+    int64_t burstStartUs;
+    int64_t changedAtUs;
+  };
+
+  Channel _ch[MAX_TRACKS_PER_BOARD];
+
+  void adapt(Channel &c, uint32_t burstMs);
+};
+
+#endif
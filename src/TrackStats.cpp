@@ -0,0 +1,151 @@
+#include "TrackStats.h"
+#include <string.h>
+
+TrackStats::TrackStats() { begin(0, nullptr, 0); }
+
+void TrackStats::begin(uint32_t nowMs, const bool *occupied, int count) {
+  _count = count;
+  memset(_buckets1m, 0, sizeof(_buckets1m));
+  memset(_buckets1h, 0, sizeof(_buckets1h));
+  memset(_buckets24h, 0, sizeof(_buckets24h));
+  memset(_dwell, 0, sizeof(_dwell));
+
+  // 1 min = 12 x 5 s, 1 h = 12 x 5 min, 24 h = 24 x 1 h
+  initWindow(_windows[STATS_WINDOW_1M], _buckets1m, 12, 1);
+  initWindow(_windows[STATS_WINDOW_1H], _buckets1h, 12, 60);
+  initWindow(_windows[STATS_WINDOW_24H], _buckets24h, 24, 720);
+
+  _slotStart = nowMs;
+  memset(_occupied, 0, sizeof(_occupied));
+  for (int t = 0; t < MAX_TRACKS_PER_BOARD; t++) {
+    _slotOccupiedMs[t] = 0;
+    _slotTransitions[t] = 0;
+    if (t < count)
+      _occupied[t] = occupied[t];
+    _lastMark[t] = nowMs;
+    _occupiedSince[t] = nowMs;
+  }
+}
+
+void TrackStats::initWindow(Window &w, Bucket *buckets, uint16_t bucketCount,
+                            uint16_t slotsPerBucket) {
+  w.buckets = buckets;
+  w.bucketCount = bucketCount;
+  w.slotsPerBucket = slotsPerBucket;
+  w.head = 0;
+  w.slotInBucket = 0;
+  w.filled = 1;
+  memset(w.occupiedSum, 0, sizeof(w.occupiedSum));
+  memset(w.transitionSum, 0, sizeof(w.transitionSum));
+}
+
+void TrackStats::onTransition(int track, bool occupied, uint32_t nowMs) {
+  if (track < 0 || track >= _count ||
+      _occupied[track] == occupied)
+    return;
+
+  // Only this track is touched: closing slots is left to tick(). An edge
+  // seen after the slot ended but before loop() closed it is booked at the
+  // slot end, at most one loop pass early.
+  uint32_t slotEnd = _slotStart + STATS_SLOT_MS;
+  if (nowMs - _slotStart >= STATS_SLOT_MS)
+    nowMs = slotEnd;
+
+  if (_occupied[track]) {
+    _slotOccupiedMs[track] += nowMs - _lastMark[track];
+    _dwell[track][dwellBin(nowMs - _occupiedSince[track])]++;
+  } else {
+    _occupiedSince[track] = nowMs;
+  }
+  _lastMark[track] = nowMs;
+  _occupied[track] = occupied;
+  _slotTransitions[track]++;
+}
+
+void TrackStats::tick(uint32_t nowMs) {
+  while (nowMs - _slotStart >= STATS_SLOT_MS) {
+    uint32_t slotEnd = _slotStart + STATS_SLOT_MS;
+    for (int t = 0; t < _count; t++) {
+      if (_occupied[t]) {
+        _slotOccupiedMs[t] += slotEnd - _lastMark[t];
+        _lastMark[t] = slotEnd;
+      }
+    }
+    closeSlot();
+    _slotStart = slotEnd;
+  }
+}
+
+void TrackStats::closeSlot() {
+  for (int i = 0; i < STATS_WINDOW_COUNT; i++) {
+    Window &w = _windows[i];
+    Bucket *head = &w.buckets[w.head * MAX_TRACKS_PER_BOARD];
+    for (int t = 0; t < _count; t++) {
+      uint16_t ds = (_slotOccupiedMs[t] + 50) / 100;
+      head[t].occupiedDs += ds;
+      head[t].transitions += _slotTransitions[t];
+      w.occupiedSum[t] += ds * 100;
+      w.transitionSum[t] += _slotTransitions[t];
+    }
+
+    if (++w.slotInBucket < w.slotsPerBucket)
+      continue;
+
+    // Advance to the next bucket, expiring the oldest once the ring is full
+    w.slotInBucket = 0;
+    w.head = (w.head + 1) % w.bucketCount;
+    if (w.filled < w.bucketCount) {
+      w.filled++;
+    } else {
+      Bucket *oldest = &w.buckets[w.head * MAX_TRACKS_PER_BOARD];
+      for (int t = 0; t < _count; t++) {
+        w.occupiedSum[t] -= oldest[t].occupiedDs * 100;
+        w.transitionSum[t] -= oldest[t].transitions;
+        oldest[t].occupiedDs = 0;
+        oldest[t].transitions = 0;
+      }
+    }
+  }
+
+  memset(_slotOccupiedMs, 0, sizeof(_slotOccupiedMs));
+  memset(_slotTransitions, 0, sizeof(_slotTransitions));
+}
+
+void TrackStats::get(int track, StatsWindowId window, uint32_t nowMs,
+                     TrackWindowStats &out) const {
+  const Window &w = _windows[window];
+  uint32_t bucketMs = w.slotsPerBucket * STATS_SLOT_MS;
+
+  out.windowMs = (w.filled - 1) * bucketMs + w.slotInBucket * STATS_SLOT_MS +
+                 (nowMs - _slotStart);
+  out.occupiedMs = w.occupiedSum[track] + _slotOccupiedMs[track];
+  if (_occupied[track]) {
+    out.occupiedMs += nowMs - _lastMark[track];
+  }
+  if (out.occupiedMs > out.windowMs) {
+    out.occupiedMs = out.windowMs;
+  }
+  out.transitions = w.transitionSum[track] + _slotTransitions[track];
+}
+
+const char *TrackStats::windowName(StatsWindowId window) {
+  switch (window) {
+  case STATS_WINDOW_1M:
+    return "1m";
+  case STATS_WINDOW_1H:
+    return "1h";
+  case STATS_WINDOW_24H:
+    return "24h";
+  default:
+    return "";
+  }
+}
+
+int TrackStats::dwellBin(uint32_t ms) {
+  uint32_t seconds = ms / 1000;
+  if (seconds == 0)
+    return 0;
+  // floor(log2(seconds)) + 1
+  int bin = 32 - __builtin_clz(seconds);
+  return (bin < STATS_DWELL_BINS) ? bin : STATS_DWELL_BINS - 1;
+}
@@ -0,0 +1,95 @@
+#ifndef TRACK_STATS_H
+#define TRACK_STATS_H
+
+#include "config.h"
+#include <stdint.h>
+
+// Incremental per-track occupancy statistics.
+// Occupied time and transitions are accumulated into a 5 second slot which
+// is folded into three bucketed rolling windows (1 min, 1 h, 24 h) when it
+// closes. Every update is O(1) per event and all storage is fixed-size.
+
+enum StatsWindowId {
+  STATS_WINDOW_1M = 0,
+  STATS_WINDOW_1H = 1,
+  STATS_WINDOW_24H = 2,
+  STATS_WINDOW_COUNT = 3
+};
+
+// Dwell histogram bins: <1s, 1-2s, 2-4s, ... 512-1024s, >=1024s
+static const int STATS_DWELL_BINS = 12;
+static const uint32_t STATS_SLOT_MS = 5000;
+
+struct TrackWindowStats {
+  uint32_t occupiedMs;  // Time spent occupied inside the window
+  uint32_t windowMs;    // Time actually covered (shorter right after boot)
+  uint32_t transitions; // FREE->OCCUPIED and OCCUPIED->FREE changes
+};
+
+class TrackStats {
+public:
+  TrackStats();
+
+  // Start accounting for count tracks with their current debounced states
+  void begin(uint32_t nowMs, const bool *occupied, int count);
+
+  // Feed a debounced transition; O(1), only the track's own slot changes
+  void onTransition(int track, bool occupied, uint32_t nowMs);
+
+  // Close elapsed slots; call regularly from loop()
+  void tick(uint32_t nowMs);
+
+  void get(int track, StatsWindowId window, uint32_t nowMs,
+           TrackWindowStats &out) const;
+
+  // Dwell-time histogram of all occupancies completed since begin(); not
+  // windowed, reported as "lifetime"
+  const uint32_t *dwellHistogram(int track) const { return _dwell[track]; }
+
+  bool isOccupied(int track) const { return _occupied[track]; }
+  int count() const { return _count; }
+
+  static const char *windowName(StatsWindowId window);
+
+private:
+  // 4 bytes per track per bucket; occupied time is kept in 100 ms units
+  // (a 1 h bucket holds at most 36000)
+  struct Bucket {
+    uint16_t occupiedDs;
+    uint16_t transitions;
+  };
+
+  struct Window {
+    Bucket *buckets; // bucketCount rows of MAX_TRACKS_PER_BOARD
+    uint16_t bucketCount;
+    uint16_t slotsPerBucket;
+    uint16_t head;         // Bucket currently being filled
+    uint16_t slotInBucket; // Slots already folded into head
+    uint16_t filled;       // Buckets in use (<= bucketCount)
+    uint32_t occupiedSum[MAX_TRACKS_PER_BOARD];
+    uint32_t transitionSum[MAX_TRACKS_PER_BOARD];
+  };
+
+  Bucket _buckets1m[12 * MAX_TRACKS_PER_BOARD];
+  Bucket _buckets1h[12 * MAX_TRACKS_PER_BOARD];
+  Bucket _buckets24h[24 * MAX_TRACKS_PER_BOARD];
+  Window _windows[STATS_WINDOW_COUNT];
+  int _count;
+
+  // Current slot accumulators
+  uint32_t _slotStart;
+  uint32_t _slotOccupiedMs[MAX_TRACKS_PER_BOARD];
+  uint16_t _slotTransitions[MAX_TRACKS_PER_BOARD];
+
+  bool _occupied[MAX_TRACKS_PER_BOARD];
+  uint32_t _lastMark[MAX_TRACKS_PER_BOARD];      // Last occupied-time accrual
+  uint32_t _occupiedSince[MAX_TRACKS_PER_BOARD]; // Start of current dwell
+  uint32_t _dwell[MAX_TRACKS_PER_BOARD][STATS_DWELL_BINS];
+
+  void initWindow(Window &w, Bucket *buckets, uint16_t bucketCount,
+                  uint16_t slotsPerBucket);
+  void closeSlot();
+  static int dwellBin(uint32_t ms);
+};
+
+#endif
@@ -1,42 +1,49 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
-// Override the board type from the library defaults
-// This identifies what type of device this is
-#undef BOARD_TYPE_DESC
-#undef BOARD_TYPE_SHORT
-
-static const char BOARD_TYPE_DESC[] =
-    "HSC YARD Device"; // Full description for web UI
-static const char BOARD_TYPE_SHORT[] =
-    "YARD"; // Short name for MQTT (e.g., "BASE-1", "YARD-2", "SIGNAL-3")
-
-// --- Pin Definitions ---
-// Matches the plan: 32, 33, 25, 26, 27, 14
-static const int PIN_TRACK_1 = 32;
-static const int PIN_TRACK_2 = 33;
-static const int PIN_TRACK_3 = 25;
-static const int PIN_TRACK_4 = 26;
-static const int PIN_TRACK_5 = 27;
-static const int PIN_TRACK_6 = 14;
-static const int PIN_TRACK_7 = 12;
-static const int PIN_TRACK_8 = 13;
-
-// Array for easier iteration
-static const int TRACK_PINS[] = {PIN_TRACK_1, PIN_TRACK_2, PIN_TRACK_3,
-                                 PIN_TRACK_4, PIN_TRACK_5, PIN_TRACK_6,
-                                 PIN_TRACK_7, PIN_TRACK_8};
-static const int NUM_TRACKS_PER_BOARD = 8;
-
-// Debounce time in milliseconds
-const unsigned long DEBOUNCE_DELAY = 50;
+#include <DeviceProfile.h>
+
+// --- Device Profile ---
+// Native track pins, matching the plan: 32, 33, 25, 26, 27, 14, 12, 13.
+// The default pin map, used until a runtime map is saved in Config.
+static constexpr uint8_t TRACK_PINS[] = {32, 33, 25, 26, 27, 14, 12, 13};
+
+static constexpr DeviceProfile DEVICE_PROFILE(
+    "HSC YARD Device", // Full description for web UI
+    "YARD",            // Short name for MQTT and OTA (e.g. "YARD", "SIGNAL")
+    "0.2.0",           // Firmware version
+    "HSC/yard",        // Prefix of the track topics
+    TRACK_PINS,
+    64, // Largest track count supported, native pins plus expanders
+    50, // Default debounce time in ms (per-track values live in Config)
+    DEVICE_FEATURE_EXPANDERS | DEVICE_FEATURE_TRACK_STATS);
+
+static_assert(DEVICE_PROFILE.pinsValid(),
+              "TRACK_PINS holds a GPIO that cannot be a track input");
+static_assert(DEVICE_PROFILE.pinsUnique(), "TRACK_PINS repeats a GPIO");
+static_assert(DEVICE_PROFILE.trackCount <= DEVICE_PROFILE.maxTracks,
+              "More native pins than tracks");
+
+// Sizes the state arrays
+static const int MAX_TRACKS_PER_BOARD = DEVICE_PROFILE.maxTracks;
+
+// --- Input Expanders ---
+// MCP23017 expanders found at 0x20-0x22 on the I2C bus at boot add 16
+// inputs each, numbered after the native track pins
+static const int PIN_I2C_SDA = 21;
+static const int PIN_I2C_SCL = 22;
+// Shared open-drain INT line of the expanders (-1 = poll the bus every loop)
+static const int PIN_EXPANDER_INT = -1;
+
+// Uncomment to replace all inputs with a simulated 64-input board
+// #define HSC_SIMULATED_INPUTS
+
+const unsigned long DEBOUNCE_DELAY = DEVICE_PROFILE.debounceMs;
+// Safety margin for the adaptive debounce window, which stays within
+// DEBOUNCE_MIN_MS..DEBOUNCE_MAX_MS (HSC_Base config.h)
+const unsigned long DEBOUNCE_MARGIN_MS = 5;
 // --- OTA Update ---
 static const char *UPDATE_URL =
     "http://www-srvr.internal/firmware/firmware_%BOARD_TYPE%.bin";
 
-// You can also override other defaults from lib/HSC_Base/src/config.h here
-// For example:
-#undef FW_VERSION
-static const char FW_VERSION[] = "0.2.0";
-
 #endif
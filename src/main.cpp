@@ -1,15 +1,64 @@
+#include "EdgeCapture.h"
+#include "GpioInputSource.h"
+#include "InputSource.h"
+#include "Mcp23x17InputSource.h"
+#include "PowerSaver.h"
+#include "RuleEngine.h"
+#include "SimulatedInputSource.h"
+#include "TrackDebouncer.h"
+#include "TrackStats.h"
 #include "config.h"
 #include <HSC_Base.h>
 #include <SPIFFS.h>
+#include <Wire.h>
+#include <esp_timer.h>
 
-HSC_Base hscBase;
+HSC_Base hscBase(DEVICE_PROFILE);
+
+static_assert(MAX_TRACKS_PER_BOARD <= MAX_TRACK_INPUTS,
+              "Config cannot hold MAX_TRACKS_PER_BOARD tracks");
+static_assert(MAX_TRACKS_PER_BOARD <= MAX_INPUTS,
+              "InputBank cannot hold MAX_TRACKS_PER_BOARD inputs");
+
+// Input sources: native GPIOs first, then any detected expanders
+InputBank inputs;
+GpioInputSource gpioInputs;
+#ifdef HSC_SIMULATED_INPUTS
+SimulatedInputSource simulatedInputs[] = {
+    {16, 1, 20000, 30}, {16, 2, 20000, 30}, {16, 3, 20000, 30},
+    {16, 4, 20000, 30}};
+#else
+Mcp23x17InputSource expanders[] = {{Wire, 0x20, PIN_EXPANDER_INT},
+                                   {Wire, 0x21, PIN_EXPANDER_INT},
+                                   {Wire, 0x22, PIN_EXPANDER_INT}};
+#endif
+int trackCount = 0;
 
 // State tracking
-int lastState[NUM_TRACKS_PER_BOARD] = {LOW};
-unsigned long lastDebounceTime[NUM_TRACKS_PER_BOARD] = {0};
-int buttonState[NUM_TRACKS_PER_BOARD] = {LOW};
+TrackDebouncer debouncer;
+
+// Occupancy statistics, only allocated when the profile has them
+TrackStats *trackStats = nullptr;
+unsigned long lastStatsPublish = 0;
+static const unsigned long STATS_PUBLISH_INTERVAL = 60000;
+
+// Interrupt timestamps for the native pins
+EdgeCapture edgeCapture;
+
+// Derived states from Config rules, or pushed to the rules topic
+RuleEngine rules;
+String rulesSource;
+String rulesError;
+bool peersChanged = false;
 
-bool wasConnected = false;
+// Low-power sensing (Config low_power)
+PowerSaver powerSaver;
+uint32_t maxSleepMs = POWER_MAX_SLEEP_MS;
+
+// Supervised by HSC_Base: the watchdog resets the board when inputs have
+// not been sampled for this long
+int sensingSection = -1;
+static const uint32_t SENSING_STALL_MS = 2000;
 
 void publishTrackState(int trackIndex, int state) {
   if (hscBase.getConfig().board_id == 0)
@@ -18,9 +67,11 @@ void publishTrackState(int trackIndex, int state) {
   // Transposed Logic from YardDetector:
   // trackIndex corresponds to TRACK index (0-5 -> Track 1-6)
   // BOARD_ID corresponds to SECTION ID
-  String topic = "HSC/yard/track/" + String(trackIndex + 1) + "/section/" +
-                 String(hscBase.getConfig().board_id);
-  String payload = (state == LOW) ? "OCCUPIED" : "FREE";
+  char topic[64];
+  snprintf(topic, sizeof(topic), "%s/track/%d/section/%d",
+           DEVICE_PROFILE.topicPrefix, trackIndex + 1,
+           hscBase.getConfig().board_id);
+  const char *payload = (state == LOW) ? "OCCUPIED" : "FREE";
 
   Serial.print("Publishing to ");
   Serial.print(topic);
@@ -28,38 +79,499 @@ void publishTrackState(int trackIndex, int state) {
   Serial.println(payload);
 
   if (hscBase.getMqttClient().connected()) {
-    hscBase.getMqttClient().publish(topic.c_str(), payload.c_str(),
-                                    true); // Retained
+    // Retained, QoS 1: resent until the broker acknowledges it
+    hscBase.getMqttClient().publish(topic, payload, true, 1);
   }
 }
 
+// Timestamped transition, non-retained. edgeUs is esp_timer time; the
+// UTC time is left out until NTP has synced.
+void publishTrackEvent(int trackIndex, int state, int64_t edgeUs) {
+  if (hscBase.getConfig().board_id == 0 ||
+      !hscBase.getMqttClient().connected())
+    return;
+
+  char topic[64];
+  snprintf(topic, sizeof(topic), "%s/track/%d/section/%d/event",
+           DEVICE_PROFILE.topicPrefix, trackIndex + 1,
+           hscBase.getConfig().board_id);
+
+  ClockService &clock = hscBase.getClock();
+  int64_t now = clock.monoMicros();
+  StaticJsonDocument<160> doc;
+  doc["state"] = (state == LOW) ? "OCCUPIED" : "FREE";
+  if (clock.synced())
+    doc["time_us"] = clock.utcAt(edgeUs);
+  doc["uptime_us"] = edgeUs;
+  doc["delay_us"] = now - edgeUs;
+
+  char buffer[160];
+  serializeJson(doc, buffer);
+  hscBase.getMqttClient().publish(topic, buffer, false, 1);
+}
+
+// Debounced occupancy, bit i = track i occupied
+uint64_t occupancyMask() {
+  uint64_t mask = 0;
+  for (int i = 0; i < trackCount; i++) {
+    if (debouncer.state(i) == LOW)
+      mask |= 1ULL << i;
+  }
+  return mask;
+}
+
 void publishAllTracks() {
   Serial.println("Publishing all track states...");
-  for (int i = 0; i < NUM_TRACKS_PER_BOARD; i++) {
-    publishTrackState(i, buttonState[i]);
+  for (int i = 0; i < trackCount; i++) {
+    publishTrackState(i, debouncer.state(i));
+  }
+}
+
+// <prefix>/section/<id>/rules, where a controller pushes rule source
+void rulesTopic(char *topic, size_t size) {
+  snprintf(topic, size, "%s/section/%d/rules", DEVICE_PROFILE.topicPrefix,
+           hscBase.getConfig().board_id);
+}
+
+void publishRuleState(int rule) {
+  if (hscBase.getConfig().board_id == 0 ||
+      !hscBase.getMqttClient().connected())
+    return;
+
+  char topic[96];
+  snprintf(topic, sizeof(topic), "%s/section/%d/rule/%s",
+           DEVICE_PROFILE.topicPrefix, hscBase.getConfig().board_id,
+           rules.name(rule));
+  // Retained, QoS 1 like the track states
+  hscBase.getMqttClient().publish(topic, rules.state(rule) ? "ON" : "OFF",
+                                  true, 1);
+}
+
+// Run the rules over our and the neighbours' occupancy and publish the
+// states that changed
+void evaluateRules() {
+  uint64_t peerMasks[RULE_MAX_PEERS];
+  for (int k = 0; k < rules.peerCount(); k++) {
+    const PeerState *peer = hscBase.getPeers().peer(rules.peerBoard(k));
+    peerMasks[k] = (peer && peer->online) ? peer->mask : 0;
+  }
+
+  uint32_t changed = rules.evaluate(occupancyMask(), peerMasks, millis());
+  for (int r = 0; r < rules.count(); r++) {
+    if ((changed >> r) & 1) {
+      Serial.printf("Rule %s: %s\n", rules.name(r),
+                    rules.state(r) ? "ON" : "OFF");
+      publishRuleState(r);
+    }
+  }
+}
+
+// Compile and switch to new rules; on error the current ones stay
+bool loadRules(const String &source) {
+  if (source == rulesSource)
+    return true;
+  char error[96];
+  if (!rules.load(source.c_str(), error, sizeof(error))) {
+    rulesError = error;
+    Serial.println("Rules: " + rulesError);
+    return false;
+  }
+  rulesSource = source;
+  rulesError = "";
+  Serial.printf("Rules: %d loaded, %d bytes of code\n", rules.count(),
+                rules.codeSize());
+  evaluateRules();
+  return true;
+}
+
+// Debounce windows from Config; safe to repeat while running
+void configureDebounce() {
+  const Config &config = hscBase.getConfig();
+  for (int i = 0; i < trackCount; i++) {
+    uint16_t window = config.debounce_ms[i] ? config.debounce_ms[i]
+                                            : DEBOUNCE_DELAY;
+    debouncer.configure(i, window, config.debounce_adaptive[i]);
   }
 }
 
+void onMqttConnect() {
+  publishAllTracks();
+  for (int r = 0; r < rules.count(); r++) {
+    publishRuleState(r);
+  }
+  if (hscBase.getConfig().board_id != 0) {
+    char topic[64];
+    rulesTopic(topic, sizeof(topic));
+    hscBase.getMqttClient().subscribe(topic, 1);
+  }
+}
+
+// Rules pushed over MQTT replace the ones from Config until the next boot
+// (the topic is normally retained, so they come back on connect)
+void handleMqttMessage(const char *topic, const uint8_t *payload,
+                       unsigned int length) {
+  char expected[64];
+  rulesTopic(expected, sizeof(expected));
+  if (strcmp(topic, expected) != 0)
+    return;
+
+  String source;
+  source.reserve(length);
+  for (unsigned int i = 0; i < length; i++) {
+    source += (char)payload[i];
+  }
+  bool ok = loadRules(source);
+
+  StaticJsonDocument<192> doc;
+  doc["ok"] = ok;
+  doc["rules"] = rules.count();
+  if (!ok)
+    doc["error"] = rulesError;
+  char buffer[192];
+  serializeJson(doc, buffer);
+  char statusTopic[72];
+  snprintf(statusTopic, sizeof(statusTopic), "%s/status", expected);
+  hscBase.getMqttClient().publish(statusTopic, buffer, false);
+}
+
+// Percentage of the window spent occupied, one decimal place
+float dutyPercent(const TrackWindowStats &ws) {
+  if (ws.windowMs == 0)
+    return 0;
+  return roundf(ws.occupiedMs * 1000.0f / ws.windowMs) / 10.0f;
+}
+
+// Transitions per hour over the window
+float transitionRate(const TrackWindowStats &ws) {
+  if (ws.windowMs == 0)
+    return 0;
+  return roundf(ws.transitions * 36000000.0f / ws.windowMs) / 10.0f;
+}
+
+void publishTrackStats() {
+  if (hscBase.getConfig().board_id == 0 ||
+      !hscBase.getMqttClient().connected())
+    return;
+
+  uint32_t now = millis();
+  for (int i = 0; i < trackCount; i++) {
+    char topic[64];
+    snprintf(topic, sizeof(topic), "%s/track/%d/section/%d/stats",
+             DEVICE_PROFILE.topicPrefix, i + 1, hscBase.getConfig().board_id);
+
+    // Written into a stack buffer: nothing allocated for 64 tracks a cycle
+    char buffer[128];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject();
+    TrackWindowStats ws;
+    for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+      char key[12];
+      snprintf(key, sizeof(key), "duty_%s",
+               TrackStats::windowName((StatsWindowId)w));
+      trackStats->get(i, (StatsWindowId)w, now, ws);
+      json.add(key, dutyPercent(ws), 1);
+    }
+    trackStats->get(i, STATS_WINDOW_1H, now, ws);
+    json.add("transitions_1h", ws.transitions);
+    json.add("rate_1h", transitionRate(ws), 1);
+    json.endObject();
+    if (json.overflowed())
+      continue;
+
+    hscBase.getMqttClient().publish(topic, buffer, false);
+  }
+}
+
+void handleTrackStats(AsyncWebServerRequest *request) {
+  // About 400 bytes of JSON per track are buffered in the stream;
+  // statistics wait for the heap to recover
+  if (hscBase.getHeap().shedding()) {
+    request->send(503, "application/json",
+                  "{\"status\":\"error\",\"message\":\"Statistics "
+                  "unavailable while memory is low\"}");
+    return;
+  }
+  AsyncResponseStream *response =
+      request->beginResponseStream("application/json");
+  JsonWriter json(*response);
+
+  uint32_t now = millis();
+  json.beginObject();
+  json.add("uptime_ms", now);
+  json.beginArray("tracks");
+  for (int i = 0; i < trackCount; i++) {
+    json.beginObject();
+    json.add("track", i + 1);
+    json.add("occupied", trackStats->isOccupied(i));
+
+    json.beginObject("windows");
+    for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+      TrackWindowStats ws;
+      trackStats->get(i, (StatsWindowId)w, now, ws);
+      json.beginObject(TrackStats::windowName((StatsWindowId)w));
+      json.add("window_ms", ws.windowMs);
+      json.add("occupied_ms", ws.occupiedMs);
+      json.add("duty", dutyPercent(ws), 1);
+      json.add("transitions", ws.transitions);
+      json.add("rate_per_hour", transitionRate(ws), 1);
+      json.endObject();
+    }
+    json.endObject();
+
+    // Not windowed: counts every occupancy since boot
+    json.add("dwell_window", "lifetime");
+    json.beginArray("dwell_histogram");
+    const uint32_t *bins = trackStats->dwellHistogram(i);
+    for (int b = 0; b < STATS_DWELL_BINS; b++) {
+      json.value(bins[b]);
+    }
+    json.endArray();
+    json.endObject();
+  }
+  json.endArray();
+  json.endObject();
+
+  request->send(response);
+}
+
+// Add the source of an input (native pin or expander channel)
+void describeInput(int input, JsonWriter &json) {
+  for (int s = inputs.sourceCount() - 1; s >= 0; s--) {
+    int offset = inputs.sourceOffset(s);
+    if (input < offset)
+      continue;
+    InputSource *source = inputs.source(s);
+    json.add("source", source->name());
+    if (source == &gpioInputs) {
+      json.add("pin", gpioInputs.pin(input - offset));
+    } else {
+      json.add("channel", input - offset);
+    }
+    return;
+  }
+}
+
+void handleTracks(AsyncWebServerRequest *request) {
+  AsyncResponseStream *response =
+      request->beginResponseStream("application/json");
+  JsonWriter json(*response);
+
+  json.beginObject();
+  json.beginArray("tracks");
+  for (int i = 0; i < trackCount; i++) {
+    json.beginObject();
+    json.add("track", i + 1);
+    describeInput(i, json);
+    json.add("state", (debouncer.state(i) == LOW) ? "OCCUPIED" : "FREE");
+    json.add("adaptive", debouncer.isAdaptive(i));
+    json.add("debounce_ms", debouncer.windowMs(i));
+    json.add("bounce_ms", debouncer.bounceMs(i));
+    json.add("glitches", debouncer.glitchCount(i));
+    json.endObject();
+  }
+  json.endArray();
+  json.endObject();
+
+  request->send(response);
+}
+
+void handleRules(AsyncWebServerRequest *request) {
+  AsyncResponseStream *response =
+      request->beginResponseStream("application/json");
+  DynamicJsonDocument doc(64 * RULE_MAX_RULES + rulesSource.length() + 256);
+
+  doc["source"] = rulesSource;
+  if (rulesError.length() > 0)
+    doc["error"] = rulesError;
+  doc["code_bytes"] = rules.codeSize();
+  JsonArray list = doc.createNestedArray("rules");
+  for (int r = 0; r < rules.count(); r++) {
+    JsonObject rule = list.createNestedObject();
+    rule["name"] = rules.name(r);
+    rule["state"] = rules.state(r) ? "ON" : "OFF";
+  }
+
+  serializeJson(doc, *response);
+  request->send(response);
+}
+
+void handlePower(AsyncWebServerRequest *request) {
+  AsyncResponseStream *response =
+      request->beginResponseStream("application/json");
+  StaticJsonDocument<384> doc;
+
+  PowerStats st = powerSaver.stats();
+  doc["low_power"] = powerSaver.enabled();
+  doc["light_sleep"] = st.lightSleep;
+  doc["max_sleep_ms"] = maxSleepMs;
+  doc["edge_wakes"] = st.edgeWakes;
+  doc["timer_wakes"] = st.timerWakes;
+  doc["wake_us_last"] = st.lastWakeUs;
+  doc["wake_us_max"] = st.maxWakeUs;
+  doc["wake_us_avg"] = st.avgWakeUs;
+  doc["awake_percent"] = roundf(st.awakePercent * 10) / 10.0f;
+  doc["current_ma_est"] = roundf(st.averageMa * 10) / 10.0f;
+
+  serializeJson(doc, *response);
+  request->send(response);
+}
+
+// Select the runtime pin map if one is saved and valid, else the defaults
+void loadPinMap() {
+  const Config &config = hscBase.getConfig();
+  String error;
+  if (config.num_tracks > 0 &&
+      ConfigManager::validateTrackPins(config.track_pins, config.num_tracks,
+                                       error)) {
+    gpioInputs.setPins(config.track_pins, config.num_tracks);
+    Serial.printf("Using runtime pin map (%d tracks)\n", config.num_tracks);
+    return;
+  }
+
+  if (config.num_tracks > 0) {
+    Serial.println("Invalid pin map in config (" + error +
+                   "), using defaults");
+  }
+  gpioInputs.setPins(DEVICE_PROFILE.trackPins, DEVICE_PROFILE.trackCount);
+}
+
+// Build the input bank from native pins and any expanders on the I2C bus
+void setupInputs() {
+#ifdef HSC_SIMULATED_INPUTS
+  Serial.println("Using simulated inputs");
+  for (SimulatedInputSource &sim : simulatedInputs) {
+    inputs.add(&sim);
+  }
+#else
+  loadPinMap();
+  inputs.add(&gpioInputs);
+
+  // Expanders only if the profile has them, and never on a bus whose pins
+  // the pin map claims
+  bool i2cFree = DEVICE_PROFILE.has(DEVICE_FEATURE_EXPANDERS);
+  for (int i = 0; i < gpioInputs.count(); i++) {
+    if (gpioInputs.pin(i) == PIN_I2C_SDA || gpioInputs.pin(i) == PIN_I2C_SCL)
+      i2cFree = false;
+  }
+  if (i2cFree) {
+    Wire.begin(PIN_I2C_SDA, PIN_I2C_SCL, 400000);
+    for (Mcp23x17InputSource &expander : expanders) {
+      if (Mcp23x17InputSource::probe(Wire, expander.address())) {
+        Serial.printf("Found %s\n", expander.name());
+        inputs.add(&expander);
+      }
+    }
+  }
+#endif
+
+  inputs.begin();
+
+  // Date native pin edges in their interrupt. Only when the GPIO source
+  // survived begin(), so that its inputs are still 0..n-1.
+  if (inputs.sourceCount() > 0 && inputs.source(0) == &gpioInputs) {
+    uint8_t pins[EDGE_MAX_PINS];
+    int count = 0;
+    for (int i = 0; i < gpioInputs.count() && i < EDGE_MAX_PINS; i++) {
+      pins[count++] = gpioInputs.pin(i);
+    }
+    edgeCapture.begin(pins, count);
+  }
+
+  trackCount = inputs.count();
+  if (trackCount > MAX_TRACKS_PER_BOARD)
+    trackCount = MAX_TRACKS_PER_BOARD;
+  Serial.printf("%d track inputs from %d sources\n", trackCount,
+                inputs.sourceCount());
+}
+
+// Wake on the native pins and the expanders' INT line. Expanders without
+// one have to be polled, which keeps the loop at one pass per tick.
+void setupLowPower() {
+#ifdef HSC_SIMULATED_INPUTS
+  Serial.println("Low power: not available with simulated inputs");
+#else
+  if (inputs.sourceCount() > 1) {
+    if (PIN_EXPANDER_INT >= 0)
+      edgeCapture.addWakePin(PIN_EXPANDER_INT);
+    else
+      maxSleepMs = 1;
+  }
+  powerSaver.begin(edgeCapture);
+#endif
+}
+
 void setup() {
   // Initialize the HSC_Base library
-  hscBase.setBoardInfo(BOARD_TYPE_DESC, BOARD_TYPE_SHORT, FW_VERSION);
   hscBase.setUpdateUrl(UPDATE_URL);
   hscBase.begin();
+  sensingSection =
+      hscBase.getSupervisor().addSection("sensing", SENSING_STALL_MS);
+  setupInputs();
+  if (hscBase.getConfig().low_power)
+    setupLowPower();
 
-  // Initialize Pins
-  for (int i = 0; i < NUM_TRACKS_PER_BOARD; i++) {
-    // OI-IB-8 uses open-collector/active-low output:
-    // - When train is present (OCCUPIED): pulls pin to GND (LOW)
-    // - When no train (FREE): releases pin (floating)
-    // INPUT_PULLUP pulls the pin HIGH when floating, LOW when grounded
-    pinMode(TRACK_PINS[i], INPUT_PULLUP);
+  // Initialize state
+  uint64_t levels = inputs.sample(millis());
+  configureDebounce();
+  for (int i = 0; i < trackCount; i++) {
+    debouncer.reset(i, (levels >> i) & 1, millis());
+  }
 
-    // Initialize state
-    int reading = digitalRead(TRACK_PINS[i]);
-    lastState[i] = reading;
-    buttonState[i] = reading;
+  if (DEVICE_PROFILE.has(DEVICE_FEATURE_TRACK_STATS)) {
+    bool occupied[MAX_TRACKS_PER_BOARD];
+    for (int i = 0; i < trackCount; i++) {
+      occupied[i] = (debouncer.state(i) == LOW);
+    }
+    trackStats = new TrackStats();
+    trackStats->begin(millis(), occupied, trackCount);
   }
 
+  // Neighbouring sections over the peer link (Config peer_link)
+  hscBase.getPeers().publish(occupancyMask(), trackCount);
+  hscBase.getPeers().onState([](const PeerState &peer) {
+    Serial.printf("Section %u %s: occupancy %llx (changed %llx)\n",
+                  peer.boardId, peer.online ? "online" : "offline",
+                  (unsigned long long)peer.mask,
+                  (unsigned long long)peer.changed);
+    peersChanged = true;
+  });
+  loadRules(hscBase.getConfig().rules);
+
+  // Only take part in a fleet rollout while no track is occupied
+  hscBase.setIdleCallback([]() {
+    for (int i = 0; i < trackCount; i++) {
+      if (debouncer.state(i) == LOW)
+        return false;
+    }
+    return true;
+  });
+
+  // Republish on every connect, including a broker switch-over; states the
+  // broker already holds are skipped
+  hscBase.setMqttConnectHandler(onMqttConnect);
+  hscBase.setMqttMessageHandler(handleMqttMessage);
+
+  // Settings from a provisioning bundle that apply without a reboot
+  hscBase.setConfigHandler([]() {
+    configureDebounce();
+    loadRules(hscBase.getConfig().rules);
+  });
+
+  // Occupancy statistics (duty cycle, transition rate, dwell histogram).
+  // Registered before /api/tracks: a handler also takes every URL below its
+  // own, and the first one registered wins.
+  if (trackStats)
+    hscBase.registerApi("/api/tracks/stats", HTTP_GET, handleTrackStats);
+
+  // Track states with debounce window and glitch counters
+  hscBase.registerApi("/api/tracks", HTTP_GET, handleTracks);
+
+  // Rule source, compile error and derived states
+  hscBase.registerApi("/api/rules", HTTP_GET, handleRules);
+
+  // Low-power mode, wake latency and estimated current
+  hscBase.registerApi("/api/power", HTTP_GET, handlePower);
+
   // Register device-specific page
   hscBase.registerPage("/device", [](AsyncWebServerRequest *request) {
     request->send(
@@ -72,30 +584,55 @@ void loop() {
   // Run the HSC_Base loop
   hscBase.loop();
 
-  // Handle MQTT Connection State Changes
-  bool isConnected = hscBase.getMqttClient().connected();
-  if (isConnected && !wasConnected) {
-    // Just connected
-    publishAllTracks();
-  }
-  wasConnected = isConnected;
-
-  // Read Pins
-  for (int i = 0; i < NUM_TRACKS_PER_BOARD; i++) {
-    int reading = digitalRead(TRACK_PINS[i]);
+  // Read Inputs. Edges are taken before sampling so that any edge behind
+  // a level is included; inputs without one are dated by the sample.
+  int64_t edgeUs[MAX_TRACKS_PER_BOARD];
+  edgeCapture.take(edgeUs, trackCount);
+  uint64_t levels = inputs.sample(millis());
+  int64_t sampleUs = esp_timer_get_time();
+  bool changed = false;
+  for (int i = 0; i < trackCount; i++) {
+    int reading = (levels >> i) & 1;
 
-    if (reading != lastState[i]) {
-      lastDebounceTime[i] = millis();
+    if (debouncer.update(i, reading, millis(),
+                         edgeUs[i] ? edgeUs[i] : sampleUs)) {
+      int64_t changedUs = debouncer.changedAtUs(i);
+      hscBase.getEventLog().appendAt(changedUs / 1000, EVENT_TRACK, i,
+                                     (reading == LOW) ? 1 : 0);
+      if (trackStats)
+        trackStats->onTransition(i, reading == LOW, millis());
+      // State Changed, Publish
+      publishTrackState(i, reading);
+      publishTrackEvent(i, reading, changedUs);
+      changed = true;
     }
+  }
+  if (changed)
+    hscBase.getPeers().publish(occupancyMask(), trackCount);
+  hscBase.getSupervisor().progress(sensingSection);
 
-    if ((millis() - lastDebounceTime[i]) > DEBOUNCE_DELAY) {
-      if (reading != buttonState[i]) {
-        buttonState[i] = reading;
-        // State Changed, Publish
-        publishTrackState(i, buttonState[i]);
-      }
-    }
+  // Rules only change with an input or when one of their timers runs out
+  uint32_t ruleMs = rules.msUntilDeadline(millis());
+  if (changed || peersChanged || ruleMs == 0) {
+    peersChanged = false;
+    evaluateRules();
+    ruleMs = rules.msUntilDeadline(millis());
+  }
 
-    lastState[i] = reading;
+  // Roll statistics windows and publish periodically
+  if (trackStats) {
+    trackStats->tick(millis());
+    if (millis() - lastStatsPublish > STATS_PUBLISH_INTERVAL &&
+        !hscBase.getHeap().shedding()) {
+      lastStatsPublish = millis();
+      publishTrackStats();
+    }
   }
+
+  // Low power: sleep until an input edge, the next debounce deadline (when
+  // sampling again could change a state) or the next rule timer
+  uint32_t sleepMs = debouncer.msUntilSettled(trackCount, millis());
+  if (ruleMs < sleepMs)
+    sleepMs = ruleMs;
+  powerSaver.sleep(sleepMs < maxSleepMs ? sleepMs : maxSleepMs);
 }
@@ -0,0 +1,20 @@
+# Adds the sources without Arduino dependencies to the native test build
+# (pio test -e native); the rest of HSC_Base and the application need the
+# ESP32 framework and stay out.
+Import("env")
+
+LIB_SOURCES = ["ClockDiscipline", "DeltaPatch", "EventRecord", "HeapGuard",
+               "JsonWriter", "MqttOutbox", "MqttPacket", "MqttSession",
+               "PeerTable", "RequestLimiter", "RolloutScheduler",
+               "StallDetector"]
+APP_SOURCES = ["InputSource", "RuleEngine", "SimulatedInputSource",
+               "TrackDebouncer", "TrackStats"]
+
+
+def build(name, src_dir, sources):
+    env.BuildSources("$BUILD_DIR/" + name, src_dir,
+                     ["-<*>"] + ["+<%s.cpp>" % s for s in sources])
+
+
+build("hsc_base", "$PROJECT_DIR/lib/HSC_Base/src", LIB_SOURCES)
+build("app", "$PROJECT_DIR/src", APP_SOURCES)
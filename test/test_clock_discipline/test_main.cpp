@@ -0,0 +1,181 @@
+// ClockDiscipline on the host with simulated NTP samples: the first sample
+// stepping the clock, offsets slewed in no faster than CLOCK_SLEW_PPM,
+// lone spikes rejected while a confirmed jump is stepped, and the
+// frequency correction converging on a drifting crystal.
+
+#include "ClockDiscipline.h"
+#include <stdio.h>
+#include <unity.h>
+
+static const int64_t S = 1000000;
+// A UTC time in µs (2024-01-01)
+static const int64_t T0 = 1704067200LL * S;
+
+static ClockDiscipline *discipline;
+
+void setUp() { discipline = new ClockDiscipline(); }
+
+void tearDown() { delete discipline; }
+
+static void assertUs(int64_t expected, int64_t actual) {
+  TEST_ASSERT_TRUE_MESSAGE(expected == actual, "µs differ");
+}
+
+void test_nothing_before_first_sample() {
+  TEST_ASSERT_FALSE(discipline->synced());
+  assertUs(0, discipline->utcAt(5 * S));
+  ClockStats st = discipline->stats(5 * S);
+  TEST_ASSERT_FALSE(st.synced);
+  TEST_ASSERT_EQUAL_UINT32(0, st.syncs);
+  TEST_ASSERT_EQUAL_UINT32(0, st.lastSyncAgeS);
+}
+
+void test_first_sample_steps() {
+  discipline->sample(5 * S, T0);
+  TEST_ASSERT_TRUE(discipline->synced());
+  assertUs(T0, discipline->utcAt(5 * S));
+  assertUs(T0 + 2 * S, discipline->utcAt(7 * S));
+  // Boot time follows from the mapping
+  assertUs(T0 - 5 * S, discipline->utcAt(0));
+
+  ClockStats st = discipline->stats(7 * S);
+  TEST_ASSERT_EQUAL_UINT32(1, st.syncs);
+  TEST_ASSERT_EQUAL_UINT32(1, st.steps);
+  TEST_ASSERT_EQUAL_UINT32(2, st.lastSyncAgeS);
+}
+
+// 100 ms behind: no jump at the sample, then at most 500 µs per second
+// until it is all taken up after 200 s
+void test_offset_slewed_at_limited_rate() {
+  discipline->sample(0, T0);
+  discipline->sample(10 * S, T0 + 10 * S + 100000);
+  assertUs(T0 + 10 * S, discipline->utcAt(10 * S));
+  assertUs(T0 + 11 * S + 500, discipline->utcAt(11 * S));
+  assertUs(T0 + 110 * S + 50000, discipline->utcAt(110 * S));
+  assertUs(T0 + 210 * S + 100000, discipline->utcAt(210 * S));
+  assertUs(T0 + 300 * S + 100000, discipline->utcAt(300 * S));
+
+  ClockStats st = discipline->stats(110 * S);
+  TEST_ASSERT_TRUE(st.offsetUs == 100000);
+  TEST_ASSERT_TRUE(st.slewUs == 50000);
+  // 10 s is too short to take drift from
+  TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.0f, st.driftPpm);
+  TEST_ASSERT_EQUAL_UINT32(1, st.steps);
+}
+
+// 100 ms ahead: slowed down, never running backwards
+void test_negative_offset_never_runs_backwards() {
+  discipline->sample(0, T0);
+  discipline->sample(10 * S, T0 + 10 * S - 100000);
+  int64_t last = discipline->utcAt(10 * S);
+  for (int64_t mono = 10 * S + 1000; mono <= 12 * S; mono += 1000) {
+    int64_t now = discipline->utcAt(mono);
+    TEST_ASSERT_TRUE(now - last >= 999 && now - last <= 1000);
+    last = now;
+  }
+  assertUs(T0 + 12 * S - 1000, discipline->utcAt(12 * S));
+}
+
+void test_lone_spike_rejected() {
+  discipline->sample(0, T0);
+  // A reply 2 s off: dropped, the clock carries on
+  discipline->sample(600 * S, T0 + 602 * S);
+  assertUs(T0 + 600 * S, discipline->utcAt(600 * S));
+  assertUs(T0 + 700 * S, discipline->utcAt(700 * S));
+  ClockStats st = discipline->stats(700 * S);
+  TEST_ASSERT_EQUAL_UINT32(1, st.rejected);
+  TEST_ASSERT_EQUAL_UINT32(1, st.steps);
+  TEST_ASSERT_TRUE(st.offsetUs == 2 * S);
+
+  // Spikes that disagree with each other are all dropped
+  discipline->sample(1200 * S, T0 + 1197 * S);
+  discipline->sample(1800 * S, T0 + 1802 * S);
+  TEST_ASSERT_EQUAL_UINT32(3, discipline->stats(1800 * S).rejected);
+  assertUs(T0 + 1800 * S, discipline->utcAt(1800 * S));
+
+  // A good sample in between resets the count towards a step
+  discipline->sample(2400 * S, T0 + 2400 * S);
+  discipline->sample(3000 * S, T0 + 3002 * S);
+  TEST_ASSERT_EQUAL_UINT32(4, discipline->stats(3000 * S).rejected);
+  TEST_ASSERT_EQUAL_UINT32(1, discipline->stats(3000 * S).steps);
+}
+
+// The server's time really moved: the second sample that agrees steps
+void test_confirmed_jump_stepped() {
+  discipline->sample(0, T0);
+  discipline->sample(600 * S, T0 + 605 * S);
+  assertUs(T0 + 600 * S, discipline->utcAt(600 * S));
+  discipline->sample(1200 * S, T0 + 1205 * S + 3000);
+  assertUs(T0 + 1205 * S + 3000, discipline->utcAt(1200 * S));
+  ClockStats st = discipline->stats(1200 * S);
+  TEST_ASSERT_EQUAL_UINT32(2, st.steps);
+  TEST_ASSERT_EQUAL_UINT32(1, st.rejected);
+  TEST_ASSERT_TRUE(st.slewUs == 0);
+}
+
+static uint32_t rng = 7;
+
+static int64_t noiseUs(int64_t amplitude) {
+  rng = rng * 1103515245u + 12345u;
+  return (int64_t)((rng >> 8) % (2 * amplitude + 1)) - amplitude;
+}
+
+// A crystal 40 ppm fast, polled every 10 minutes with ±1 ms of network
+// noise: the correction settles near -40 ppm and the clock stays within a
+// few ms of true time between polls
+void test_drift_converges() {
+  const int64_t PPM = 40;
+  const int64_t POLL = 600 * S;
+  const int POLLS = 72; // 12 hours
+  int64_t maxError = 0;
+  for (int i = 0; i <= POLLS; i++) {
+    // True elapsed time and what the crystal counted meanwhile
+    int64_t t = i * POLL;
+    int64_t mono = t + t * PPM / 1000000;
+    discipline->sample(mono, T0 + t + noiseUs(1000));
+
+    // Worst error halfway to the next poll, once settled
+    int64_t half = t + POLL / 2;
+    int64_t error =
+        discipline->utcAt(half + half * PPM / 1000000) - (T0 + half);
+    if (error < 0)
+      error = -error;
+    if (i >= POLLS / 2 && error > maxError)
+      maxError = error;
+  }
+
+  ClockStats st = discipline->stats(POLLS * POLL);
+  char line[96];
+  snprintf(line, sizeof(line),
+           "40 ppm crystal: %.3f ppm correction, worst %lld us off after 6 h",
+           st.driftPpm, (long long)maxError);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, -40.0f, st.driftPpm);
+  TEST_ASSERT_TRUE(maxError < 5000);
+  TEST_ASSERT_EQUAL_UINT32(0, st.rejected);
+  TEST_ASSERT_EQUAL_UINT32(1, st.steps);
+}
+
+// The correction is capped at CLOCK_MAX_FREQ_PPM whatever the samples say
+void test_frequency_correction_capped() {
+  for (int i = 0; i <= 40; i++) {
+    int64_t t = i * 90 * S;
+    // Slower than any crystal: 1000 ppm
+    discipline->sample(t - t / 1000, T0 + t);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, (float)CLOCK_MAX_FREQ_PPM,
+                           discipline->stats(0).driftPpm);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_nothing_before_first_sample);
+  RUN_TEST(test_first_sample_steps);
+  RUN_TEST(test_offset_slewed_at_limited_rate);
+  RUN_TEST(test_negative_offset_never_runs_backwards);
+  RUN_TEST(test_lone_spike_rejected);
+  RUN_TEST(test_confirmed_jump_stepped);
+  RUN_TEST(test_drift_converges);
+  RUN_TEST(test_frequency_correction_capped);
+  return UNITY_END();
+}
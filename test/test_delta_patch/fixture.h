@@ -0,0 +1,232 @@
+// Generated by make_fixture.py with mkdelta.py; do not edit
+#ifndef DELTA_FIXTURE_H
+#define DELTA_FIXTURE_H
+
+#include <stdint.h>
+
+// Old image: FIXTURE_OLD_SIZE bytes of xorshift32 from FIXTURE_SEED
+static const uint32_t FIXTURE_SEED = 0x2545F491;
+static const uint32_t FIXTURE_OLD_SIZE = 131072;
+static const uint32_t FIXTURE_NEW_SIZE = 132708;
+// CRC-32 of the new image
+static const uint32_t FIXTURE_NEW_CRC = 0x45EECE94;
+
+static const uint8_t FIXTURE_PATCH[] = {
+    0x48, 0x53, 0x43, 0x44, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00,
+    0x64, 0x06, 0x02, 0x00, 0x01, 0xc0, 0xb8, 0x02, 0x03, 0x82, 0x0c, 0x25,
+    0x54, 0xef, 0xfc, 0x3e, 0xcf, 0xaa, 0x8a, 0x9e, 0x9e, 0xb2, 0xcd, 0x2c,
+    0x96, 0x5e, 0x57, 0x8c, 0x0b, 0xde, 0xbd, 0x6a, 0x59, 0xba, 0x20, 0x7f,
+    0xa4, 0x2d, 0xba, 0xbe, 0xce, 0x53, 0x79, 0x43, 0x5d, 0x2f, 0x4d, 0x61,
+    0xe7, 0x8e, 0x81, 0x12, 0xfc, 0xb8, 0x3c, 0xc6, 0x8e, 0x61, 0xf1, 0x01,
+    0x56, 0xc1, 0x4e, 0xed, 0xc5, 0x10, 0x68, 0x4e, 0xcc, 0x29, 0x1b, 0xbb,
+    0xf1, 0xd2, 0x56, 0x50, 0x23, 0x48, 0xfe, 0xe7, 0xca, 0x49, 0xd0, 0xe9,
+    0x40, 0xa0, 0xfc, 0xf6, 0xcf, 0x3d, 0x7b, 0xe1, 0xc3, 0xad, 0x0f, 0x79,
+    0x85, 0xf5, 0x49, 0x03, 0xb3, 0xad, 0xa1, 0xce, 0x85, 0x27, 0x7e, 0x82,
+    0x62, 0x30, 0x65, 0xa3, 0xdc, 0xcd, 0xfc, 0x5f, 0xbc, 0x4d, 0xc8, 0xee,
+    0xd3, 0x8d, 0x49, 0xb6, 0x3c, 0xc4, 0x31, 0x0a, 0x5a, 0xa0, 0xd7, 0x73,
+    0x6b, 0x98, 0xde, 0x3a, 0x81, 0x73, 0xd6, 0xae, 0x29, 0x3b, 0x9b, 0xfd,
+    0x55, 0xb3, 0x07, 0x0f, 0x1b, 0x12, 0xbd, 0x95, 0xbf, 0x1a, 0x48, 0xf9,
+    0xb0, 0x69, 0x61, 0x46, 0x23, 0x58, 0x30, 0x03, 0x11, 0x7c, 0x82, 0x5f,
+    0xf3, 0xaa, 0x2e, 0x89, 0xb8, 0xac, 0xc2, 0x01, 0xd3, 0xd7, 0x89, 0x8e,
+    0xf1, 0x32, 0x87, 0x67, 0x42, 0xb1, 0x6f, 0x30, 0x30, 0x97, 0x39, 0x55,
+    0xdb, 0xb8, 0xe3, 0x2e, 0xb5, 0x34, 0x33, 0x09, 0x4f, 0xc6, 0x7b, 0x61,
+    0xc4, 0x49, 0x08, 0xc4, 0x7d, 0x2e, 0x0d, 0xa0, 0x43, 0x68, 0xf9, 0x7b,
+    0xa8, 0xde, 0x33, 0xbc, 0x2b, 0xbd, 0x32, 0xd2, 0x4a, 0x0c, 0x97, 0x0e,
+    0xb6, 0x79, 0x9a, 0x7e, 0x2c, 0xf7, 0x1a, 0xdd, 0x35, 0xb6, 0xab, 0xe2,
+    0xe0, 0x32, 0x7a, 0xc9, 0x12, 0x7b, 0xad, 0x46, 0xc1, 0x26, 0xbb, 0xc1,
+    0x2f, 0x20, 0xfa, 0xe9, 0x86, 0x1d, 0xff, 0xc7, 0xde, 0x63, 0xff, 0x4c,
+    0x0d, 0x67, 0x09, 0xfa, 0xe6, 0x4b, 0xba, 0xff, 0xe0, 0xda, 0x28, 0x21,
+    0x0b, 0x89, 0x03, 0x03, 0xac, 0x95, 0x82, 0x64, 0x74, 0x53, 0x09, 0x4e,
+    0x0a, 0xcf, 0x91, 0x9a, 0x25, 0xb2, 0xb8, 0xc6, 0x39, 0xd7, 0xf5, 0x56,
+    0x70, 0x6a, 0x15, 0x6b, 0x62, 0x3b, 0x56, 0x4e, 0xf3, 0x3e, 0x25, 0x6d,
+    0x7a, 0x19, 0xce, 0xaa, 0xb9, 0x26, 0xda, 0x08, 0xf5, 0x05, 0x6c, 0xaf,
+    0xb7, 0xa9, 0x04, 0x6b, 0xbd, 0xdc, 0x5d, 0xf1, 0x78, 0x5c, 0x2f, 0x57,
+    0x54, 0xbc, 0xa8, 0x4b, 0x7f, 0x05, 0x2c, 0xa6, 0x9e, 0x0c, 0x58, 0x91,
+    0x1c, 0x3c, 0x7e, 0x1b, 0x70, 0x85, 0x73, 0x71, 0x48, 0x03, 0xac, 0x0d,
+    0x41, 0x8c, 0x04, 0x53, 0xb0, 0x55, 0x3a, 0x31, 0xdd, 0xcc, 0xc9, 0x06,
+    0x76, 0xbb, 0xf7, 0x6f, 0xfa, 0xa0, 0x29, 0xe7, 0x74, 0xd1, 0x31, 0x9e,
+    0x95, 0x95, 0x23, 0xe7, 0xaf, 0xf1, 0x1b, 0x29, 0xe4, 0xbb, 0x68, 0xff,
+    0x72, 0xbb, 0xdc, 0xfb, 0x2a, 0x00, 0x5f, 0xec, 0xd6, 0x20, 0xa2, 0x7b,
+    0x89, 0x52, 0x15, 0xca, 0x87, 0xf2, 0x1c, 0xa3, 0x57, 0xe2, 0xd1, 0xd7,
+    0xed, 0xff, 0x1b, 0xb9, 0x19, 0x5b, 0x75, 0xf3, 0x2a, 0x63, 0x14, 0xe2,
+    0x93, 0x95, 0xce, 0xa3, 0x28, 0x59, 0xe9, 0xd4, 0x41, 0x5b, 0x9b, 0xc7,
+    0xbc, 0xd9, 0x88, 0x71, 0x68, 0xaa, 0xd2, 0xf0, 0xe8, 0x2f, 0x30, 0x03,
+    0xc7, 0x53, 0x04, 0x7a, 0x03, 0xbb, 0x1c, 0xa3, 0x97, 0x16, 0x8e, 0x0f,
+    0xc0, 0xad, 0x0a, 0x93, 0xc5, 0xe6, 0xea, 0x42, 0xba, 0xd0, 0x78, 0xfe,
+    0x4e, 0x7f, 0x15, 0x09, 0xc1, 0xd6, 0xe5, 0xb9, 0x70, 0x92, 0x11, 0x02,
+    0xef, 0xe4, 0xf6, 0x8f, 0x89, 0x31, 0x7a, 0x02, 0x8e, 0xf0, 0x11, 0x20,
+    0x14, 0x2a, 0x3f, 0x84, 0x4f, 0x6a, 0x44, 0x04, 0x77, 0xc6, 0x92, 0x64,
+    0xb3, 0x9e, 0x5e, 0xff, 0x32, 0x89, 0x45, 0xba, 0x45, 0x5f, 0x3e, 0xb1,
+    0xef, 0xd8, 0xb3, 0x8d, 0xa9, 0xb8, 0xcc, 0xfc, 0x5b, 0xaa, 0xb8, 0x47,
+    0x5b, 0xa4, 0xaa, 0x69, 0xd8, 0xc1, 0x81, 0xb9, 0xee, 0x47, 0x49, 0x6e,
+    0x4e, 0x86, 0xad, 0x3d, 0xcf, 0x59, 0xdc, 0x93, 0x1a, 0xf5, 0x81, 0xfc,
+    0x25, 0x40, 0x61, 0x19, 0x97, 0xb8, 0xf5, 0x80, 0xf4, 0x87, 0xbd, 0x52,
+    0xb5, 0xf2, 0xfc, 0x0e, 0x70, 0xdd, 0x33, 0xa2, 0xa1, 0xa1, 0x78, 0x89,
+    0x54, 0xe4, 0x74, 0xbb, 0x81, 0x92, 0xe3, 0x23, 0xe9, 0xea, 0x39, 0x60,
+    0xa9, 0x20, 0xb8, 0x25, 0x1c, 0x58, 0xb7, 0x84, 0xb9, 0xe8, 0xbe, 0x79,
+    0x16, 0x82, 0xab, 0x1c, 0xe7, 0x5e, 0x01, 0xa4, 0xfa, 0x1b, 0xab, 0x97,
+    0x10, 0x8f, 0x64, 0x8d, 0x42, 0x18, 0x35, 0x4e, 0x5b, 0x0e, 0xb8, 0x49,
+    0x3d, 0x13, 0xbd, 0x65, 0x4c, 0xf4, 0xce, 0x4c, 0xd3, 0xd4, 0x76, 0xa3,
+    0x69, 0xda, 0x76, 0x65, 0x04, 0x79, 0xd6, 0x93, 0x82, 0xa3, 0x50, 0x3f,
+    0xd9, 0x63, 0x69, 0x17, 0x73, 0xd7, 0x56, 0x78, 0x29, 0x7c, 0x6d, 0xe0,
+    0xd3, 0x8c, 0x18, 0xd6, 0x0a, 0x0d, 0xc6, 0xf1, 0xce, 0x6b, 0xcf, 0x95,
+    0xb7, 0xb4, 0x3c, 0x09, 0xf4, 0xde, 0xe2, 0xab, 0xa2, 0xf7, 0xa9, 0x3b,
+    0x97, 0x75, 0x55, 0x98, 0xcd, 0xb3, 0xff, 0x6a, 0x89, 0xfa, 0x05, 0x66,
+    0xbf, 0x88, 0x39, 0x0d, 0x78, 0x60, 0x01, 0xab, 0x3a, 0x00, 0xa1, 0x8a,
+    0x13, 0x3e, 0xfb, 0x97, 0x83, 0x64, 0x86, 0x38, 0x56, 0x5e, 0x18, 0xbe,
+    0xec, 0x80, 0xbc, 0xf9, 0x4e, 0x62, 0x35, 0xf6, 0x00, 0x38, 0xf8, 0xbe,
+    0xcd, 0x09, 0x1a, 0x37, 0xea, 0x1f, 0x60, 0x6b, 0x17, 0xaa, 0xb7, 0xc1,
+    0x62, 0x08, 0xfc, 0x35, 0x1f, 0x59, 0xad, 0x26, 0x65, 0x52, 0x57, 0xda,
+    0x02, 0x5a, 0x10, 0xb4, 0xf4, 0xee, 0xeb, 0xea, 0x2b, 0x14, 0x16, 0xb3,
+    0x59, 0xa4, 0x26, 0x71, 0xdb, 0xbf, 0x79, 0x87, 0xe9, 0x11, 0x29, 0xa3,
+    0x5f, 0x2c, 0x3d, 0xfb, 0xa9, 0xad, 0x5f, 0xee, 0x13, 0x23, 0x19, 0x12,
+    0x50, 0xd1, 0x2d, 0xb1, 0xd6, 0x7d, 0x77, 0x52, 0xdb, 0xc0, 0xbd, 0xa6,
+    0xc6, 0x7b, 0xe2, 0xf3, 0x94, 0xb7, 0xd0, 0xb4, 0xfc, 0x3f, 0xc5, 0x44,
+    0x22, 0x5f, 0xaf, 0xac, 0x11, 0x67, 0x94, 0x96, 0xe6, 0x3b, 0x85, 0xb0,
+    0xb7, 0x22, 0xbb, 0x28, 0x25, 0x64, 0x38, 0x8f, 0x92, 0xed, 0x52, 0x42,
+    0x97, 0x37, 0x35, 0x67, 0xf1, 0xea, 0x09, 0x38, 0xb2, 0xdb, 0x58, 0x84,
+    0x5c, 0xf4, 0xc4, 0x2d, 0x57, 0xbe, 0xc2, 0xdc, 0x82, 0x69, 0xfd, 0x58,
+    0xde, 0x29, 0x64, 0xdc, 0x65, 0x99, 0xe9, 0x5f, 0xe7, 0x25, 0x78, 0x0c,
+    0x78, 0xc2, 0x84, 0x25, 0x00, 0x1f, 0xb2, 0x58, 0xa2, 0x60, 0x0b, 0x24,
+    0xde, 0x70, 0x15, 0xd6, 0x77, 0x24, 0xad, 0x37, 0x84, 0x08, 0x25, 0x1f,
+    0xd4, 0x7f, 0x3f, 0xec, 0xb3, 0x75, 0x91, 0x99, 0x5b, 0x03, 0xd0, 0x70,
+    0x78, 0x33, 0x51, 0xb9, 0xc3, 0x54, 0xc2, 0x51, 0x8d, 0xbd, 0x29, 0x6e,
+    0xcd, 0x7c, 0x1e, 0x48, 0x22, 0xc0, 0xf9, 0xda, 0x59, 0xc6, 0xa5, 0xbb,
+    0x88, 0x60, 0xe9, 0x38, 0xd1, 0x96, 0x7a, 0x53, 0x2d, 0x38, 0x0b, 0xf9,
+    0x85, 0xb8, 0x5a, 0x84, 0xbb, 0xd3, 0x6f, 0x3d, 0x89, 0xdd, 0x0f, 0x88,
+    0x39, 0x79, 0x46, 0x00, 0xda, 0x21, 0xa4, 0x51, 0xc1, 0x0e, 0xbb, 0xd3,
+    0x2a, 0x00, 0xa1, 0x5e, 0xe7, 0x7b, 0xc3, 0x53, 0x6a, 0xd1, 0x56, 0x68,
+    0x74, 0x6e, 0x9f, 0x19, 0xe5, 0x20, 0xfc, 0xaf, 0x3c, 0x57, 0x1e, 0x6d,
+    0x04, 0xd1, 0x9f, 0x48, 0x08, 0x30, 0x9a, 0x99, 0xa6, 0xdf, 0xd1, 0x3b,
+    0x7d, 0x26, 0xaa, 0x9b, 0x98, 0x28, 0xba, 0xa7, 0x42, 0x34, 0xfc, 0x0e,
+    0x47, 0xf6, 0x98, 0x8a, 0xde, 0xf8, 0xe2, 0x98, 0x33, 0x0d, 0x91, 0xbb,
+    0x95, 0x9f, 0xa7, 0x92, 0x14, 0x61, 0x89, 0x50, 0x5d, 0xfc, 0x4c, 0x73,
+    0xc5, 0x92, 0xcd, 0x38, 0xd7, 0xbb, 0x8e, 0x0c, 0x84, 0x4d, 0xab, 0xa1,
+    0x9d, 0x4c, 0x95, 0xd6, 0xc1, 0xb7, 0x54, 0xb2, 0xe5, 0x8c, 0x2a, 0xc0,
+    0xde, 0x19, 0x8e, 0xa0, 0x58, 0x17, 0x00, 0xe0, 0x7d, 0x87, 0xaf, 0x56,
+    0x77, 0x7b, 0x85, 0x96, 0x34, 0xb0, 0x10, 0xb6, 0x66, 0x99, 0x1c, 0xe7,
+    0x60, 0x14, 0x99, 0xf0, 0x69, 0x8a, 0x2a, 0x10, 0xa3, 0xb1, 0x93, 0x94,
+    0x3c, 0x02, 0xe4, 0x5e, 0x2d, 0x26, 0x70, 0x77, 0x35, 0xf3, 0xe2, 0xe6,
+    0x8e, 0xa0, 0x82, 0x40, 0xc1, 0x2a, 0x09, 0x11, 0xa6, 0xc7, 0x10, 0x67,
+    0x26, 0x10, 0x84, 0x03, 0xec, 0xd7, 0x54, 0xf0, 0x2e, 0x7f, 0xdb, 0x30,
+    0xf1, 0x30, 0x09, 0x9c, 0x46, 0x13, 0x98, 0x4f, 0xe5, 0x60, 0x32, 0x69,
+    0x30, 0x34, 0x19, 0x5b, 0xee, 0x09, 0xd3, 0xc0, 0xd9, 0x81, 0x5e, 0xe8,
+    0xef, 0x02, 0x93, 0x7c, 0xfe, 0x54, 0x79, 0xc6, 0x09, 0xed, 0x4c, 0x17,
+    0x89, 0xb2, 0x41, 0xb6, 0x04, 0xd3, 0x98, 0x34, 0x82, 0x3f, 0xfb, 0x2e,
+    0x80, 0x9c, 0x7f, 0x55, 0xd7, 0xa2, 0x90, 0xbf, 0x4e, 0xd0, 0x06, 0xbb,
+    0x5a, 0x02, 0xe3, 0x55, 0x8d, 0xa2, 0x6f, 0xb1, 0x17, 0x48, 0x04, 0x42,
+    0x79, 0x75, 0x86, 0xca, 0x79, 0xed, 0x6f, 0xc5, 0x55, 0x78, 0x0d, 0x72,
+    0x0f, 0x90, 0xc2, 0x45, 0xe4, 0x66, 0xc2, 0x96, 0x5b, 0x8e, 0xb5, 0xbb,
+    0xce, 0xd4, 0x9b, 0x34, 0x96, 0x57, 0xb4, 0x25, 0x0e, 0x28, 0x6e, 0x0c,
+    0x2a, 0x1f, 0xfe, 0xa9, 0x45, 0x50, 0x01, 0x5e, 0x0c, 0xc8, 0x82, 0x88,
+    0x6b, 0xc4, 0x70, 0xb5, 0xa8, 0x6b, 0xd0, 0x45, 0xce, 0x6a, 0x1c, 0xc2,
+    0xd5, 0x22, 0x11, 0xf7, 0x68, 0xb5, 0x39, 0x7c, 0x7c, 0xf3, 0x86, 0x1e,
+    0xd5, 0x1b, 0xa8, 0x3d, 0xd0, 0xb8, 0xf7, 0xfa, 0x48, 0x4e, 0xca, 0x44,
+    0x76, 0x46, 0x38, 0xf1, 0x14, 0x65, 0x9e, 0x95, 0x39, 0xf4, 0x69, 0x60,
+    0x08, 0x37, 0x6a, 0xde, 0x1c, 0x2d, 0x17, 0xd3, 0x06, 0x61, 0x84, 0x32,
+    0x95, 0x34, 0x56, 0xa2, 0xae, 0xdb, 0x5f, 0xb6, 0x26, 0x5f, 0x52, 0x73,
+    0xf8, 0xfb, 0x48, 0xa0, 0x7d, 0x44, 0x39, 0x93, 0xc1, 0xae, 0xc5, 0x0e,
+    0x38, 0xb3, 0xc1, 0xd2, 0x80, 0xff, 0xac, 0x2e, 0xfc, 0x0d, 0x0d, 0xe4,
+    0x43, 0x33, 0xfe, 0x43, 0x3e, 0x30, 0x18, 0x85, 0xf0, 0x81, 0xce, 0x3e,
+    0x1d, 0x3e, 0x0b, 0x53, 0x96, 0xdc, 0xcb, 0xa3, 0xf8, 0xcf, 0xd3, 0x28,
+    0x71, 0x48, 0x98, 0x81, 0xee, 0xac, 0xe4, 0xcb, 0x01, 0x31, 0x15, 0x75,
+    0xab, 0x04, 0x69, 0xff, 0xcf, 0xff, 0x2e, 0xa6, 0xb3, 0x2b, 0x02, 0x5e,
+    0xdc, 0x00, 0x47, 0xd7, 0x0e, 0xfc, 0x1e, 0xe3, 0xdd, 0xb4, 0xbe, 0xd2,
+    0xdc, 0x62, 0x3a, 0x6b, 0xa9, 0x1e, 0x78, 0xac, 0x56, 0x53, 0x90, 0x33,
+    0x56, 0x30, 0x71, 0xe4, 0xe0, 0x72, 0x59, 0x12, 0xe8, 0xde, 0xf5, 0x29,
+    0x90, 0x5a, 0x6c, 0xf8, 0x6d, 0x9c, 0xe0, 0xea, 0x6d, 0xd2, 0x35, 0x3f,
+    0x8a, 0xdc, 0x8b, 0x64, 0xb6, 0xd2, 0xab, 0x09, 0x6c, 0xc2, 0x1e, 0xe9,
+    0xcb, 0x67, 0x08, 0xcd, 0x45, 0x53, 0x86, 0x25, 0x93, 0x45, 0x0a, 0x4b,
+    0xbf, 0x1e, 0x20, 0x70, 0x77, 0x6a, 0x5e, 0xc8, 0x00, 0x3c, 0xaa, 0x90,
+    0xc9, 0x45, 0xc1, 0xe2, 0x25, 0x6e, 0x24, 0x9c, 0x98, 0x4f, 0x03, 0xcc,
+    0x4d, 0x87, 0x4a, 0x50, 0xce, 0x7e, 0x28, 0xce, 0xff, 0xd7, 0x7f, 0x9a,
+    0x6a, 0x70, 0xbe, 0xfa, 0x4d, 0xf9, 0xdf, 0x02, 0x08, 0xf5, 0x26, 0x11,
+    0x6f, 0x98, 0xd5, 0x6e, 0xc9, 0xe8, 0x8a, 0xe2, 0x2f, 0x87, 0x53, 0x0c,
+    0xa3, 0x04, 0x04, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f,
+    0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f,
+    0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f,
+    0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f,
+    0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f,
+    0x02, 0x02, 0x06, 0x01, 0x01, 0xfe, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff,
+    0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff,
+    0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff,
+    0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff,
+    0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff,
+    0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff,
+    0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff,
+    0x0f, 0x02, 0x01, 0x06, 0x01, 0xce, 0x06, 0x03, 0xbc, 0x05, 0x6e, 0x29,
+    0x45, 0x18, 0xa5, 0x8d, 0x9c, 0xe0, 0x40, 0xd3, 0x60, 0xf1, 0xbe, 0x4d,
+    0xb9, 0xc9, 0xdb, 0xe1, 0x1a, 0x75, 0xe9, 0x50, 0xe3, 0x39, 0x0d, 0xa4,
+    0x7f, 0xed, 0xbc, 0xb4, 0xad, 0xd6, 0x66, 0x8e, 0xd8, 0xe0, 0xc4, 0x55,
+    0x50, 0x42, 0xfc, 0x03, 0xf9, 0x37, 0x41, 0xc1, 0x67, 0x99, 0xc0, 0xee,
+    0x71, 0x44, 0xa2, 0x20, 0x6b, 0x9e, 0x71, 0x3d, 0x4f, 0xe3, 0xee, 0xd3,
+    0x29, 0x60, 0x92, 0xb0, 0x0e, 0x3b, 0x50, 0x15, 0x74, 0x06, 0x2c, 0xbc,
+    0xa6, 0xef, 0x04, 0x86, 0x11, 0x75, 0x1f, 0xc9, 0xcd, 0x32, 0xfc, 0xc5,
+    0x7f, 0x63, 0xed, 0xa3, 0x7f, 0xe0, 0x88, 0x08, 0xa1, 0x1b, 0x31, 0xc3,
+    0x0c, 0x4f, 0x18, 0x08, 0x8e, 0x7c, 0x54, 0x34, 0x1f, 0x0d, 0xd3, 0xe7,
+    0xa4, 0x5d, 0xe9, 0x22, 0x9f, 0x60, 0x52, 0x5e, 0xf2, 0x7d, 0x6f, 0x1e,
+    0xa1, 0x34, 0x4b, 0xba, 0x98, 0x62, 0xa3, 0x15, 0x7d, 0xf9, 0xbf, 0xcc,
+    0x95, 0x71, 0x27, 0x18, 0xd8, 0x6a, 0x71, 0x3b, 0x2a, 0xc3, 0x1d, 0x5d,
+    0x1c, 0xed, 0xda, 0xb7, 0x54, 0xc1, 0xe6, 0x85, 0x0d, 0xe0, 0xda, 0x78,
+    0x6e, 0xf3, 0x06, 0xaa, 0x65, 0xcf, 0xec, 0x40, 0x05, 0xe0, 0x0f, 0xc1,
+    0x94, 0x5c, 0x7e, 0xec, 0x66, 0x6e, 0xfd, 0x67, 0x30, 0x3b, 0x6e, 0xa5,
+    0x37, 0x82, 0x5c, 0xc0, 0xcc, 0x94, 0x49, 0x32, 0x0f, 0xc9, 0x6d, 0xba,
+    0xe9, 0x05, 0x13, 0xca, 0x98, 0xee, 0x58, 0x6d, 0xe7, 0x89, 0x90, 0xc5,
+    0x03, 0x82, 0x43, 0x20, 0x85, 0x16, 0xf5, 0x8c, 0xdb, 0x44, 0xc9, 0x6e,
+    0xcc, 0x20, 0x23, 0xd1, 0xd5, 0x98, 0xd3, 0x43, 0xab, 0x72, 0x16, 0x57,
+    0xfc, 0x57, 0x94, 0x2c, 0x8a, 0x92, 0x79, 0x7d, 0x91, 0x9c, 0x60, 0x87,
+    0x64, 0xcd, 0x75, 0x84, 0xd6, 0x34, 0xc4, 0x13, 0x4e, 0xba, 0x50, 0x3a,
+    0x42, 0x8c, 0xd1, 0xec, 0x94, 0x13, 0xf9, 0x97, 0xff, 0x6b, 0xed, 0xf8,
+    0xee, 0x48, 0xa4, 0xeb, 0x8c, 0xe7, 0x6e, 0xb6, 0xce, 0xe1, 0x90, 0xf9,
+    0xbc, 0xa0, 0xef, 0xe8, 0xf5, 0xf3, 0xad, 0x47, 0x8f, 0xf6, 0x4d, 0x1a,
+    0x7d, 0xad, 0x31, 0xcc, 0x74, 0x07, 0xcf, 0xfd, 0x06, 0xad, 0xfc, 0xbb,
+    0x27, 0x8f, 0x74, 0x01, 0xa6, 0x82, 0x7f, 0x5e, 0x84, 0x77, 0x18, 0x60,
+    0x65, 0xb8, 0xd1, 0xb4, 0x20, 0x47, 0x68, 0x61, 0x3a, 0xc1, 0x7d, 0x55,
+    0xf4, 0x66, 0xc2, 0x23, 0x32, 0xbc, 0x03, 0x80, 0xff, 0xd2, 0x45, 0x1b,
+    0x74, 0x10, 0x73, 0x3b, 0x33, 0x66, 0xe5, 0x4b, 0x3f, 0x5e, 0xc3, 0x39,
+    0x50, 0xe6, 0xa5, 0xbd, 0x17, 0x76, 0x6b, 0xb1, 0xc4, 0xa7, 0xa3, 0xcd,
+    0xdb, 0x49, 0xba, 0x87, 0x8f, 0x77, 0x8d, 0x7e, 0x18, 0x28, 0xa8, 0xfe,
+    0x97, 0xc9, 0x09, 0x9e, 0x0e, 0xd6, 0x7b, 0x6b, 0x15, 0x97, 0x4c, 0xca,
+    0x2e, 0x66, 0x30, 0x30, 0xd9, 0xf0, 0x5a, 0xbf, 0xad, 0xd1, 0xeb, 0xbf,
+    0xa7, 0x00, 0x84, 0xf3, 0x0e, 0x5a, 0x79, 0x0a, 0x12, 0x75, 0x68, 0x02,
+    0xe3, 0x49, 0x76, 0x30, 0xa2, 0xbf, 0x59, 0x26, 0x9c, 0xb3, 0x71, 0x8b,
+    0xf4, 0x65, 0x87, 0xe2, 0x0b, 0xb8, 0x17, 0x36, 0x02, 0xd1, 0x7a, 0xa2,
+    0x88, 0x78, 0xfa, 0xdc, 0x92, 0xa2, 0x0d, 0x53, 0x26, 0x7f, 0xef, 0x5b,
+    0x6e, 0x55, 0xe8, 0xa7, 0x15, 0x77, 0x0e, 0xfb, 0xb1, 0x8f, 0xa9, 0x97,
+    0xa7, 0xf2, 0x35, 0x2d, 0x96, 0x16, 0xb0, 0xbd, 0x09, 0x14, 0x1e, 0x13,
+    0x39, 0x05, 0x20, 0xee, 0xed, 0xce, 0xf4, 0xde, 0xf1, 0xb2, 0xe3, 0x00,
+    0x66, 0x70, 0x78, 0x8a, 0x77, 0x21, 0x59, 0x55, 0x6a, 0xd8, 0x72, 0xfc,
+    0xe0, 0x87, 0xc0, 0x97, 0xd0, 0x95, 0xeb, 0x14, 0x12, 0x09, 0xee, 0x9e,
+    0x43, 0xa0, 0x66, 0x93, 0xb3, 0x84, 0x8b, 0xa4, 0xc1, 0x1a, 0xd4, 0xe4,
+    0xe7, 0xee, 0xbd, 0x40, 0x2d, 0x30, 0xde, 0x64, 0x87, 0x7d, 0x34, 0xde,
+    0x92, 0x8c, 0xf0, 0x10, 0xce, 0x2c, 0x17, 0xa8, 0x5f, 0xc9, 0x2a, 0x02,
+    0xba, 0x3a, 0xf6, 0x1e, 0x28, 0xdd, 0xce, 0x2d, 0xa1, 0x63, 0x10, 0x90,
+    0x4b, 0xb7, 0xa0, 0x85, 0x54, 0x11, 0xda, 0xd6, 0x58, 0x09, 0x37, 0x79,
+    0x22, 0x88, 0x38, 0x44, 0x23, 0x78, 0x1f, 0x78, 0x7e, 0xbc, 0x4b, 0xc0,
+    0x6e, 0xbf, 0xfe, 0x05, 0xf1, 0x5f, 0x40, 0x2b, 0x39, 0xdf, 0xeb, 0xee,
+    0x6a, 0xf2, 0x94, 0x51, 0x79, 0xe9, 0x7d, 0xc2, 0xa8, 0x29, 0xe0, 0x00,
+    0xfe, 0x5d, 0x21, 0x26, 0x7d, 0x55, 0x77, 0x47, 0xe3, 0x89, 0x1a, 0xbb,
+    0x3d, 0x2d, 0x5e, 0xb0, 0xd6, 0x55, 0xcd, 0x28, 0x36, 0xcb, 0x98, 0x52,
+    0xcc, 0x83, 0x8a, 0x59, 0x3d, 0x5e, 0x1c, 0x95, 0xa3, 0xe6, 0xe5, 0xf1,
+    0xe1, 0xa1, 0xc9, 0x4e, 0x11, 0xc6, 0x18, 0x98, 0x7a, 0xd0, 0x9d, 0x45,
+    0xf6, 0x26, 0x2b, 0x43, 0x07, 0xd6, 0x69, 0xea, 0x5d, 0x1b, 0xe5, 0x04,
+    0x21, 0xa7, 0xe4, 0xd7, 0xeb, 0xd3, 0xad, 0x4f, 0x52, 0xc0, 0x6a, 0x51,
+    0x55, 0x9c, 0x5a, 0x19, 0xca, 0x79, 0xfb, 0x05, 0x14, 0x0f, 0xac, 0xfb,
+    0x95, 0x83, 0xd6, 0x4c, 0x3d, 0x6e, 0xdc, 0x1a, 0x93, 0x18, 0x1d, 0x19,
+    0xad, 0x5e, 0x04, 0xb0, 0x09, 0x01, 0xf5, 0x03, 0x02, 0x01, 0x06, 0x01,
+    0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01,
+    0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x02, 0x06, 0x01,
+    0x01, 0xfe, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06,
+    0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06,
+    0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06,
+    0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06,
+    0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06,
+    0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06,
+    0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0xff, 0x0f, 0x02, 0x01, 0x06,
+    0x01, 0xff, 0x0f, 0x02, 0x01, 0x06, 0x01, 0x82, 0x08, 0x03, 0x20, 0x48,
+    0x53, 0x43, 0x2d, 0x59, 0x61, 0x72, 0x64, 0x20, 0x30, 0x2e, 0x33, 0x2e,
+    0x30, 0x20, 0x62, 0x75, 0x69, 0x6c, 0x74, 0x20, 0x32, 0x30, 0x32, 0x36,
+    0x2d, 0x31, 0x30, 0x2d, 0x31, 0x39, 0x00, 0x00,
+};
+
+#endif
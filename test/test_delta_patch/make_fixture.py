@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Regenerates fixture.h for test_delta_patch with mkdelta.py.
+
+The old image comes from the same xorshift generator as the test, so only
+the patch has to be stored. The new image is the old one with the changes
+a rebuild typically makes: a function added in the middle (everything
+after it moves and the addresses pointing past it change), one function
+rewritten, and a new version string at the end.
+
+Usage:
+    python3 test/test_delta_patch/make_fixture.py
+"""
+
+import os
+import sys
+import zlib
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HERE, "..", ".."))
+import mkdelta  # noqa: E402
+
+SEED = 0x2545F491
+OLD_SIZE = 128 * 1024
+INSERT_AT = 40000
+INSERT_SIZE = 1536
+REWRITE_AT = 90000
+REWRITE_OLD = 600
+REWRITE_NEW = 700
+RELOCATION_STRIDE = 2048
+
+
+class XorShift:
+    def __init__(self, seed):
+        self.state = seed
+
+    def next(self):
+        x = self.state
+        x ^= (x << 13) & 0xFFFFFFFF
+        x ^= x >> 17
+        x ^= (x << 5) & 0xFFFFFFFF
+        self.state = x
+        return x
+
+    def bytes(self, n):
+        return bytes(self.next() & 0xFF for _ in range(n))
+
+
+def old_image():
+    return XorShift(SEED).bytes(OLD_SIZE)
+
+
+def new_image(old):
+    fresh = XorShift(SEED ^ 0xFFFFFFFF)
+    new = bytearray(old[:INSERT_AT])
+    new += fresh.bytes(INSERT_SIZE)
+    new += old[INSERT_AT:REWRITE_AT]
+    new += fresh.bytes(REWRITE_NEW)
+    new += old[REWRITE_AT + REWRITE_OLD:]
+    # Addresses into the moved code shift by the inserted size
+    for i in range(INSERT_AT + INSERT_SIZE, len(new) - 4, RELOCATION_STRIDE):
+        word = int.from_bytes(new[i:i + 4], "little")
+        new[i:i + 4] = ((word + INSERT_SIZE) & 0xFFFFFFFF).to_bytes(4,
+                                                                      "little")
+    new[-32:] = b"HSC-Yard 0.3.0 built 2026-10-19\0"
+    return bytes(new)
+
+
+def main():
+    old = old_image()
+    new = new_image(old)
+    patch = mkdelta.make_delta(old, new)
+    if mkdelta.apply_delta(old, patch) != new:
+        sys.exit("mkdelta.py does not reproduce the new image")
+
+    lines = [
+        "// Generated by make_fixture.py with mkdelta.py; do not edit",
+        "#ifndef DELTA_FIXTURE_H",
+        "#define DELTA_FIXTURE_H",
+        "",
+        "#include <stdint.h>",
+        "",
+        "// Old image: FIXTURE_OLD_SIZE bytes of xorshift32 from FIXTURE_SEED",
+        "static const uint32_t FIXTURE_SEED = 0x%08X;" % SEED,
+        "static const uint32_t FIXTURE_OLD_SIZE = %d;" % len(old),
+        "static const uint32_t FIXTURE_NEW_SIZE = %d;" % len(new),
+        "// CRC-32 of the new image",
+        "static const uint32_t FIXTURE_NEW_CRC = 0x%08X;" % zlib.crc32(new),
+        "",
+        "static const uint8_t FIXTURE_PATCH[] = {",
+    ]
+    for i in range(0, len(patch), 12):
+        lines.append("    " + ", ".join("0x%02x" % b
+                                         for b in patch[i:i + 12]) + ",")
+    lines += ["};", "", "#endif", ""]
+    with open(os.path.join(HERE, "fixture.h"), "w") as f:
+        f.write("\n".join(lines))
+    print("fixture.h: %d byte patch for a %d byte image" %
+          (len(patch), len(new)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,223 @@
+// Applies a patch made by mkdelta.py (fixture.h, see make_fixture.py)
+// through DeltaPatch the way OtaUpdater does, and checks that damaged
+// patches never produce an image that passes the digest.
+
+#include "DeltaPatch.h"
+#include "EventRecord.h"
+#include "fixture.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+#include <vector>
+
+// Update server throughput used for the download time comparison
+static const uint32_t LINK_BYTES_PER_S = 30 * 1024;
+
+static std::vector<uint8_t> oldImage;
+static std::vector<uint8_t> output;
+static size_t writeLimit; // Writer fails past this many bytes
+
+static void makeImage(std::vector<uint8_t> &image, uint32_t seed,
+                      uint32_t size) {
+  image.resize(size);
+  uint32_t x = seed;
+  for (uint32_t i = 0; i < size; i++) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    image[i] = x & 0xFF;
+  }
+}
+
+static bool readOld(uint32_t offset, uint8_t *buf, size_t len) {
+  if (offset > oldImage.size() || len > oldImage.size() - offset)
+    return false;
+  memcpy(buf, oldImage.data() + offset, len);
+  return true;
+}
+
+static bool writeOutput(const uint8_t *data, size_t len) {
+  if (output.size() + len > writeLimit)
+    return false;
+  output.insert(output.end(), data, data + len);
+  return true;
+}
+
+static DeltaPatch delta(readOld, writeOutput);
+
+// Feed the patch in pieces of the given size, as it arrives off the network
+static DeltaResult apply(const uint8_t *patch, size_t len, size_t piece) {
+  delta.reset();
+  output.clear();
+  DeltaResult result = DELTA_OK;
+  for (size_t pos = 0; pos < len && result == DELTA_OK; pos += piece) {
+    size_t n = len - pos < piece ? len - pos : piece;
+    result = delta.feed(patch + pos, n);
+  }
+  return result;
+}
+
+static uint32_t outputCrc() { return eventCrc32(output.data(), output.size()); }
+
+void setUp() {
+  makeImage(oldImage, FIXTURE_SEED, FIXTURE_OLD_SIZE);
+  writeLimit = SIZE_MAX;
+}
+
+void tearDown() {}
+
+void test_rebuilds_new_image() {
+  TEST_ASSERT_EQUAL(DELTA_DONE,
+                    apply(FIXTURE_PATCH, sizeof(FIXTURE_PATCH), 4096));
+  TEST_ASSERT_TRUE(delta.isDone());
+  TEST_ASSERT_EQUAL(FIXTURE_OLD_SIZE, delta.sourceSize());
+  TEST_ASSERT_EQUAL(FIXTURE_NEW_SIZE, delta.targetSize());
+  TEST_ASSERT_EQUAL(FIXTURE_NEW_SIZE, output.size());
+  TEST_ASSERT_EQUAL_HEX32(FIXTURE_NEW_CRC, outputCrc());
+}
+
+// Split at every kind of boundary: header, opcode, varint, data
+void test_any_split_gives_same_image() {
+  const size_t pieces[] = {1, 3, 16, 17, 1460};
+  for (size_t piece : pieces) {
+    TEST_ASSERT_EQUAL(DELTA_DONE,
+                      apply(FIXTURE_PATCH, sizeof(FIXTURE_PATCH), piece));
+    TEST_ASSERT_EQUAL_HEX32(FIXTURE_NEW_CRC, outputCrc());
+  }
+}
+
+// A connection that drops early leaves the patch waiting for more, which
+// OtaUpdater reports as "ended early" rather than installing anything.
+// Without its END op the patch is unfinished even though every byte of
+// the image has been written.
+void test_truncated_patch_never_completes() {
+  const size_t cuts[] = {4, DELTA_HEADER_SIZE, DELTA_HEADER_SIZE + 1,
+                         sizeof(FIXTURE_PATCH) / 2, sizeof(FIXTURE_PATCH) - 1};
+  for (size_t cut : cuts) {
+    TEST_ASSERT_EQUAL(DELTA_OK, apply(FIXTURE_PATCH, cut, 512));
+    TEST_ASSERT_FALSE(delta.isDone());
+  }
+  TEST_ASSERT_EQUAL(FIXTURE_NEW_SIZE, output.size());
+}
+
+void test_bad_header_rejected() {
+  std::vector<uint8_t> patch(FIXTURE_PATCH,
+                             FIXTURE_PATCH + sizeof(FIXTURE_PATCH));
+  patch[0] = 'X'; // Magic
+  TEST_ASSERT_EQUAL(DELTA_ERR_FORMAT, apply(patch.data(), patch.size(), 64));
+  TEST_ASSERT_EQUAL(0, output.size());
+
+  patch[0] = FIXTURE_PATCH[0];
+  patch[4] = DELTA_FORMAT_VERSION + 1;
+  TEST_ASSERT_EQUAL(DELTA_ERR_FORMAT, apply(patch.data(), patch.size(), 64));
+}
+
+void test_trailing_data_rejected() {
+  std::vector<uint8_t> patch(FIXTURE_PATCH,
+                             FIXTURE_PATCH + sizeof(FIXTURE_PATCH));
+  patch.push_back(0);
+  TEST_ASSERT_EQUAL(DELTA_ERR_FORMAT, apply(patch.data(), patch.size(), 64));
+}
+
+// Damage anywhere in the ops either stops the patch or changes the image,
+// which the SHA-256 check then refuses; it never writes past the target
+void test_corrupt_patch_never_passes_digest() {
+  std::vector<uint8_t> patch(FIXTURE_PATCH,
+                             FIXTURE_PATCH + sizeof(FIXTURE_PATCH));
+  int stopped = 0;
+  int caught = 0;
+  for (size_t i = DELTA_HEADER_SIZE; i < patch.size(); i += 7) {
+    patch[i] ^= 0x5A;
+    DeltaResult result = apply(patch.data(), patch.size(), 1460);
+    patch[i] ^= 0x5A;
+
+    TEST_ASSERT_LESS_OR_EQUAL(FIXTURE_NEW_SIZE, output.size());
+    if (result != DELTA_DONE) {
+      stopped++;
+    } else {
+      TEST_ASSERT_NOT_EQUAL(FIXTURE_NEW_CRC, outputCrc());
+      caught++;
+    }
+  }
+  char line[80];
+  snprintf(line, sizeof(line), "%d corruptions stopped, %d caught by digest",
+           stopped, caught);
+  TEST_MESSAGE(line);
+}
+
+// A board running another build than the patch was made for gets a wrong
+// image; OtaUpdater checks source_sha256 first for this reason
+void test_other_source_fails_digest() {
+  makeImage(oldImage, FIXTURE_SEED + 1, FIXTURE_OLD_SIZE);
+  TEST_ASSERT_EQUAL(DELTA_DONE,
+                    apply(FIXTURE_PATCH, sizeof(FIXTURE_PATCH), 4096));
+  TEST_ASSERT_NOT_EQUAL(FIXTURE_NEW_CRC, outputCrc());
+
+  oldImage.resize(FIXTURE_OLD_SIZE / 2);
+  TEST_ASSERT_EQUAL(DELTA_ERR_SOURCE,
+                    apply(FIXTURE_PATCH, sizeof(FIXTURE_PATCH), 4096));
+}
+
+void test_write_failure_stops() {
+  writeLimit = FIXTURE_NEW_SIZE / 2;
+  TEST_ASSERT_EQUAL(DELTA_ERR_WRITE,
+                    apply(FIXTURE_PATCH, sizeof(FIXTURE_PATCH), 4096));
+  TEST_ASSERT_EQUAL(DELTA_ERR_WRITE, delta.feed(FIXTURE_PATCH, 1));
+}
+
+// Patch against full image: bytes on the wire and time to produce the
+// image (patch applied vs the full image written in 4 KB chunks)
+void test_size_and_time() {
+  TEST_ASSERT_EQUAL(DELTA_DONE,
+                    apply(FIXTURE_PATCH, sizeof(FIXTURE_PATCH), 4096));
+  std::vector<uint8_t> image = output;
+
+  const int rounds = 20;
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < rounds; i++)
+    apply(FIXTURE_PATCH, sizeof(FIXTURE_PATCH), 4096);
+  double patchUs =
+      std::chrono::duration<double, std::micro>(Clock::now() - start).count() /
+      rounds;
+
+  start = Clock::now();
+  for (int i = 0; i < rounds; i++) {
+    output.clear();
+    for (size_t pos = 0; pos < image.size(); pos += 4096) {
+      size_t n = image.size() - pos < 4096 ? image.size() - pos : 4096;
+      writeOutput(image.data() + pos, n);
+    }
+  }
+  double fullUs =
+      std::chrono::duration<double, std::micro>(Clock::now() - start).count() /
+      rounds;
+
+  char line[160];
+  snprintf(line, sizeof(line),
+           "patch %u B = %.1f%% of %u B image; download %.1f s vs %.1f s at "
+           "%u KB/s; apply %.0f us vs %.0f us full write",
+           (unsigned)sizeof(FIXTURE_PATCH),
+           100.0 * sizeof(FIXTURE_PATCH) / FIXTURE_NEW_SIZE,
+           (unsigned)FIXTURE_NEW_SIZE,
+           (double)sizeof(FIXTURE_PATCH) / LINK_BYTES_PER_S,
+           (double)FIXTURE_NEW_SIZE / LINK_BYTES_PER_S,
+           (unsigned)(LINK_BYTES_PER_S / 1024), patchUs, fullUs);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_LESS_THAN(FIXTURE_NEW_SIZE / 10, sizeof(FIXTURE_PATCH));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_rebuilds_new_image);
+  RUN_TEST(test_any_split_gives_same_image);
+  RUN_TEST(test_truncated_patch_never_completes);
+  RUN_TEST(test_bad_header_rejected);
+  RUN_TEST(test_trailing_data_rejected);
+  RUN_TEST(test_corrupt_patch_never_passes_digest);
+  RUN_TEST(test_other_source_fails_digest);
+  RUN_TEST(test_write_failure_stops);
+  RUN_TEST(test_size_and_time);
+  return UNITY_END();
+}
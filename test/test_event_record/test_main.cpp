@@ -0,0 +1,183 @@
+// EventRecord codec on the host: encode and decode, records rejected for a
+// bad magic byte or CRC, and scanEventRecords resyncing past a record torn
+// by power loss where one log segment ends and the next begins.
+
+#include "EventRecord.h"
+#include <string.h>
+#include <unity.h>
+
+static const int MAX_SEEN = 16;
+
+struct Seen {
+  EventRecord recs[MAX_SEEN];
+  int count;
+};
+
+static Seen *seen;
+
+static void collect(const EventRecord &rec, void *ctx) {
+  Seen *s = (Seen *)ctx;
+  if (s->count < MAX_SEEN)
+    s->recs[s->count] = rec;
+  s->count++;
+}
+
+static EventRecord makeRecord(uint32_t seq) {
+  EventRecord rec;
+  rec.type = EVENT_TRACK;
+  rec.code = (uint16_t)(seq % 64);
+  rec.seq = seq;
+  rec.time = 1700000000u + seq;
+  rec.uptimeMs = 1000u * seq;
+  rec.value = (int32_t)(seq & 1);
+  return rec;
+}
+
+// Records seq first..first+count-1 back to back
+static size_t writeRecords(uint8_t *out, uint32_t first, int count) {
+  for (int i = 0; i < count; i++)
+    encodeEventRecord(makeRecord(first + i), out + i * EVENT_RECORD_SIZE);
+  return count * EVENT_RECORD_SIZE;
+}
+
+static void assertSeqs(uint32_t first, int count) {
+  TEST_ASSERT_EQUAL(count, seen->count);
+  for (int i = 0; i < count; i++)
+    TEST_ASSERT_EQUAL_UINT32(first + i, seen->recs[i].seq);
+}
+
+void setUp() {
+  seen = new Seen();
+  seen->count = 0;
+}
+
+void tearDown() { delete seen; }
+
+void test_round_trip() {
+  EventRecord rec;
+  rec.type = EVENT_STALL;
+  rec.code = 0xBEEF;
+  rec.seq = 0x01020304;
+  rec.time = 0xFFFFFFFE;
+  rec.uptimeMs = 123456789;
+  rec.value = -42;
+
+  uint8_t buf[EVENT_RECORD_SIZE];
+  encodeEventRecord(rec, buf);
+  TEST_ASSERT_EQUAL_HEX8(EVENT_RECORD_MAGIC, buf[0]);
+  // Little-endian on the wire whatever the host
+  TEST_ASSERT_EQUAL_HEX8(0xEF, buf[2]);
+  TEST_ASSERT_EQUAL_HEX8(0x04, buf[4]);
+  TEST_ASSERT_EQUAL_HEX8(0x01, buf[7]);
+
+  EventRecord out;
+  TEST_ASSERT_TRUE(decodeEventRecord(buf, out));
+  TEST_ASSERT_EQUAL_UINT8(EVENT_STALL, out.type);
+  TEST_ASSERT_EQUAL_HEX16(0xBEEF, out.code);
+  TEST_ASSERT_EQUAL_HEX32(0x01020304, out.seq);
+  TEST_ASSERT_EQUAL_HEX32(0xFFFFFFFE, out.time);
+  TEST_ASSERT_EQUAL_UINT32(123456789, out.uptimeMs);
+  TEST_ASSERT_EQUAL_INT32(-42, out.value);
+}
+
+void test_crc_matches_ieee() {
+  // The standard CRC-32 check value
+  TEST_ASSERT_EQUAL_HEX32(0xCBF43926,
+                          eventCrc32((const uint8_t *)"123456789", 9));
+}
+
+void test_bad_magic_rejected() {
+  uint8_t buf[EVENT_RECORD_SIZE];
+  encodeEventRecord(makeRecord(7), buf);
+  buf[0] = 0x5A;
+  EventRecord out;
+  TEST_ASSERT_FALSE(decodeEventRecord(buf, out));
+}
+
+void test_bad_crc_rejected() {
+  uint8_t buf[EVENT_RECORD_SIZE];
+  EventRecord out;
+  // Any single flipped bit, in the body or in the CRC itself
+  for (size_t i = 1; i < EVENT_RECORD_SIZE; i++) {
+    encodeEventRecord(makeRecord(7), buf);
+    buf[i] ^= 0x10;
+    TEST_ASSERT_FALSE(decodeEventRecord(buf, out));
+  }
+}
+
+void test_scan_clean_buffer() {
+  uint8_t buf[4 * EVENT_RECORD_SIZE];
+  size_t len = writeRecords(buf, 10, 4);
+  TEST_ASSERT_EQUAL_UINT32(len, scanEventRecords(buf, len, collect, seen));
+  assertSeqs(10, 4);
+  TEST_ASSERT_EQUAL_UINT8(EVENT_TRACK, seen->recs[3].type);
+  TEST_ASSERT_EQUAL_UINT32(13000, seen->recs[3].uptimeMs);
+}
+
+// /events.old ends in a torn append; /events.log starts on a record
+// boundary after the rotation at boot. Read back as one stream the scanner
+// loses only the torn record.
+void test_scan_resyncs_after_torn_record_at_segment_end() {
+  uint8_t buf[8 * EVENT_RECORD_SIZE];
+  size_t len = writeRecords(buf, 1, 3);
+  uint8_t torn[EVENT_RECORD_SIZE];
+  encodeEventRecord(makeRecord(4), torn);
+  memcpy(buf + len, torn, 11);
+  len += 11;
+  len += writeRecords(buf + len, 5, 3);
+
+  TEST_ASSERT_EQUAL_UINT32(len, scanEventRecords(buf, len, collect, seen));
+  TEST_ASSERT_EQUAL(6, seen->count);
+  TEST_ASSERT_EQUAL_UINT32(3, seen->recs[2].seq);
+  TEST_ASSERT_EQUAL_UINT32(5, seen->recs[3].seq);
+  TEST_ASSERT_EQUAL_UINT32(7, seen->recs[5].seq);
+}
+
+// Garbage that starts with the magic byte must not swallow the good record
+// right behind it
+void test_scan_resyncs_past_false_magic() {
+  uint8_t buf[4 * EVENT_RECORD_SIZE];
+  memset(buf, EVENT_RECORD_MAGIC, 5);
+  size_t len = 5 + writeRecords(buf + 5, 20, 2);
+  TEST_ASSERT_EQUAL_UINT32(len, scanEventRecords(buf, len, collect, seen));
+  assertSeqs(20, 2);
+}
+
+// A partial record at the end of a chunk is left for the next call, so a
+// record split across two reads is not lost
+void test_scan_leaves_partial_record() {
+  uint8_t buf[4 * EVENT_RECORD_SIZE];
+  size_t len = writeRecords(buf, 30, 3);
+  size_t split = 2 * EVENT_RECORD_SIZE + 9;
+
+  size_t used = scanEventRecords(buf, split, collect, seen);
+  TEST_ASSERT_EQUAL_UINT32(2 * EVENT_RECORD_SIZE, used);
+  TEST_ASSERT_EQUAL(2, seen->count);
+
+  used += scanEventRecords(buf + used, len - used, collect, seen);
+  TEST_ASSERT_EQUAL_UINT32(len, used);
+  assertSeqs(30, 3);
+}
+
+// A torn tail alone is never taken for a record and is not consumed
+void test_scan_torn_tail_only() {
+  uint8_t buf[EVENT_RECORD_SIZE];
+  encodeEventRecord(makeRecord(1), buf);
+  TEST_ASSERT_EQUAL_UINT32(0, scanEventRecords(buf, EVENT_RECORD_SIZE - 1,
+                                               collect, seen));
+  TEST_ASSERT_EQUAL(0, seen->count);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_crc_matches_ieee);
+  RUN_TEST(test_bad_magic_rejected);
+  RUN_TEST(test_bad_crc_rejected);
+  RUN_TEST(test_scan_clean_buffer);
+  RUN_TEST(test_scan_resyncs_after_torn_record_at_segment_end);
+  RUN_TEST(test_scan_resyncs_past_false_magic);
+  RUN_TEST(test_scan_leaves_partial_record);
+  RUN_TEST(test_scan_torn_tail_only);
+  return UNITY_END();
+}
@@ -0,0 +1,138 @@
+// HeapGuard on the host with a simulated heap that fragments: plenty free
+// while the largest block shrinks. Checks the levels it sheds load at, the
+// hysteresis on the way back, and the low-water mark of the largest block.
+
+#include "HeapGuard.h"
+#include <unity.h>
+
+static const uint32_t KB = 1024;
+
+static HeapGuard *guard;
+
+static HeapSample heap(uint32_t freeBytes, uint32_t largestBlock) {
+  HeapSample s;
+  s.freeBytes = freeBytes;
+  s.minFreeBytes = freeBytes;
+  s.largestBlock = largestBlock;
+  return s;
+}
+
+static void assertLevel(HeapLevel expected) {
+  TEST_ASSERT_EQUAL_STRING(HeapGuard::levelName(expected),
+                           HeapGuard::levelName(guard->level()));
+}
+
+void setUp() { guard = new HeapGuard(); }
+
+void tearDown() { delete guard; }
+
+// 120 KB free throughout; only the largest block gives the heap away
+void test_fragmenting_heap_sheds_load() {
+  TEST_ASSERT_FALSE(guard->update(heap(120 * KB, 60 * KB)));
+  assertLevel(HEAP_OK);
+  TEST_ASSERT_EQUAL_UINT8(50, guard->fragmentation());
+
+  TEST_ASSERT_FALSE(guard->update(heap(120 * KB, 16 * KB)));
+  assertLevel(HEAP_OK);
+
+  TEST_ASSERT_TRUE(guard->update(heap(120 * KB, 16 * KB - 1)));
+  assertLevel(HEAP_LOW);
+  TEST_ASSERT_TRUE(guard->shedding());
+
+  TEST_ASSERT_FALSE(guard->update(heap(120 * KB, 9 * KB)));
+  TEST_ASSERT_TRUE(guard->update(heap(120 * KB, 8 * KB - 1)));
+  assertLevel(HEAP_CRITICAL);
+  TEST_ASSERT_EQUAL_UINT8(94, guard->fragmentation());
+  TEST_ASSERT_EQUAL_UINT32(2, guard->transitions());
+}
+
+// Free heap alone trips the levels too
+void test_free_heap_limits() {
+  guard->update(heap(40 * KB, 30 * KB));
+  assertLevel(HEAP_OK);
+  guard->update(heap(40 * KB - 1, 30 * KB));
+  assertLevel(HEAP_LOW);
+  guard->update(heap(24 * KB - 1, 20 * KB));
+  assertLevel(HEAP_CRITICAL);
+}
+
+// Getting worse takes effect at once, skipping levels
+void test_worsening_is_immediate() {
+  TEST_ASSERT_TRUE(guard->update(heap(120 * KB, 4 * KB)));
+  assertLevel(HEAP_CRITICAL);
+  TEST_ASSERT_EQUAL_UINT32(1, guard->transitions());
+}
+
+// Back from critical: each level is left only with HEAP_HYSTERESIS to
+// spare on both values
+void test_recovery_needs_margin() {
+  guard->update(heap(120 * KB, 4 * KB));
+
+  // Clear of the critical limit but not by the margin
+  TEST_ASSERT_FALSE(guard->update(heap(120 * KB, 16 * KB - 1)));
+  assertLevel(HEAP_CRITICAL);
+  TEST_ASSERT_TRUE(guard->update(heap(120 * KB, 16 * KB)));
+  assertLevel(HEAP_LOW);
+
+  // The block is fine now, free heap still within the margin of low
+  TEST_ASSERT_FALSE(guard->update(heap(48 * KB - 1, 40 * KB)));
+  assertLevel(HEAP_LOW);
+  TEST_ASSERT_FALSE(guard->update(heap(120 * KB, 24 * KB - 1)));
+  TEST_ASSERT_TRUE(guard->update(heap(48 * KB, 24 * KB)));
+  assertLevel(HEAP_OK);
+  TEST_ASSERT_EQUAL_UINT32(3, guard->transitions());
+}
+
+// A big recovery goes straight back to ok
+void test_full_recovery_in_one_step() {
+  guard->update(heap(120 * KB, 4 * KB));
+  TEST_ASSERT_TRUE(guard->update(heap(120 * KB, 60 * KB)));
+  assertLevel(HEAP_OK);
+}
+
+// A heap hovering around a limit changes level once, not on every sample
+void test_no_flapping_at_limit() {
+  for (int i = 0; i < 100; i++) {
+    uint32_t block = (i % 2) ? 16 * KB + 512 : 16 * KB - 512;
+    guard->update(heap(120 * KB, block));
+  }
+  assertLevel(HEAP_LOW);
+  TEST_ASSERT_EQUAL_UINT32(1, guard->transitions());
+}
+
+// The smallest largest block seen is kept through recovery
+void test_min_largest_block_tracked() {
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, guard->minLargestBlock());
+  guard->update(heap(120 * KB, 60 * KB));
+  TEST_ASSERT_EQUAL_UINT32(60 * KB, guard->minLargestBlock());
+
+  uint32_t blocks[] = {48 * KB, 30 * KB, 12 * KB, 7 * KB, 20 * KB, 64 * KB};
+  for (uint32_t block : blocks)
+    guard->update(heap(120 * KB, block));
+  TEST_ASSERT_EQUAL_UINT32(7 * KB, guard->minLargestBlock());
+  assertLevel(HEAP_OK);
+  TEST_ASSERT_EQUAL_UINT32(64 * KB, guard->sample().largestBlock);
+}
+
+void test_fragmentation_edges() {
+  TEST_ASSERT_EQUAL_UINT8(0, guard->fragmentation());
+  guard->update(heap(0, 0));
+  TEST_ASSERT_EQUAL_UINT8(0, guard->fragmentation());
+  guard->update(heap(32 * KB, 32 * KB));
+  TEST_ASSERT_EQUAL_UINT8(0, guard->fragmentation());
+  guard->update(heap(100 * KB, 25 * KB));
+  TEST_ASSERT_EQUAL_UINT8(75, guard->fragmentation());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_fragmenting_heap_sheds_load);
+  RUN_TEST(test_free_heap_limits);
+  RUN_TEST(test_worsening_is_immediate);
+  RUN_TEST(test_recovery_needs_margin);
+  RUN_TEST(test_full_recovery_in_one_step);
+  RUN_TEST(test_no_flapping_at_limit);
+  RUN_TEST(test_min_largest_block_tracked);
+  RUN_TEST(test_fragmentation_edges);
+  return UNITY_END();
+}
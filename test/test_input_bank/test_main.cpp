@@ -0,0 +1,170 @@
+// InputBank on the host with the simulated 64-input board (4 x 16 inputs,
+// as with HSC_SIMULATED_INPUTS): the index layout, every clean toggle of
+// every source coming out of TrackDebouncer as exactly one edge, and the
+// cost of one sampling pass over all inputs.
+
+#include "InputSource.h"
+#include "SimulatedInputSource.h"
+#include "TrackDebouncer.h"
+#include <chrono>
+#include <stdio.h>
+#include <unity.h>
+
+static const int SOURCES = 4;
+static const int PER_SOURCE = 16;
+static const uint32_t DWELL_MS = 20000;
+static const uint32_t BOUNCE_MS = 30;
+static const uint16_t WINDOW_MS = 50;
+
+static SimulatedInputSource *sources[SOURCES];
+static InputBank *bank;
+static TrackDebouncer *debouncer;
+
+void setUp() {
+  bank = new InputBank();
+  debouncer = new TrackDebouncer();
+  for (int s = 0; s < SOURCES; s++) {
+    sources[s] = new SimulatedInputSource(PER_SOURCE, s + 1, DWELL_MS,
+                                          BOUNCE_MS);
+    bank->add(sources[s]);
+  }
+  bank->begin();
+}
+
+void tearDown() {
+  delete debouncer;
+  delete bank;
+  for (int s = 0; s < SOURCES; s++)
+    delete sources[s];
+}
+
+// What loop() does each pass: one sample of the bank, one update per input
+static int samplePass(uint32_t nowMs, int *changes) {
+  uint64_t levels = bank->sample(nowMs);
+  int changed = 0;
+  for (int i = 0; i < bank->count(); i++) {
+    int raw = (levels >> i) & 1;
+    if (!debouncer->update(i, raw, nowMs))
+      continue;
+    TEST_ASSERT_EQUAL(raw, debouncer->state(i));
+    changes[i / PER_SOURCE]++;
+    changed++;
+  }
+  return changed;
+}
+
+static void resetDebouncer(uint32_t nowMs) {
+  uint64_t levels = bank->sample(nowMs);
+  for (int i = 0; i < bank->count(); i++) {
+    debouncer->configure(i, WINDOW_MS, false);
+    debouncer->reset(i, (levels >> i) & 1, nowMs);
+  }
+}
+
+void test_layout() {
+  TEST_ASSERT_EQUAL(SOURCES, bank->sourceCount());
+  TEST_ASSERT_EQUAL(MAX_INPUTS, bank->count());
+  for (int s = 0; s < SOURCES; s++) {
+    TEST_ASSERT_EQUAL(s * PER_SOURCE, bank->sourceOffset(s));
+    TEST_ASSERT_TRUE(bank->source(s) == sources[s]);
+  }
+
+  // Full: no fifth source, and no more than 64 inputs
+  SimulatedInputSource extra(1, 9, DWELL_MS, BOUNCE_MS);
+  TEST_ASSERT_FALSE(bank->add(&extra));
+  InputBank small;
+  SimulatedInputSource wide(32, 9, DWELL_MS, BOUNCE_MS);
+  TEST_ASSERT_TRUE(small.add(&wide));
+  TEST_ASSERT_TRUE(small.add(&wide));
+  TEST_ASSERT_FALSE(small.add(&extra));
+}
+
+// A source that fails to start is dropped and the rest close up
+void test_failed_source_dropped() {
+  InputBank partial;
+  SimulatedInputSource empty(0, 9, DWELL_MS, BOUNCE_MS);
+  partial.add(sources[0]);
+  partial.add(&empty);
+  partial.add(sources[1]);
+  partial.begin();
+  TEST_ASSERT_EQUAL(2, partial.sourceCount());
+  TEST_ASSERT_EQUAL(2 * PER_SOURCE, partial.count());
+  TEST_ASSERT_TRUE(partial.source(1) == sources[1]);
+  TEST_ASSERT_EQUAL(PER_SOURCE, partial.sourceOffset(1));
+}
+
+// Ten minutes sampled every 1 ms. Bounce is shorter than the window, so
+// every toggle of every source is one edge in that source's range and none
+// ends as a glitch. Toggles in the last window may not have settled yet.
+void test_every_toggle_is_one_edge() {
+  const uint32_t RUN_MS = 600000;
+  const uint32_t SETTLE_MS = BOUNCE_MS + WINDOW_MS + 1;
+  int changes[SOURCES] = {0, 0, 0, 0};
+  uint32_t settled[SOURCES] = {0, 0, 0, 0};
+
+  resetDebouncer(0);
+  for (uint32_t t = 1; t <= RUN_MS; t++) {
+    samplePass(t, changes);
+    if (t == RUN_MS - SETTLE_MS)
+      for (int s = 0; s < SOURCES; s++)
+        settled[s] = sources[s]->toggles();
+  }
+
+  int total = 0;
+  for (int s = 0; s < SOURCES; s++) {
+    char line[96];
+    snprintf(line, sizeof(line), "source %d: %u toggles, %d edges", s,
+             (unsigned)sources[s]->toggles(), changes[s]);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_GREATER_THAN(0, (int)settled[s]);
+    TEST_ASSERT_GREATER_OR_EQUAL((int)settled[s], changes[s]);
+    TEST_ASSERT_LESS_OR_EQUAL((int)sources[s]->toggles(), changes[s]);
+    total += changes[s];
+  }
+  for (int i = 0; i < bank->count(); i++)
+    TEST_ASSERT_EQUAL_UINT32(0, debouncer->glitchCount(i));
+  TEST_ASSERT_GREATER_THAN(SOURCES * PER_SOURCE, total);
+}
+
+typedef std::chrono::steady_clock Clock;
+
+static double nsPerPass(Clock::duration elapsed, uint32_t passes) {
+  return std::chrono::duration<double, std::nano>(elapsed).count() / passes;
+}
+
+// One loop() pass over all 64 inputs: the bank read alone, and with the
+// debouncer
+void test_pass_cost() {
+  const uint32_t PASSES = 200000;
+  int changes[SOURCES] = {0, 0, 0, 0};
+  resetDebouncer(0);
+
+  volatile uint64_t sink = 0;
+  Clock::time_point start = Clock::now();
+  for (uint32_t t = 1; t <= PASSES; t++)
+    sink = sink ^ bank->sample(t);
+  double sampleNs = nsPerPass(Clock::now() - start, PASSES);
+
+  start = Clock::now();
+  for (uint32_t t = PASSES + 1; t <= 2 * PASSES; t++)
+    samplePass(t, changes);
+  double passNs = nsPerPass(Clock::now() - start, PASSES);
+
+  char line[128];
+  snprintf(line, sizeof(line),
+           "%d inputs: %.0f ns to sample, %.0f ns with the debouncer "
+           "(%.1f ns per input)",
+           bank->count(), sampleNs, passNs, passNs / bank->count());
+  TEST_MESSAGE(line);
+  TEST_ASSERT_GREATER_THAN(0, changes[0] + changes[1] + changes[2] +
+                                  changes[3]);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_layout);
+  RUN_TEST(test_failed_source_dropped);
+  RUN_TEST(test_every_toggle_is_one_edge);
+  RUN_TEST(test_pass_cost);
+  return UNITY_END();
+}
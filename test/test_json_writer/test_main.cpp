@@ -0,0 +1,336 @@
+// JsonWriter output checks, and a microbenchmark against the ArduinoJson
+// path it replaced: the /api/settings reply written into a Print, bytes per
+// second and the memory each side needs. The output must be identical.
+
+#include "JsonWriter.h"
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+#if __has_include(<ArduinoJson.h>)
+#include <ArduinoJson.h>
+#define HAVE_ARDUINOJSON 1
+#endif
+
+static const int BENCH_RUNS = 20000;
+
+// A Print that keeps what fits and counts the rest, like the response
+// stream without the network
+class Sink : public Print {
+public:
+  char data[2048];
+  size_t length = 0;
+
+  void reset() { length = 0; }
+  const char *str() {
+    data[length < sizeof(data) ? length : sizeof(data) - 1] = '\0';
+    return data;
+  }
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size) override {
+    for (size_t i = 0; i < size; i++) {
+      if (length + i < sizeof(data))
+        data[length + i] = buffer[i];
+    }
+    length += size;
+    return size;
+  }
+};
+
+static Sink sink;
+
+static const char *write(void (*body)(JsonWriter &)) {
+  sink.reset();
+  JsonWriter json(sink);
+  body(json);
+  TEST_ASSERT_EQUAL(sink.length, json.length());
+  return sink.str();
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_nesting_and_separators() {
+  const char *out = write([](JsonWriter &json) {
+    json.beginObject();
+    json.add("a", 1);
+    json.beginArray("list");
+    json.value(1);
+    json.beginObject();
+    json.endObject();
+    json.beginArray();
+    json.endArray();
+    json.value("x");
+    json.endArray();
+    json.beginObject("o");
+    json.addNull("n");
+    json.add("t", true);
+    json.add("f", false);
+    json.endObject();
+    json.endObject();
+  });
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"a\":1,\"list\":[1,{},[],\"x\"],\"o\":{\"n\":null,\"t\":true,"
+      "\"f\":false}}",
+      out);
+}
+
+void test_string_escapes() {
+  const char *out = write([](JsonWriter &json) {
+    json.beginObject();
+    json.add("s", "quote \" back \\ nl \n cr \r tab \t bell \x07 end");
+    json.add("k\"ey", "");
+    json.add("null", (const char *)nullptr);
+    json.endObject();
+  });
+  TEST_ASSERT_EQUAL_STRING("{\"s\":\"quote \\\" back \\\\ nl \\n cr \\r "
+                           "tab \\t bell \\u0007 end\",\"k\\\"ey\":\"\","
+                           "\"null\":null}",
+                           out);
+}
+
+void test_integer_limits() {
+  const char *out = write([](JsonWriter &json) {
+    json.beginArray();
+    json.value(0);
+    json.value(-1);
+    json.value(2147483647L);
+    json.endArray();
+  });
+  TEST_ASSERT_EQUAL_STRING("[0,-1,2147483647]", out);
+
+  out = write([](JsonWriter &json) {
+    json.beginObject();
+    json.add("min", (long long)INT64_MIN);
+    json.add("max", (unsigned long long)UINT64_MAX);
+    json.add("u8", (uint8_t)255);
+    json.add("i16", (int16_t)-300);
+    json.endObject();
+  });
+  TEST_ASSERT_EQUAL_STRING("{\"min\":-9223372036854775808,"
+                           "\"max\":18446744073709551615,\"u8\":255,"
+                           "\"i16\":-300}",
+                           out);
+}
+
+void test_fixed_point_floats() {
+  const char *out = write([](JsonWriter &json) {
+    json.beginObject();
+    json.add("a", 12.345f, 1);
+    json.add("b", -0.04f, 1);
+    json.add("c", 0.5f, 0);
+    json.add("d", -2.5f, 3);
+    json.add("e", 1.0f / 3, 9);
+    json.add("nan", NAN, 2);
+    json.add("inf", -INFINITY, 2);
+    json.endObject();
+  });
+  // -0.04 rounds to 0.0, which is not written as -0.0; decimals stop at 6
+  TEST_ASSERT_EQUAL_STRING("{\"a\":12.3,\"b\":0.0,\"c\":1,\"d\":-2.500,"
+                           "\"e\":0.333333,\"nan\":null,\"inf\":null}",
+                           out);
+}
+
+void test_buffer_overflow() {
+  char buffer[24];
+  JsonWriter json(buffer, sizeof(buffer));
+  json.beginObject();
+  json.add("name", "board-3");
+  TEST_ASSERT_FALSE(json.overflowed());
+  json.add("location", "yard");
+  json.endObject();
+  TEST_ASSERT_TRUE(json.overflowed());
+  TEST_ASSERT_EQUAL(strlen("{\"name\":\"board-3\",\"location\":\"yard\"}"),
+                    json.length());
+  // Cut short but terminated
+  TEST_ASSERT_EQUAL_STRING("{\"name\":\"board-3\",\"loca", buffer);
+}
+
+// --- Benchmark ---
+
+// What /api/settings sends, with a full track table and a rule set
+struct Settings {
+  const char *wifiSsid = "yard-net";
+  const char *wifiPassword = "correct horse";
+  const char *mqttServer = "broker.yard.local";
+  int mqttPort = 1883;
+  const char *mqttUser = "hsc";
+  const char *mqttPassword = "s3cret\"pw";
+  const char *mqttFallback = "10.0.0.2:1883";
+  bool mqttDual = false;
+  int boardId = 3;
+  const char *location = "North ladder, \"B\" side";
+  bool lowPower = false;
+  bool peerLink = true;
+  const char *ntpServer = "pool.ntp.org";
+  const char *tz = "CET-1CEST,M3.5.0,M10.5.0/3";
+  const char *rules = "# Ladder fouled\n"
+                      "ladder_fouled = off(on(T1 | T2, 2000), 5000)\n"
+                      "pair_3_4 = T3 & T4\n"
+                      "boundary = T8 | P2.1\n"
+                      "yard_busy = ladder_fouled | pair_3_4\n";
+  bool provisionKeySet = true;
+  uint32_t provisionSeq = 41;
+  uint16_t debounceMs[16] = {0, 0, 20, 20, 0, 0, 0, 0,
+                             0, 0, 0, 0,  0,  0, 0, 250};
+  bool debounceAdaptive[16] = {true, true, false, false, true, true,
+                               true, true, true,  true,  true, true,
+                               true, true, true,  false};
+  uint8_t trackPins[16] = {4,  5,  13, 14, 16, 17, 18, 19,
+                           21, 22, 23, 25, 26, 27, 32, 33};
+  int numTracks = 16;
+};
+
+static Settings settings;
+
+static void writeSettings(JsonWriter &json) {
+  const Settings &c = settings;
+  json.beginObject();
+  json.add("wifi_ssid", c.wifiSsid);
+  json.add("wifi_password", c.wifiPassword);
+  json.add("mqtt_server", c.mqttServer);
+  json.add("mqtt_port", c.mqttPort);
+  json.add("mqtt_user", c.mqttUser);
+  json.add("mqtt_password", c.mqttPassword);
+  json.add("mqtt_fallback", c.mqttFallback);
+  json.add("mqtt_dual", c.mqttDual);
+  json.add("board_id", c.boardId);
+  json.add("location", c.location);
+  json.add("low_power", c.lowPower);
+  json.add("peer_link", c.peerLink);
+  json.add("ntp_server", c.ntpServer);
+  json.add("tz", c.tz);
+  json.add("rules", c.rules);
+  json.add("provision_key_set", c.provisionKeySet);
+  json.add("provision_seq", c.provisionSeq);
+  json.beginArray("debounce_ms");
+  for (int i = 0; i < 16; i++)
+    json.value(c.debounceMs[i]);
+  json.endArray();
+  json.beginArray("debounce_adaptive");
+  for (int i = 0; i < 16; i++)
+    json.value(c.debounceAdaptive[i]);
+  json.endArray();
+  json.beginArray("track_pins");
+  for (int i = 0; i < c.numTracks; i++)
+    json.value(c.trackPins[i]);
+  json.endArray();
+  json.endObject();
+}
+
+#ifdef HAVE_ARDUINOJSON
+// The document the handler used to build
+static const size_t SETTINGS_DOC_SIZE = 6144;
+
+static size_t writeSettingsDocument(Print &out) {
+  const Settings &c = settings;
+  DynamicJsonDocument doc(SETTINGS_DOC_SIZE);
+  doc["wifi_ssid"] = c.wifiSsid;
+  doc["wifi_password"] = c.wifiPassword;
+  doc["mqtt_server"] = c.mqttServer;
+  doc["mqtt_port"] = c.mqttPort;
+  doc["mqtt_user"] = c.mqttUser;
+  doc["mqtt_password"] = c.mqttPassword;
+  doc["mqtt_fallback"] = c.mqttFallback;
+  doc["mqtt_dual"] = c.mqttDual;
+  doc["board_id"] = c.boardId;
+  doc["location"] = c.location;
+  doc["low_power"] = c.lowPower;
+  doc["peer_link"] = c.peerLink;
+  doc["ntp_server"] = c.ntpServer;
+  doc["tz"] = c.tz;
+  doc["rules"] = c.rules;
+  doc["provision_key_set"] = c.provisionKeySet;
+  doc["provision_seq"] = c.provisionSeq;
+  JsonArray debounce = doc.createNestedArray("debounce_ms");
+  for (int i = 0; i < 16; i++)
+    debounce.add(c.debounceMs[i]);
+  JsonArray adaptive = doc.createNestedArray("debounce_adaptive");
+  for (int i = 0; i < 16; i++)
+    adaptive.add(c.debounceAdaptive[i]);
+  JsonArray pins = doc.createNestedArray("track_pins");
+  for (int i = 0; i < c.numTracks; i++)
+    pins.add(c.trackPins[i]);
+  TEST_ASSERT_FALSE(doc.overflowed());
+  serializeJson(doc, out);
+  return doc.memoryUsage();
+}
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static double megabytesPerSecond(size_t bytes, Clock::duration elapsed) {
+  double s = std::chrono::duration<double>(elapsed).count();
+  return s > 0 ? bytes / s / 1e6 : 0;
+}
+
+static void report(const char *path, double mbps, const char *memory) {
+  char line[128];
+  snprintf(line, sizeof(line), "%-22s %6.1f MB/s  %s", path, mbps, memory);
+  TEST_MESSAGE(line);
+}
+
+void test_settings_benchmark() {
+  char memory[64];
+  const char *reply = write(writeSettings);
+  size_t replyLen = strlen(reply);
+  TEST_ASSERT_GREATER_THAN(700, replyLen);
+
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < BENCH_RUNS; i++) {
+    sink.reset();
+    JsonWriter json(sink);
+    writeSettings(json);
+  }
+  double writerMbps =
+      megabytesPerSecond(replyLen * BENCH_RUNS, Clock::now() - start);
+  snprintf(memory, sizeof(memory), "%u B reply, %u B writer on the stack",
+           (unsigned)replyLen, (unsigned)sizeof(JsonWriter));
+  report("JsonWriter -> Print", writerMbps, memory);
+
+  static char buffer[1024];
+  start = Clock::now();
+  for (int i = 0; i < BENCH_RUNS; i++) {
+    JsonWriter json(buffer, sizeof(buffer));
+    writeSettings(json);
+  }
+  report("JsonWriter -> buffer",
+         megabytesPerSecond(replyLen * BENCH_RUNS, Clock::now() - start),
+         "");
+  TEST_ASSERT_EQUAL_STRING(reply, buffer);
+
+#ifdef HAVE_ARDUINOJSON
+  static char expected[sizeof(sink.data)];
+  strcpy(expected, reply);
+  sink.reset();
+  size_t used = writeSettingsDocument(sink);
+  TEST_ASSERT_EQUAL_STRING(expected, sink.str());
+
+  start = Clock::now();
+  for (int i = 0; i < BENCH_RUNS; i++) {
+    sink.reset();
+    writeSettingsDocument(sink);
+  }
+  snprintf(memory, sizeof(memory), "%u B document on the heap, %u B used",
+           (unsigned)SETTINGS_DOC_SIZE, (unsigned)used);
+  report("ArduinoJson -> Print",
+         megabytesPerSecond(replyLen * BENCH_RUNS, Clock::now() - start),
+         memory);
+#else
+  TEST_MESSAGE("ArduinoJson not found, comparison skipped");
+#endif
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_nesting_and_separators);
+  RUN_TEST(test_string_escapes);
+  RUN_TEST(test_integer_limits);
+  RUN_TEST(test_fixed_point_floats);
+  RUN_TEST(test_buffer_overflow);
+  RUN_TEST(test_settings_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,488 @@
+// MQTT 3.1.1 conformance of the packet layer MqttClient is built on.
+//
+// The first tests check encoders and the reader against the byte layouts
+// of the specification. The rest talk to a real broker over a socket:
+// MQTT_TEST_BROKER=host:port (default 127.0.0.1:1883), e.g. a local
+// mosquitto. They are ignored when no broker answers.
+
+#include "MqttPacket.h"
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <unity.h>
+
+static const int BROKER_TIMEOUT_MS = 2000;
+
+static uint8_t buf[MQTT_MAX_PACKET_SIZE];
+static char topicPrefix[32];
+
+static const uint8_t *bytes(const char *s) { return (const uint8_t *)s; }
+
+// Feed a whole packet and return the reader holding it
+static void readBack(MqttReader &reader, const uint8_t *data, size_t len) {
+  reader.reset();
+  size_t used = reader.feed(data, len);
+  TEST_ASSERT_EQUAL(len, used);
+  TEST_ASSERT_TRUE(reader.ready());
+}
+
+void test_connect_layout() {
+  MqttConnectOptions opt;
+  opt.clientId = "hsc";
+  opt.keepAliveS = 15;
+  size_t len = mqttEncodeConnect(buf, sizeof(buf), opt);
+  // [MQTT-3.1]: protocol name "MQTT", level 4, clean session flag
+  const uint8_t expected[] = {0x10, 0x0F, 0x00, 0x04, 'M', 'Q', 'T', 'T',
+                              0x04, 0x02, 0x00, 0x0F, 0x00, 0x03, 'h', 's',
+                              'c'};
+  TEST_ASSERT_EQUAL(sizeof(expected), len);
+  TEST_ASSERT_EQUAL_MEMORY(expected, buf, len);
+}
+
+void test_connect_flags() {
+  MqttConnectOptions opt;
+  opt.clientId = "hsc";
+  opt.user = "u";
+  opt.password = "p";
+  opt.willTopic = "w";
+  opt.willMessage = "offline";
+  opt.willQos = 1;
+  opt.willRetain = true;
+  opt.cleanSession = false;
+  size_t len = mqttEncodeConnect(buf, sizeof(buf), opt);
+  TEST_ASSERT_GREATER_THAN(0, len);
+  // user, password, will retain, will QoS 1, will; no clean session
+  TEST_ASSERT_EQUAL_HEX8(0x80 | 0x40 | 0x20 | 0x08 | 0x04, buf[9]);
+
+  // [MQTT-3.1.2-22]: no password flag without a user name
+  opt.user = "";
+  len = mqttEncodeConnect(buf, sizeof(buf), opt);
+  TEST_ASSERT_EQUAL_HEX8(0x20 | 0x08 | 0x04, buf[9]);
+
+  TEST_ASSERT_EQUAL(0, mqttEncodeConnect(buf, 8, opt));
+}
+
+void test_subscribe_layout() {
+  size_t len = mqttEncodeSubscribe(buf, sizeof(buf), 0x1234, "a/b", 1);
+  // [MQTT-3.8.1-1]: fixed header flags 0010
+  const uint8_t expected[] = {0x82, 0x08, 0x12, 0x34, 0x00, 0x03,
+                              'a',  '/',  'b',  0x01};
+  TEST_ASSERT_EQUAL(sizeof(expected), len);
+  TEST_ASSERT_EQUAL_MEMORY(expected, buf, len);
+  TEST_ASSERT_EQUAL(len, mqttSubscribeLength("a/b"));
+}
+
+void test_publish_layout() {
+  size_t len =
+      mqttEncodePublish(buf, sizeof(buf), "t", bytes("on"), 2, 1, true, 7);
+  const uint8_t expected[] = {0x33, 0x07, 0x00, 0x01, 't',
+                              0x00, 0x07, 'o',  'n'};
+  TEST_ASSERT_EQUAL(sizeof(expected), len);
+  TEST_ASSERT_EQUAL_MEMORY(expected, buf, len);
+  TEST_ASSERT_EQUAL(len, mqttPublishLength("t", 2, 1));
+
+  // QoS 0 carries no packet id
+  len = mqttEncodePublish(buf, sizeof(buf), "t", bytes("on"), 2, 0, false, 7);
+  TEST_ASSERT_EQUAL(7, len);
+  TEST_ASSERT_EQUAL_HEX8(0x30, buf[0]);
+}
+
+void test_acks_and_empty_packets() {
+  TEST_ASSERT_EQUAL(4, mqttEncodeAck(buf, MQTT_PKT_PUBACK, 0xABCD));
+  const uint8_t puback[] = {0x40, 0x02, 0xAB, 0xCD};
+  TEST_ASSERT_EQUAL_MEMORY(puback, buf, 4);
+
+  TEST_ASSERT_EQUAL(2, mqttEncodeEmpty(buf, MQTT_PKT_PINGREQ));
+  TEST_ASSERT_EQUAL_HEX8(0xC0, buf[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x00, buf[1]);
+  TEST_ASSERT_EQUAL(2, mqttEncodeEmpty(buf, MQTT_PKT_DISCONNECT));
+  TEST_ASSERT_EQUAL_HEX8(0xE0, buf[0]);
+}
+
+// [MQTT-2.2.3]: 127 fits one length byte, 128 takes two
+void test_remaining_length_boundary() {
+  static uint8_t payload[200];
+  MqttReader reader;
+  // Topic "t" (3 bytes) + packet id (2) + payload = remaining length
+  size_t len = mqttEncodePublish(buf, sizeof(buf), "t", payload, 122, 1,
+                                 false, 1);
+  TEST_ASSERT_EQUAL(2 + 127, len);
+  TEST_ASSERT_EQUAL_HEX8(0x7F, buf[1]);
+  readBack(reader, buf, len);
+  TEST_ASSERT_EQUAL(127, reader.bodyLength());
+
+  len = mqttEncodePublish(buf, sizeof(buf), "t", payload, 123, 1, false, 1);
+  TEST_ASSERT_EQUAL(3 + 128, len);
+  TEST_ASSERT_EQUAL_HEX8(0x80, buf[1]);
+  TEST_ASSERT_EQUAL_HEX8(0x01, buf[2]);
+  readBack(reader, buf, len);
+  TEST_ASSERT_EQUAL(128, reader.bodyLength());
+}
+
+// TCP may split a packet anywhere, including inside the length bytes
+void test_reader_reassembles_byte_by_byte() {
+  uint8_t payload[150];
+  memset(payload, 'x', sizeof(payload));
+  size_t len = mqttEncodePublish(buf, sizeof(buf), "hsc/track/1", payload,
+                                 sizeof(payload), 1, true, 42);
+  MqttReader reader;
+  for (size_t i = 0; i < len; i++) {
+    TEST_ASSERT_FALSE(reader.ready());
+    TEST_ASSERT_EQUAL(1, reader.feed(buf + i, 1));
+  }
+  TEST_ASSERT_TRUE(reader.ready());
+  TEST_ASSERT_EQUAL(MQTT_PKT_PUBLISH, reader.type());
+  TEST_ASSERT_EQUAL(0x03, reader.flags());
+
+  char *topic;
+  uint16_t packetId;
+  uint8_t *data;
+  size_t dataLen;
+  TEST_ASSERT_TRUE(mqttParsePublish(reader.flags(), reader.body(),
+                                    reader.bodyLength(), topic, packetId,
+                                    data, dataLen));
+  TEST_ASSERT_EQUAL_STRING("hsc/track/1", topic);
+  TEST_ASSERT_EQUAL(42, packetId);
+  TEST_ASSERT_EQUAL(sizeof(payload), dataLen);
+  TEST_ASSERT_EQUAL_MEMORY(payload, data, dataLen);
+
+  // Nothing more is taken until the packet is released
+  TEST_ASSERT_EQUAL(0, reader.feed(buf, 1));
+  reader.next();
+  TEST_ASSERT_EQUAL(1, reader.feed(buf, 1));
+}
+
+void test_reader_skips_oversize_packet() {
+  // PUBLISH with a 1000 byte body, then a PINGRESP
+  uint8_t stream[1003 + 2] = {0x30, 0xE8, 0x07};
+  stream[1003] = 0xD0;
+  stream[1004] = 0x00;
+  MqttReader reader;
+  size_t used = 0;
+  while (used < sizeof(stream) && !reader.ready())
+    used += reader.feed(stream + used, sizeof(stream) - used);
+  TEST_ASSERT_TRUE(reader.ready());
+  TEST_ASSERT_EQUAL(MQTT_PKT_PINGRESP, reader.type());
+  TEST_ASSERT_EQUAL(1, reader.oversizeCount());
+}
+
+void test_malformed_publish_rejected() {
+  char *topic;
+  uint16_t packetId;
+  uint8_t *data;
+  size_t dataLen;
+  // Topic length past the end of the body
+  uint8_t body[] = {0x00, 0x09, 'a', 'b'};
+  TEST_ASSERT_FALSE(mqttParsePublish(0x00, body, sizeof(body), topic,
+                                     packetId, data, dataLen));
+  // QoS 1 without room for the packet id
+  uint8_t noId[] = {0x00, 0x01, 'a', 0x00};
+  TEST_ASSERT_FALSE(mqttParsePublish(0x02, noId, sizeof(noId), topic,
+                                     packetId, data, dataLen));
+}
+
+// --- Against a broker ---
+
+class BrokerConnection {
+public:
+  ~BrokerConnection() { drop(); }
+
+  bool open() {
+    const char *env = getenv("MQTT_TEST_BROKER");
+    char host[64] = "127.0.0.1";
+    const char *port = "1883";
+    if (env && *env) {
+      snprintf(host, sizeof(host), "%s", env);
+      char *colon = strchr(host, ':');
+      if (colon) {
+        *colon = '\0';
+        port = env + (colon - host) + 1;
+      }
+    }
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addr = nullptr;
+    if (getaddrinfo(host, port, &hints, &addr) != 0)
+      return false;
+    _fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+    bool ok = _fd >= 0 && connect(_fd, addr->ai_addr, addr->ai_addrlen) == 0;
+    freeaddrinfo(addr);
+    if (!ok) {
+      drop();
+      return false;
+    }
+    timeval tv = {BROKER_TIMEOUT_MS / 1000, 0};
+    setsockopt(_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return true;
+  }
+
+  // Open and CONNECT; returns the session present flag, -1 on failure
+  int connectAs(const MqttConnectOptions &opt) {
+    if (!open())
+      return -1;
+    size_t len = mqttEncodeConnect(buf, sizeof(buf), opt);
+    if (!send(buf, len) || !receive(MQTT_PKT_CONNACK) ||
+        _reader.bodyLength() != 2 || _reader.body()[1] != 0)
+      return -1;
+    int present = _reader.body()[0] & 0x01;
+    _reader.next();
+    return present;
+  }
+
+  bool send(const uint8_t *data, size_t len) {
+    return ::send(_fd, data, len, 0) == (ssize_t)len;
+  }
+
+  // Wait for a packet of the given type, skipping others; it stays in
+  // reader() until the next call
+  bool receive(uint8_t type) {
+    if (_reader.ready())
+      _reader.next();
+    while (_fd >= 0) {
+      while (_pending > 0 && !_reader.ready()) {
+        size_t used = _reader.feed(_in + _offset, _pending);
+        _offset += used;
+        _pending -= used;
+      }
+      if (_reader.ready()) {
+        if (_reader.type() == type)
+          return true;
+        _reader.next();
+        continue;
+      }
+      ssize_t n = recv(_fd, _in, sizeof(_in), 0);
+      if (n <= 0)
+        return false;
+      _offset = 0;
+      _pending = n;
+    }
+    return false;
+  }
+
+  // Receive a PUBLISH and acknowledge it if QoS 1
+  bool receivePublish(char *&topic, uint8_t *&payload, size_t &len,
+                      bool &retained) {
+    if (!receive(MQTT_PKT_PUBLISH))
+      return false;
+    uint16_t packetId;
+    uint8_t flags = _reader.flags();
+    if (!mqttParsePublish(flags, _reader.body(), _reader.bodyLength(), topic,
+                          packetId, payload, len))
+      return false;
+    retained = flags & 0x01;
+    if (flags & 0x06) {
+      uint8_t ack[4];
+      send(ack, mqttEncodeAck(ack, MQTT_PKT_PUBACK, packetId));
+    }
+    return true;
+  }
+
+  bool subscribe(const char *topic, uint8_t qos, uint16_t packetId) {
+    uint8_t packet[128];
+    size_t len =
+        mqttEncodeSubscribe(packet, sizeof(packet), packetId, topic, qos);
+    if (!send(packet, len) || !receive(MQTT_PKT_SUBACK))
+      return false;
+    const uint8_t *body = _reader.body();
+    return _reader.bodyLength() == 3 && body[0] == packetId >> 8 &&
+           body[1] == (packetId & 0xFF) && body[2] == qos;
+  }
+
+  bool publish(const char *topic, const char *payload, uint8_t qos,
+               bool retained, uint16_t packetId) {
+    uint8_t packet[256];
+    size_t len = mqttEncodePublish(packet, sizeof(packet), topic,
+                                   bytes(payload), strlen(payload), qos,
+                                   retained, packetId);
+    if (!send(packet, len))
+      return false;
+    if (qos == 0)
+      return true;
+    return receive(MQTT_PKT_PUBACK) && _reader.bodyLength() == 2 &&
+           _reader.body()[0] == packetId >> 8 &&
+           _reader.body()[1] == (packetId & 0xFF);
+  }
+
+  void disconnect() {
+    uint8_t packet[2];
+    send(packet, mqttEncodeEmpty(packet, MQTT_PKT_DISCONNECT));
+    drop();
+  }
+
+  // Close the socket without DISCONNECT, like a board losing power
+  void drop() {
+    if (_fd >= 0)
+      close(_fd);
+    _fd = -1;
+    _reader.reset();
+    _pending = 0;
+  }
+
+private:
+  int _fd = -1;
+  MqttReader _reader;
+  uint8_t _in[1024];
+  size_t _offset = 0;
+  size_t _pending = 0;
+};
+
+static void requireBroker() {
+  BrokerConnection probe;
+  if (!probe.open())
+    TEST_IGNORE_MESSAGE("no broker, set MQTT_TEST_BROKER=host:port");
+}
+
+static const char *topicOf(const char *name) {
+  static char topic[64];
+  snprintf(topic, sizeof(topic), "%s/%s", topicPrefix, name);
+  return topic;
+}
+
+static MqttConnectOptions options(const char *clientId, bool clean) {
+  MqttConnectOptions opt;
+  opt.clientId = clientId;
+  opt.cleanSession = clean;
+  return opt;
+}
+
+void test_broker_connect_and_ping() {
+  requireBroker();
+  BrokerConnection c;
+  TEST_ASSERT_EQUAL(0, c.connectAs(options("hsc-test-ping", true)));
+  uint8_t ping[2];
+  TEST_ASSERT_TRUE(c.send(ping, mqttEncodeEmpty(ping, MQTT_PKT_PINGREQ)));
+  TEST_ASSERT_TRUE(c.receive(MQTT_PKT_PINGRESP));
+  c.disconnect();
+}
+
+void test_broker_qos1_round_trip() {
+  requireBroker();
+  BrokerConnection c;
+  TEST_ASSERT_EQUAL(0, c.connectAs(options("hsc-test-qos1", true)));
+  TEST_ASSERT_TRUE(c.subscribe(topicOf("qos1"), 1, 1));
+  TEST_ASSERT_TRUE(c.publish(topicOf("qos1"), "OCCUPIED", 1, false, 2));
+
+  char *topic;
+  uint8_t *payload;
+  size_t len;
+  bool retained;
+  TEST_ASSERT_TRUE(c.receivePublish(topic, payload, len, retained));
+  TEST_ASSERT_EQUAL_STRING(topicOf("qos1"), topic);
+  TEST_ASSERT_EQUAL(8, len);
+  TEST_ASSERT_EQUAL_MEMORY("OCCUPIED", payload, len);
+  TEST_ASSERT_FALSE(retained);
+  c.disconnect();
+}
+
+// A retained value reaches later subscribers with the retain flag set
+void test_broker_retained_value() {
+  requireBroker();
+  BrokerConnection pub;
+  TEST_ASSERT_EQUAL(0, pub.connectAs(options("hsc-test-ret-pub", true)));
+  TEST_ASSERT_TRUE(pub.publish(topicOf("retained"), "FREE", 1, true, 1));
+  pub.disconnect();
+
+  BrokerConnection sub;
+  TEST_ASSERT_EQUAL(0, sub.connectAs(options("hsc-test-ret-sub", true)));
+  TEST_ASSERT_TRUE(sub.subscribe(topicOf("retained"), 1, 1));
+  char *topic;
+  uint8_t *payload;
+  size_t len;
+  bool retained;
+  TEST_ASSERT_TRUE(sub.receivePublish(topic, payload, len, retained));
+  TEST_ASSERT_TRUE(retained);
+  TEST_ASSERT_EQUAL_MEMORY("FREE", payload, len);
+
+  // An empty retained message clears it
+  TEST_ASSERT_TRUE(sub.publish(topicOf("retained"), "", 1, true, 2));
+  sub.disconnect();
+}
+
+// The fast reconnect path relies on the broker keeping subscriptions and
+// queueing QoS 1 messages for a session without clean session
+void test_broker_resumes_persistent_session() {
+  requireBroker();
+  BrokerConnection c;
+  // Start from no session
+  TEST_ASSERT_EQUAL(0, c.connectAs(options("hsc-test-session", true)));
+  c.disconnect();
+
+  TEST_ASSERT_EQUAL(0, c.connectAs(options("hsc-test-session", false)));
+  TEST_ASSERT_TRUE(c.subscribe(topicOf("session"), 1, 1));
+  c.drop();
+
+  BrokerConnection pub;
+  TEST_ASSERT_EQUAL(0, pub.connectAs(options("hsc-test-session-pub", true)));
+  TEST_ASSERT_TRUE(pub.publish(topicOf("session"), "while away", 1, false, 1));
+  pub.disconnect();
+
+  TEST_ASSERT_EQUAL(1, c.connectAs(options("hsc-test-session", false)));
+  char *topic;
+  uint8_t *payload;
+  size_t len;
+  bool retained;
+  TEST_ASSERT_TRUE(c.receivePublish(topic, payload, len, retained));
+  TEST_ASSERT_EQUAL_STRING(topicOf("session"), topic);
+  TEST_ASSERT_EQUAL_MEMORY("while away", payload, len);
+  c.disconnect();
+
+  // Clean session discards it again
+  TEST_ASSERT_EQUAL(0, c.connectAs(options("hsc-test-session", true)));
+  c.disconnect();
+}
+
+// The status topic goes "offline" through the will when a board vanishes
+void test_broker_publishes_will() {
+  requireBroker();
+  BrokerConnection sub;
+  TEST_ASSERT_EQUAL(0, sub.connectAs(options("hsc-test-will-sub", true)));
+  TEST_ASSERT_TRUE(sub.subscribe(topicOf("will"), 1, 1));
+
+  MqttConnectOptions opt = options("hsc-test-will", true);
+  opt.willTopic = topicOf("will");
+  opt.willMessage = "offline";
+  opt.willQos = 1;
+  BrokerConnection board;
+  TEST_ASSERT_EQUAL(0, board.connectAs(opt));
+  board.drop();
+
+  char *topic;
+  uint8_t *payload;
+  size_t len;
+  bool retained;
+  TEST_ASSERT_TRUE(sub.receivePublish(topic, payload, len, retained));
+  TEST_ASSERT_EQUAL_MEMORY("offline", payload, len);
+  sub.disconnect();
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+int main(int argc, char **argv) {
+  snprintf(topicPrefix, sizeof(topicPrefix), "hsc-test/%d", (int)getpid());
+
+  UNITY_BEGIN();
+  RUN_TEST(test_connect_layout);
+  RUN_TEST(test_connect_flags);
+  RUN_TEST(test_subscribe_layout);
+  RUN_TEST(test_publish_layout);
+  RUN_TEST(test_acks_and_empty_packets);
+  RUN_TEST(test_remaining_length_boundary);
+  RUN_TEST(test_reader_reassembles_byte_by_byte);
+  RUN_TEST(test_reader_skips_oversize_packet);
+  RUN_TEST(test_malformed_publish_rejected);
+  RUN_TEST(test_broker_connect_and_ping);
+  RUN_TEST(test_broker_qos1_round_trip);
+  RUN_TEST(test_broker_retained_value);
+  RUN_TEST(test_broker_resumes_persistent_session);
+  RUN_TEST(test_broker_publishes_will);
+  return UNITY_END();
+}
@@ -0,0 +1,326 @@
+// Messages per reconnect: a board's connect handler driven through
+// MqttSession and MqttOutbox the way MqttClient does, against a stub
+// broker that acknowledges everything, keeps retained values and publishes
+// the will when the connection drops. What each reconnect costs is counted
+// and the broker's retained values are checked against the board's after
+// every one, so a skipped publish can never leave a stale value behind.
+
+#include "MqttOutbox.h"
+#include "MqttPacket.h"
+#include "MqttSession.h"
+#include <map>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unity.h>
+#include <vector>
+
+static const int TRACKS = 8;
+static const char *STATUS_TOPIC = "HSC/devices/board-3/status";
+static const char *INFO_TOPIC = "HSC/devices/board-3/info";
+static const char *CONFIG_TOPIC = "HSC/devices/board-3/config";
+static const char *ROLLOUT_TOPIC = "HSC/devices/rollout";
+
+struct Counts {
+  int publishes; // PUBLISH packets that reached the broker
+  int resent;    // Of those, with DUP set
+  int subscribes;
+  int skipped; // Publishes and subscriptions left out
+};
+
+// Broker side: one client, its persistent session and the retained store
+class StubBroker {
+public:
+  std::map<std::string, std::string> retained;
+  bool connected = false;
+  bool sessionKept = true; // Resume the session on the next connect
+  bool holdAcks = false;   // Take PUBLISHes without acknowledging them
+  std::vector<uint16_t> acks;
+  Counts counts;
+
+  // CONNACK session present flag
+  bool connect() {
+    bool present = hasSession && sessionKept;
+    hasSession = true;
+    connected = true;
+    counts = Counts();
+    return present;
+  }
+
+  // Unclean: the will replaces the status
+  void drop() {
+    connected = false;
+    retained[STATUS_TOPIC] = "offline";
+  }
+
+  bool receive(const uint8_t *data, size_t len, bool dup) {
+    if (!connected)
+      return false;
+    const char *topic;
+    size_t topicLen;
+    const uint8_t *payload;
+    size_t payloadLen;
+    TEST_ASSERT_TRUE(
+        mqttSplitPublish(data, len, topic, topicLen, payload, payloadLen));
+    counts.publishes++;
+    if (dup)
+      counts.resent++;
+    if (data[0] & 0x01)
+      retained[std::string(topic, topicLen)] =
+          std::string((const char *)payload, payloadLen);
+    if (!holdAcks) {
+      // Packet id follows the topic
+      const uint8_t *id = (const uint8_t *)topic + topicLen;
+      acks.push_back(((uint16_t)id[0] << 8) | id[1]);
+    }
+    return true;
+  }
+
+private:
+  bool hasSession = false;
+};
+
+// MqttClient's publish, subscribe and PUBACK handling without the socket
+class StubClient {
+public:
+  explicit StubClient(StubBroker &broker) : _broker(broker) {}
+
+  void connect() {
+    _session.forgetRetained(STATUS_TOPIC);
+    bool present = _broker.connect();
+    if (!present)
+      _session.clear();
+    _sessionPresent = present;
+    _connected = true;
+    pump();
+  }
+
+  void drop() {
+    _broker.drop();
+    _connected = false;
+    _outbox.requeueInFlight();
+  }
+
+  bool sessionPresent() const { return _sessionPresent; }
+
+  void publish(const char *topic, const char *payload) {
+    size_t len = strlen(payload);
+    if (_connected &&
+        _session.retainedCurrent(topic, (const uint8_t *)payload, len)) {
+      _broker.counts.skipped++;
+      return;
+    }
+    _session.retainedQueued(topic, (const uint8_t *)payload, len);
+    TEST_ASSERT_NOT_EQUAL(
+        0, _outbox.push(topic, (const uint8_t *)payload, len, true));
+    pump();
+  }
+
+  void subscribe(const char *topic) {
+    if (_session.subscribed(topic)) {
+      _broker.counts.skipped++;
+      return;
+    }
+    _outbox.allocateId();
+    _broker.counts.subscribes++;
+    _session.addSubscription(topic);
+  }
+
+  // Send what the window allows and take the broker's PUBACKs
+  void pump() {
+    if (!_connected)
+      return;
+    StubBroker &broker = _broker;
+    for (int round = 0; round < 8; round++) {
+      _outbox.poll(_nowMs, [&broker](const uint8_t *data, size_t len,
+                                     bool dup) {
+        return broker.receive(data, len, dup);
+      });
+      if (broker.acks.empty())
+        return;
+      for (uint16_t id : broker.acks)
+        ack(id);
+      broker.acks.clear();
+    }
+  }
+
+private:
+  StubBroker &_broker;
+  MqttSession _session;
+  MqttOutbox _outbox;
+  bool _connected = false;
+  bool _sessionPresent = false;
+  uint32_t _nowMs = 1000;
+
+  void ack(uint16_t id) {
+    size_t len;
+    const uint8_t *packet = _outbox.inFlightPacket(id, len);
+    const char *topic;
+    size_t topicLen;
+    const uint8_t *payload;
+    size_t payloadLen;
+    if (packet && (packet[0] & 0x01) &&
+        mqttSplitPublish(packet, len, topic, topicLen, payload, payloadLen))
+      _session.retainedAcked(topic, topicLen, payload, payloadLen);
+    _outbox.ack(id, _nowMs);
+  }
+};
+
+static StubBroker *broker;
+static StubClient *client;
+static bool occupied[TRACKS];
+
+static void trackTopic(char *topic, size_t size, int track) {
+  snprintf(topic, size, "yard/track/%d/section/3", track + 1);
+}
+
+// What HSC_Base and the sketch publish from the connect handler
+static void onConnect() {
+  client->publish(STATUS_TOPIC, "online");
+  client->subscribe(CONFIG_TOPIC);
+  client->subscribe(ROLLOUT_TOPIC);
+  client->publish(INFO_TOPIC, "{\"board_id\":3,\"version\":\"2.4.0\"}");
+  char topic[64];
+  for (int i = 0; i < TRACKS; i++) {
+    trackTopic(topic, sizeof(topic), i);
+    client->publish(topic, occupied[i] ? "OCCUPIED" : "FREE");
+  }
+}
+
+static Counts reconnect() {
+  client->connect();
+  onConnect();
+  return broker->counts;
+}
+
+// Every retained value the board stands for is what the broker holds
+static void assertBrokerCurrent() {
+  TEST_ASSERT_EQUAL_STRING("online", broker->retained[STATUS_TOPIC].c_str());
+  char topic[64];
+  for (int i = 0; i < TRACKS; i++) {
+    trackTopic(topic, sizeof(topic), i);
+    TEST_ASSERT_EQUAL_STRING(occupied[i] ? "OCCUPIED" : "FREE",
+                             broker->retained[topic].c_str());
+  }
+}
+
+static void report(const char *what, const Counts &c) {
+  char line[128];
+  snprintf(line, sizeof(line),
+           "%-24s %2d publishes (%d resent), %d subscribes, %2d skipped",
+           what, c.publishes, c.resent, c.subscribes, c.skipped);
+  TEST_MESSAGE(line);
+}
+
+void setUp() {
+  broker = new StubBroker();
+  client = new StubClient(*broker);
+  for (int i = 0; i < TRACKS; i++)
+    occupied[i] = i % 3 == 0;
+}
+
+void tearDown() {
+  delete client;
+  delete broker;
+}
+
+void test_first_connect_sends_everything() {
+  Counts c = reconnect();
+  report("first connect", c);
+  TEST_ASSERT_FALSE(client->sessionPresent());
+  TEST_ASSERT_EQUAL(2 + TRACKS, c.publishes);
+  TEST_ASSERT_EQUAL(2, c.subscribes);
+  TEST_ASSERT_EQUAL(0, c.skipped);
+  assertBrokerCurrent();
+}
+
+void test_resumed_session_resends_only_status() {
+  reconnect();
+  client->drop();
+  Counts c = reconnect();
+  report("resumed, no change", c);
+  TEST_ASSERT_TRUE(client->sessionPresent());
+  // The will replaced the status; info and tracks are unchanged
+  TEST_ASSERT_EQUAL(1, c.publishes);
+  TEST_ASSERT_EQUAL(0, c.subscribes);
+  TEST_ASSERT_EQUAL(1 + TRACKS + 2, c.skipped);
+  assertBrokerCurrent();
+}
+
+void test_resumed_session_resends_changed_tracks() {
+  reconnect();
+  client->drop();
+  occupied[2] = !occupied[2];
+  occupied[5] = !occupied[5];
+  Counts c = reconnect();
+  report("resumed, 2 tracks moved", c);
+  TEST_ASSERT_EQUAL(1 + 2, c.publishes);
+  TEST_ASSERT_EQUAL(0, c.subscribes);
+  assertBrokerCurrent();
+}
+
+void test_new_session_sends_everything() {
+  reconnect();
+  client->drop();
+  broker->sessionKept = false;
+  Counts c = reconnect();
+  report("session not resumed", c);
+  TEST_ASSERT_FALSE(client->sessionPresent());
+  TEST_ASSERT_EQUAL(2 + TRACKS, c.publishes);
+  TEST_ASSERT_EQUAL(2, c.subscribes);
+  TEST_ASSERT_EQUAL(0, c.skipped);
+  assertBrokerCurrent();
+}
+
+// Values the broker took but never acknowledged are not known to be there:
+// they go out again with DUP set and are not skipped
+void test_unacknowledged_values_are_resent() {
+  reconnect();
+  client->drop();
+  reconnect();
+  broker->holdAcks = true;
+  occupied[1] = !occupied[1];
+  client->publish("yard/track/2/section/3",
+                  occupied[1] ? "OCCUPIED" : "FREE");
+  client->drop();
+  broker->holdAcks = false;
+  Counts c = reconnect();
+  report("resumed, 1 unacknowledged", c);
+  // Status, the DUP of the lost PUBACK, and no second copy of it
+  TEST_ASSERT_EQUAL(2, c.publishes);
+  TEST_ASSERT_EQUAL(1, c.resent);
+  assertBrokerCurrent();
+
+  // Once acknowledged it is skipped like the rest
+  client->drop();
+  c = reconnect();
+  TEST_ASSERT_EQUAL(1, c.publishes);
+}
+
+void test_reconnect_storm_costs_one_publish_each() {
+  reconnect();
+  int total = 0;
+  const int RECONNECTS = 20;
+  for (int i = 0; i < RECONNECTS; i++) {
+    client->drop();
+    total += reconnect().publishes;
+  }
+  char line[96];
+  snprintf(line, sizeof(line),
+           "%d reconnects: %d publishes, %d without the session cache",
+           RECONNECTS, total, RECONNECTS * (2 + TRACKS));
+  TEST_MESSAGE(line);
+  TEST_ASSERT_EQUAL(RECONNECTS, total);
+  assertBrokerCurrent();
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_first_connect_sends_everything);
+  RUN_TEST(test_resumed_session_resends_only_status);
+  RUN_TEST(test_resumed_session_resends_changed_tracks);
+  RUN_TEST(test_new_session_sends_everything);
+  RUN_TEST(test_unacknowledged_values_are_resent);
+  RUN_TEST(test_reconnect_storm_costs_one_publish_each);
+  return UNITY_END();
+}
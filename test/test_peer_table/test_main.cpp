@@ -0,0 +1,199 @@
+// PeerTable on the host: the frame codec, and per-neighbour sequencing of
+// duplicates, gaps, late frames, timeouts and a restarted board's new
+// epoch.
+
+#include "PeerTable.h"
+#include <unity.h>
+
+static PeerTable *table;
+
+static PeerFrame frame(uint16_t board, uint16_t epoch, uint32_t seq,
+                       uint64_t mask) {
+  PeerFrame f;
+  f.boardId = board;
+  f.epoch = epoch;
+  f.seq = seq;
+  f.count = 16;
+  f.mask = mask;
+  f.sentUs = 0;
+  return f;
+}
+
+static PeerState *apply(uint32_t seq, uint64_t mask, uint32_t nowMs,
+                        uint16_t epoch = 0x1234) {
+  return table->apply(frame(3, epoch, seq, mask), nowMs);
+}
+
+void setUp() { table = new PeerTable(); }
+
+void tearDown() { delete table; }
+
+void test_frame_round_trip() {
+  PeerFrame in = frame(513, 0xBEEF, 0x89ABCDEF, 0x8000000000000001ULL);
+  in.count = 64;
+  in.sentUs = 1704067200123456LL;
+  uint8_t buf[PEER_FRAME_SIZE];
+  encodePeerFrame(in, buf);
+  TEST_ASSERT_EQUAL_HEX8('H', buf[0]);
+  TEST_ASSERT_EQUAL_HEX8('P', buf[1]);
+
+  PeerFrame out;
+  TEST_ASSERT_TRUE(decodePeerFrame(buf, sizeof(buf), out));
+  TEST_ASSERT_EQUAL_UINT16(513, out.boardId);
+  TEST_ASSERT_EQUAL_UINT16(0xBEEF, out.epoch);
+  TEST_ASSERT_EQUAL_HEX32(0x89ABCDEF, out.seq);
+  TEST_ASSERT_EQUAL_UINT8(64, out.count);
+  TEST_ASSERT_TRUE(out.mask == in.mask);
+  TEST_ASSERT_TRUE(out.sentUs == in.sentUs);
+}
+
+void test_bad_frames_rejected() {
+  PeerFrame in = frame(3, 1, 1, 1);
+  uint8_t buf[PEER_FRAME_SIZE + 1];
+  PeerFrame out;
+  encodePeerFrame(in, buf);
+  TEST_ASSERT_FALSE(decodePeerFrame(buf, PEER_FRAME_SIZE - 1, out));
+  TEST_ASSERT_FALSE(decodePeerFrame(buf, PEER_FRAME_SIZE + 1, out));
+
+  buf[1] = 'X';
+  TEST_ASSERT_FALSE(decodePeerFrame(buf, PEER_FRAME_SIZE, out));
+  encodePeerFrame(in, buf);
+  buf[2] = PEER_FRAME_VERSION + 1;
+  TEST_ASSERT_FALSE(decodePeerFrame(buf, PEER_FRAME_SIZE, out));
+  encodePeerFrame(in, buf);
+  buf[3] = 65;
+  TEST_ASSERT_FALSE(decodePeerFrame(buf, PEER_FRAME_SIZE, out));
+}
+
+void test_first_frame_reports_everything() {
+  PeerState *p = apply(10, 0x5, 1000);
+  TEST_ASSERT_NOT_NULL(p);
+  TEST_ASSERT_EQUAL_UINT16(3, p->boardId);
+  TEST_ASSERT_TRUE(p->online);
+  TEST_ASSERT_TRUE(p->changed == 0x5);
+  TEST_ASSERT_EQUAL_UINT32(1, p->frames);
+  TEST_ASSERT_EQUAL_UINT32(0, p->lost);
+  TEST_ASSERT_TRUE(table->find(3) == p);
+  TEST_ASSERT_NULL(table->find(4));
+}
+
+// The repeat sent 30 ms after each change, and heartbeats, say nothing new
+void test_duplicates_and_heartbeats() {
+  apply(10, 0x5, 1000);
+  TEST_ASSERT_NULL(apply(10, 0x5, 1030));
+  const PeerState *p = table->find(3);
+  TEST_ASSERT_EQUAL_UINT32(1, p->duplicates);
+  TEST_ASSERT_EQUAL_UINT32(1, p->frames);
+
+  // Heartbeat: new sequence, same mask
+  TEST_ASSERT_NULL(apply(11, 0x5, 2000));
+  TEST_ASSERT_EQUAL_UINT32(2, p->frames);
+  TEST_ASSERT_EQUAL_UINT32(2000, p->lastSeenMs);
+
+  PeerState *changed = apply(12, 0x6, 2100);
+  TEST_ASSERT_NOT_NULL(changed);
+  TEST_ASSERT_TRUE(changed->changed == 0x3);
+  TEST_ASSERT_TRUE(changed->mask == 0x6);
+}
+
+void test_gap_counted_as_lost() {
+  apply(10, 0x1, 1000);
+  PeerState *p = apply(14, 0x3, 1100);
+  TEST_ASSERT_NOT_NULL(p);
+  TEST_ASSERT_EQUAL_UINT32(3, p->lost);
+  TEST_ASSERT_TRUE(p->changed == 0x2);
+}
+
+// A frame overtaken by a newer one is dropped; applying it would roll the
+// mask back
+void test_late_frame_dropped() {
+  apply(10, 0x1, 1000);
+  apply(12, 0x3, 1100);
+  TEST_ASSERT_NULL(apply(11, 0x7, 1110));
+  const PeerState *p = table->find(3);
+  TEST_ASSERT_TRUE(p->mask == 0x3);
+  TEST_ASSERT_EQUAL_UINT32(12, p->seq);
+  TEST_ASSERT_EQUAL_UINT32(1, p->duplicates);
+  // Counted lost when skipped, not found again
+  TEST_ASSERT_EQUAL_UINT32(1, p->lost);
+}
+
+void test_sequence_wraps() {
+  apply(0xFFFFFFFEu, 0x1, 1000);
+  // 0xFFFFFFFF and 0 skipped
+  PeerState *p = apply(1, 0x0, 1100);
+  TEST_ASSERT_NOT_NULL(p);
+  TEST_ASSERT_EQUAL_UINT32(2, p->lost);
+  TEST_ASSERT_NULL(apply(0xFFFFFFFFu, 0x1, 1110));
+}
+
+void test_timeout_and_back_online() {
+  apply(10, 0x1, 1000);
+  TEST_ASSERT_NULL(table->expire(1000 + PEER_TIMEOUT_MS - 1));
+
+  PeerState *p = table->expire(1000 + PEER_TIMEOUT_MS);
+  TEST_ASSERT_NOT_NULL(p);
+  TEST_ASSERT_FALSE(p->online);
+  TEST_ASSERT_TRUE(p->changed == 0);
+  // Reported once
+  TEST_ASSERT_NULL(table->expire(1000 + 2 * PEER_TIMEOUT_MS));
+
+  // Back with the same mask: still news, it was offline
+  p = apply(15, 0x1, 9000);
+  TEST_ASSERT_NOT_NULL(p);
+  TEST_ASSERT_TRUE(p->online);
+  TEST_ASSERT_TRUE(p->changed == 0);
+  TEST_ASSERT_EQUAL_UINT32(4, p->lost);
+}
+
+void test_timeout_across_millis_wrap() {
+  uint32_t t0 = 0xFFFFFFFFu - 1000;
+  apply(10, 0x1, t0);
+  TEST_ASSERT_NULL(table->expire(t0 + PEER_TIMEOUT_MS - 1));
+  TEST_ASSERT_NOT_NULL(table->expire(t0 + PEER_TIMEOUT_MS));
+}
+
+// A restarted board counts from 1 again under a new epoch: taken as it
+// comes, not dropped as old and not counted as a gap
+void test_epoch_restart_accepted() {
+  apply(5000, 0x1, 1000);
+  PeerState *p = apply(1, 0x2, 1500, 0x4321);
+  TEST_ASSERT_NOT_NULL(p);
+  TEST_ASSERT_EQUAL_UINT16(0x4321, p->epoch);
+  TEST_ASSERT_EQUAL_UINT32(1, p->seq);
+  TEST_ASSERT_TRUE(p->changed == 0x3);
+  TEST_ASSERT_EQUAL_UINT32(0, p->lost);
+  TEST_ASSERT_EQUAL_UINT32(0, p->duplicates);
+
+  // Then sequenced within the new epoch
+  TEST_ASSERT_NULL(apply(1, 0x2, 1530, 0x4321));
+  TEST_ASSERT_EQUAL_UINT32(1, p->duplicates);
+  TEST_ASSERT_NOT_NULL(apply(3, 0x0, 1540, 0x4321));
+  TEST_ASSERT_EQUAL_UINT32(1, p->lost);
+}
+
+void test_table_full() {
+  for (int i = 0; i < PEER_MAX_BOARDS; i++)
+    TEST_ASSERT_NOT_NULL(table->apply(frame(100 + i, 1, 1, 0), 1000));
+  TEST_ASSERT_NULL(table->apply(frame(200, 1, 1, 0), 1000));
+  TEST_ASSERT_EQUAL_UINT32(1, table->rejected());
+  TEST_ASSERT_EQUAL(PEER_MAX_BOARDS, table->count());
+  // Known boards still get through
+  TEST_ASSERT_NOT_NULL(table->apply(frame(100, 1, 2, 1), 1100));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_frame_round_trip);
+  RUN_TEST(test_bad_frames_rejected);
+  RUN_TEST(test_first_frame_reports_everything);
+  RUN_TEST(test_duplicates_and_heartbeats);
+  RUN_TEST(test_gap_counted_as_lost);
+  RUN_TEST(test_late_frame_dropped);
+  RUN_TEST(test_sequence_wraps);
+  RUN_TEST(test_timeout_and_back_online);
+  RUN_TEST(test_timeout_across_millis_wrap);
+  RUN_TEST(test_epoch_restart_accepted);
+  RUN_TEST(test_table_full);
+  return UNITY_END();
+}
@@ -0,0 +1,276 @@
+// RequestLimiter on the host: the admission rules, then a load generator of
+// simulated clients (polling tabs, page loads, settings saves, scripts
+// hammering the API, address churn) whose admitted requests hold a
+// connection for their service time. What each client got through is
+// printed with -v; the status polls must always get through.
+
+#include "RequestLimiter.h"
+#include <stdio.h>
+#include <unity.h>
+#include <vector>
+
+static RequestLimiter *limiter;
+
+void setUp() { limiter = new RequestLimiter(); }
+
+void tearDown() { delete limiter; }
+
+// Admit and release at once, as for a request answered immediately
+static RequestVerdict ask(uint32_t client, RequestClass cls, uint32_t nowMs) {
+  RequestVerdict v = limiter->admit(client, cls, nowMs);
+  if (v == REQUEST_ADMITTED)
+    limiter->release(cls);
+  return v;
+}
+
+void test_client_burst_then_rate() {
+  uint32_t t = 100000;
+  int admitted = 0;
+  for (int i = 0; i < 20; i++)
+    admitted += ask(1, REQUEST_NORMAL, t) == REQUEST_ADMITTED;
+  TEST_ASSERT_EQUAL(WEB_CLIENT_BURST, admitted);
+  TEST_ASSERT_EQUAL(REQUEST_CLIENT_LIMITED, ask(1, REQUEST_NORMAL, t + 100));
+  // One token every 1000 / WEB_CLIENT_RATE ms
+  TEST_ASSERT_EQUAL(REQUEST_ADMITTED, ask(1, REQUEST_NORMAL, t + 250));
+  TEST_ASSERT_EQUAL(REQUEST_CLIENT_LIMITED, ask(1, REQUEST_NORMAL, t + 260));
+  // Another client is not affected
+  TEST_ASSERT_EQUAL(REQUEST_ADMITTED, ask(2, REQUEST_NORMAL, t + 260));
+  TEST_ASSERT_EQUAL(WEB_CLIENT_BURST + 2, limiter->stats().admitted);
+}
+
+void test_global_limit_spares_cheap() {
+  uint32_t t = 100000;
+  int admitted = 0;
+  for (int c = 0; c < 4; c++) {
+    for (int i = 0; i < WEB_CLIENT_BURST; i++)
+      admitted += ask(10 + c, REQUEST_NORMAL, t) == REQUEST_ADMITTED;
+  }
+  TEST_ASSERT_EQUAL(WEB_GLOBAL_BURST, admitted);
+  TEST_ASSERT_EQUAL(REQUEST_GLOBAL_LIMITED, ask(20, REQUEST_NORMAL, t));
+  TEST_ASSERT_EQUAL(REQUEST_ADMITTED, ask(20, REQUEST_CHEAP, t));
+}
+
+void test_open_cap_keeps_slots_for_cheap() {
+  uint32_t t = 100000;
+  for (int i = 0; i < WEB_MAX_OPEN - WEB_CHEAP_RESERVED; i++)
+    TEST_ASSERT_EQUAL(REQUEST_ADMITTED,
+                      limiter->admit(10 + i, REQUEST_NORMAL, t));
+  TEST_ASSERT_EQUAL(REQUEST_BUSY, limiter->admit(30, REQUEST_NORMAL, t));
+  for (int i = 0; i < WEB_CHEAP_RESERVED; i++)
+    TEST_ASSERT_EQUAL(REQUEST_ADMITTED,
+                      limiter->admit(31 + i, REQUEST_CHEAP, t));
+  TEST_ASSERT_EQUAL(REQUEST_BUSY, limiter->admit(40, REQUEST_CHEAP, t));
+  TEST_ASSERT_EQUAL(WEB_MAX_OPEN, limiter->open());
+  TEST_ASSERT_EQUAL(WEB_MAX_OPEN, limiter->stats().peakOpen);
+
+  for (int i = 0; i < WEB_MAX_OPEN - WEB_CHEAP_RESERVED; i++)
+    limiter->release(REQUEST_NORMAL);
+  for (int i = 0; i < WEB_CHEAP_RESERVED; i++)
+    limiter->release(REQUEST_CHEAP);
+  TEST_ASSERT_EQUAL(0, limiter->open());
+}
+
+void test_one_heavy_at_a_time() {
+  uint32_t t = 100000;
+  TEST_ASSERT_EQUAL(REQUEST_ADMITTED, limiter->admit(1, REQUEST_HEAVY, t));
+  TEST_ASSERT_EQUAL(REQUEST_DEFERRED, limiter->admit(2, REQUEST_HEAVY, t));
+  TEST_ASSERT_EQUAL(REQUEST_ADMITTED, limiter->admit(2, REQUEST_NORMAL, t));
+  limiter->release(REQUEST_HEAVY);
+  limiter->release(REQUEST_NORMAL);
+  TEST_ASSERT_EQUAL(REQUEST_ADMITTED, ask(2, REQUEST_HEAVY, t));
+  TEST_ASSERT_EQUAL(1, limiter->stats().deferred);
+}
+
+void test_least_recent_client_replaced() {
+  uint32_t t = 100000;
+  for (int c = 0; c < WEB_MAX_CLIENTS; c++) {
+    for (int i = 0; i < WEB_CLIENT_BURST; i++)
+      ask(100 + c, REQUEST_CHEAP, t + c);
+  }
+  TEST_ASSERT_EQUAL(WEB_MAX_CLIENTS, limiter->clients());
+  // A new address takes the slot of 100, seen least recently
+  TEST_ASSERT_EQUAL(REQUEST_ADMITTED, ask(200, REQUEST_CHEAP, t + 20));
+  TEST_ASSERT_EQUAL(WEB_MAX_CLIENTS, limiter->clients());
+  TEST_ASSERT_EQUAL(REQUEST_CLIENT_LIMITED, ask(107, REQUEST_CHEAP, t + 21));
+  // So 100 comes back with a full burst
+  TEST_ASSERT_EQUAL(REQUEST_ADMITTED, ask(100, REQUEST_CHEAP, t + 22));
+}
+
+// --- Load generator ---
+
+struct Source {
+  const char *name;
+  uint32_t address; // First address; churning sources count up from it
+  RequestClass cls;
+  uint32_t periodMs;
+  uint32_t phaseMs;
+  int requests;       // Sent together every period, e.g. a page load
+  uint32_t serviceMs; // Connection held once admitted
+  int addresses;      // Distinct addresses used in turn
+};
+
+struct Tally {
+  int sent = 0;
+  int admitted = 0;
+  int limited = 0;
+  int busy = 0;
+  int deferred = 0;
+};
+
+struct InFlight {
+  uint32_t doneMs;
+  RequestClass cls;
+};
+
+struct LoadResult {
+  uint32_t seconds;
+  int peakOpen;
+  int peakHeavy;
+  int admittedNotCheap;
+};
+
+static LoadResult runLoad(const Source *sources, Tally *tally, int count,
+                          uint32_t startMs, uint32_t seconds) {
+  LoadResult r = {seconds, 0, 0, 0};
+  std::vector<InFlight> inFlight;
+  for (uint32_t ms = 0; ms < seconds * 1000; ms++) {
+    uint32_t now = startMs + ms;
+    for (size_t i = 0; i < inFlight.size();) {
+      if ((int32_t)(now - inFlight[i].doneMs) >= 0) {
+        limiter->release(inFlight[i].cls);
+        inFlight[i] = inFlight.back();
+        inFlight.pop_back();
+      } else {
+        i++;
+      }
+    }
+
+    for (int s = 0; s < count; s++) {
+      const Source &src = sources[s];
+      Tally &t = tally[s];
+      if (ms < src.phaseMs || (ms - src.phaseMs) % src.periodMs != 0)
+        continue;
+      for (int n = 0; n < src.requests; n++) {
+        uint32_t address = src.address + t.sent++ % src.addresses;
+        switch (limiter->admit(address, src.cls, now)) {
+        case REQUEST_ADMITTED:
+          t.admitted++;
+          if (src.cls != REQUEST_CHEAP)
+            r.admittedNotCheap++;
+          inFlight.push_back({now + src.serviceMs, src.cls});
+          break;
+        case REQUEST_CLIENT_LIMITED:
+        case REQUEST_GLOBAL_LIMITED:
+          t.limited++;
+          break;
+        case REQUEST_BUSY:
+          t.busy++;
+          break;
+        case REQUEST_DEFERRED:
+          t.deferred++;
+          break;
+        }
+      }
+    }
+    if (limiter->open() > r.peakOpen)
+      r.peakOpen = limiter->open();
+    if (limiter->heavy() > r.peakHeavy)
+      r.peakHeavy = limiter->heavy();
+  }
+  for (const InFlight &f : inFlight)
+    limiter->release(f.cls);
+  return r;
+}
+
+static void report(const Source *sources, const Tally *tally, int count,
+                   const LoadResult &r) {
+  char line[128];
+  for (int s = 0; s < count; s++) {
+    const Tally &t = tally[s];
+    snprintf(line, sizeof(line),
+             "%-14s %5d sent %5d admitted %5d limited %4d busy %4d deferred",
+             sources[s].name, t.sent, t.admitted, t.limited, t.busy,
+             t.deferred);
+    TEST_MESSAGE(line);
+  }
+  snprintf(line, sizeof(line),
+           "%u s: peak %d open, %d heavy; %d not cheap admitted (%.1f/s)",
+           (unsigned)r.seconds, r.peakOpen, r.peakHeavy, r.admittedNotCheap,
+           (double)r.admittedNotCheap / r.seconds);
+  TEST_MESSAGE(line);
+}
+
+// Normal use: a few tabs polling, page loads (6 requests at once, as many
+// connections as a browser opens to one host) and a settings save now and
+// then all get through
+void test_load_normal_use() {
+  const Source sources[] = {
+      {"status tabs", 100, REQUEST_CHEAP, 1000, 0, 3, 20, 3},
+      {"page loads", 200, REQUEST_NORMAL, 15000, 500, 6, 150, 1},
+      {"api calls", 300, REQUEST_NORMAL, 2000, 700, 1, 40, 2},
+      {"settings save", 400, REQUEST_HEAVY, 30000, 5000, 1, 900, 1},
+  };
+  const int count = sizeof(sources) / sizeof(sources[0]);
+  Tally tally[count];
+  LoadResult r = runLoad(sources, tally, count, 1000000, 120);
+  report(sources, tally, count, r);
+
+  for (int s = 0; s < count; s++)
+    TEST_ASSERT_EQUAL_MESSAGE(tally[s].sent, tally[s].admitted,
+                              sources[s].name);
+  TEST_ASSERT_EQUAL(0, limiter->open());
+}
+
+static const Source overload[] = {
+    {"status tabs", 100, REQUEST_CHEAP, 1000, 0, 3, 20, 3},
+    {"page loads", 200, REQUEST_NORMAL, 10000, 500, 8, 150, 1},
+    {"hammer 20/s", 300, REQUEST_NORMAL, 50, 0, 1, 30, 1},
+    {"scripts 10x2/s", 400, REQUEST_NORMAL, 500, 100, 10, 200, 10},
+    {"settings 3x1/s", 500, REQUEST_HEAVY, 1000, 300, 3, 900, 3},
+    {"churn 40 addrs", 1000, REQUEST_NORMAL, 100, 50, 1, 60, 40},
+};
+
+// Scripts and address churn take the global budget first come, first
+// served, so page loads and saves mostly get 429 and retry on Retry-After
+static void checkOverload(uint32_t startMs) {
+  const int count = sizeof(overload) / sizeof(overload[0]);
+  Tally tally[count];
+  const uint32_t seconds = 120;
+  LoadResult r = runLoad(overload, tally, count, startMs, seconds);
+  report(overload, tally, count, r);
+
+  // The status polls always get through
+  TEST_ASSERT_EQUAL(tally[0].sent, tally[0].admitted);
+  // Nothing above the caps
+  TEST_ASSERT_TRUE(r.peakOpen <= WEB_MAX_OPEN);
+  TEST_ASSERT_EQUAL(1, r.peakHeavy);
+  // The hammering client gets its own rate, all of them the global one
+  TEST_ASSERT_TRUE(tally[2].admitted <=
+                   WEB_CLIENT_BURST + (int)(WEB_CLIENT_RATE * seconds));
+  TEST_ASSERT_TRUE(tally[2].limited > tally[2].admitted);
+  TEST_ASSERT_TRUE(r.admittedNotCheap <=
+                   WEB_GLOBAL_BURST + (int)(WEB_GLOBAL_RATE * seconds));
+  // No source is shut out entirely
+  for (int s = 0; s < count; s++)
+    TEST_ASSERT_TRUE_MESSAGE(tally[s].admitted > 0, overload[s].name);
+  TEST_ASSERT_EQUAL(0, limiter->open());
+  TEST_ASSERT_EQUAL(0, limiter->heavy());
+}
+
+void test_load_overload() { checkOverload(1000000); }
+
+// Same load across the millis() wraparound
+void test_load_overload_across_wrap() { checkOverload(0xFFFFFFFFu - 60000); }
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_client_burst_then_rate);
+  RUN_TEST(test_global_limit_spares_cheap);
+  RUN_TEST(test_open_cap_keeps_slots_for_cheap);
+  RUN_TEST(test_one_heavy_at_a_time);
+  RUN_TEST(test_least_recent_client_replaced);
+  RUN_TEST(test_load_normal_use);
+  RUN_TEST(test_load_overload);
+  RUN_TEST(test_load_overload_across_wrap);
+  return UNITY_END();
+}
@@ -0,0 +1,198 @@
+// Host simulation of a yard-wide rollout: N boards hear the same broadcast,
+// each polls its RolloutScheduler once a second and downloads for
+// DOWNLOAD_S once due. The peak of concurrent downloads is what the update
+// server and the access point have to carry.
+
+#include "RolloutScheduler.h"
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+// A 1.2 MB image at about 30 KB/s on a busy 2.4 GHz network
+static const uint32_t DOWNLOAD_S = 40;
+// Concurrent downloads the update server is sized for
+static const int PEAK_LIMIT = 2;
+static const int MAX_BOARDS = 64;
+
+struct Board {
+  uint8_t mac[6];
+  int boardId;
+  RolloutScheduler rollout;
+  uint32_t busyFromS; // Tracks occupied in [busyFromS, busyUntilS)
+  uint32_t busyUntilS;
+  uint32_t startedS;
+  bool started;
+};
+
+struct Result {
+  int peak;
+  int updated;
+  uint32_t lastDoneS;
+};
+
+static Board boards[MAX_BOARDS];
+static uint32_t seed;
+
+static uint32_t next() {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+// Espressif OUI, random device part
+static void makeBoards(int count, bool withIds) {
+  for (int i = 0; i < count; i++) {
+    Board &b = boards[i];
+    b = Board();
+    uint8_t oui[3] = {0x24, 0x6F, 0x28};
+    memcpy(b.mac, oui, 3);
+    uint32_t r = next();
+    b.mac[3] = r >> 16;
+    b.mac[4] = r >> 8;
+    b.mac[5] = r;
+    b.boardId = withIds ? i + 1 : 0;
+  }
+}
+
+static Result run(int count, uint32_t windowS, uint32_t slotS) {
+  for (int i = 0; i < count; i++) {
+    Board &b = boards[i];
+    uint32_t offset = rolloutOffset(b.mac, b.boardId, windowS, slotS);
+    b.rollout.schedule("1.0.0", offset, 0, 0, 0, false);
+  }
+
+  Result result = {0, 0, 0};
+  uint32_t endS = windowS + 4 * 3600;
+  for (uint32_t t = 0; t < endS; t++) {
+    int active = 0;
+    for (int i = 0; i < count; i++) {
+      Board &b = boards[i];
+      bool idle = t < b.busyFromS || t >= b.busyUntilS;
+      if (b.rollout.poll(t * 1000, idle)) {
+        b.started = true;
+        b.startedS = t;
+      }
+      if (b.started && t - b.startedS < DOWNLOAD_S)
+        active++;
+    }
+    if (active > result.peak)
+      result.peak = active;
+  }
+
+  for (int i = 0; i < count; i++) {
+    if (!boards[i].started)
+      continue;
+    result.updated++;
+    uint32_t done = boards[i].startedS + DOWNLOAD_S;
+    if (done > result.lastDoneS)
+      result.lastDoneS = done;
+  }
+
+  char line[96];
+  snprintf(line, sizeof(line),
+           "%d boards, %u s window, %u s slots: peak %d, done after %u s",
+           count, (unsigned)windowS, (unsigned)slotS, result.peak,
+           (unsigned)result.lastDoneS);
+  TEST_MESSAGE(line);
+  return result;
+}
+
+void setUp() { seed = 0x2545F491; }
+
+void tearDown() {}
+
+// Unique ids fill one slot each: a download ends before the next starts
+void test_unique_ids_never_overlap() {
+  makeBoards(30, true);
+  Result r = run(30, 1800, 60);
+  TEST_ASSERT_EQUAL(30, r.updated);
+  TEST_ASSERT_EQUAL(1, r.peak);
+  TEST_ASSERT_LESS_OR_EQUAL(1800 + DOWNLOAD_S, r.lastDoneS);
+}
+
+// More boards than slots: ids wrap, two boards per slot at most
+void test_more_boards_than_slots() {
+  makeBoards(45, true);
+  Result r = run(45, 1800, 60);
+  TEST_ASSERT_EQUAL(45, r.updated);
+  TEST_ASSERT_EQUAL(2, r.peak);
+  TEST_ASSERT_LESS_OR_EQUAL(PEAK_LIMIT, r.peak);
+}
+
+// Without board ids the MAC hash picks the slot. Boards that collide
+// overlap; with downloads shorter than a slot minus the jitter, nothing
+// else does, so the peak is the most boards sharing one slot.
+void test_hashed_slots_only_overlap_on_collision() {
+  makeBoards(30, false);
+  int shared[30] = {};
+  int mostShared = 0;
+  for (int i = 0; i < 30; i++) {
+    int slot = rolloutOffset(boards[i].mac, 0, 1800, 60) / 60;
+    if (++shared[slot] > mostShared)
+      mostShared = shared[slot];
+  }
+  Result r = run(30, 1800, 60);
+  TEST_ASSERT_EQUAL(30, r.updated);
+  TEST_ASSERT_EQUAL(mostShared, r.peak);
+}
+
+// The whole yard at once (no window) is what the scheduler prevents
+void test_no_window_is_a_stampede() {
+  makeBoards(30, true);
+  Result r = run(30, 0, 60);
+  TEST_ASSERT_EQUAL(30, r.peak);
+}
+
+// Boards with occupied tracks defer until idle. Trains running through
+// a group of sections release several boards together, which must still
+// stay under the limit.
+void test_busy_boards_defer_under_limit() {
+  makeBoards(30, true);
+  for (int i = 0; i < 30; i++) {
+    Board &b = boards[i];
+    if (next() % 3 == 0) {
+      uint32_t slotStart = i * 60;
+      b.busyFromS = slotStart;
+      b.busyUntilS = slotStart + 30 + next() % 600;
+    }
+  }
+  Result r = run(30, 1800, 60);
+  TEST_ASSERT_EQUAL(30, r.updated);
+  TEST_ASSERT_LESS_OR_EQUAL(PEAK_LIMIT, r.peak);
+}
+
+// Busy boards never start without force, forced ones start in their slot
+void test_force_ignores_busy() {
+  makeBoards(1, true);
+  Board &b = boards[0];
+  b.rollout.schedule("1.0.0", 10, 0, 0, 0, false);
+  TEST_ASSERT_FALSE(b.rollout.poll(10000, false));
+  TEST_ASSERT_EQUAL(ROLLOUT_DEFERRED, b.rollout.state());
+  TEST_ASSERT_TRUE(b.rollout.poll(11000, true));
+
+  b.rollout.schedule("1.0.0", 10, 0, 0, 0, true);
+  TEST_ASSERT_FALSE(b.rollout.poll(9999, false));
+  TEST_ASSERT_TRUE(b.rollout.poll(10000, false));
+}
+
+// A board that hears a retained command late keeps its original slot
+void test_late_board_keeps_slot() {
+  RolloutScheduler rollout;
+  rollout.schedule("1.0.0", 600, 1700000000, 1700000400, 5000, false);
+  TEST_ASSERT_EQUAL(200, rollout.secondsUntilDue(5000));
+  rollout.schedule("1.0.0", 600, 1700000000, 1700000900, 5000, false);
+  TEST_ASSERT_TRUE(rollout.poll(5000, true));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_unique_ids_never_overlap);
+  RUN_TEST(test_more_boards_than_slots);
+  RUN_TEST(test_hashed_slots_only_overlap_on_collision);
+  RUN_TEST(test_no_window_is_a_stampede);
+  RUN_TEST(test_busy_boards_defer_under_limit);
+  RUN_TEST(test_force_ignores_busy);
+  RUN_TEST(test_late_board_keeps_slot);
+  return UNITY_END();
+}
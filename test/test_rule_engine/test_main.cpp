@@ -0,0 +1,251 @@
+// RuleEngine on the host: compiling, error handling on a bad load, the
+// on()/off() timer edges, deadlines and peer operands.
+
+#include "RuleEngine.h"
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+
+static RuleEngine *engine;
+static char error[64];
+static uint64_t peers[RULE_MAX_PEERS];
+
+static uint64_t tracks(int a, int b = 0, int c = 0) {
+  uint64_t mask = 0;
+  if (a)
+    mask |= 1ULL << (a - 1);
+  if (b)
+    mask |= 1ULL << (b - 1);
+  if (c)
+    mask |= 1ULL << (c - 1);
+  return mask;
+}
+
+static void load(const char *source) {
+  bool ok = engine->load(source, error, sizeof(error));
+  TEST_ASSERT_TRUE_MESSAGE(ok, error);
+}
+
+static bool eval(uint64_t local, uint32_t nowMs, int rule = 0) {
+  engine->evaluate(local, peers, nowMs);
+  return engine->state(rule);
+}
+
+static void assertLoadFails(const char *source, const char *expected) {
+  TEST_ASSERT_FALSE(engine->load(source, error, sizeof(error)));
+  TEST_ASSERT_EQUAL_STRING(expected, error);
+}
+
+void setUp() {
+  engine = new RuleEngine();
+  memset(peers, 0, sizeof(peers));
+  error[0] = '\0';
+}
+
+void tearDown() { delete engine; }
+
+void test_operators_and_precedence() {
+  load("a = T1 | T2 & T3\n"
+       "b = !T1 ^ T2\n"
+       "c = (T1 | T2) & T3; d = a & !c # trailing comment\n"
+       "e = 1 & !0");
+  TEST_ASSERT_EQUAL(5, engine->count());
+  TEST_ASSERT_EQUAL_STRING("d", engine->name(3));
+
+  eval(tracks(1), 0);
+  TEST_ASSERT_TRUE(engine->state(0));
+  TEST_ASSERT_FALSE(engine->state(1));
+  TEST_ASSERT_FALSE(engine->state(2));
+  TEST_ASSERT_TRUE(engine->state(3));
+  TEST_ASSERT_TRUE(engine->state(4));
+
+  eval(tracks(2, 3), 0);
+  TEST_ASSERT_TRUE(engine->state(0));
+  TEST_ASSERT_FALSE(engine->state(1));
+  TEST_ASSERT_TRUE(engine->state(2));
+  TEST_ASSERT_FALSE(engine->state(3));
+
+  eval(tracks(2), 0);
+  TEST_ASSERT_FALSE(engine->state(0));
+  TEST_ASSERT_FALSE(engine->state(1));
+  eval(0, 0);
+  TEST_ASSERT_TRUE(engine->state(1));
+}
+
+void test_first_evaluation_reports_every_rule() {
+  load("a = T1; b = T2; c = 0");
+  TEST_ASSERT_EQUAL_HEX32(0x7, engine->evaluate(0, peers, 0));
+  TEST_ASSERT_EQUAL_HEX32(0, engine->evaluate(0, peers, 10));
+  TEST_ASSERT_EQUAL_HEX32(0x2, engine->evaluate(tracks(2), peers, 20));
+}
+
+void test_compile_errors() {
+  assertLoadFails("a = T65", "line 1: tracks are T1 to T64 near 'T65'");
+  assertLoadFails("a = T1\nb = x", "line 2: unknown name near 'x'");
+  assertLoadFails("a = T1\na = T2", "line 2: name already taken near 'a = T2'");
+  assertLoadFails("on = T1", "line 1: name already taken near 'on = T1'");
+  assertLoadFails("a = T1 T2", "line 1: unexpected input near 'T2'");
+  assertLoadFails("a = 2", "line 1: only 0 and 1 are values");
+  assertLoadFails("a = P2.65",
+                  "line 1: peer tracks are P<board>.1 to P<board>.64");
+
+  char many[RULE_MAX_RULES * 12];
+  many[0] = '\0';
+  for (int i = 0; i <= RULE_MAX_RULES; i++) {
+    char rule[12];
+    snprintf(rule, sizeof(rule), "r%d = T1\n", i);
+    strcat(many, rule);
+  }
+  TEST_ASSERT_FALSE(engine->load(many, error, sizeof(error)));
+  TEST_ASSERT_NOT_NULL(strstr(error, "too many rules"));
+}
+
+// A rejected push from the controller must not disturb what is running:
+// same rules, same states, same timers
+void test_compile_error_keeps_previous_rules() {
+  load("fouled = off(T1, 5000)\nbusy = fouled | T2");
+  eval(tracks(1), 1000);
+  eval(0, 2000);
+  TEST_ASSERT_TRUE(engine->state(0));
+
+  TEST_ASSERT_FALSE(engine->load("fouled = T1 &", error, sizeof(error)));
+  TEST_ASSERT_EQUAL(2, engine->count());
+  TEST_ASSERT_EQUAL_STRING("busy", engine->name(1));
+  TEST_ASSERT_TRUE(engine->state(0));
+  TEST_ASSERT_TRUE(engine->state(1));
+
+  // The hold started at 2000 still runs out at 7000
+  TEST_ASSERT_EQUAL_HEX32(0, engine->evaluate(0, peers, 6999));
+  TEST_ASSERT_EQUAL_HEX32(0x3, engine->evaluate(0, peers, 7000));
+
+  // A good load replaces the rules and starts from scratch
+  load("other = T3");
+  TEST_ASSERT_EQUAL(1, engine->count());
+  TEST_ASSERT_EQUAL_HEX32(0x1, engine->evaluate(0, peers, 8000));
+}
+
+void test_on_delay_edges() {
+  load("a = on(T1, 2000)");
+  TEST_ASSERT_FALSE(eval(tracks(1), 1000));
+  TEST_ASSERT_FALSE(eval(tracks(1), 2999));
+  TEST_ASSERT_TRUE(eval(tracks(1), 3000));
+  // Drops at once
+  TEST_ASSERT_FALSE(eval(0, 3001));
+
+  // A gap restarts the delay
+  TEST_ASSERT_FALSE(eval(tracks(1), 4000));
+  TEST_ASSERT_FALSE(eval(0, 5500));
+  TEST_ASSERT_FALSE(eval(tracks(1), 5600));
+  TEST_ASSERT_FALSE(eval(tracks(1), 7599));
+  TEST_ASSERT_TRUE(eval(tracks(1), 7600));
+}
+
+void test_off_delay_edges() {
+  load("a = off(T1, 5000)");
+  TEST_ASSERT_FALSE(eval(0, 0));
+  // Follows the input up at once
+  TEST_ASSERT_TRUE(eval(tracks(1), 1000));
+  TEST_ASSERT_TRUE(eval(0, 2000));
+  TEST_ASSERT_TRUE(eval(0, 6999));
+  TEST_ASSERT_FALSE(eval(0, 7000));
+
+  // Occupied again within the hold: the hold restarts from the next drop
+  TEST_ASSERT_TRUE(eval(tracks(1), 8000));
+  TEST_ASSERT_TRUE(eval(0, 9000));
+  TEST_ASSERT_TRUE(eval(tracks(1), 13000));
+  TEST_ASSERT_TRUE(eval(0, 13500));
+  TEST_ASSERT_TRUE(eval(0, 18499));
+  TEST_ASSERT_FALSE(eval(0, 18500));
+}
+
+void test_timers_across_millis_wrap() {
+  load("a = on(T1, 2000); b = off(T2, 3000)");
+  uint32_t t0 = 0xFFFFFFFFu - 999;
+  eval(tracks(1, 2), t0);
+  eval(tracks(1), t0 + 500);
+  TEST_ASSERT_FALSE(engine->state(0));
+  TEST_ASSERT_TRUE(engine->state(1));
+  TEST_ASSERT_EQUAL_UINT32(1500, engine->msUntilDeadline(t0 + 500));
+
+  eval(tracks(1), t0 + 1999);
+  TEST_ASSERT_FALSE(engine->state(0));
+  eval(tracks(1), t0 + 2000);
+  TEST_ASSERT_TRUE(engine->state(0));
+  TEST_ASSERT_TRUE(engine->state(1));
+  eval(tracks(1), t0 + 3500);
+  TEST_ASSERT_FALSE(engine->state(1));
+}
+
+void test_deadline_tracks_nearest_timer() {
+  load("a = T1");
+  eval(tracks(1), 0);
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, engine->msUntilDeadline(0));
+
+  load("slow = on(T1, 5000); fast = off(T2, 1500)");
+  eval(tracks(1, 2), 1000);
+  // Only the on() is counting; the off() follows its input
+  TEST_ASSERT_EQUAL_UINT32(5000, engine->msUntilDeadline(1000));
+  eval(tracks(1), 2000);
+  TEST_ASSERT_EQUAL_UINT32(1500, engine->msUntilDeadline(2000));
+  TEST_ASSERT_EQUAL_UINT32(500, engine->msUntilDeadline(3000));
+  // Overdue reads as 0, so the caller evaluates now
+  TEST_ASSERT_EQUAL_UINT32(0, engine->msUntilDeadline(4000));
+
+  // Evaluating at the deadline changes the state and moves on to the next
+  TEST_ASSERT_EQUAL_HEX32(0x2, engine->evaluate(tracks(1), peers, 3500));
+  TEST_ASSERT_EQUAL_UINT32(2500, engine->msUntilDeadline(3500));
+  TEST_ASSERT_EQUAL_HEX32(0x1, engine->evaluate(tracks(1), peers, 6000));
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, engine->msUntilDeadline(6000));
+}
+
+void test_peer_operands() {
+  load("boundary = T8 | P2.1\n"
+       "far = P7.64 & P2.3\n"
+       "both = boundary & far");
+  TEST_ASSERT_EQUAL(2, engine->peerCount());
+  TEST_ASSERT_EQUAL_UINT16(2, engine->peerBoard(0));
+  TEST_ASSERT_EQUAL_UINT16(7, engine->peerBoard(1));
+
+  TEST_ASSERT_FALSE(eval(0, 0));
+  peers[0] = 1ULL << 0;
+  TEST_ASSERT_TRUE(eval(0, 10));
+  peers[0] = 1ULL << 2;
+  peers[1] = 1ULL << 63;
+  eval(0, 20);
+  TEST_ASSERT_FALSE(engine->state(0));
+  TEST_ASSERT_TRUE(engine->state(1));
+  eval(tracks(8), 30);
+  TEST_ASSERT_TRUE(engine->state(2));
+
+  // An offline neighbour reads as all free
+  memset(peers, 0, sizeof(peers));
+  eval(tracks(8), 40);
+  TEST_ASSERT_TRUE(engine->state(0));
+  TEST_ASSERT_FALSE(engine->state(1));
+}
+
+void test_too_many_peers() {
+  char source[128] = "a = 0";
+  for (int i = 1; i <= RULE_MAX_PEERS + 1; i++) {
+    char operand[12];
+    snprintf(operand, sizeof(operand), " | P%d.1", i);
+    strcat(source, operand);
+  }
+  TEST_ASSERT_FALSE(engine->load(source, error, sizeof(error)));
+  TEST_ASSERT_NOT_NULL(strstr(error, "too many peer boards"));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_operators_and_precedence);
+  RUN_TEST(test_first_evaluation_reports_every_rule);
+  RUN_TEST(test_compile_errors);
+  RUN_TEST(test_compile_error_keeps_previous_rules);
+  RUN_TEST(test_on_delay_edges);
+  RUN_TEST(test_off_delay_edges);
+  RUN_TEST(test_timers_across_millis_wrap);
+  RUN_TEST(test_deadline_tracks_nearest_timer);
+  RUN_TEST(test_peer_operands);
+  RUN_TEST(test_too_many_peers);
+  return UNITY_END();
+}
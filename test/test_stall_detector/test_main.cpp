@@ -0,0 +1,151 @@
+// StallDetector on the host with an injected clock: hung sections, recovery,
+// scoped sections that are idle, and millis() wrapping around.
+
+#include "StallDetector.h"
+#include <unity.h>
+
+static StallDetector *detector;
+static StallInfo worst;
+static int loop, network, web;
+
+void setUp() {
+  detector = new StallDetector();
+  loop = detector->add("loop", 2000);
+  network = detector->add("network", 5000);
+  web = detector->add("web", 5000);
+}
+
+void tearDown() { delete detector; }
+
+void test_hung_section_reported() {
+  detector->progress(loop, 1000);
+  detector->progress(network, 1000);
+  TEST_ASSERT_TRUE(detector->check(3000, worst));
+  TEST_ASSERT_EQUAL(-1, worst.section);
+
+  detector->progress(network, 3000);
+  TEST_ASSERT_FALSE(detector->check(3001, worst));
+  TEST_ASSERT_EQUAL(loop, worst.section);
+  TEST_ASSERT_EQUAL_STRING("loop", worst.name);
+  TEST_ASSERT_EQUAL_UINT32(2001, worst.stalledMs);
+  TEST_ASSERT_FALSE(worst.busy);
+  TEST_ASSERT_EQUAL_STRING("", worst.inside);
+}
+
+void test_worst_stall_wins() {
+  detector->progress(loop, 1000);
+  detector->progress(network, 0);
+  // loop 7000 ms over its 2000, network 8000 over its 5000
+  TEST_ASSERT_FALSE(detector->check(8000, worst));
+  TEST_ASSERT_EQUAL_STRING("network", worst.name);
+  TEST_ASSERT_EQUAL_UINT32(8000, worst.stalledMs);
+}
+
+void test_recovery() {
+  detector->progress(loop, 0);
+  TEST_ASSERT_FALSE(detector->check(2500, worst));
+  detector->progress(loop, 2600);
+  TEST_ASSERT_TRUE(detector->check(2700, worst));
+  TEST_ASSERT_EQUAL_UINT32(100, detector->ageMs(loop, 2700));
+}
+
+void test_no_stall_before_first_progress() {
+  // Start-up may take any time
+  TEST_ASSERT_TRUE(detector->check(60000, worst));
+  TEST_ASSERT_EQUAL_UINT32(0, detector->ageMs(loop, 60000));
+}
+
+// A section used only with scopes is idle between requests for any time,
+// and judged by the scope while inside one
+void test_scoped_section_idle_not_counted() {
+  detector->enter(web, 1000);
+  detector->leave(web);
+  TEST_ASSERT_TRUE(detector->check(600000, worst));
+
+  detector->enter(web, 600000);
+  TEST_ASSERT_EQUAL_UINT32(5000, detector->busyMs(web, 605000));
+  TEST_ASSERT_TRUE(detector->check(605000, worst));
+  TEST_ASSERT_FALSE(detector->check(605001, worst));
+  TEST_ASSERT_EQUAL_STRING("web", worst.name);
+  TEST_ASSERT_TRUE(worst.busy);
+
+  detector->leave(web);
+  TEST_ASSERT_TRUE(detector->check(605002, worst));
+  TEST_ASSERT_EQUAL_UINT32(0, detector->busyMs(web, 605002));
+}
+
+// A reporting section inside a short scope is judged by the scope, not by
+// its last report
+void test_scope_covers_reporting_section() {
+  detector->progress(loop, 0);
+  detector->enter(loop, 1500);
+  TEST_ASSERT_TRUE(detector->check(3000, worst));
+  detector->leave(loop);
+  TEST_ASSERT_FALSE(detector->check(3000, worst));
+  TEST_ASSERT_FALSE(worst.busy);
+}
+
+// The loop stopped reporting after entering a scope that is not overdue
+// yet: the scope is named as where it is stuck
+void test_stuck_inside_other_section() {
+  detector->progress(loop, 1000);
+  detector->enter(web, 1500);
+  TEST_ASSERT_FALSE(detector->check(3500, worst));
+  TEST_ASSERT_EQUAL_STRING("loop", worst.name);
+  TEST_ASSERT_EQUAL_STRING("web", worst.inside);
+
+  // Entered before the last report: not the culprit
+  detector->leave(web);
+  detector->enter(web, 500);
+  TEST_ASSERT_FALSE(detector->check(3500, worst));
+  TEST_ASSERT_EQUAL_STRING("", worst.inside);
+}
+
+void test_millis_wraparound() {
+  uint32_t t0 = 0xFFFFFFFFu - 500;
+  detector->progress(loop, t0);
+  detector->enter(web, t0);
+  TEST_ASSERT_TRUE(detector->check(t0 + 2000, worst));
+  TEST_ASSERT_EQUAL_UINT32(2000, detector->ageMs(loop, t0 + 2000));
+  TEST_ASSERT_EQUAL_UINT32(2000, detector->busyMs(web, t0 + 2000));
+
+  TEST_ASSERT_FALSE(detector->check(t0 + 2001, worst));
+  TEST_ASSERT_EQUAL_STRING("loop", worst.name);
+  TEST_ASSERT_EQUAL_UINT32(2001, worst.stalledMs);
+
+  detector->progress(loop, t0 + 2100);
+  TEST_ASSERT_FALSE(detector->check(t0 + 5001, worst));
+  TEST_ASSERT_EQUAL_STRING("web", worst.name);
+  TEST_ASSERT_TRUE(worst.busy);
+}
+
+void test_table_full() {
+  for (int i = detector->count(); i < SUPERVISOR_MAX_SECTIONS; i++)
+    TEST_ASSERT_EQUAL(i, detector->add("extra", 1000));
+  TEST_ASSERT_EQUAL(-1, detector->add("one too many", 1000));
+  // An unregistered section is ignored
+  detector->progress(-1, 0);
+  detector->enter(-1, 0);
+  detector->leave(-1);
+  TEST_ASSERT_TRUE(detector->check(10000, worst));
+}
+
+void test_long_name_truncated() {
+  int s = detector->add("a-very-long-section-name", 1000);
+  TEST_ASSERT_EQUAL_STRING("a-very-long-sec", detector->name(s));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_hung_section_reported);
+  RUN_TEST(test_worst_stall_wins);
+  RUN_TEST(test_recovery);
+  RUN_TEST(test_no_stall_before_first_progress);
+  RUN_TEST(test_scoped_section_idle_not_counted);
+  RUN_TEST(test_scope_covers_reporting_section);
+  RUN_TEST(test_stuck_inside_other_section);
+  RUN_TEST(test_millis_wraparound);
+  RUN_TEST(test_table_full);
+  RUN_TEST(test_long_name_truncated);
+  return UNITY_END();
+}
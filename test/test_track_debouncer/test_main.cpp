@@ -0,0 +1,346 @@
+// TrackDebouncer on the host: a clean edge, bounce bursts widening the
+// adaptive window to 1.5 x bounce + margin, the DEBOUNCE_MIN_MS and
+// DEBOUNCE_MAX_MS clamps, glitches counted without a change, and low-power
+// mode (waking on edges and at msUntilSettled()) committing the same
+// transitions at the same times as sampling every 1 ms.
+
+#include "TrackDebouncer.h"
+#include <stdio.h>
+#include <unity.h>
+#include <vector>
+
+struct Edge {
+  uint32_t atMs;
+  int raw;
+};
+
+struct Change {
+  uint32_t atMs; // Sample that reported the change
+  int state;
+  int64_t changedAtUs;
+};
+
+static const int MAX_CHANGES = 16;
+
+static TrackDebouncer *debouncer;
+static Change changes[MAX_CHANGES];
+static int changeCount;
+
+// Feed the raw level given by edges to channel 0 every 1 ms from fromMs to
+// toMs inclusive, counting each change reported and keeping the first few
+static void sample(const Edge *edges, int count, uint32_t fromMs,
+                   uint32_t toMs) {
+  int raw = debouncer->state(0);
+  int next = 0;
+  for (uint32_t t = fromMs; t <= toMs; t++) {
+    while (next < count && edges[next].atMs <= t)
+      raw = edges[next++].raw;
+    if (!debouncer->update(0, raw, t))
+      continue;
+    if (changeCount < MAX_CHANGES) {
+      changes[changeCount].atMs = t;
+      changes[changeCount].state = debouncer->state(0);
+      changes[changeCount].changedAtUs = debouncer->changedAtUs(0);
+    }
+    changeCount++;
+  }
+}
+
+// One clean edge to raw at atMs, sampled until it has settled
+static void cleanEdge(int raw, uint32_t atMs) {
+  Edge edge = {atMs, raw};
+  sample(&edge, 1, atMs, atMs + debouncer->windowMs(0) + 1);
+}
+
+void setUp() {
+  debouncer = new TrackDebouncer();
+  debouncer->reset(0, 0, 0);
+  changeCount = 0;
+}
+
+void tearDown() { delete debouncer; }
+
+void test_clean_edge() {
+  debouncer->configure(0, 50, false);
+  Edge edge = {1000, 1};
+  sample(&edge, 1, 1000, 1050);
+  TEST_ASSERT_EQUAL(0, changeCount);
+  TEST_ASSERT_EQUAL(0, debouncer->state(0));
+
+  // Accepted once quiet for more than the window, dated by the edge
+  sample(&edge, 1, 1051, 1100);
+  TEST_ASSERT_EQUAL(1, changeCount);
+  TEST_ASSERT_EQUAL_UINT32(1051, changes[0].atMs);
+  TEST_ASSERT_EQUAL(1, changes[0].state);
+  TEST_ASSERT_TRUE(changes[0].changedAtUs == 1000000);
+  TEST_ASSERT_EQUAL_UINT32(0, debouncer->glitchCount(0));
+  // A fixed window stays put
+  TEST_ASSERT_EQUAL_UINT16(50, debouncer->windowMs(0));
+}
+
+void test_captured_edge_time_dates_the_change() {
+  debouncer->configure(0, 50, false);
+  debouncer->update(0, 1, 1003, 1000250);
+  for (uint32_t t = 1004; t <= 1053; t++)
+    TEST_ASSERT_FALSE(debouncer->update(0, 1, t));
+  TEST_ASSERT_TRUE(debouncer->changedAtUs(0) == 0);
+  TEST_ASSERT_TRUE(debouncer->update(0, 1, 1054));
+  TEST_ASSERT_TRUE(debouncer->changedAtUs(0) == 1000250);
+}
+
+// Contacts bouncing for 60 ms: one change, dated by the first edge, and
+// the window widens to 1.5 x 60 + 5 at once
+void test_bounce_burst_widens_window() {
+  debouncer->configure(0, 20, true);
+  Edge bounce[] = {{1000, 1}, {1015, 0}, {1030, 1}, {1045, 0}, {1060, 1}};
+  sample(bounce, 5, 1000, 1200);
+  TEST_ASSERT_EQUAL(1, changeCount);
+  TEST_ASSERT_EQUAL_UINT32(1081, changes[0].atMs);
+  TEST_ASSERT_TRUE(changes[0].changedAtUs == 1000000);
+  TEST_ASSERT_EQUAL_UINT16(60, debouncer->bounceMs(0));
+  TEST_ASSERT_EQUAL_UINT16(60 + 30 + DEBOUNCE_MARGIN_MS,
+                           debouncer->windowMs(0));
+
+  // Slow decay: a clean edge takes an eighth of the gap off the estimate
+  cleanEdge(0, 2000);
+  TEST_ASSERT_EQUAL_UINT16(52, debouncer->bounceMs(0));
+  TEST_ASSERT_EQUAL_UINT16(52 + 26 + DEBOUNCE_MARGIN_MS,
+                           debouncer->windowMs(0));
+  TEST_ASSERT_EQUAL(2, changeCount);
+}
+
+// A fixed window ignores the bounce length
+void test_fixed_window_not_adapted() {
+  debouncer->configure(0, 20, false);
+  Edge bounce[] = {{1000, 1}, {1015, 0}, {1030, 1}, {1045, 0}, {1060, 1}};
+  sample(bounce, 5, 1000, 1200);
+  TEST_ASSERT_EQUAL(1, changeCount);
+  TEST_ASSERT_EQUAL_UINT16(20, debouncer->windowMs(0));
+}
+
+// Clean edges decay the estimate to nothing; the window stops at the floor
+void test_window_clamped_to_min() {
+  debouncer->configure(0, 10, true);
+  uint32_t t = 1000;
+  for (int i = 0; i < 40; i++, t += 100)
+    cleanEdge(i % 2 ? 0 : 1, t);
+  TEST_ASSERT_EQUAL(40, changeCount);
+  TEST_ASSERT_EQUAL_UINT16(0, debouncer->bounceMs(0));
+  TEST_ASSERT_EQUAL_UINT16(DEBOUNCE_MIN_MS, debouncer->windowMs(0));
+}
+
+// A 450 ms burst asks for 680 ms and gets the ceiling; a burst longer than
+// the ceiling is counted as the ceiling
+void test_window_clamped_to_max() {
+  debouncer->configure(0, 200, true);
+  Edge chatter[] = {{1000, 1}, {1100, 0}, {1200, 1}, {1300, 0}, {1450, 1}};
+  sample(chatter, 5, 1000, 2000);
+  TEST_ASSERT_EQUAL(1, changeCount);
+  TEST_ASSERT_EQUAL_UINT16(450, debouncer->bounceMs(0));
+  TEST_ASSERT_EQUAL_UINT16(DEBOUNCE_MAX_MS, debouncer->windowMs(0));
+
+  Edge longer[] = {{3000, 0}, {3400, 1}, {3800, 0}};
+  sample(longer, 3, 3000, 4400);
+  TEST_ASSERT_EQUAL(2, changeCount);
+  TEST_ASSERT_EQUAL_UINT16(DEBOUNCE_MAX_MS, debouncer->bounceMs(0));
+  TEST_ASSERT_EQUAL_UINT16(DEBOUNCE_MAX_MS, debouncer->windowMs(0));
+}
+
+// A pulse shorter than the window ends where it started: counted as a
+// glitch, the state never changes
+void test_glitch_counted_not_committed() {
+  debouncer->configure(0, 50, false);
+  Edge pulse[] = {{1000, 1}, {1020, 0}};
+  sample(pulse, 2, 1000, 1200);
+  TEST_ASSERT_EQUAL(0, changeCount);
+  TEST_ASSERT_EQUAL(0, debouncer->state(0));
+  TEST_ASSERT_EQUAL_UINT32(1, debouncer->glitchCount(0));
+
+  // A bouncing pulse is one glitch, not one per edge
+  Edge burst[] = {{2000, 1}, {2010, 0}, {2020, 1}, {2030, 0}};
+  sample(burst, 4, 2000, 2200);
+  TEST_ASSERT_EQUAL(0, changeCount);
+  TEST_ASSERT_EQUAL_UINT32(2, debouncer->glitchCount(0));
+}
+
+void test_channels_independent() {
+  debouncer->reset(1, 1, 0);
+  debouncer->configure(0, 50, false);
+  debouncer->configure(1, 30, true);
+  debouncer->update(1, 0, 1000);
+  TEST_ASSERT_EQUAL_UINT32(31, debouncer->msUntilSettled(2, 1000));
+  cleanEdge(1, 1000);
+  TEST_ASSERT_EQUAL(1, changeCount);
+  TEST_ASSERT_TRUE(debouncer->isAdaptive(1));
+  TEST_ASSERT_FALSE(debouncer->isAdaptive(0));
+  TEST_ASSERT_EQUAL(1, debouncer->state(1));
+  TEST_ASSERT_TRUE(debouncer->update(1, 0, 1031));
+  TEST_ASSERT_EQUAL(0, debouncer->state(1));
+}
+
+// --- Low power equivalence ---
+
+static const int TRACE_CHANNELS = 4;
+
+struct TraceEdge {
+  uint32_t atMs;
+  int ch;
+  int raw;
+};
+
+struct Commit {
+  uint32_t atMs;
+  int ch;
+  int state;
+  int64_t changedAtUs;
+  bool operator==(const Commit &o) const {
+    return atMs == o.atMs && ch == o.ch && state == o.state &&
+           changedAtUs == o.changedAtUs;
+  }
+};
+
+static uint32_t rng = 2024;
+
+static uint32_t nextRandom() {
+  rng = rng * 1103515245u + 12345u;
+  return rng >> 8;
+}
+
+// Clean edges, bounce bursts and short glitches on every channel, in time
+// order
+static std::vector<TraceEdge> makeTrace(uint32_t lengthMs) {
+  std::vector<TraceEdge> trace;
+  int level[TRACE_CHANNELS] = {0, 0, 0, 0};
+  for (uint32_t t = 1000; t < lengthMs; t += 20 + nextRandom() % 700) {
+    int ch = nextRandom() % TRACE_CHANNELS;
+    int kind = nextRandom() % 3;
+    int edges = kind == 0 ? 1 : 2 + nextRandom() % 6;
+    uint32_t at = t;
+    for (int e = 0; e < edges; e++) {
+      level[ch] = !level[ch];
+      TraceEdge edge = {at, ch, level[ch]};
+      trace.push_back(edge);
+      at += 1 + nextRandom() % (kind == 1 ? 15 : 40);
+    }
+    // A glitch ends where it started
+    if (kind == 2 && edges % 2) {
+      level[ch] = !level[ch];
+      TraceEdge edge = {at, ch, level[ch]};
+      trace.push_back(edge);
+    }
+  }
+  return trace;
+}
+
+static void configureTraceChannels(TrackDebouncer &d) {
+  for (int ch = 0; ch < TRACE_CHANNELS; ch++) {
+    d.reset(ch, 0, 0);
+    d.configure(ch, ch % 2 ? 30 : 50, ch >= 2);
+  }
+}
+
+// Raw levels at nowMs: every edge up to and including it applied
+static void applyEdges(const std::vector<TraceEdge> &trace, size_t &next,
+                       uint32_t nowMs, int *raw) {
+  while (next < trace.size() && trace[next].atMs <= nowMs) {
+    raw[trace[next].ch] = trace[next].raw;
+    next++;
+  }
+}
+
+static void updateAll(TrackDebouncer &d, const int *raw, uint32_t nowMs,
+                      std::vector<Commit> &out) {
+  for (int ch = 0; ch < TRACE_CHANNELS; ch++) {
+    if (d.update(ch, raw[ch], nowMs)) {
+      Commit c = {nowMs, ch, d.state(ch), d.changedAtUs(ch)};
+      out.push_back(c);
+    }
+  }
+}
+
+// Always on: loop() samples every millisecond
+static void runAlwaysOn(TrackDebouncer &d,
+                        const std::vector<TraceEdge> &trace,
+                        uint32_t lengthMs, std::vector<Commit> &out) {
+  configureTraceChannels(d);
+  int raw[TRACE_CHANNELS] = {0, 0, 0, 0};
+  size_t next = 0;
+  for (uint32_t t = 1; t <= lengthMs; t++) {
+    applyEdges(trace, next, t, raw);
+    updateAll(d, raw, t, out);
+  }
+}
+
+// Low power: loop() sleeps until the next input edge or until
+// msUntilSettled() says a burst can end, and samples only then. The 50 ms
+// bound main.cpp adds is left out, so only these wakes are relied on.
+static uint32_t runLowPower(TrackDebouncer &d,
+                            const std::vector<TraceEdge> &trace,
+                            uint32_t lengthMs, std::vector<Commit> &out) {
+  configureTraceChannels(d);
+  int raw[TRACE_CHANNELS] = {0, 0, 0, 0};
+  size_t next = 0;
+  uint32_t wakes = 0;
+  uint32_t t = 1;
+  while (t <= lengthMs) {
+    applyEdges(trace, next, t, raw);
+    updateAll(d, raw, t, out);
+    wakes++;
+
+    uint32_t wake = UINT32_MAX;
+    uint32_t settle = d.msUntilSettled(TRACE_CHANNELS, t);
+    if (settle != UINT32_MAX)
+      wake = t + (settle ? settle : 1);
+    if (next < trace.size() && trace[next].atMs < wake)
+      wake = trace[next].atMs;
+    if (wake == UINT32_MAX)
+      break;
+    t = wake;
+  }
+  return wakes;
+}
+
+void test_low_power_matches_always_on() {
+  const uint32_t LENGTH_MS = 600000;
+  std::vector<TraceEdge> trace = makeTrace(LENGTH_MS - 1000);
+  TrackDebouncer spinning, sleeping;
+  std::vector<Commit> alwaysOn, lowPower;
+  runAlwaysOn(spinning, trace, LENGTH_MS, alwaysOn);
+  uint32_t wakes = runLowPower(sleeping, trace, LENGTH_MS, lowPower);
+
+  char line[128];
+  snprintf(line, sizeof(line),
+           "%u edges: %u transitions, %u wakes against %u samples",
+           (unsigned)trace.size(), (unsigned)alwaysOn.size(),
+           (unsigned)wakes, (unsigned)LENGTH_MS);
+  TEST_MESSAGE(line);
+
+  TEST_ASSERT_GREATER_THAN(100, (int)alwaysOn.size());
+  TEST_ASSERT_EQUAL(alwaysOn.size(), lowPower.size());
+  for (size_t i = 0; i < alwaysOn.size(); i++) {
+    TEST_ASSERT_EQUAL_UINT32(alwaysOn[i].atMs, lowPower[i].atMs);
+    TEST_ASSERT_TRUE(alwaysOn[i] == lowPower[i]);
+  }
+  // Same glitches, and the adaptive windows saw the same bursts
+  for (int ch = 0; ch < TRACE_CHANNELS; ch++) {
+    TEST_ASSERT_GREATER_THAN(0, (int)spinning.glitchCount(ch));
+    TEST_ASSERT_EQUAL_UINT32(spinning.glitchCount(ch),
+                             sleeping.glitchCount(ch));
+    TEST_ASSERT_EQUAL_UINT16(spinning.windowMs(ch), sleeping.windowMs(ch));
+    TEST_ASSERT_EQUAL_UINT16(spinning.bounceMs(ch), sleeping.bounceMs(ch));
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_clean_edge);
+  RUN_TEST(test_captured_edge_time_dates_the_change);
+  RUN_TEST(test_bounce_burst_widens_window);
+  RUN_TEST(test_fixed_window_not_adapted);
+  RUN_TEST(test_window_clamped_to_min);
+  RUN_TEST(test_window_clamped_to_max);
+  RUN_TEST(test_glitch_counted_not_committed);
+  RUN_TEST(test_channels_independent);
+  RUN_TEST(test_low_power_matches_always_on);
+  return UNITY_END();
+}
@@ -0,0 +1,262 @@
+// TrackStats on the host: occupancy leaving the 1 min window as its 5 s
+// slots roll over, the running window sums against a brute-force recount
+// after every ring has wrapped (and millis() with them), and the dwell
+// histogram bin edges.
+
+#include "TrackStats.h"
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+#include <vector>
+
+static const int TRACKS = 4;
+
+static TrackStats *stats;
+static TrackWindowStats ws;
+
+static void beginAllFree(uint32_t nowMs) {
+  bool occupied[TRACKS] = {false, false, false, false};
+  stats->begin(nowMs, occupied, TRACKS);
+}
+
+// What the sketch does: close elapsed slots, then feed the edge
+static void edge(int track, bool occupied, uint32_t nowMs) {
+  stats->tick(nowMs);
+  stats->onTransition(track, occupied, nowMs);
+}
+
+static void get1m(int track, uint32_t nowMs) {
+  stats->tick(nowMs);
+  stats->get(track, STATS_WINDOW_1M, nowMs, ws);
+}
+
+void setUp() { stats = new TrackStats(); }
+
+void tearDown() { delete stats; }
+
+void test_occupancy_expires_with_slots() {
+  beginAllFree(0);
+  edge(0, true, 0);
+  edge(0, false, 10000);
+
+  get1m(0, 10000);
+  TEST_ASSERT_EQUAL_UINT32(10000, ws.occupiedMs);
+  TEST_ASSERT_EQUAL_UINT32(2, ws.transitions);
+
+  // The ring holds 12 slots: until the 12th closes nothing leaves
+  get1m(0, 59999);
+  TEST_ASSERT_EQUAL_UINT32(10000, ws.occupiedMs);
+  TEST_ASSERT_EQUAL_UINT32(59999, ws.windowMs);
+
+  // 0-5 s leaves with the occupied edge in it
+  get1m(0, 60000);
+  TEST_ASSERT_EQUAL_UINT32(5000, ws.occupiedMs);
+  TEST_ASSERT_EQUAL_UINT32(55000, ws.windowMs);
+  TEST_ASSERT_EQUAL_UINT32(1, ws.transitions);
+  get1m(0, 64999);
+  TEST_ASSERT_EQUAL_UINT32(5000, ws.occupiedMs);
+
+  // Then 5-10 s, the last occupied time
+  get1m(0, 65000);
+  TEST_ASSERT_EQUAL_UINT32(0, ws.occupiedMs);
+  TEST_ASSERT_EQUAL_UINT32(1, ws.transitions);
+  TEST_ASSERT_EQUAL_UINT32(55000, ws.windowMs);
+
+  // The free edge at 10 s opened the 10-15 s slot and leaves with it
+  get1m(0, 70000);
+  TEST_ASSERT_EQUAL_UINT32(0, ws.transitions);
+
+  // The 1 h window still has all of it
+  stats->get(0, STATS_WINDOW_1H, 70000, ws);
+  TEST_ASSERT_EQUAL_UINT32(10000, ws.occupiedMs);
+  TEST_ASSERT_EQUAL_UINT32(2, ws.transitions);
+  TEST_ASSERT_EQUAL_UINT32(70000, ws.windowMs);
+}
+
+// A track still occupied is counted up to now, not to the last slot end
+void test_open_occupancy_counted_to_now() {
+  beginAllFree(0);
+  edge(1, true, 2000);
+  get1m(1, 7500);
+  TEST_ASSERT_EQUAL_UINT32(5500, ws.occupiedMs);
+  TEST_ASSERT_EQUAL_UINT32(1, ws.transitions);
+  get1m(1, 70000);
+  TEST_ASSERT_EQUAL_UINT32(55000, ws.occupiedMs);
+  TEST_ASSERT_EQUAL_UINT32(55000, ws.windowMs);
+  TEST_ASSERT_EQUAL_UINT32(0, ws.transitions);
+
+  // Other tracks are untouched
+  stats->get(0, STATS_WINDOW_1M, 70000, ws);
+  TEST_ASSERT_EQUAL_UINT32(0, ws.occupiedMs);
+}
+
+// Per slot, what the stats saw: occupied time and changes per track
+struct Slot {
+  uint32_t occupiedMs[TRACKS];
+  uint16_t transitions[TRACKS];
+};
+
+static uint32_t rng = 12345;
+
+static uint32_t nextRandom() {
+  rng = rng * 1103515245u + 12345u;
+  return rng >> 8;
+}
+
+// Recount a window from the slot history the way its buckets split it
+static void recount(const std::vector<Slot> &slots, StatsWindowId window,
+                    int track, uint32_t &occupiedMs, uint32_t &transitions) {
+  static const uint32_t bucketCount[] = {12, 12, 24};
+  static const uint32_t slotsPerBucket[] = {1, 60, 720};
+  uint32_t closed = slots.size();
+  uint32_t filled = closed / slotsPerBucket[window] + 1;
+  if (filled > bucketCount[window])
+    filled = bucketCount[window];
+  uint32_t n =
+      (filled - 1) * slotsPerBucket[window] + closed % slotsPerBucket[window];
+
+  occupiedMs = 0;
+  transitions = 0;
+  for (uint32_t i = closed - n; i < closed; i++) {
+    // Buckets keep 100 ms units, rounded per slot
+    occupiedMs += (slots[i].occupiedMs[track] + 50) / 100 * 100;
+    transitions += slots[i].transitions[track];
+  }
+}
+
+// 30 hours of random traffic starting 30 minutes before millis() wraps:
+// every window ring wraps at least once and the subtract-on-expiry sums
+// must still match a recount at every check
+void test_sums_match_recount_after_wraparound() {
+  const uint32_t t0 = 0xFFFFFFFFu - 30 * 60000u;
+  const uint32_t SLOTS = 30 * 3600 / 5;
+  beginAllFree(t0);
+
+  std::vector<Slot> slots;
+  slots.reserve(SLOTS);
+  bool occupied[TRACKS] = {false, false, false, false};
+  uint32_t checks = 0;
+
+  for (uint32_t s = 0; s < SLOTS; s++) {
+    uint32_t slotStart = t0 + s * STATS_SLOT_MS;
+    Slot slot;
+    memset(&slot, 0, sizeof(slot));
+    uint32_t mark[TRACKS];
+    for (int t = 0; t < TRACKS; t++)
+      mark[t] = 0;
+
+    // Up to three edges per slot on a random track; track 3 stays quiet
+    int edges = nextRandom() % 4;
+    uint32_t at = 0;
+    for (int e = 0; e < edges; e++) {
+      at += 1 + nextRandom() % 1600;
+      if (at >= STATS_SLOT_MS)
+        break;
+      int t = nextRandom() % (TRACKS - 1);
+      if (occupied[t])
+        slot.occupiedMs[t] += at - mark[t];
+      mark[t] = at;
+      occupied[t] = !occupied[t];
+      slot.transitions[t]++;
+      edge(t, occupied[t], slotStart + at);
+    }
+    for (int t = 0; t < TRACKS; t++)
+      if (occupied[t])
+        slot.occupiedMs[t] += STATS_SLOT_MS - mark[t];
+    slots.push_back(slot);
+
+    // Check on every slot for the first and last hours, then now and then
+    uint32_t slotEnd = slotStart + STATS_SLOT_MS;
+    if (s > 720 && s < SLOTS - 720 && s % 97 != 0)
+      continue;
+    stats->tick(slotEnd);
+    for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+      for (int t = 0; t < TRACKS; t++) {
+        uint32_t occupiedMs, transitions;
+        recount(slots, (StatsWindowId)w, t, occupiedMs, transitions);
+        stats->get(t, (StatsWindowId)w, slotEnd, ws);
+        TEST_ASSERT_EQUAL_UINT32(occupiedMs, ws.occupiedMs);
+        TEST_ASSERT_EQUAL_UINT32(transitions, ws.transitions);
+        TEST_ASSERT_LESS_OR_EQUAL(ws.windowMs, ws.occupiedMs);
+      }
+    }
+    checks++;
+  }
+
+  // Full rings ending on a bucket edge cover one bucket less than their
+  // length
+  uint32_t end = t0 + SLOTS * STATS_SLOT_MS;
+  stats->get(0, STATS_WINDOW_1H, end, ws);
+  TEST_ASSERT_EQUAL_UINT32(11 * 300000u, ws.windowMs);
+  stats->get(0, STATS_WINDOW_24H, end, ws);
+  TEST_ASSERT_EQUAL_UINT32(23 * 3600000u, ws.windowMs);
+  stats->get(3, STATS_WINDOW_24H, end, ws);
+  TEST_ASSERT_EQUAL_UINT32(0, ws.occupiedMs);
+  TEST_ASSERT_EQUAL_UINT32(0, ws.transitions);
+
+  char line[80];
+  snprintf(line, sizeof(line), "%u slots, %u checks against a recount",
+           (unsigned)SLOTS, (unsigned)checks);
+  TEST_MESSAGE(line);
+}
+
+// One occupancy of durationMs, returning the bin it landed in
+static int dwellBinOf(uint32_t durationMs) {
+  beginAllFree(0);
+  edge(0, true, 0);
+  edge(0, false, durationMs);
+  const uint32_t *histogram = stats->dwellHistogram(0);
+  int bin = -1;
+  for (int b = 0; b < STATS_DWELL_BINS; b++) {
+    if (histogram[b] == 0)
+      continue;
+    TEST_ASSERT_EQUAL(-1, bin);
+    TEST_ASSERT_EQUAL_UINT32(1, histogram[b]);
+    bin = b;
+  }
+  return bin;
+}
+
+// <1 s, 1-2 s, 2-4 s, ... 512-1024 s, >=1024 s
+void test_dwell_histogram_bin_edges() {
+  TEST_ASSERT_EQUAL(0, dwellBinOf(0));
+  TEST_ASSERT_EQUAL(0, dwellBinOf(999));
+  TEST_ASSERT_EQUAL(1, dwellBinOf(1000));
+  TEST_ASSERT_EQUAL(1, dwellBinOf(1999));
+  TEST_ASSERT_EQUAL(2, dwellBinOf(2000));
+  TEST_ASSERT_EQUAL(2, dwellBinOf(3999));
+  TEST_ASSERT_EQUAL(3, dwellBinOf(4000));
+  TEST_ASSERT_EQUAL(10, dwellBinOf(512000));
+  TEST_ASSERT_EQUAL(10, dwellBinOf(1023999));
+  TEST_ASSERT_EQUAL(11, dwellBinOf(1024000));
+  TEST_ASSERT_EQUAL(11, dwellBinOf(86400000));
+}
+
+// Only completed occupancies are binned, and each track has its own
+void test_dwell_histogram_completed_only() {
+  beginAllFree(0);
+  edge(0, true, 0);
+  edge(1, true, 0);
+  edge(0, false, 500);
+  edge(1, false, 3000);
+  const uint32_t *first = stats->dwellHistogram(0);
+  const uint32_t *second = stats->dwellHistogram(1);
+  TEST_ASSERT_EQUAL_UINT32(1, first[0]);
+  TEST_ASSERT_EQUAL_UINT32(1, second[2]);
+
+  edge(2, true, 4000);
+  get1m(2, 50000);
+  const uint32_t *open = stats->dwellHistogram(2);
+  for (int b = 0; b < STATS_DWELL_BINS; b++)
+    TEST_ASSERT_EQUAL_UINT32(0, open[b]);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_occupancy_expires_with_slots);
+  RUN_TEST(test_open_occupancy_counted_to_now);
+  RUN_TEST(test_sums_match_recount_after_wraparound);
+  RUN_TEST(test_dwell_histogram_bin_edges);
+  RUN_TEST(test_dwell_histogram_completed_only);
+  return UNITY_END();
+}